@@ -3,6 +3,7 @@
 
 #include "world.hpp"
 #include "scheduler.hpp"
+#include "event.hpp"
 
 namespace ecs {
 template <AllowedEntityType Entity>
@@ -29,11 +30,17 @@ public:
     using ResourcesType = Resources<Entity>;
     using SystemArgPackType = SystemArgPack<Entity>;
 
-    using SystemType = std::function<void(SystemArgPackType)>;
     using SchedulerType = Scheduler<SystemArgPackType>;
+    using SystemType = typename SchedulerType::SystemType;
     using SchedulerStageIdType = typename SchedulerType::StageIdType;
+    using SchedulerStageSystemIdType = typename SchedulerType::StageSystemIdType;
 
-    Application() noexcept {
+    Application() noexcept : Application(std::thread::hardware_concurrency()) {
+    }
+
+    /// 三个调度器的每个 Stage 都使用 num_threads 个工作线程
+    explicit Application(const std::size_t num_threads)
+        : startup_scheduler_(num_threads), update_scheduler_(num_threads), shutdown_scheduler_(num_threads) {
         // 每个调度器默认有一个阶段
         startup_scheduler_.AddStageToFront();
         update_scheduler_.AddStageToFront();
@@ -55,17 +62,33 @@ public:
 
         // 先执行 startup
         startup_scheduler_.Execute(pack);
+        MergeCommandBuffers();
 
         // 执行命令队列
         world_.commands().Execute();
+        world_.registry().SwapComponentBuffers();
+        SwapEventBuffers();
 
         // 然后每一帧都执行 update
         while (!should_exit()) {
+            // 一帧之内工作线程保持活跃，降低任务的唤醒延迟
+            update_scheduler_.KeepWorkersHot();
+
             // 执行调度器
             update_scheduler_.Execute(pack);
+            MergeCommandBuffers();
+
+            // 执行命令队列，不同组件类型的命令借用 update 已有的线程池并行执行
+            world_.commands().Execute(update_scheduler_.GetCommandThreadPool());
+
+            // 这一帧写入的双缓冲组件在下一帧成为上一帧的值
+            world_.registry().SwapComponentBuffers();
+
+            // 这一帧发送的事件在下一帧可以读取
+            SwapEventBuffers();
 
-            // 执行命令队列
-            world_.commands().Execute();
+            // 帧与帧之间让工作线程休眠
+            update_scheduler_.ParkWorkers();
         }
 
         // 最后执行 shutdown
@@ -96,12 +119,74 @@ public:
         return shutdown_scheduler_;
     }
 
+    /// 添加一个拥有自己的命令缓冲区的 System
+    ///
+    /// 这个 System 记录命令时不会和其他 System 竞争同一个队列。调度器执行完之后，
+    /// 所有缓冲区按 System 添加的顺序合并到 World 的命令队列中，所以命令的顺序与线程的调度无关
+    SchedulerStageSystemIdType AddBufferedSystem(SchedulerType& scheduler, const SchedulerStageIdType stage,
+                                                 SystemType system) {
+        auto& buffer = *command_buffers_.emplace_back(std::make_unique<CommandsType>(world_));
+
+        return scheduler.AddSystemToStage(stage, [&buffer, system = std::move(system)](SystemArgPackType pack) {
+            system(SystemArgPackType{
+                .viewer = pack.viewer,
+                .commands = buffer,
+                .resources = pack.resources
+            });
+        });
+    }
+
+    /// 调度器的工作线程数量，三个调度器相同，创建 WorkerLocal 和 EventChannel 时用它作为槽位数
+    [[nodiscard]] std::size_t ThreadCount() const noexcept {
+        return update_scheduler_.ThreadCount();
+    }
+
+    /// 添加一种事件通道，它作为资源放进 Resources，System 通过 GetResourceReference 访问
+    ///
+    /// 缓冲区的数量按调度器实际的线程数分配。每一帧结束时交换通道的缓冲区，已经存在时直接返回已有的通道
+    template <AllowedEventType Event>
+    EventChannel<Event>& AddEventChannel() {
+        using ChannelType = EventChannel<Event>;
+
+        if (auto* channel = resources().template GetResourcePointer<ChannelType>()) {
+            return *channel;
+        }
+
+        resources().UpsertResource(ChannelType(ThreadCount()));
+        event_swaps_.push_back([](ResourcesType& resources) noexcept {
+            // 通道可能已经被删除了
+            if (auto* channel = resources.template GetResourcePointer<ChannelType>()) {
+                channel->Swap();
+            }
+        });
+        return resources().template GetResourceReference<ChannelType>();
+    }
+
+private:
+    void SwapEventBuffers() noexcept {
+        for (const auto swap : event_swaps_) {
+            swap(resources());
+        }
+    }
+
+    constexpr void MergeCommandBuffers() {
+        for (const auto& buffer : command_buffers_) {
+            world_.commands().Append(*buffer);
+        }
+    }
+
 private:
     WorldType world_{};
 
-    SchedulerType startup_scheduler_{};
-    SchedulerType update_scheduler_{};
-    SchedulerType shutdown_scheduler_{};
+    SchedulerType startup_scheduler_;
+    SchedulerType update_scheduler_;
+    SchedulerType shutdown_scheduler_;
+
+    // AddBufferedSystem 添加的 System 的命令缓冲区，按添加的顺序排列
+    std::vector<std::unique_ptr<CommandsType>> command_buffers_;
+
+    // AddEventChannel 添加的每种事件通道的交换函数
+    std::vector<void (*)(ResourcesType&) noexcept> event_swaps_;
 };
 
 
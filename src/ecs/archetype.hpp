@@ -0,0 +1,686 @@
+#ifndef ARCHETYPE_HPP
+#define ARCHETYPE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+#include "component.hpp"
+#include "entity.hpp"
+#include "viewer.hpp"
+
+namespace ecs {
+template <AllowedEntityType Entity>
+class ArchetypeRegistry;
+
+namespace internal {
+/// 一个 Archetype 中一行所在的位置
+struct ArchetypeRow {
+    std::size_t chunk;
+    std::size_t row;
+};
+
+/// 一列组件的大小和对齐
+struct ArchetypeColumnLayout {
+    std::size_t size;
+    std::size_t alignment;
+};
+
+/// 组件集合完全相同的实体放在同一个 Archetype 中
+///
+/// 数据按块存放，每一块中每种组件占一列，列内紧密排列，所以遍历时是按列线性扫描。
+/// 每一列的起点按这种组件的对齐方式对齐，块按所有列中最大的对齐方式分配
+template <AllowedEntityType Entity>
+class Archetype {
+public:
+    using EntityOriginalType = typename EntityTraits<Entity>::OriginalType;
+
+private:
+    /// 和分配时相同的对齐方式释放块
+    struct ChunkDeleter {
+        std::align_val_t alignment;
+
+        void operator()(std::byte* chunk) const noexcept {
+            ::operator delete(chunk, alignment);
+        }
+    };
+
+    using ChunkPointerType = std::unique_ptr<std::byte[], ChunkDeleter>;
+
+public:
+    /// 每一块的目标大小
+    static constexpr std::size_t chunk_bytes_k = 16 * 1024;
+
+    static constexpr std::size_t npos_k = static_cast<std::size_t>(-1);
+
+    Archetype(std::vector<ComponentTypeId> types, const std::vector<internal::ArchetypeColumnLayout>& layouts)
+        : types_(std::move(types)) {
+        std::size_t row_size = 0;
+        for (const auto& layout : layouts) {
+            sizes_.push_back(layout.size);
+            row_size += layout.size;
+            chunk_alignment_ = std::max(chunk_alignment_, layout.alignment);
+        }
+
+        rows_per_chunk_ = std::max<std::size_t>(1, chunk_bytes_k / std::max<std::size_t>(1, row_size));
+
+        // 块的起点按最大的对齐方式对齐，所以列的偏移按各自的对齐方式对齐即可
+        std::size_t offset = 0;
+        for (const auto& layout : layouts) {
+            offset = AlignUp(offset, layout.alignment);
+            offsets_.push_back(offset);
+            offset += layout.size * rows_per_chunk_;
+        }
+        chunk_size_ = offset;
+    }
+
+    Archetype(const Archetype&) = delete;
+    Archetype& operator=(const Archetype&) = delete;
+
+    [[nodiscard]] const std::vector<ComponentTypeId>& Types() const noexcept {
+        return types_;
+    }
+
+    [[nodiscard]] std::size_t Size() const noexcept {
+        return entities_.size();
+    }
+
+    [[nodiscard]] std::size_t ColumnCount() const noexcept {
+        return types_.size();
+    }
+
+    [[nodiscard]] std::size_t RowsPerChunk() const noexcept {
+        return rows_per_chunk_;
+    }
+
+    [[nodiscard]] std::size_t ChunkCount() const noexcept {
+        return (entities_.size() + rows_per_chunk_ - 1) / rows_per_chunk_;
+    }
+
+    /// 第 chunk 块中的行数
+    [[nodiscard]] std::size_t ChunkSize(const std::size_t chunk) const noexcept {
+        return std::min(rows_per_chunk_, entities_.size() - chunk * rows_per_chunk_);
+    }
+
+    /// 组件所在的列，不存在时返回 npos_k
+    [[nodiscard]] std::size_t ColumnOf(const ComponentTypeId type_id) const noexcept {
+        const auto it = std::ranges::lower_bound(types_, type_id);
+        if (it == types_.end() || *it != type_id) return npos_k;
+        return static_cast<std::size_t>(it - types_.begin());
+    }
+
+    [[nodiscard]] bool Contains(const ComponentTypeId type_id) const noexcept {
+        return ColumnOf(type_id) != npos_k;
+    }
+
+    /// 第 chunk 块中第 column 列的起点
+    [[nodiscard]] std::byte* Column(const std::size_t chunk, const std::size_t column) noexcept {
+        return chunks_[chunk].get() + offsets_[column];
+    }
+
+    [[nodiscard]] std::byte* At(const std::size_t index, const std::size_t column) noexcept {
+        const auto [chunk, row] = Locate(index);
+        return Column(chunk, column) + row * sizes_[column];
+    }
+
+    [[nodiscard]] EntityOriginalType EntityAt(const std::size_t index) const noexcept {
+        return entities_[index];
+    }
+
+    [[nodiscard]] const EntityOriginalType* Entities(const std::size_t chunk) const noexcept {
+        return entities_.data() + chunk * rows_per_chunk_;
+    }
+
+    /// 在末尾添加一行，组件的内容没有初始化
+    std::size_t PushBack(const EntityOriginalType entity) {
+        if (entities_.size() == chunks_.size() * rows_per_chunk_) {
+            const auto alignment = static_cast<std::align_val_t>(chunk_alignment_);
+            chunks_.emplace_back(static_cast<std::byte*>(::operator new(chunk_size_, alignment)),
+                                 ChunkDeleter{alignment});
+        }
+        entities_.push_back(entity);
+        return entities_.size() - 1;
+    }
+
+    /// 用最后一行覆盖第 index 行，返回被移动的实体，没有移动时返回 nullopt
+    std::optional<EntityOriginalType> SwapAndPop(const std::size_t index) {
+        const auto last = entities_.size() - 1;
+
+        std::optional<EntityOriginalType> moved;
+        if (index != last) {
+            for (std::size_t column = 0; column < types_.size(); ++column) {
+                std::memcpy(At(index, column), At(last, column), sizes_[column]);
+            }
+            entities_[index] = entities_[last];
+            moved = entities_[index];
+        }
+
+        entities_.pop_back();
+        if (chunks_.size() > ChunkCount() + 1) {
+            // 保留一个空块，避免在边界上反复分配
+            chunks_.pop_back();
+        }
+        return moved;
+    }
+
+    /// 把 from 中第 from_index 行里两边都有的组件拷贝到这个 Archetype 的第 index 行
+    void CopyCommon(const std::size_t index, Archetype& from, const std::size_t from_index) {
+        std::size_t i = 0;
+        std::size_t j = 0;
+        while (i < types_.size() && j < from.types_.size()) {
+            if (types_[i] < from.types_[j]) {
+                ++i;
+            } else if (from.types_[j] < types_[i]) {
+                ++j;
+            } else {
+                std::memcpy(At(index, i), from.At(from_index, j), sizes_[i]);
+                ++i;
+                ++j;
+            }
+        }
+    }
+
+    // Archetype 之间的转移关系，添加或删除一种组件之后到达的 Archetype
+    std::unordered_map<ComponentTypeId, Archetype*> add_edges;
+    std::unordered_map<ComponentTypeId, Archetype*> remove_edges;
+
+private:
+    [[nodiscard]] ArchetypeRow Locate(const std::size_t index) const noexcept {
+        return {index / rows_per_chunk_, index % rows_per_chunk_};
+    }
+
+    static constexpr std::size_t AlignUp(const std::size_t value, const std::size_t alignment) noexcept {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+private:
+    std::vector<ComponentTypeId> types_;
+    std::vector<std::size_t> sizes_;
+    std::vector<std::size_t> offsets_;
+
+    std::size_t rows_per_chunk_{1};
+    std::size_t chunk_size_{0};
+    std::size_t chunk_alignment_{alignof(std::max_align_t)};
+
+    std::vector<ChunkPointerType> chunks_;
+    std::vector<EntityOriginalType> entities_;
+};
+} // namespace internal
+
+
+template <AllowedEntityType Entity,
+    bool WithEntity,
+    AllowedUniqueComponentsTupleType Required = std::tuple<>,
+    AllowedUniqueComponentsTupleType Optional = std::tuple<>,
+    AllowedUniqueComponentsTupleType Exclude = std::tuple<>>
+class ArchetypeView;
+
+
+/// 基于 Archetype 的 Registry，是 Registry 的另一种实现
+///
+/// 组件集合相同的实体放在同一张表中，每种组件一列，查询多种组件时只需要按列线性扫描，
+/// 没有每个组件一次的稀疏数组查找。挂载和卸载组件需要把实体移动到另一张表中，
+/// 表之间的转移关系会被缓存下来。接口和 Registry 中的同名函数相同。
+///
+/// 它是单独使用的另一种后端，不能作为 World 的后端：World、Commands、Viewer、快照和回滚都只支持 Registry
+template <AllowedEntityType Entity>
+class ArchetypeRegistry {
+public:
+    using EntityTraits = EntityTraits<Entity>;
+
+    using EntityOriginalType = typename EntityTraits::OriginalType;
+    using EntityIdType = typename EntityTraits::IdType;
+    using EntityUnderlyingType = typename EntityTraits::UnderlyingType;
+
+    using ArchetypeType = internal::Archetype<Entity>;
+
+    template <AllowedUniqueComponentsTupleType Required,
+        AllowedUniqueComponentsTupleType Optional,
+        AllowedUniqueComponentsTupleType Exclude>
+    using ViewWithoutEntityType = ArchetypeView<Entity, false, Required, Optional, Exclude>;
+
+    template <AllowedUniqueComponentsTupleType Required,
+        AllowedUniqueComponentsTupleType Optional,
+        AllowedUniqueComponentsTupleType Exclude>
+    using ViewWithEntityType = ArchetypeView<Entity, true, Required, Optional, Exclude>;
+
+private:
+    /// 实体所在的 Archetype 和行
+    struct EntityRecord {
+        EntityOriginalType entity;
+        ArchetypeType* archetype;
+        std::size_t index;
+    };
+
+public:
+    ArchetypeRegistry() {
+        empty_archetype_ = &GetOrCreateArchetype({});
+    }
+
+    ArchetypeRegistry(const ArchetypeRegistry&) = delete;
+    ArchetypeRegistry& operator=(const ArchetypeRegistry&) = delete;
+
+    ArchetypeRegistry(ArchetypeRegistry&&) noexcept = default;
+    ArchetypeRegistry& operator=(ArchetypeRegistry&&) noexcept = default;
+
+    ~ArchetypeRegistry() = default;
+
+    EntityOriginalType CreateEntity() {
+        if (free_list_.empty()) {
+            free_list_.push_back(MakeEntityUnderlying<EntityOriginalType>(next_entity_, 0));
+            ++next_entity_;
+        }
+
+        const auto underlying = free_list_.back();
+        free_list_.pop_back();
+
+        const auto entity = ToOriginal<EntityOriginalType>(underlying);
+        const auto id = GetId<EntityOriginalType>(underlying);
+        if (id >= records_.size()) {
+            records_.resize(id + 1);
+        }
+
+        records_[id] = {entity, empty_archetype_, empty_archetype_->PushBack(entity)};
+        ++entity_count_;
+        return entity;
+    }
+
+    void DestroyEntity(const EntityOriginalType entity) {
+        auto* record = FindRecord(entity);
+        if (!record) return;
+
+        RemoveRow(*record->archetype, record->index);
+        record->archetype = nullptr;
+        --entity_count_;
+
+        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
+        free_list_.push_back(GenNextVersion<EntityOriginalType>(underlying));
+    }
+
+    [[nodiscard]] bool ContainsEntity(const EntityOriginalType entity) const {
+        return FindRecord(entity) != nullptr;
+    }
+
+    [[nodiscard]] std::size_t EntityCount() const noexcept {
+        return entity_count_;
+    }
+
+    [[nodiscard]] std::size_t ArchetypeCount() const noexcept {
+        return archetypes_.size();
+    }
+
+    template <AllowedComponentType Component>
+    void AttachComponent(const EntityOriginalType entity, Component component) {
+        auto& record = GetRecord(entity);
+        const auto type_id = GetTypeId<Component>();
+        component_layouts_.try_emplace(type_id, internal::ArchetypeColumnLayout{sizeof(Component), alignof(Component)});
+
+        auto* from = record.archetype;
+        if (const auto column = from->ColumnOf(type_id); column != ArchetypeType::npos_k) {
+            std::memcpy(from->At(record.index, column), &component, sizeof(Component));
+            return;
+        }
+
+        auto& to = AddEdge(*from, type_id);
+        MoveEntity(record, to);
+        std::memcpy(to.At(record.index, to.ColumnOf(type_id)), &component, sizeof(Component));
+    }
+
+    template <AllowedComponentType... Components>
+    void AttachComponents(const EntityOriginalType entity, Components... components) {
+        static_assert(!CheckDuplicateComponents<Components...>(), "Duplicate components");
+        (AttachComponent(entity, components), ...);
+    }
+
+    template <AllowedComponentType Component>
+    void DetachComponent(const EntityOriginalType entity) {
+        auto* record = FindRecord(entity);
+        if (!record) return;
+
+        const auto type_id = GetTypeId<Component>();
+        auto* from = record->archetype;
+        if (!from->Contains(type_id)) return;
+
+        MoveEntity(*record, RemoveEdge(*from, type_id));
+    }
+
+    template <AllowedComponentType... Components>
+    void DetachComponents(const EntityOriginalType entity) {
+        static_assert(!CheckDuplicateComponents<Components...>(), "Duplicate components");
+        (DetachComponent<Components>(entity), ...);
+    }
+
+    template <AllowedComponentType Component>
+    [[nodiscard]] bool ContainsComponent(const EntityOriginalType entity) const {
+        const auto* record = FindRecord(entity);
+        return record && record->archetype->Contains(GetTypeId<Component>());
+    }
+
+    template <AllowedComponentType... Components>
+    [[nodiscard]] bool ContainsAllComponents(const EntityOriginalType entity) const {
+        return (ContainsComponent<Components>(entity) && ...);
+    }
+
+    template <AllowedComponentType Component>
+    Component& GetComponentReference(const EntityOriginalType entity) {
+        auto* component = GetComponentPointer<Component>(entity);
+        if (!component) {
+            throw std::runtime_error("ArchetypeRegistry::GetComponentReference: Component not found");
+        }
+        return *component;
+    }
+
+    template <AllowedComponentType Component>
+    Component* GetComponentPointer(const EntityOriginalType entity) {
+        const auto* record = FindRecord(entity);
+        if (!record) return nullptr;
+
+        const auto column = record->archetype->ColumnOf(GetTypeId<Component>());
+        if (column == ArchetypeType::npos_k) return nullptr;
+
+        return std::launder(reinterpret_cast<Component*>(record->archetype->At(record->index, column)));
+    }
+
+    template <AllowedComponentType... Components>
+    std::tuple<Components&...> GetComponentReferences(const EntityOriginalType entity) {
+        return std::tuple<Components&...>(GetComponentReference<Components>(entity)...);
+    }
+
+    template <AllowedComponentType... Components>
+    std::tuple<Components*...> GetComponentPointers(const EntityOriginalType entity) {
+        return std::tuple<Components*...>(GetComponentPointer<Components>(entity)...);
+    }
+
+    template <AllowedUniqueComponentsTupleType Required = std::tuple<>,
+        AllowedUniqueComponentsTupleType Optional = std::tuple<>,
+        AllowedUniqueComponentsTupleType Exclude = std::tuple<>>
+    [[nodiscard]] ViewWithoutEntityType<Required, Optional, Exclude> View() {
+        return ViewWithoutEntityType<Required, Optional, Exclude>{*this};
+    }
+
+    template <AllowedUniqueComponentsTupleType Required = std::tuple<>,
+        AllowedUniqueComponentsTupleType Optional = std::tuple<>,
+        AllowedUniqueComponentsTupleType Exclude = std::tuple<>>
+    [[nodiscard]] ViewWithEntityType<Required, Optional, Exclude> ViewWithEntity() {
+        return ViewWithEntityType<Required, Optional, Exclude>{*this};
+    }
+
+    /// 对每个拥有所有 Components 的实体调用 function(entity, components...)
+    ///
+    /// 按块遍历，块内每一列都是连续的数组，是最快的遍历方式
+    template <AllowedComponentType... Components, typename Function>
+    void Each(Function&& function) {
+        static_assert(!CheckDuplicateComponents<Components...>(), "Duplicate components");
+
+        for (auto& [_, archetype] : archetypes_) {
+            const std::array<std::size_t, sizeof...(Components)> columns = {
+                archetype->ColumnOf(GetTypeId<Components>())...
+            };
+            if (std::ranges::find(columns, ArchetypeType::npos_k) != columns.end()) continue;
+
+            for (std::size_t chunk = 0; chunk < archetype->ChunkCount(); ++chunk) {
+                EachInChunk<Components...>(*archetype, chunk, columns, function,
+                                           std::index_sequence_for<Components...>{});
+            }
+        }
+    }
+
+    /// 遍历所有的 Archetype，View 用它来查找匹配的表
+    template <typename Function>
+    void ForEachArchetype(Function&& function) {
+        for (auto& [_, archetype] : archetypes_) {
+            function(*archetype);
+        }
+    }
+
+private:
+    template <AllowedComponentType... Components, typename Function, std::size_t... Indices>
+    static void EachInChunk(ArchetypeType& archetype, const std::size_t chunk,
+                            const std::array<std::size_t, sizeof...(Components)>& columns,
+                            Function& function, std::index_sequence<Indices...>) {
+        const auto size = archetype.ChunkSize(chunk);
+        const auto* entities = archetype.Entities(chunk);
+        const std::tuple<Components*...> arrays = {
+            std::launder(reinterpret_cast<Components*>(archetype.Column(chunk, columns[Indices])))...
+        };
+
+        for (std::size_t row = 0; row < size; ++row) {
+            function(entities[row], std::get<Indices>(arrays)[row]...);
+        }
+    }
+
+    [[nodiscard]] EntityRecord* FindRecord(const EntityOriginalType entity) {
+        const auto id = GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(entity));
+        if (id >= records_.size()) return nullptr;
+
+        auto& record = records_[id];
+        if (!record.archetype || record.entity != entity) return nullptr;
+        return &record;
+    }
+
+    [[nodiscard]] const EntityRecord* FindRecord(const EntityOriginalType entity) const {
+        return const_cast<ArchetypeRegistry*>(this)->FindRecord(entity);
+    }
+
+    EntityRecord& GetRecord(const EntityOriginalType entity) {
+        auto* record = FindRecord(entity);
+        if (!record) {
+            throw std::runtime_error("ArchetypeRegistry: Entity not found");
+        }
+        return *record;
+    }
+
+    ArchetypeType& GetOrCreateArchetype(const std::vector<ComponentTypeId>& types) {
+        auto& archetype = archetypes_[types];
+        if (!archetype) {
+            std::vector<internal::ArchetypeColumnLayout> layouts;
+            for (const auto type_id : types) {
+                layouts.push_back(component_layouts_.at(type_id));
+            }
+            archetype = std::make_unique<ArchetypeType>(types, layouts);
+        }
+        return *archetype;
+    }
+
+    ArchetypeType& AddEdge(ArchetypeType& from, const ComponentTypeId type_id) {
+        if (const auto it = from.add_edges.find(type_id); it != from.add_edges.end()) {
+            return *it->second;
+        }
+
+        auto types = from.Types();
+        types.insert(std::ranges::upper_bound(types, type_id), type_id);
+
+        auto& to = GetOrCreateArchetype(types);
+        from.add_edges[type_id] = &to;
+        to.remove_edges[type_id] = &from;
+        return to;
+    }
+
+    ArchetypeType& RemoveEdge(ArchetypeType& from, const ComponentTypeId type_id) {
+        if (const auto it = from.remove_edges.find(type_id); it != from.remove_edges.end()) {
+            return *it->second;
+        }
+
+        auto types = from.Types();
+        types.erase(std::ranges::find(types, type_id));
+
+        auto& to = GetOrCreateArchetype(types);
+        from.remove_edges[type_id] = &to;
+        to.add_edges[type_id] = &from;
+        return to;
+    }
+
+    /// 把实体移动到另一个 Archetype，两边都有的组件会被拷贝过去
+    void MoveEntity(EntityRecord& record, ArchetypeType& to) {
+        auto& from = *record.archetype;
+        const auto index = to.PushBack(record.entity);
+        to.CopyCommon(index, from, record.index);
+
+        RemoveRow(from, record.index);
+        record.archetype = &to;
+        record.index = index;
+    }
+
+    void RemoveRow(ArchetypeType& archetype, const std::size_t index) {
+        if (const auto moved = archetype.SwapAndPop(index)) {
+            const auto id = GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(*moved));
+            records_[id].index = index;
+        }
+    }
+
+private:
+    template <AllowedEntityType Entity2,
+        bool WithEntity,
+        AllowedUniqueComponentsTupleType Required,
+        AllowedUniqueComponentsTupleType Optional,
+        AllowedUniqueComponentsTupleType Exclude>
+    friend class ArchetypeView;
+
+    // 按组件类型排好序的集合到 Archetype，指针在 Registry 的生命周期内不会失效
+    std::map<std::vector<ComponentTypeId>, std::unique_ptr<ArchetypeType>> archetypes_;
+    ArchetypeType* empty_archetype_{nullptr};
+
+    // 见过的组件类型的大小和对齐，用于创建新的 Archetype
+    std::unordered_map<ComponentTypeId, internal::ArchetypeColumnLayout> component_layouts_;
+
+    // 以实体 id 为下标
+    std::vector<EntityRecord> records_;
+    std::size_t entity_count_{0};
+
+    std::vector<EntityUnderlyingType> free_list_;
+    EntityIdType next_entity_{};
+};
+
+
+/// ArchetypeRegistry 的视图，返回的类型和 View 相同
+///
+/// 创建时找出所有匹配的 Archetype，遍历时依次扫描它们的每一行
+template <AllowedEntityType Entity,
+    bool WithEntity,
+    AllowedUniqueComponentsTupleType Required,
+    AllowedUniqueComponentsTupleType Optional,
+    AllowedUniqueComponentsTupleType Exclude>
+class ArchetypeView {
+    static_assert(!CheckDuplicateComponentsTuple<Required, Optional, Exclude>(),
+                  "ArchetypeView: Duplicate components in Required, Optional or Exclude");
+
+public:
+    using RegistryType = ArchetypeRegistry<Entity>;
+    using ArchetypeType = typename RegistryType::ArchetypeType;
+
+    using EntityType = Entity;
+
+    using RequiredTupleType = UnderlyingTupleType<Required>;
+    using RequiredReferenceTupleType = ReferenceTupleType<Required>;
+
+    using OptionalTupleType = UnderlyingTupleType<Optional>;
+    using OptionalPointerTupleType = PointerTupleType<Optional>;
+
+    using BaseReturnTupleType = std::tuple<RequiredReferenceTupleType, OptionalPointerTupleType>;
+
+    /// 和 View 相同，对于 Required 返回引用，对于 Optional 返回指针
+    using ReturnTupleType = std::conditional_t<WithEntity,
+        internal::tuple_cat_t<std::tuple<EntityType>, BaseReturnTupleType>,
+        BaseReturnTupleType>;
+
+    using IteratorType = internal::ViewIterator<ArchetypeView>;
+
+private:
+    static constexpr auto required_size_k = size_k<Required>;
+    static constexpr auto optional_size_k = size_k<Optional>;
+
+    struct Match {
+        ArchetypeType* archetype;
+        std::array<std::size_t, required_size_k> required;
+        std::array<std::size_t, optional_size_k> optional;
+    };
+
+public:
+    explicit ArchetypeView(RegistryType& registry) {
+        registry.ForEachArchetype([this](ArchetypeType& archetype) {
+            Match match{&archetype, {}, {}};
+
+            for (std::size_t i = 0; i < required_size_k; ++i) {
+                match.required[i] = archetype.ColumnOf(type_ids_k<Required>[i]);
+                if (match.required[i] == ArchetypeType::npos_k) return;
+            }
+            for (const auto type_id : type_ids_k<Exclude>) {
+                if (archetype.Contains(type_id)) return;
+            }
+            for (std::size_t i = 0; i < optional_size_k; ++i) {
+                match.optional[i] = archetype.ColumnOf(type_ids_k<Optional>[i]);
+            }
+
+            matches_.push_back(match);
+        });
+    }
+
+    constexpr std::optional<ReturnTupleType> Next() {
+        while (current_ < matches_.size() && index_ >= matches_[current_].archetype->Size()) {
+            ++current_;
+            index_ = 0;
+        }
+        if (current_ >= matches_.size()) {
+            return std::nullopt;
+        }
+
+        const auto& match = matches_[current_];
+        const auto index = index_++;
+
+        auto components = BaseReturnTupleType{
+            GetRequired(match, index, std::make_index_sequence<required_size_k>{}),
+            GetOptional(match, index, std::make_index_sequence<optional_size_k>{})
+        };
+
+        if constexpr (WithEntity) {
+            return std::tuple_cat(std::tuple<EntityType>(match.archetype->EntityAt(index)), components);
+        } else {
+            return components;
+        }
+    }
+
+private:
+    template <std::size_t... Indices>
+    static RequiredReferenceTupleType GetRequired(const Match& match, const std::size_t index,
+                                                  std::index_sequence<Indices...>) {
+        return RequiredReferenceTupleType{
+            *std::launder(reinterpret_cast<std::tuple_element_t<Indices, RequiredTupleType>*>(
+                match.archetype->At(index, match.required[Indices])))...
+        };
+    }
+
+    template <std::size_t... Indices>
+    static OptionalPointerTupleType GetOptional(const Match& match, const std::size_t index,
+                                                std::index_sequence<Indices...>) {
+        return OptionalPointerTupleType{
+            (match.optional[Indices] == ArchetypeType::npos_k
+                 ? nullptr
+                 : std::launder(reinterpret_cast<std::tuple_element_t<Indices, OptionalTupleType>*>(
+                     match.archetype->At(index, match.optional[Indices]))))...
+        };
+    }
+
+    friend IteratorType begin(ArchetypeView& view) {
+        return IteratorType(view);
+    }
+
+    friend IteratorType end(ArchetypeView& view) {
+        return IteratorType(view, true);
+    }
+
+private:
+    std::vector<Match> matches_;
+    std::size_t current_{0};
+    std::size_t index_{0};
+};
+} // namespace ecs
+
+#endif // ARCHETYPE_HPP
@@ -1,8 +1,20 @@
 #ifndef COMMANDS_HPP
 #define COMMANDS_HPP
+#include <algorithm>
+#include <cstring>
 #include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
 
 #include "component.hpp"
+#include "replay.hpp"
+#include "scheduler.hpp"
 #include "world.hpp"
 
 namespace ecs {
@@ -10,200 +22,99 @@ template <AllowedEntityType Entity>
 using Command = std::function<void(World<Entity>&)>;
 
 
-/// 命令队列，这是一个线程安全的队列
-template <typename... CommandArgs>
-class CommandQueue {
-public:
-    using CommandType = std::function<void(CommandArgs...)>;
-
-private:
-    struct Node {
-        std::shared_ptr<CommandType> data{};
-        std::unique_ptr<Node> next{};
-    };
-
-public:
-    CommandQueue() noexcept :
-        head_(std::make_unique<Node>()),
-        tail_(head_.get()) {
-    }
-
-    CommandQueue(const CommandQueue&) = delete;
-    CommandQueue& operator=(const CommandQueue&) = delete;
-
-    CommandQueue(CommandQueue&&) noexcept = default;
-    CommandQueue& operator=(CommandQueue&&) noexcept = default;
-
-    ~CommandQueue() = default;
-
-    constexpr void Push(CommandType command) {
-        // 将 InvokeType 转换为 CommandType
-        std::shared_ptr<CommandType> new_data = std::make_shared<CommandType>(command);
-        std::unique_ptr<Node> p = std::make_unique<Node>();
-        Node* const new_tail = p.get();
-
-        {
-            std::lock_guard lock(tail_m_);
-            tail_->data = new_data;
-            tail_->next = std::move(p);
-            tail_ = new_tail;
-        }
-
-        data_cond_.notify_one();
-    }
-
-    constexpr std::shared_ptr<CommandType> WaitAndPop() {
-        const std::unique_ptr<Node> old_head = WaitPopHead();
-        return old_head->data;
-    }
-
-    constexpr std::shared_ptr<CommandType> TryPop() {
-        const std::unique_ptr<Node> old_head = TryPopHead();
-        return old_head ? old_head->data : nullptr;
-    }
-
-    [[nodiscard]] constexpr bool Empty() const {
-        std::lock_guard lock(head_m_);
-        return head_.get() == GetTail();
-    }
-
-    constexpr void Execute(CommandArgs... args) {
-        std::scoped_lock lock(head_m_, tail_m_);
-        while (head_.get() != tail_) {
-            std::unique_ptr<Node> old_head = PopHeadNoThreadSafe();
-            (*old_head->data)(args...);
-        }
-    }
-
-    constexpr void Clear() {
-        std::scoped_lock lock(head_m_, tail_m_);
-        while (head_.get() != tail_) {
-            std::unique_ptr<Node> old_head = PopHeadNoThreadSafe();
-            old_head.reset();
-        }
-    }
-
-private:
-    constexpr Node* GetTail() {
-        std::lock_guard lock(tail_m_);
-        return tail_;
-    }
-
-    constexpr std::unique_ptr<Node> PopHeadNoThreadSafe() {
-        std::unique_ptr<Node> old_head = std::move(head_);
-        head_ = std::move(old_head->next);
-        return old_head;
-    }
-
-    constexpr std::unique_ptr<Node> WaitPopHead() {
-        std::unique_lock lock(head_m_);
-        data_cond_.wait(lock, [this] {
-            return head_.get() != GetTail();
-        });
-
-        return PopHeadNoThreadSafe();
-    }
-
-    constexpr std::unique_ptr<Node> TryPopHead() {
-        std::lock_guard lock(head_m_);
-        if (head_.get() == GetTail()) return nullptr;
-
-        return PopHeadNoThreadSafe();
-    }
-
-private:
-    std::mutex head_m_;
-    std::mutex tail_m_;
-
-    std::condition_variable data_cond_;
-
-    std::unique_ptr<Node> head_;
-    Node* tail_;
-
-    // std::queue<CommandType> queue_;
-};
-
-
 namespace internal {
-template <AllowedEntityType Entity, AllowedComponentType... Components>
-struct SpawnCommand {
-    static_assert(!CheckDuplicateComponents<Components...>(),
-                  "SpawnCommand: Duplicate components in SpawnCommand");
-
-    using CommandType = Command<Entity>;
-
-    explicit SpawnCommand(Components... components) noexcept :
-        components_(std::forward<Components>(components)...) {
-    }
-
-    void operator()(World<Entity>& world) const {
-        const auto entity = world.registry().CreateEntity();
-        world.registry().AttachComponents(entity, std::get<Components>(components_)...);
-    }
-
-    std::tuple<Components...> components_;
+/// 结构性命令的种类，它们不会被包装成 std::function，而是记录下来在 Execute 时批量执行
+///
+/// Closure 是一个包装成 std::function 的命令（实例化预制体、增删资源），它把前后的结构性命令分成两批，
+/// 保证它和结构性命令之间仍然是记录的顺序
+enum class StructuralCommandKind : std::uint8_t {
+    Attach,
+    Detach,
+    Destroy,
+    Closure,
 };
 
-
 template <AllowedEntityType Entity>
-struct DestroyCommand {
-    using CommandType = Command<Entity>;
+struct StructuralCommand {
+    StructuralCommandKind kind;
+    Entity entity;
 
-    explicit DestroyCommand(const Entity entity) noexcept : entity_(entity) {
-    }
+    // Destroy 时没有意义
+    ComponentTypeId type_id;
 
-    void operator()(World<Entity>& world) const {
-        world.registry().DestroyEntity(entity_);
-    }
+    // Attach 时组件在 payload 中的偏移，Closure 时命令在 closures_ 中的下标
+    std::size_t payload_offset;
+};
 
-    Entity entity_;
+/// 只知道 ComponentTypeId 时操作组件所需的信息，在记录命令时由模板填写
+template <AllowedEntityType Entity>
+struct ComponentOps {
+    std::size_t size;
+    typename Registry<Entity>::MakeStorageType make_storage;
 };
 
-template <AllowedEntityType Entity, AllowedComponentType... Components>
-struct AttachCommand {
-    static_assert(!CheckDuplicateComponents<Components...>(),
-                  "AttachCommand: Duplicate components in AttachCommand");
 
+template <AllowedEntityType Entity>
+struct InstantiateCommand {
     using CommandType = Command<Entity>;
 
-    explicit AttachCommand(const Entity entity, Components... components) noexcept
-        : entity_(entity), components_(components...) {
+    InstantiateCommand(std::shared_ptr<const Prefab<Entity>> prefab, std::vector<Entity> entities) noexcept
+        : prefab_(std::move(prefab)), entities_(std::move(entities)) {
     }
 
     void operator()(World<Entity>& world) const {
-        const auto underlying = ToUnderlying<Entity>(entity_);
-        world.registry().AttachComponents(underlying, std::get<Components>(components_)...);
-    }
-
-    Entity entity_;
-    std::tuple<Components...> components_;
-};
+        auto& registry = world.registry();
 
-template <AllowedEntityType Entity, AllowedComponentType... Components>
-struct DetachCommand {
-    using CommandType = Command<Entity>;
+        // 同一帧中被销毁的实体不再实例化
+        std::vector<Entity> alive;
+        alive.reserve(entities_.size());
+        std::ranges::copy_if(entities_, std::back_inserter(alive), [&registry](const Entity entity) {
+            return registry.ContainsEntity(entity);
+        });
 
-    explicit DetachCommand(const Entity entity) noexcept : entity_(entity) {
-    }
+        // 已经有的组件不会被覆盖，所以只记录真正挂载的组件。
+        // 共享组件捕获的是句柄，记录的是它在值表中的值，回放的 World 没有这个值表
+        if (auto* recorder = world.commands().GetRecorder()) {
+            for (const auto& entry : prefab_->Components()) {
+                const auto* component = prefab_->ComponentBytes(entry);
+                const auto* storage = registry.FindBasicStorage(entry.type_id);
+                const auto* value = storage ? storage->ValueBytesOf(component) : nullptr;
+
+                for (const auto entity : alive) {
+                    if (registry.ContainsComponent(entity, entry.type_id)) continue;
+
+                    if (value) {
+                        recorder->RecordAttachShared(entity, entry.type_id, value, storage->ValueSize());
+                    } else {
+                        recorder->RecordAttach(entity, entry.type_id, component, entry.size);
+                    }
+                }
+            }
+        }
 
-    void operator()(World<Entity>& world) const {
-        const auto underlying = ToUnderlying<Entity>(entity_);
-        const auto type_ids = ToComponentTypeIds<Components...>();
-        world.registry().DetachComponents(underlying, type_ids);
+        registry.InstantiateInto(*prefab_, alive);
     }
 
-    Entity entity_;
+    std::shared_ptr<const Prefab<Entity>> prefab_;
+    std::vector<Entity> entities_;
 };
 
 template <AllowedEntityType Entity, AllowedResourceType Resource>
 struct AddResourceCommand {
     using CommandType = Command<Entity>;
 
-    explicit AddResourceCommand(const Resource resource) noexcept : resource_(resource) {
+    explicit AddResourceCommand(Resource resource) : resource_(std::move(resource)) {
     }
 
     void operator()(World<Entity>& world) const {
         world.resources().UpsertResource(resource_);
+
+        // 只有可以平凡复制的资源才能按字节记录，其他资源在记录时已经被 Commands 拒绝
+        if constexpr (std::is_trivially_copyable_v<Resource>) {
+            if (auto* recorder = world.commands().GetRecorder()) {
+                recorder->RecordUpsertResource(resource_);
+            }
+        }
     }
 
     Resource resource_;
@@ -217,6 +128,9 @@ struct RemoveResourceCommand {
 
     void operator()(World<Entity>& world) const {
         world.resources().template RemoveResource<Resource>();
+        if (auto* recorder = world.commands().GetRecorder()) {
+            recorder->template RecordRemoveResource<Resource>();
+        }
     }
 };
 } // namespace internal
@@ -226,9 +140,9 @@ template <AllowedEntityType Entity>
 class Commands {
 public:
     using WorldType = World<Entity>;
+    using RegistryType = Registry<Entity>;
 
-    using CommandQueueType = CommandQueue<WorldType&>;
-    using CommandType = typename CommandQueueType::CommandType;
+    using CommandType = Command<Entity>;
 
     using EntityTraits = EntityTraits<Entity>;
 
@@ -236,7 +150,10 @@ public:
     using EntityIdType = typename EntityTraits::IdType;
     using EntityUnderlyingType = typename EntityTraits::UnderlyingType;
 
-    explicit Commands(WorldType& world) noexcept : world_(world), command_queue_() {
+    using StructuralCommandType = internal::StructuralCommand<EntityOriginalType>;
+    using ComponentOpsType = internal::ComponentOps<Entity>;
+
+    explicit Commands(WorldType& world) noexcept : world_(world) {
     }
 
     Commands(const Commands&) = delete;
@@ -249,76 +166,532 @@ public:
 
     template <AllowedComponentType... Components>
     constexpr Commands& Spawn(Components... components) {
-        Command<Entity> command = internal::SpawnCommand<Entity, Components...>(components...);
-
-        command_queue_.Push(command);
+        SpawnEntity<Components...>(components...);
         return *this;
     }
 
+    /// 和 Spawn 相同，但是立刻返回新实体，同一帧之后的命令可以直接使用这个实体
+    template <AllowedComponentType... Components>
+    constexpr Entity SpawnEntity(Components... components) {
+        static_assert(!CheckDuplicateComponents<Components...>(),
+                      "Commands::SpawnEntity: Duplicate components");
+
+        const auto entity = Reserve();
+
+        std::lock_guard lock(structural_mutex_);
+        (RecordAttach(entity, components), ...);
+        return entity;
+    }
+
+    /// 延迟实例化 count 个预制体，立刻返回新实体，组件在 Execute 时按 Registry::InstantiateInto 批量挂载
+    ///
+    /// 和其他命令之间按记录的顺序执行，之后对这些实体的 Attach、Detach 在实例化之后执行
+    std::vector<Entity> Instantiate(const Prefab<Entity>& prefab, const std::size_t count) {
+        std::vector<Entity> entities(count);
+        for (auto& entity : entities) {
+            entity = Reserve();
+        }
+
+        PushClosure(internal::InstantiateCommand<Entity>(std::make_shared<const Prefab<Entity>>(prefab), entities));
+        return entities;
+    }
+
+    /// 预留一个实体，线程安全，实体在 Execute 时才会真正出现在 registry 中
+    constexpr Entity Reserve() {
+        return world_.registry().ReserveEntity();
+    }
+
     constexpr Commands& Destroy(const Entity entity) {
-        Command<Entity> command = internal::DestroyCommand<Entity>(entity);
-        command_queue_.Push(command);
+        std::lock_guard lock(structural_mutex_);
+        PushStructural({internal::StructuralCommandKind::Destroy, entity, 0, 0});
         return *this;
     }
 
     template <AllowedComponentType... Components>
     constexpr Commands& Attach(const Entity entity, Components&&... components) {
-        Command<Entity> command = internal::AttachCommand<Entity, Components...>(entity, components...);
-        command_queue_.Push(command);
+        static_assert(!CheckDuplicateComponents<std::decay_t<Components>...>(),
+                      "Commands::Attach: Duplicate components");
+
+        std::lock_guard lock(structural_mutex_);
+        (RecordAttach(entity, components), ...);
         return *this;
     }
 
     template <AllowedComponentType... Components>
     constexpr Commands& Detach(const Entity entity) {
-        Command<Entity> command = internal::DetachCommand<Entity, Components...>(entity);
-        command_queue_.Push(command);
+        static_assert(!CheckDuplicateComponents<Components...>(),
+                      "Commands::Detach: Duplicate components");
+
+        std::lock_guard lock(structural_mutex_);
+        (PushStructural({internal::StructuralCommandKind::Detach, entity, GetTypeId<Components>(), 0}), ...);
         return *this;
     }
-
+    /// 设置了记录器时，资源必须可以平凡复制，否则抛出异常
     template <AllowedResourceType Resource>
     constexpr Commands& AddResource(Resource resource) {
-        Command<Entity> command = internal::AddResourceCommand<Entity, Resource>(resource);
-        command_queue_.Push(command);
+        CheckRecordable<Resource>();
+        PushClosure(internal::AddResourceCommand<Entity, Resource>(std::move(resource)));
         return *this;
     }
 
     template <AllowedResourceType Resource>
     constexpr Commands& AddResource() {
-        Command<Entity> command = internal::AddResourceCommand<Entity, Resource>(Resource{});
-        command_queue_.Push(command);
+        CheckRecordable<Resource>();
+        PushClosure(internal::AddResourceCommand<Entity, Resource>(Resource{}));
         return *this;
     }
 
     template <AllowedResourceType Resource>
     constexpr Commands& RemoveResource() {
-        Command<Entity> command = internal::RemoveResourceCommand<Entity, Resource>();
-        command_queue_.Push(command);
+        PushClosure(internal::RemoveResourceCommand<Entity, Resource>());
         return *this;
     }
 
-    constexpr void Execute() {
-        command_queue_.Execute(world_);
+    /// 执行所有命令
+    ///
+    /// 结构性命令不会逐条回放：先抵消同一个实体上的命令，再按组件类型分组批量执行，
+    /// 最终结果和按顺序逐条执行相同。传入线程池时，不同组件类型的批次会并行执行。
+    /// 其他命令按记录的顺序穿插在这些批次之间执行
+    constexpr void Execute(internal::ThreadPool* pool = nullptr) {
+        auto& registry = world_.registry();
+
+        // 先让所有预留的实体出现在 registry 中，之后的命令才能使用它们
+        if (recorder_) {
+            recorder_->RecordFrame();
+
+            spawned_.clear();
+            registry.FlushReservedEntities(&spawned_);
+            for (const auto entity : spawned_) {
+                recorder_->RecordSpawn(entity);
+            }
+        } else {
+            registry.FlushReservedEntities();
+        }
+
+        std::lock_guard lock(structural_mutex_);
+        MergeSegments();
+        ExecuteStructural(registry, pool);
     }
 
     constexpr void Clear() {
-        command_queue_.Clear();
+        std::lock_guard lock(structural_mutex_);
+        structural_.clear();
+        payload_.clear();
+        closures_.clear();
+        for (std::size_t i = 0; i < segment_count_; ++i) {
+            ClearSegment(segments_[i]);
+        }
+        segment_count_ = 0;
+        size_ = 0;
+        unrecordable_count_ = 0;
     }
 
+    /// 把 other 中的命令移动到这个 Commands 的末尾，other 会被清空
+    ///
+    /// 用于合并每个 System 自己的命令缓冲区。只是接管 other 的缓冲区，和命令的数量无关，
+    /// 作为交换 other 拿到的是已经清空、保留了容量的缓冲区。
+    /// 各段在 Execute 时才拼接到一起，这一步和命令的数量成正比，见 MergeSegments
     constexpr void Append(Commands& other) {
-        command_queue_.Append(other.command_queue_);
+        if (this == &other) return;
+
+        std::scoped_lock lock(structural_mutex_, other.structural_mutex_);
+
+        // 之后记录的命令要排在 other 的命令之后，所以先把自己正在记录的命令封存成一段
+        SealActive();
+        for (std::size_t i = 0; i < other.segment_count_; ++i) {
+            std::swap(NextSegment(), other.segments_[i]);
+        }
+        other.segment_count_ = 0;
+        if (!other.structural_.empty()) {
+            other.SwapActive(NextSegment());
+        }
+
+        component_ops_.merge(other.component_ops_);
+
+        size_ += other.size_;
+        other.size_ = 0;
+        unrecordable_count_ += other.unrecordable_count_;
+        other.unrecordable_count_ = 0;
     }
 
     [[nodiscard]] constexpr bool Empty() const {
-        return command_queue_.Empty();
+        std::lock_guard lock(structural_mutex_);
+        return structural_.empty() && segment_count_ == 0;
     }
 
     [[nodiscard]] constexpr std::size_t Size() const {
-        return command_queue_.Size();
+        std::lock_guard lock(structural_mutex_);
+        return size_;
+    }
+
+    /// 设置命令记录器，之后每次 Execute 实际执行的命令都会被记录下来，传入 nullptr 停止记录
+    ///
+    /// 不能在 Execute 的过程中调用。还有没执行的、不能平凡复制的资源命令时不能开始记录
+    constexpr void SetRecorder(CommandRecorder<Entity>* recorder) {
+        std::lock_guard lock(structural_mutex_);
+        if (recorder && unrecordable_count_ > 0) {
+            throw std::runtime_error("Commands::SetRecorder: Pending resources are not trivially copyable");
+        }
+        recorder_ = recorder;
+    }
+
+    [[nodiscard]] constexpr CommandRecorder<Entity>* GetRecorder() const noexcept {
+        return recorder_;
+    }
+
+private:
+    /// 不能平凡复制的资源不能按字节记录，在记录命令时就拒绝，而不是在 Execute 的中途
+    template <AllowedResourceType Resource>
+    void CheckRecordable() {
+        if constexpr (!std::is_trivially_copyable_v<Resource>) {
+            std::lock_guard lock(structural_mutex_);
+            if (recorder_) {
+                throw std::runtime_error("Commands::AddResource: Resource must be trivially copyable to be recorded");
+            }
+            ++unrecordable_count_;
+        }
+    }
+
+    /// 调用者需要持有 structural_mutex_
+    template <AllowedComponentType Component>
+    void RecordAttach(const Entity entity, const Component& component) {
+        static_assert(!is_shared_component_k<Component>,
+                      "Commands::Attach: Shared<T> cannot be attached through Commands");
+
+        constexpr auto type_id = GetTypeId<Component>();
+        component_ops_.try_emplace(type_id, ComponentOpsType{
+            sizeof(Component), &RegistryType::template MakeStorage<Component>
+        });
+
+        const auto offset = payload_.size();
+        payload_.resize(offset + sizeof(Component));
+        std::memcpy(payload_.data() + offset, &component, sizeof(Component));
+
+        PushStructural({internal::StructuralCommandKind::Attach, entity, type_id, offset});
+    }
+
+    void PushClosure(CommandType command) {
+        std::lock_guard lock(structural_mutex_);
+        PushStructural({internal::StructuralCommandKind::Closure, EntityOriginalType{}, 0, closures_.size()});
+        closures_.push_back(std::move(command));
+    }
+
+    /// 调用者需要持有 structural_mutex_
+    void PushStructural(const StructuralCommandType& command) {
+        structural_.push_back(command);
+        ++size_;
+    }
+
+    /// Append 接管的一段命令，布局和 structural_、payload_、closures_ 相同
+    struct Segment {
+        std::vector<StructuralCommandType> structural;
+        std::vector<std::byte> payload;
+        std::vector<CommandType> closures;
+    };
+
+    static void ClearSegment(Segment& segment) noexcept {
+        segment.structural.clear();
+        segment.payload.clear();
+        segment.closures.clear();
+    }
+
+    /// 调用者需要持有 structural_mutex_
+    constexpr void SwapActive(Segment& segment) noexcept {
+        structural_.swap(segment.structural);
+        payload_.swap(segment.payload);
+        closures_.swap(segment.closures);
+    }
+
+    /// 下一个空的段，segments_ 只增不减，用过的段保留容量，之后可以交换给其他 Commands
+    constexpr Segment& NextSegment() {
+        if (segment_count_ == segments_.size()) {
+            segments_.emplace_back();
+        }
+        return segments_[segment_count_++];
+    }
+
+    /// 把正在记录的命令封存成一段，调用者需要持有 structural_mutex_
+    constexpr void SealActive() {
+        if (!structural_.empty()) {
+            SwapActive(NextSegment());
+        }
+    }
+
+    /// 按顺序把所有段拼接到 structural_ 中，第一段直接交换，其余的段逐条修正下标后追加
+    ///
+    /// 除了第一段，每条命令和组件的字节都会复制一次，开销和命令的数量成正比。
+    /// 之后的排序和分组本来就要遍历所有命令，需要它们在同一个数组中，所以这里没有再省掉这次复制。
+    /// 调用者需要持有 structural_mutex_
+    void MergeSegments() {
+        using Kind = internal::StructuralCommandKind;
+
+        if (segment_count_ == 0) return;
+
+        SealActive();
+        SwapActive(segments_[0]);
+
+        auto structural_size = structural_.size();
+        auto payload_size = payload_.size();
+        for (std::size_t i = 1; i < segment_count_; ++i) {
+            structural_size += segments_[i].structural.size();
+            payload_size += segments_[i].payload.size();
+        }
+        structural_.reserve(structural_size);
+        payload_.reserve(payload_size);
+
+        for (std::size_t i = 1; i < segment_count_; ++i) {
+            auto& segment = segments_[i];
+
+            const auto offset = payload_.size();
+            const auto closure_offset = closures_.size();
+            for (auto command : segment.structural) {
+                if (command.kind == Kind::Attach) {
+                    command.payload_offset += offset;
+                } else if (command.kind == Kind::Closure) {
+                    command.payload_offset += closure_offset;
+                }
+                structural_.push_back(command);
+            }
+            payload_.insert(payload_.end(), segment.payload.begin(), segment.payload.end());
+            std::ranges::move(segment.closures, std::back_inserter(closures_));
+
+            ClearSegment(segment);
+        }
+        segment_count_ = 0;
+    }
+
+    /// 按组件类型分好的一批命令，范围是 attach_entities_、attach_payload_、detach_entities_ 中的下标
+    struct CommandGroup {
+        ComponentTypeId type_id;
+        BasicStorage<Entity>* storage;
+
+        std::size_t attach_begin;
+        std::size_t attach_end;
+        std::size_t payload_begin;
+        std::size_t detach_begin;
+        std::size_t detach_end;
+    };
+
+    /// structural_ 中 [first, last) 这一批命令已经按组件类型和实体排好序
+    void BuildGroups(const std::size_t first, const std::size_t last) {
+        using Kind = internal::StructuralCommandKind;
+
+        groups_.clear();
+        attach_entities_.clear();
+        attach_payload_.clear();
+        detach_entities_.clear();
+
+        for (std::size_t begin = first; begin < last;) {
+            const auto type_id = structural_[begin].type_id;
+            auto& group = groups_.emplace_back(CommandGroup{
+                type_id, nullptr,
+                attach_entities_.size(), attach_entities_.size(), attach_payload_.size(),
+                detach_entities_.size(), detach_entities_.size()
+            });
+
+            auto end = begin;
+            for (; end < last && structural_[end].type_id == type_id; ++end) {
+                const auto& command = structural_[end];
+
+                // 同一个实体的同一个组件只有最后一条命令有效
+                const auto next = end + 1;
+                if (next < last && structural_[next].type_id == type_id &&
+                    structural_[next].entity == command.entity) {
+                    continue;
+                }
+
+                if (command.kind == Kind::Attach) {
+                    const auto size = component_ops_.at(type_id).size;
+                    const auto* data = payload_.data() + command.payload_offset;
+                    attach_entities_.push_back(command.entity);
+                    attach_payload_.insert(attach_payload_.end(), data, data + size);
+                } else {
+                    detach_entities_.push_back(command.entity);
+                }
+            }
+
+            group.attach_end = attach_entities_.size();
+            group.detach_end = detach_entities_.size();
+            begin = end;
+        }
+    }
+
+    /// 只修改这个组自己的 Storage，所以不同的组可以并行执行
+    void ApplyGroup(const std::size_t index) {
+        const auto& group = groups_[index];
+        if (!group.storage) return;
+
+        group.storage->UpsertRange(attach_entities_.data() + group.attach_begin,
+                                   attach_payload_.data() + group.payload_begin,
+                                   group.attach_end - group.attach_begin);
+
+        for (auto i = group.detach_begin; i < group.detach_end; ++i) {
+            const auto underlying = ToUnderlying<EntityOriginalType>(detach_entities_[i]);
+            group.storage->Pop(GetId<EntityOriginalType>(underlying));
+        }
+    }
+
+    void ApplyGroupsParallel(internal::ThreadPool& pool) {
+        auto apply = [this](const std::size_t index) { ApplyGroup(index); };
+        internal::ForkJoin(pool, groups_.size(), apply);
+    }
+
+    void RecordGroup(const CommandGroup& group) {
+        const auto size = component_ops_.at(group.type_id).size;
+        for (auto i = group.attach_begin; i < group.attach_end; ++i) {
+            const auto* component = attach_payload_.data() + group.payload_begin + (i - group.attach_begin) * size;
+            recorder_->RecordAttach(attach_entities_[i], group.type_id, component, size);
+        }
+
+        if (!group.storage) return;
+        for (auto i = group.detach_begin; i < group.detach_end; ++i) {
+            recorder_->RecordDetach(detach_entities_[i], group.type_id);
+        }
+    }
+
+    /// 清空已经拼接好的命令，调用者需要持有 structural_mutex_
+    void ClearExecuted() noexcept {
+        structural_.clear();
+        payload_.clear();
+        closures_.clear();
+        size_ = 0;
+        unrecordable_count_ = 0;
+    }
+
+    /// 调用者需要持有 structural_mutex_
+    void ExecuteStructural(RegistryType& registry, internal::ThreadPool* pool) {
+        using Kind = internal::StructuralCommandKind;
+
+        // 即使某条命令抛出异常，已经执行过的命令也不能在下一次 Execute 时再执行一次
+        struct ClearGuard {
+            Commands& commands;
+
+            ~ClearGuard() {
+                commands.ClearExecuted();
+            }
+        } guard{*this};
+
+        if (structural_.empty()) return;
+
+        // 被销毁的实体上的其他命令都可以直接丢弃，无论它们在销毁之前还是之后
+        destroyed_.clear();
+        for (const auto& command : structural_) {
+            if (command.kind == Kind::Destroy) {
+                destroyed_.push_back(command.entity);
+            }
+        }
+        std::sort(destroyed_.begin(), destroyed_.end());
+        destroyed_.erase(std::unique(destroyed_.begin(), destroyed_.end()), destroyed_.end());
+
+        std::erase_if(structural_, [this](const StructuralCommandType& command) {
+            if (command.kind == Kind::Closure) return false;
+            return command.kind == Kind::Destroy ||
+                std::binary_search(destroyed_.begin(), destroyed_.end(), command.entity);
+        });
+
+        for (const auto entity : destroyed_) {
+            if (registry.ContainsEntity(entity)) {
+                registry.DestroyEntity(entity);
+                if (recorder_) recorder_->RecordDestroy(entity);
+            }
+        }
+
+        // Closure 把命令分成若干批，每一批执行完之后再执行它后面的 Closure
+        for (std::size_t first = 0;;) {
+            std::size_t last = first;
+            while (last < structural_.size() && structural_[last].kind != Kind::Closure) {
+                ++last;
+            }
+
+            ExecuteBatch(registry, pool, first, last);
+
+            if (last == structural_.size()) break;
+            closures_[structural_[last].payload_offset](world_);
+            first = last + 1;
+        }
+    }
+
+    /// 执行 structural_ 中 [first, last) 这一批 Attach 和 Detach
+    void ExecuteBatch(RegistryType& registry, internal::ThreadPool* pool, const std::size_t first, const std::size_t last) {
+        if (first == last) return;
+
+        // 按组件类型和实体分组，稳定排序保证同一个组件上的命令仍然是记录的顺序
+        std::stable_sort(structural_.begin() + first, structural_.begin() + last,
+                         [](const StructuralCommandType& lhs, const StructuralCommandType& rhs) {
+                             if (lhs.type_id != rhs.type_id) return lhs.type_id < rhs.type_id;
+                             return lhs.entity < rhs.entity;
+                         });
+
+        BuildGroups(first, last);
+
+        // 新的 Storage 必须串行创建，之后每个组只会访问自己的 Storage
+        for (auto& group : groups_) {
+            if (group.attach_begin != group.attach_end) {
+                group.storage = &registry.GetOrCreateBasicStorage(group.type_id,
+                                                                  component_ops_.at(group.type_id).make_storage);
+            } else {
+                group.storage = registry.FindBasicStorage(group.type_id);
+            }
+        }
+
+        if (pool && groups_.size() > 1 && last - first >= parallel_threshold_k) {
+            ApplyGroupsParallel(*pool);
+        } else {
+            for (std::size_t index = 0; index < groups_.size(); ++index) {
+                ApplyGroup(index);
+            }
+        }
+
+        // 实体到组件的索引是所有组共享的，最后串行更新
+        for (const auto& group : groups_) {
+            const auto attached = std::span(attach_entities_).subspan(
+                group.attach_begin, group.attach_end - group.attach_begin);
+            registry.MarkComponentsAttached(group.type_id, attached);
+
+            if (group.storage) {
+                const auto detached = std::span(detach_entities_).subspan(
+                    group.detach_begin, group.detach_end - group.detach_begin);
+                registry.MarkComponentsDetached(group.type_id, detached);
+            }
+
+            if (recorder_) {
+                RecordGroup(group);
+            }
+        }
     }
 
 private:
     WorldType& world_;
-    CommandQueueType command_queue_;
+
+    CommandRecorder<Entity>* recorder_{nullptr};
+
+    // 所有命令都按记录的顺序放在 structural_ 中，组件的字节放在 payload_ 中，其他命令放在 closures_ 中
+    mutable std::mutex structural_mutex_;
+    std::vector<StructuralCommandType> structural_;
+    std::vector<std::byte> payload_;
+    std::vector<CommandType> closures_;
+    std::unordered_map<ComponentTypeId, ComponentOpsType> component_ops_;
+
+    // structural_ 和所有段中的命令数量
+    std::size_t size_{0};
+
+    // 还没有执行的、不能平凡复制的资源命令的数量，这时不能设置记录器
+    std::size_t unrecordable_count_{0};
+
+    // Append 接管的段，前 segment_count_ 个按顺序排在 structural_ 之前
+    std::vector<Segment> segments_;
+    std::size_t segment_count_{0};
+
+    // Execute 时使用的临时数组，保留下来避免每帧重新分配
+    std::vector<EntityOriginalType> destroyed_;
+    std::vector<EntityOriginalType> attach_entities_;
+    std::vector<std::byte> attach_payload_;
+    std::vector<EntityOriginalType> detach_entities_;
+    std::vector<CommandGroup> groups_;
+    std::vector<EntityOriginalType> spawned_;
+
+    /// 结构性命令少于这个数量时，并行执行的开销比收益大
+    static constexpr std::size_t parallel_threshold_k = 1024;
 };
 } // namespace ecs
 
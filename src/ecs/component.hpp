@@ -19,6 +19,48 @@ concept AllowedComponentType = std::is_trivially_copyable_v<Type> &&
 /// ComponentTypeId 类型
 using ComponentTypeId = TypeId;
 
+
+/// 共享组件的标记，相同的值在所有实体之间只存一份，见 SharedStorage
+///
+/// 在 View 和 Registry::GetComponentReference 中写 Shared<T>，得到的是 const T&
+template <AllowedComponentType Component>
+struct Shared {
+    using ValueType = Component;
+};
+
+namespace internal::components {
+/// 访问组件时得到的引用和指针类型，共享组件是只读的
+template <typename Type>
+struct ComponentAccessTrait {
+    using ReferenceType = Type&;
+    using PointerType = Type*;
+    static constexpr bool is_shared_k = false;
+};
+
+template <AllowedComponentType Component>
+struct ComponentAccessTrait<Shared<Component>> {
+    using ReferenceType = const Component&;
+    using PointerType = const Component*;
+    static constexpr bool is_shared_k = true;
+};
+
+/// 在 View 中写 const T 表示只读取，得到的是 const T&，不会被记录为修改
+template <typename Type>
+struct ComponentAccessTrait<const Type> : ComponentAccessTrait<Type> {
+    using ReferenceType = const std::remove_reference_t<typename ComponentAccessTrait<Type>::ReferenceType>&;
+    using PointerType = const std::remove_pointer_t<typename ComponentAccessTrait<Type>::PointerType>*;
+};
+} // namespace internal::components
+
+template <typename Type>
+using ComponentReferenceType = typename internal::components::ComponentAccessTrait<Type>::ReferenceType;
+
+template <typename Type>
+using ComponentPointerType = typename internal::components::ComponentAccessTrait<Type>::PointerType;
+
+template <typename Type>
+constexpr bool is_shared_component_k = internal::components::ComponentAccessTrait<Type>::is_shared_k;
+
 namespace internal::duplicate {
 template <AllowedComponentType... Components>
 constexpr bool CheckDuplicateComponents();
@@ -79,18 +121,20 @@ template <typename Type>
 struct ComponentsTupleTrait<Type> : ComponentsTupleTrait<typename Type::TupleType> {
 };
 
-template <AllowedComponentType... Components>
+/// 组件可以带 const，表示只读取
+template <typename... Components>
+    requires (AllowedComponentType<std::remove_const_t<Components>> && ...)
 struct ComponentsTupleTrait<std::tuple<Components...>> {
     /// 原始元组类型
     using TupleType = std::tuple<std::decay_t<Components>...>;
 
     /// 引用元组类型，用于 Required 的情况
-    using ReferenceTupleType = std::tuple<std::decay_t<Components>&...>;
+    using ReferenceTupleType = std::tuple<ComponentReferenceType<Components>...>;
 
     /// 指针元组类型，用于 Optional 的情况
-    using PointerTupleType = std::tuple<std::decay_t<Components>*...>;
+    using PointerTupleType = std::tuple<ComponentPointerType<Components>...>;
 
-    static constexpr bool is_duplicate_k = duplicate::CheckDuplicateComponents<Components...>();
+    static constexpr bool is_duplicate_k = duplicate::CheckDuplicateComponents<std::decay_t<Components>...>();
     static constexpr std::size_t size_k = sizeof...(Components);
     static constexpr std::array<ComponentTypeId, size_k> type_ids_k = {GetTypeId<std::decay_t<Components>>()...};
 };
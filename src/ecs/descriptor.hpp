@@ -0,0 +1,125 @@
+#ifndef DESCRIPTOR_HPP
+#define DESCRIPTOR_HPP
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+#include "component.hpp"
+#include "storage.hpp"
+#include "type.hpp"
+
+namespace ecs {
+template <AllowedEntityType Entity>
+class Registry;
+
+/// 组件类型的描述，用于在运行时创建和访问组件
+template <AllowedEntityType Entity>
+struct ComponentDescriptor {
+    using BasicStorageType = BasicStorage<Entity>;
+
+    // 创建编译期类型的 Storage，运行时类型为空
+    using MakeStorageType = std::unique_ptr<BasicStorageType> (*)();
+
+    ComponentTypeId type_id;
+    std::size_t size;
+    std::size_t alignment;
+    std::string name;
+
+    MakeStorageType make_storage{nullptr};
+
+    [[nodiscard]] bool IsRuntime() const noexcept {
+        return make_storage == nullptr;
+    }
+
+    /// 编译期类型创建 Storage<Entity, Component>，运行时类型创建 RuntimeStorage
+    ///
+    /// 编译期类型一定要创建对应的 Storage，否则之后用模板访问时的 static_cast 是错误的
+    [[nodiscard]] std::unique_ptr<BasicStorageType> MakeStorage() const {
+        if (make_storage) {
+            return make_storage();
+        }
+        return std::make_unique<RuntimeStorage<Entity>>(size, alignment);
+    }
+};
+
+/// 组件描述的注册表，按 ComponentTypeId 和名字查找
+///
+/// 编译期类型的 ComponentTypeId 和 GetTypeId 相同，运行时类型的 ComponentTypeId 是名字的哈希。
+/// 返回的引用在注册表的生命周期内不会失效
+template <AllowedEntityType Entity>
+class ComponentDescriptorRegistry {
+public:
+    using DescriptorType = ComponentDescriptor<Entity>;
+
+    template <AllowedComponentType Component>
+    const DescriptorType& Register(std::string name) {
+        return Insert(DescriptorType{
+            GetTypeId<Component>(),
+            sizeof(Component),
+            alignof(Component),
+            std::move(name),
+            &Registry<Entity>::template MakeStorage<Component>
+        });
+    }
+
+    /// 注册一个运行时类型
+    const DescriptorType& Register(std::string name, const std::size_t size, const std::size_t alignment) {
+        if (alignment == 0 || alignment > alignof(std::max_align_t) || (alignment & (alignment - 1)) != 0) {
+            throw std::runtime_error("ComponentDescriptorRegistry::Register: Invalid alignment");
+        }
+
+        const auto type_id = internal::fnv1a_64(name);
+        return Insert(DescriptorType{type_id, size, alignment, std::move(name), nullptr});
+    }
+
+    [[nodiscard]] const DescriptorType* Find(const ComponentTypeId type_id) const {
+        const auto it = descriptors_.find(type_id);
+        return it == descriptors_.end() ? nullptr : &it->second;
+    }
+
+    [[nodiscard]] const DescriptorType* Find(const std::string_view name) const {
+        const auto it = names_.find(std::string(name));
+        return it == names_.end() ? nullptr : Find(it->second);
+    }
+
+    [[nodiscard]] const DescriptorType& Get(const std::string_view name) const {
+        const auto* descriptor = Find(name);
+        if (!descriptor) {
+            throw std::runtime_error("ComponentDescriptorRegistry::Get: Component not registered");
+        }
+        return *descriptor;
+    }
+
+    [[nodiscard]] std::size_t Size() const noexcept {
+        return descriptors_.size();
+    }
+
+private:
+    const DescriptorType& Insert(DescriptorType descriptor) {
+        if (const auto* existing = Find(descriptor.type_id)) {
+            // 重复注册同一种类型是允许的，但是描述必须一致
+            if (existing->size != descriptor.size || existing->alignment != descriptor.alignment ||
+                existing->name != descriptor.name) {
+                throw std::runtime_error("ComponentDescriptorRegistry::Register: Conflicting descriptor");
+            }
+            return *existing;
+        }
+        if (names_.contains(descriptor.name)) {
+            throw std::runtime_error("ComponentDescriptorRegistry::Register: Duplicate name");
+        }
+
+        names_.emplace(descriptor.name, descriptor.type_id);
+        const auto type_id = descriptor.type_id;
+        return descriptors_.emplace(type_id, std::move(descriptor)).first->second;
+    }
+
+private:
+    std::unordered_map<ComponentTypeId, DescriptorType> descriptors_;
+    std::unordered_map<std::string, ComponentTypeId> names_;
+};
+} // namespace ecs
+
+#endif // DESCRIPTOR_HPP
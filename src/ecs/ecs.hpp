@@ -4,13 +4,25 @@
 #include "type.hpp"
 #include "component.hpp"
 #include "entity.hpp"
+#include "function.hpp"
+#include "index.hpp"
 #include "storage.hpp"
+#include "descriptor.hpp"
+#include "prefab.hpp"
 #include "registry.hpp"
 #include "system.hpp"
 #include "scheduler.hpp"
+#include "replay.hpp"
+#include "snapshot.hpp"
+#include "rollback.hpp"
 #include "commands.hpp"
 #include "viewer.hpp"
+#include "archetype.hpp"
+#include "static_world.hpp"
 #include "resource.hpp"
+#include "worker_local.hpp"
+#include "event.hpp"
+#include "hierarchy.hpp"
 #include "world.hpp"
 #include "application.hpp"
 
@@ -0,0 +1,133 @@
+#ifndef EVENT_HPP
+#define EVENT_HPP
+
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "scheduler.hpp"
+#include "worker_local.hpp"
+
+namespace ecs {
+/// 事件类型，必须是 decay 过的、可以移动构造的类型
+template <typename Type>
+concept AllowedEventType = std::is_object_v<Type> &&
+    std::is_same_v<Type, std::decay_t<Type>> &&
+    std::is_move_constructible_v<Type>;
+
+/// 双缓冲的事件通道，在 System 之间传递碰撞、伤害、生成请求之类的事件
+///
+/// 写入的一侧每个工作线程一个缓冲区，按缓存行对齐，Send 不需要加锁。
+/// 读取的一侧是上一帧写入的事件，只读，所以多个 System 可以同时读取。
+/// 帧结束时调用 Swap 交换两侧的缓冲区，交换本身是 O(1) 的，清空时会保留缓冲区的容量。
+/// 通常用 Application::AddEventChannel 创建，它会作为资源放进 Resources，并在每一帧结束时交换
+template <AllowedEventType Event>
+class EventChannel {
+private:
+    struct alignas(internal::cache_line_size_k) Buffer {
+        std::vector<Event> events;
+    };
+
+public:
+    /// num_threads 需要不小于执行 System 的线程池的线程数，另外还有一个缓冲区留给调用线程。
+    /// 默认值是 hardware_concurrency，Application::AddEventChannel 会传入调度器实际的线程数
+    explicit EventChannel(const std::size_t num_threads = std::thread::hardware_concurrency())
+        : writing_(num_threads + 1), reading_(num_threads + 1) {
+    }
+
+    EventChannel(const EventChannel&) = delete;
+    EventChannel& operator=(const EventChannel&) = delete;
+
+    EventChannel(EventChannel&&) noexcept = default;
+    EventChannel& operator=(EventChannel&&) noexcept = default;
+
+    ~EventChannel() = default;
+
+    /// 写入当前线程的缓冲区，下一帧才能读到
+    ///
+    /// 线程池的线程数比构造时给出的多时抛出异常
+    void Send(Event event) {
+        WritingBuffer().events.push_back(std::move(event));
+    }
+
+    template <typename... Args>
+    Event& Emplace(Args&&... args) {
+        return WritingBuffer().events.emplace_back(std::forward<Args>(args)...);
+    }
+
+    /// 按缓冲区的顺序遍历上一帧的事件，每个缓冲区是一段连续的 span，跳过空的缓冲区
+    template <typename Func>
+    void EachSpan(Func&& func) const {
+        for (const auto& buffer : reading_) {
+            if (!buffer.events.empty()) {
+                func(std::span<const Event>(buffer.events));
+            }
+        }
+    }
+
+    /// 遍历上一帧的每一个事件
+    template <typename Func>
+    void Each(Func&& func) const {
+        for (const auto& buffer : reading_) {
+            for (const auto& event : buffer.events) {
+                func(event);
+            }
+        }
+    }
+
+    /// 上一帧的事件数量
+    [[nodiscard]] std::size_t Size() const noexcept {
+        std::size_t size = 0;
+        for (const auto& buffer : reading_) {
+            size += buffer.events.size();
+        }
+        return size;
+    }
+
+    [[nodiscard]] bool Empty() const noexcept {
+        return Size() == 0;
+    }
+
+    /// 这一帧写入的事件成为可读的事件，上一帧的事件被丢弃，不能和 Send 或读取同时调用
+    void Swap() noexcept {
+        writing_.swap(reading_);
+        for (auto& buffer : writing_) {
+            buffer.events.clear();
+        }
+    }
+
+    /// 丢弃两侧的所有事件
+    void Clear() noexcept {
+        for (auto& buffer : writing_) {
+            buffer.events.clear();
+        }
+        for (auto& buffer : reading_) {
+            buffer.events.clear();
+        }
+    }
+
+    [[nodiscard]] std::size_t BufferCount() const noexcept {
+        return writing_.size();
+    }
+
+private:
+    Buffer& WritingBuffer() {
+        const auto slot = internal::current_worker_slot;
+        if (slot >= writing_.size()) {
+            throw std::runtime_error("EventChannel: Fewer buffers than the thread pool");
+        }
+        return writing_[slot];
+    }
+
+private:
+    // 下标是 internal::current_worker_slot
+    std::vector<Buffer> writing_;
+    std::vector<Buffer> reading_;
+};
+} // namespace ecs
+
+#endif // EVENT_HPP
@@ -0,0 +1,179 @@
+#ifndef FUNCTION_HPP
+#define FUNCTION_HPP
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ecs {
+template <typename Signature, std::size_t BufferSize = 48>
+class SmallFunction;
+
+namespace internal {
+template <typename Type>
+constexpr bool is_std_function_k = false;
+
+template <typename Signature>
+constexpr bool is_std_function_k<std::function<Signature>> = true;
+} // namespace internal
+
+/// 只能移动的可调用对象包装，用来代替 std::function 存放 System
+///
+/// 不超过 BufferSize 的可调用对象直接构造在内部缓冲区中，不分配内存；
+/// 更大的可调用对象只在构造时分配一次，之后的移动只是移动指针。
+/// 调用只有一次间接跳转。
+template <typename Return, typename... Args, std::size_t BufferSize>
+class SmallFunction<Return(Args...), BufferSize> {
+    static_assert(BufferSize >= sizeof(void*), "SmallFunction: BufferSize is too small");
+
+    enum class Operation {
+        Move,
+        Destroy,
+    };
+
+    using InvokeType = Return (*)(void*, Args&&...);
+    using ManageType = void (*)(Operation, void*, void*);
+
+    /// 能否直接放在内部缓冲区中，移动时不能抛异常，否则 SmallFunction 的移动也就不是 noexcept 的了
+    template <typename Function>
+    static constexpr bool is_local_k = sizeof(Function) <= BufferSize &&
+        alignof(Function) <= alignof(std::max_align_t) &&
+        std::is_nothrow_move_constructible_v<Function>;
+
+public:
+    SmallFunction() noexcept = default;
+
+    SmallFunction(std::nullptr_t) noexcept {
+    }
+
+    template <typename Function>
+        requires (!std::is_same_v<std::remove_cvref_t<Function>, SmallFunction>) &&
+        std::is_invocable_r_v<Return, std::decay_t<Function>&, Args...>
+    SmallFunction(Function&& function) {
+        using FunctionType = std::decay_t<Function>;
+        using SourceType = std::remove_cvref_t<Function>;
+
+        // 空的函数指针和 std::function 当作空的 SmallFunction，函数的引用不可能为空，不需要检查
+        if constexpr (std::is_pointer_v<SourceType> || std::is_member_pointer_v<SourceType>) {
+            if (function == nullptr) return;
+        } else if constexpr (internal::is_std_function_k<SourceType>) {
+            if (!function) return;
+        }
+
+        if constexpr (is_local_k<FunctionType>) {
+            ::new(static_cast<void*>(buffer_)) FunctionType(std::forward<Function>(function));
+        } else {
+            ::new(static_cast<void*>(buffer_)) FunctionType*(new FunctionType(std::forward<Function>(function)));
+        }
+
+        invoke_ = &Invoke<FunctionType>;
+        manage_ = &Manage<FunctionType>;
+    }
+
+    SmallFunction(const SmallFunction&) = delete;
+    SmallFunction& operator=(const SmallFunction&) = delete;
+
+    SmallFunction(SmallFunction&& other) noexcept {
+        MoveFrom(other);
+    }
+
+    SmallFunction& operator=(SmallFunction&& other) noexcept {
+        // 一定要检查自赋值
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+
+        return *this;
+    }
+
+    SmallFunction& operator=(std::nullptr_t) noexcept {
+        Reset();
+        return *this;
+    }
+
+    ~SmallFunction() {
+        Reset();
+    }
+
+    explicit operator bool() const noexcept {
+        return invoke_ != nullptr;
+    }
+
+    Return operator()(Args... args) const {
+        if (!invoke_) {
+            throw std::bad_function_call();
+        }
+
+        // 和 std::function 一样，const 的调用也可以修改内部的可调用对象
+        return invoke_(const_cast<std::byte*>(buffer_), std::forward<Args>(args)...);
+    }
+
+private:
+    template <typename Function>
+    static Function* Target(void* buffer) noexcept {
+        if constexpr (is_local_k<Function>) {
+            return std::launder(static_cast<Function*>(buffer));
+        } else {
+            return *std::launder(static_cast<Function**>(buffer));
+        }
+    }
+
+    template <typename Function>
+    static Return Invoke(void* buffer, Args&&... args) {
+        if constexpr (std::is_void_v<Return>) {
+            std::invoke(*Target<Function>(buffer), std::forward<Args>(args)...);
+        } else {
+            return std::invoke(*Target<Function>(buffer), std::forward<Args>(args)...);
+        }
+    }
+
+    template <typename Function>
+    static void Manage(const Operation operation, void* dst, void* src) noexcept {
+        switch (operation) {
+        case Operation::Move:
+            if constexpr (is_local_k<Function>) {
+                Function* source = Target<Function>(src);
+                ::new(dst) Function(std::move(*source));
+                source->~Function();
+            } else {
+                ::new(dst) Function*(Target<Function>(src));
+            }
+            break;
+        case Operation::Destroy:
+            if constexpr (is_local_k<Function>) {
+                Target<Function>(dst)->~Function();
+            } else {
+                delete Target<Function>(dst);
+            }
+            break;
+        }
+    }
+
+    void MoveFrom(SmallFunction& other) noexcept {
+        if (!other.manage_) return;
+
+        other.manage_(Operation::Move, buffer_, other.buffer_);
+        invoke_ = std::exchange(other.invoke_, nullptr);
+        manage_ = std::exchange(other.manage_, nullptr);
+    }
+
+    void Reset() noexcept {
+        if (!manage_) return;
+
+        manage_(Operation::Destroy, buffer_, nullptr);
+        invoke_ = nullptr;
+        manage_ = nullptr;
+    }
+
+private:
+    alignas(std::max_align_t) std::byte buffer_[BufferSize]{};
+
+    InvokeType invoke_{nullptr};
+    ManageType manage_{nullptr};
+};
+} // namespace ecs
+
+#endif // FUNCTION_HPP
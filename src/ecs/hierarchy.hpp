@@ -0,0 +1,506 @@
+#ifndef HIERARCHY_HPP
+#define HIERARCHY_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "entity.hpp"
+#include "scheduler.hpp"
+
+namespace ecs {
+/// 实体的父子关系，以及沿着父子关系传播的变换（例如局部坐标到世界坐标）
+///
+/// 节点按深度排列在紧密的数组中，同一深度的节点是连续的一段，父节点总是在更浅的一段里，
+/// 每个节点直接保存父节点在数组中的下标，传播时不需要查表。
+/// 插入、删除和修改父节点时，每经过一层只需要交换一个节点，不会重新排列整个数组。
+/// 被交换的节点的子节点保存的下标不会立即修正，而是在下一次 Propagate 之前统一修正，
+/// 每个移动过的节点只修正一次，所以修正的总开销不超过节点的数量。
+/// 修改局部变换会标记节点，Propagate 从最浅的被标记的一层开始逐层计算，同一层可以并行
+template <AllowedEntityType Entity, typename Transform>
+class Hierarchy {
+public:
+    using EntityTraitsType = EntityTraits<Entity>;
+    using EntityOriginalType = typename EntityTraitsType::OriginalType;
+    using EntityIdType = typename EntityTraitsType::IdType;
+    using EntityUnderlyingType = typename EntityTraitsType::UnderlyingType;
+
+    static constexpr std::size_t npos_k = std::numeric_limits<std::size_t>::max();
+
+    /// 并行传播时每个任务处理的节点数量
+    static constexpr std::size_t propagate_chunk_size_k = 4096;
+
+private:
+    static constexpr EntityOriginalType null_entity_k = ToOriginal<EntityOriginalType>(NullEntity<EntityOriginalType>());
+
+    /// 按实体 ID 索引，节点在数组中移动时只需要修改 index
+    struct Link {
+        std::size_t index{npos_k};
+        std::size_t depth{0};
+
+        EntityOriginalType parent{null_entity_k};
+        EntityOriginalType first_child{null_entity_k};
+        EntityOriginalType next_sibling{null_entity_k};
+        EntityOriginalType prev_sibling{null_entity_k};
+
+        // 移动过并且子节点的 parents_ 还没有修正
+        bool moved{false};
+    };
+
+public:
+    Hierarchy() = default;
+
+    Hierarchy(const Hierarchy&) = delete;
+    Hierarchy& operator=(const Hierarchy&) = delete;
+
+    Hierarchy(Hierarchy&&) noexcept = default;
+    Hierarchy& operator=(Hierarchy&&) noexcept = default;
+
+    ~Hierarchy() = default;
+
+    /// 插入一个根节点
+    void Insert(const EntityOriginalType entity, Transform local) {
+        Insert(entity, std::move(local), null_entity_k);
+    }
+
+    /// 插入一个节点，parent 必须已经在层级中
+    void Insert(const EntityOriginalType entity, Transform local, const EntityOriginalType parent) {
+        if (Contains(entity)) {
+            throw std::runtime_error("Hierarchy::Insert: Entity already exists");
+        }
+        if (parent != null_entity_k && !Contains(parent)) {
+            throw std::runtime_error("Hierarchy::Insert: Parent does not exist");
+        }
+
+        const auto id = IdOf(entity);
+        if (id >= links_.size()) {
+            links_.resize(static_cast<std::size_t>(id) + 1);
+        }
+
+        auto& link = links_[id];
+        link = Link{};
+        link.depth = parent == null_entity_k ? 0 : LinkOf(parent).depth + 1;
+        LinkChild(entity, parent);
+
+        const auto parent_index = parent == null_entity_k ? npos_k : LinkOf(parent).index;
+        auto world = local;
+        InsertSlot(entity, std::move(local), std::move(world), parent_index, link.depth);
+        MarkDirty(link.index, link.depth);
+    }
+
+    /// 删除一个节点，它的子节点成为根节点
+    void Remove(const EntityOriginalType entity) {
+        if (!Contains(entity)) return;
+
+        while (LinkOf(entity).first_child != null_entity_k) {
+            SetParent(LinkOf(entity).first_child, null_entity_k);
+        }
+
+        UnlinkChild(entity);
+        RemoveSlot(entity);
+        LinkOf(entity) = Link{};
+    }
+
+    void Clear() noexcept {
+        links_.clear();
+        entities_.clear();
+        parents_.clear();
+        locals_.clear();
+        worlds_.clear();
+        dirty_.clear();
+        moved_.clear();
+        levels_.assign(1, 0);
+        min_dirty_level_ = npos_k;
+        max_dirty_level_ = 0;
+    }
+
+    [[nodiscard]] bool Contains(const EntityOriginalType entity) const noexcept {
+        const auto id = IdOf(entity);
+        return id < links_.size() && links_[id].index != npos_k && entities_[links_[id].index] == entity;
+    }
+
+    /// 修改父节点，parent 为空实体时成为根节点
+    ///
+    /// 深度不变时是 O(1) 的，否则整棵子树按层移动，每个节点的开销和层数成正比
+    void SetParent(const EntityOriginalType entity, const EntityOriginalType parent) {
+        if (!Contains(entity)) {
+            throw std::runtime_error("Hierarchy::SetParent: Entity does not exist");
+        }
+        if (parent != null_entity_k) {
+            if (!Contains(parent)) {
+                throw std::runtime_error("Hierarchy::SetParent: Parent does not exist");
+            }
+            for (auto ancestor = parent; ancestor != null_entity_k; ancestor = LinkOf(ancestor).parent) {
+                if (ancestor == entity) {
+                    throw std::runtime_error("Hierarchy::SetParent: Cycle detected");
+                }
+            }
+        }
+
+        if (LinkOf(entity).parent == parent) return;
+
+        UnlinkChild(entity);
+        LinkChild(entity, parent);
+
+        const auto depth = parent == null_entity_k ? 0 : LinkOf(parent).depth + 1;
+        if (depth == LinkOf(entity).depth) {
+            const auto index = LinkOf(entity).index;
+            parents_[index] = parent == null_entity_k ? npos_k : LinkOf(parent).index;
+            MarkDirty(index, depth);
+            return;
+        }
+
+        // 按广度优先的顺序移动，移动一个节点时它的父节点已经在新的一层
+        subtree_.clear();
+        subtree_.push_back(entity);
+        for (std::size_t i = 0; i < subtree_.size(); ++i) {
+            ForEachChild(subtree_[i], [this](const EntityOriginalType child) {
+                subtree_.push_back(child);
+            });
+        }
+
+        const auto delta = static_cast<std::ptrdiff_t>(depth) - static_cast<std::ptrdiff_t>(LinkOf(entity).depth);
+        for (const auto node : subtree_) {
+            const auto index = LinkOf(node).index;
+            auto local = std::move(locals_[index]);
+            auto world = std::move(worlds_[index]);
+            const bool dirty = dirty_[index];
+            RemoveSlot(node);
+
+            auto& link = LinkOf(node);
+            link.depth = static_cast<std::size_t>(static_cast<std::ptrdiff_t>(link.depth) + delta);
+            const auto parent_index = link.parent == null_entity_k ? npos_k : LinkOf(link.parent).index;
+            InsertSlot(node, std::move(local), std::move(world), parent_index, link.depth);
+
+            if (dirty || node == entity) {
+                MarkDirty(link.index, link.depth);
+            }
+        }
+    }
+
+    void RemoveParent(const EntityOriginalType entity) {
+        SetParent(entity, null_entity_k);
+    }
+
+    /// 根节点没有父节点
+    [[nodiscard]] std::optional<EntityOriginalType> ParentOf(const EntityOriginalType entity) const {
+        const auto parent = CheckedLinkOf(entity, "Hierarchy::ParentOf: Entity does not exist").parent;
+        if (parent == null_entity_k) return std::nullopt;
+        return parent;
+    }
+
+    /// 根节点的深度为 0
+    [[nodiscard]] std::size_t DepthOf(const EntityOriginalType entity) const {
+        return CheckedLinkOf(entity, "Hierarchy::DepthOf: Entity does not exist").depth;
+    }
+
+    template <typename Func>
+    void ForEachChild(const EntityOriginalType entity, Func&& func) const {
+        const auto& link = CheckedLinkOf(entity, "Hierarchy::ForEachChild: Entity does not exist");
+        for (auto child = link.first_child; child != null_entity_k;) {
+            // 允许在 func 中修改这个子节点的父节点
+            const auto next = LinkOf(child).next_sibling;
+            func(child);
+            child = next;
+        }
+    }
+
+    [[nodiscard]] const Transform& GetLocal(const EntityOriginalType entity) const {
+        return locals_[CheckedLinkOf(entity, "Hierarchy::GetLocal: Entity does not exist").index];
+    }
+
+    /// 修改局部变换，下一次 Propagate 时重新计算这个节点和它的子树
+    void SetLocal(const EntityOriginalType entity, Transform local) {
+        const auto& link = CheckedLinkOf(entity, "Hierarchy::SetLocal: Entity does not exist");
+        locals_[link.index] = std::move(local);
+        MarkDirty(link.index, link.depth);
+    }
+
+    /// 上一次 Propagate 计算出的变换
+    [[nodiscard]] const Transform& GetWorld(const EntityOriginalType entity) const {
+        return worlds_[CheckedLinkOf(entity, "Hierarchy::GetWorld: Entity does not exist").index];
+    }
+
+    /// 从最浅的被标记的一层开始逐层计算 world = combine(parent_world, local)，根节点的 world 就是 local
+    ///
+    /// 只重新计算被标记的节点和它们的子树，某一层之后没有被标记的节点时提前结束。
+    /// 传入线程池时，每一层分成 propagate_chunk_size_k 个节点一组并行计算，调用线程也会参与；
+    /// 不能在这个线程池的工作线程中调用，否则可能会死锁
+    template <typename Func>
+    void Propagate(Func&& combine, internal::ThreadPool* pool = nullptr) {
+        FixMovedParents();
+
+        const auto level_count = LevelCount();
+        if (min_dirty_level_ >= level_count) {
+            // 被标记的节点都已经删除了
+            min_dirty_level_ = npos_k;
+            max_dirty_level_ = 0;
+            return;
+        }
+
+        auto last = min_dirty_level_;
+        for (auto level = min_dirty_level_; level < level_count; ++level) {
+            last = level;
+            if (!PropagateLevel(combine, levels_[level], levels_[level + 1], pool) && level >= max_dirty_level_) {
+                break;
+            }
+        }
+
+        std::fill(dirty_.begin() + static_cast<std::ptrdiff_t>(levels_[min_dirty_level_]),
+                  dirty_.begin() + static_cast<std::ptrdiff_t>(levels_[last + 1]), std::uint8_t{0});
+        min_dirty_level_ = npos_k;
+        max_dirty_level_ = 0;
+    }
+
+    /// 节点的数量
+    [[nodiscard]] std::size_t Size() const noexcept {
+        return entities_.size();
+    }
+
+    [[nodiscard]] bool Empty() const noexcept {
+        return entities_.empty();
+    }
+
+    /// 层数，也就是最大深度加 1
+    [[nodiscard]] std::size_t LevelCount() const noexcept {
+        return levels_.size() - 1;
+    }
+
+    /// 某一层的所有实体
+    [[nodiscard]] std::span<const EntityOriginalType> Level(const std::size_t depth) const noexcept {
+        return std::span(entities_).subspan(levels_[depth], levels_[depth + 1] - levels_[depth]);
+    }
+
+    /// 按深度排列的所有实体，和 Worlds、Locals 的下标对应
+    [[nodiscard]] std::span<const EntityOriginalType> Entities() const noexcept {
+        return entities_;
+    }
+
+    [[nodiscard]] std::span<const Transform> Worlds() const noexcept {
+        return worlds_;
+    }
+
+    [[nodiscard]] std::span<const Transform> Locals() const noexcept {
+        return locals_;
+    }
+
+private:
+    /// 返回这一层是否有被标记的节点
+    template <typename Func>
+    bool PropagateLevel(Func& combine, const std::size_t begin, const std::size_t end, internal::ThreadPool* pool) {
+        const auto chunk_count = (end - begin + propagate_chunk_size_k - 1) / propagate_chunk_size_k;
+        if (!pool || chunk_count <= 1) {
+            return PropagateRange(combine, begin, end);
+        }
+
+        chunk_dirty_.assign(chunk_count, 0);
+        auto propagate = [&](const std::size_t chunk) {
+            const auto chunk_begin = begin + chunk * propagate_chunk_size_k;
+            const auto chunk_end = std::min(end, chunk_begin + propagate_chunk_size_k);
+            chunk_dirty_[chunk] = PropagateRange(combine, chunk_begin, chunk_end);
+        };
+        internal::ForkJoin(*pool, chunk_count, propagate);
+
+        return std::ranges::any_of(chunk_dirty_, [](const std::uint8_t dirty) { return dirty != 0; });
+    }
+
+    /// 只读取父节点所在的上一层，只写入这一段，所以同一层的不同段可以并行
+    template <typename Func>
+    bool PropagateRange(Func& combine, const std::size_t begin, const std::size_t end) {
+        bool any = false;
+        for (auto index = begin; index < end; ++index) {
+            const auto parent = parents_[index];
+            if (parent != npos_k && dirty_[parent]) {
+                dirty_[index] = 1;
+            }
+            if (!dirty_[index]) continue;
+
+            any = true;
+            if (parent == npos_k) {
+                worlds_[index] = locals_[index];
+            } else {
+                worlds_[index] = combine(std::as_const(worlds_[parent]), std::as_const(locals_[index]));
+            }
+        }
+        return any;
+    }
+
+    void MarkDirty(const std::size_t index, const std::size_t depth) noexcept {
+        dirty_[index] = 1;
+        min_dirty_level_ = std::min(min_dirty_level_, depth);
+        max_dirty_level_ = std::max(max_dirty_level_, depth);
+    }
+
+    static EntityIdType IdOf(const EntityOriginalType entity) noexcept {
+        return GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(entity));
+    }
+
+    Link& LinkOf(const EntityOriginalType entity) noexcept {
+        return links_[IdOf(entity)];
+    }
+
+    const Link& LinkOf(const EntityOriginalType entity) const noexcept {
+        return links_[IdOf(entity)];
+    }
+
+    const Link& CheckedLinkOf(const EntityOriginalType entity, const char* message) const {
+        if (!Contains(entity)) {
+            throw std::runtime_error(message);
+        }
+        return LinkOf(entity);
+    }
+
+    /// 加入 parent 的子节点链表的头部
+    void LinkChild(const EntityOriginalType entity, const EntityOriginalType parent) noexcept {
+        auto& link = LinkOf(entity);
+        link.parent = parent;
+        link.prev_sibling = null_entity_k;
+        link.next_sibling = null_entity_k;
+        if (parent == null_entity_k) return;
+
+        auto& parent_link = LinkOf(parent);
+        link.next_sibling = parent_link.first_child;
+        if (parent_link.first_child != null_entity_k) {
+            LinkOf(parent_link.first_child).prev_sibling = entity;
+        }
+        parent_link.first_child = entity;
+    }
+
+    void UnlinkChild(const EntityOriginalType entity) noexcept {
+        auto& link = LinkOf(entity);
+        if (link.prev_sibling != null_entity_k) {
+            LinkOf(link.prev_sibling).next_sibling = link.next_sibling;
+        } else if (link.parent != null_entity_k) {
+            LinkOf(link.parent).first_child = link.next_sibling;
+        }
+        if (link.next_sibling != null_entity_k) {
+            LinkOf(link.next_sibling).prev_sibling = link.prev_sibling;
+        }
+        link.parent = null_entity_k;
+        link.prev_sibling = null_entity_k;
+        link.next_sibling = null_entity_k;
+    }
+
+    /// 节点移动到 index 之后，修正它自己保存的下标，子节点保存的下标留到 FixMovedParents 修正
+    void FixIndex(const std::size_t index) {
+        auto& link = LinkOf(entities_[index]);
+        link.index = index;
+        if (!link.moved && link.first_child != null_entity_k) {
+            link.moved = true;
+            moved_.push_back(entities_[index]);
+        }
+    }
+
+    /// 修正移动过的节点的子节点保存的下标，每个节点只处理一次
+    void FixMovedParents() noexcept {
+        for (const auto entity : moved_) {
+            // 移动之后可能被删除了，或者删除之后重新插入又被记录了一次
+            if (!Contains(entity) || !LinkOf(entity).moved) continue;
+
+            auto& link = LinkOf(entity);
+            link.moved = false;
+            for (auto child = link.first_child; child != null_entity_k; child = LinkOf(child).next_sibling) {
+                parents_[LinkOf(child).index] = link.index;
+            }
+        }
+        moved_.clear();
+    }
+
+    void SwapSlots(const std::size_t lhs, const std::size_t rhs) {
+        if (lhs == rhs) return;
+
+        using std::swap;
+        swap(entities_[lhs], entities_[rhs]);
+        swap(parents_[lhs], parents_[rhs]);
+        swap(locals_[lhs], locals_[rhs]);
+        swap(worlds_[lhs], worlds_[rhs]);
+        swap(dirty_[lhs], dirty_[rhs]);
+
+        FixIndex(lhs);
+        FixIndex(rhs);
+    }
+
+    /// 放到 depth 这一层的末尾，之后每一层的第一个节点依次移动到这一层的末尾
+    void InsertSlot(const EntityOriginalType entity, Transform local, Transform world, const std::size_t parent_index,
+                    const std::size_t depth) {
+        if (depth >= LevelCount()) {
+            levels_.push_back(levels_.back());
+        }
+
+        entities_.push_back(entity);
+        parents_.push_back(parent_index);
+        locals_.push_back(std::move(local));
+        worlds_.push_back(std::move(world));
+        dirty_.push_back(0);
+
+        auto index = entities_.size() - 1;
+        FixIndex(index);
+        for (auto level = LevelCount() - 1; level > depth; --level) {
+            const auto first = levels_[level];
+            if (first != levels_[level + 1]) {
+                SwapSlots(first, index);
+                index = first;
+            }
+            ++levels_[level + 1];
+        }
+        ++levels_[depth + 1];
+    }
+
+    /// 移动到这一层的末尾，之后每一层的最后一个节点依次移动到上一层空出来的位置，最后移除数组末尾
+    void RemoveSlot(const EntityOriginalType entity) {
+        const auto depth = LinkOf(entity).depth;
+        auto index = LinkOf(entity).index;
+
+        // 缩小这一层之后，被删除的节点成为下一层的第一个节点，再和下一层的最后一个节点交换
+        for (auto level = depth; level < LevelCount(); ++level) {
+            const auto last = levels_[level + 1] - 1;
+            SwapSlots(index, last);
+            index = last;
+            --levels_[level + 1];
+        }
+
+        LinkOf(entity).index = npos_k;
+        entities_.pop_back();
+        parents_.pop_back();
+        locals_.pop_back();
+        worlds_.pop_back();
+        dirty_.pop_back();
+
+        while (LevelCount() > 0 && levels_[LevelCount() - 1] == levels_[LevelCount()]) {
+            levels_.pop_back();
+        }
+    }
+
+private:
+    // 下标是实体 ID
+    std::vector<Link> links_;
+
+    // 以下数组按深度排列，下标对应
+    std::vector<EntityOriginalType> entities_;
+    std::vector<std::size_t> parents_;
+    std::vector<Transform> locals_;
+    std::vector<Transform> worlds_;
+    std::vector<std::uint8_t> dirty_;
+
+    // 移动过的节点，它们的子节点保存的下标在 Propagate 之前修正
+    std::vector<EntityOriginalType> moved_;
+
+    // 第 i 层是 [levels_[i], levels_[i + 1])
+    std::vector<std::size_t> levels_{0};
+
+    std::size_t min_dirty_level_{npos_k};
+    std::size_t max_dirty_level_{0};
+
+    // 复用的临时数组
+    std::vector<EntityOriginalType> subtree_;
+    std::vector<std::uint8_t> chunk_dirty_;
+};
+} // namespace ecs
+
+#endif // HIERARCHY_HPP
@@ -0,0 +1,146 @@
+#ifndef INDEX_HPP
+#define INDEX_HPP
+
+#include <concepts>
+#include <cstddef>
+#include <functional>
+#include <limits>
+#include <span>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "entity.hpp"
+#include "component.hpp"
+#include "type.hpp"
+
+namespace ecs {
+/// 可以建立索引的组件字段，Member 是 Component 的数据成员指针，字段的值需要可以哈希
+template <auto Member, typename Component>
+concept IndexableFieldType = std::is_member_object_pointer_v<decltype(Member)> &&
+    requires(const Component& component) {
+        { std::hash<std::remove_cvref_t<decltype(component.*Member)>>{}(component.*Member) } -> std::convertible_to<std::size_t>;
+        { component.*Member == component.*Member } -> std::convertible_to<bool>;
+    };
+
+namespace internal {
+/// 组件索引的基类，Storage 通过它在组件变化时更新索引
+template <AllowedEntityType Entity, AllowedComponentType Component>
+class BasicComponentIndex {
+public:
+    using EntityTraitsType = EntityTraits<Entity>;
+    using EntityOriginalType = typename EntityTraitsType::OriginalType;
+    using EntityIdType = typename EntityTraitsType::IdType;
+
+    virtual ~BasicComponentIndex() = default;
+
+    /// 区分同一种组件上的不同索引
+    [[nodiscard]] virtual std::size_t Key() const noexcept = 0;
+
+    /// 插入实体，或者在组件变化之后更新实体所在的位置
+    virtual void Update(EntityIdType entity_id, EntityOriginalType entity, const Component& component) = 0;
+
+    virtual void Erase(EntityIdType entity_id) noexcept = 0;
+
+    virtual void Clear() noexcept = 0;
+};
+} // namespace internal
+
+/// 组件某个字段的值到实体的哈希索引，值相同的实体放在同一个数组中
+///
+/// 每个实体记录了自己在数组中的位置，所以更新和删除都是 O(1) 的。
+/// 由 Storage::AddIndex 创建，Storage 在插入、删除和被记录的修改之后自动更新它
+template <AllowedEntityType Entity, AllowedComponentType Component, auto Member>
+    requires IndexableFieldType<Member, Component>
+class ComponentIndex final : public internal::BasicComponentIndex<Entity, Component> {
+public:
+    using BasicComponentIndexType = internal::BasicComponentIndex<Entity, Component>;
+    using EntityOriginalType = typename BasicComponentIndexType::EntityOriginalType;
+    using EntityIdType = typename BasicComponentIndexType::EntityIdType;
+
+    using FieldType = std::remove_cvref_t<decltype(std::declval<const Component&>().*Member)>;
+
+    static constexpr std::size_t key_k = GetTypeId<ComponentIndex>();
+
+    [[nodiscard]] std::size_t Key() const noexcept override {
+        return key_k;
+    }
+
+    /// 字段等于 value 的所有实体，顺序不固定，下一次修改 Storage 之后失效
+    [[nodiscard]] std::span<const EntityOriginalType> Find(const FieldType& value) const {
+        const auto it = buckets_.find(value);
+        if (it == buckets_.end()) return {};
+        return it->second;
+    }
+
+    [[nodiscard]] bool Contains(const FieldType& value) const {
+        return buckets_.contains(value);
+    }
+
+    /// 不同的值的数量
+    [[nodiscard]] std::size_t BucketCount() const noexcept {
+        return buckets_.size();
+    }
+
+    void Update(const EntityIdType entity_id, const EntityOriginalType entity, const Component& component) override {
+        const auto& value = component.*Member;
+
+        if (entity_id < entries_.size() && entries_[entity_id].position != npos_k) {
+            auto& entry = entries_[entity_id];
+            if (entry.value == value) {
+                buckets_.find(value)->second[entry.position] = entity;
+                return;
+            }
+            Erase(entity_id);
+        }
+
+        if (entity_id >= entries_.size()) {
+            entries_.resize(static_cast<std::size_t>(entity_id) + 1);
+        }
+
+        auto& bucket = buckets_[value];
+        entries_[entity_id] = {value, bucket.size()};
+        bucket.push_back(entity);
+    }
+
+    void Erase(const EntityIdType entity_id) noexcept override {
+        if (entity_id >= entries_.size() || entries_[entity_id].position == npos_k) return;
+
+        auto& entry = entries_[entity_id];
+        const auto it = buckets_.find(entry.value);
+        auto& bucket = it->second;
+
+        // 用最后一个实体填补空位
+        const auto moved = bucket.back();
+        bucket[entry.position] = moved;
+        entries_[GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(moved))].position = entry.position;
+        bucket.pop_back();
+        if (bucket.empty()) {
+            buckets_.erase(it);
+        }
+
+        entry.position = npos_k;
+    }
+
+    void Clear() noexcept override {
+        buckets_.clear();
+        entries_.clear();
+    }
+
+private:
+    static constexpr std::size_t npos_k = std::numeric_limits<std::size_t>::max();
+
+    /// 按实体 ID 索引，记录实体被索引时的值和在数组中的位置
+    struct Entry {
+        FieldType value{};
+        std::size_t position{npos_k};
+    };
+
+private:
+    std::unordered_map<FieldType, std::vector<EntityOriginalType>> buckets_;
+    std::vector<Entry> entries_;
+};
+} // namespace ecs
+
+#endif // INDEX_HPP
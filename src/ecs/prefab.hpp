@@ -0,0 +1,111 @@
+#ifndef PREFAB_HPP
+#define PREFAB_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "component.hpp"
+#include "storage.hpp"
+
+namespace ecs {
+/// 预制体，保存一个实体的所有组件的字节，用于批量生成相同的实体
+///
+/// 可以用 Registry::MakePrefab 从已有的实体中捕获，也可以用 Add 直接构造。
+/// 实例化时每个 Storage 只 reserve 一次，然后按块复制组件，见 Registry::Instantiate
+template <AllowedEntityType Entity>
+class Prefab {
+public:
+    using BasicStorageType = BasicStorage<Entity>;
+
+    // 和 Registry::MakeStorageType 相同
+    using MakeStorageType = std::unique_ptr<BasicStorageType> (*)();
+
+    struct ComponentEntry {
+        ComponentTypeId type_id;
+        std::size_t size;
+
+        // 组件在 data_ 中的偏移
+        std::size_t offset;
+
+        // 从已有的实体中捕获的组件为空，这时目标 Registry 中必须已经有这种组件的 Storage
+        MakeStorageType make_storage;
+    };
+
+    Prefab() = default;
+
+    template <AllowedComponentType Component>
+    Prefab& Add(const Component& component) {
+        return Add(GetTypeId<Component>(), reinterpret_cast<const std::byte*>(&component), sizeof(Component),
+                   &MakeStorage<Component>);
+    }
+
+    /// 加入一个组件，已经有这种组件时覆盖它
+    Prefab& Add(const ComponentTypeId type_id, const std::byte* component, const std::size_t size,
+                const MakeStorageType make_storage = nullptr) {
+        const auto it = std::ranges::find(components_, type_id, &ComponentEntry::type_id);
+        if (it != components_.end() && it->size == size) {
+            std::memcpy(data_.data() + it->offset, component, size);
+            if (make_storage) it->make_storage = make_storage;
+            return *this;
+        }
+        if (it != components_.end()) {
+            Remove(type_id);
+        }
+
+        const auto offset = data_.size();
+        data_.insert(data_.end(), component, component + size);
+        components_.push_back({type_id, size, offset, make_storage});
+        return *this;
+    }
+
+    Prefab& Remove(const ComponentTypeId type_id) {
+        const auto it = std::ranges::find(components_, type_id, &ComponentEntry::type_id);
+        if (it == components_.end()) return *this;
+
+        const auto offset = it->offset;
+        const auto size = it->size;
+        data_.erase(data_.begin() + offset, data_.begin() + offset + size);
+        components_.erase(it);
+        for (auto& entry : components_) {
+            if (entry.offset > offset) entry.offset -= size;
+        }
+        return *this;
+    }
+
+    [[nodiscard]] bool Contains(const ComponentTypeId type_id) const noexcept {
+        return std::ranges::find(components_, type_id, &ComponentEntry::type_id) != components_.end();
+    }
+
+    [[nodiscard]] std::span<const ComponentEntry> Components() const noexcept {
+        return components_;
+    }
+
+    /// 组件的字节
+    [[nodiscard]] const std::byte* ComponentBytes(const ComponentEntry& entry) const noexcept {
+        return data_.data() + entry.offset;
+    }
+
+    [[nodiscard]] std::size_t Size() const noexcept {
+        return components_.size();
+    }
+
+    [[nodiscard]] bool Empty() const noexcept {
+        return components_.empty();
+    }
+
+private:
+    template <AllowedComponentType Component>
+    static std::unique_ptr<BasicStorageType> MakeStorage() {
+        return std::make_unique<Storage<Entity, Component>>();
+    }
+
+private:
+    std::vector<ComponentEntry> components_;
+    std::vector<std::byte> data_;
+};
+} // namespace ecs
+
+#endif // PREFAB_HPP
@@ -1,12 +1,19 @@
 #ifndef REGISTRY_HPP
 #define REGISTRY_HPP
 
-#include <list>
+#include <algorithm>
+#include <atomic>
 #include <memory>
+#include <span>
+#include <stdexcept>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
+#include <vector>
 
 #include "component.hpp"
+#include "descriptor.hpp"
+#include "prefab.hpp"
 #include "storage.hpp"
 
 namespace ecs {
@@ -24,7 +31,14 @@ public:
     using StoragesType = std::unordered_map<ComponentTypeId, std::unique_ptr<BasicStorageType>>;
     using EntityToComponentsType = std::unordered_map<EntityOriginalType, std::unordered_set<ComponentTypeId>>;
 
-    using FreeListType = std::list<EntityUnderlyingType>;
+    using FreeListType = std::vector<EntityUnderlyingType>;
+
+    using ComponentDescriptorType = ComponentDescriptor<Entity>;
+
+    using PrefabType = Prefab<Entity>;
+
+    // 创建某种组件的 Storage，用于在只知道 ComponentTypeId 的地方创建 Storage
+    using MakeStorageType = std::unique_ptr<BasicStorageType> (*)();
 
     using ConstStoragesIteratorType = typename StoragesType::const_iterator;
     using ConstEntityToComponentsIteratorType = typename EntityToComponentsType::const_iterator;
@@ -34,12 +48,43 @@ public:
     Registry(const Registry&) = delete;
     Registry& operator=(const Registry&) = delete;
 
-    Registry(Registry&&) noexcept = default;
-    Registry& operator=(Registry&&) noexcept = default;
+    // std::atomic 不能移动，所以需要手写移动，不能和 ReserveEntity 同时调用
+    Registry(Registry&& other) noexcept
+        : storages_(std::move(other.storages_)),
+          double_buffered_(std::move(other.double_buffered_)),
+          double_buffered_types_(std::move(other.double_buffered_types_)),
+          entity_to_components_(std::move(other.entity_to_components_)),
+          free_list_(std::move(other.free_list_)),
+          free_cursor_(other.free_cursor_.exchange(0, std::memory_order_relaxed)),
+          next_entity_(std::exchange(other.next_entity_, EntityIdType{})),
+          track_changes_(std::exchange(other.track_changes_, false)),
+          created_entities_(std::move(other.created_entities_)),
+          destroyed_entities_(std::move(other.destroyed_entities_)),
+          free_list_low_water_(std::exchange(other.free_list_low_water_, 0)) {
+    }
+
+    Registry& operator=(Registry&& other) noexcept {
+        if (this != &other) {
+            storages_ = std::move(other.storages_);
+            double_buffered_ = std::move(other.double_buffered_);
+            double_buffered_types_ = std::move(other.double_buffered_types_);
+            entity_to_components_ = std::move(other.entity_to_components_);
+            free_list_ = std::move(other.free_list_);
+            free_cursor_.store(other.free_cursor_.exchange(0, std::memory_order_relaxed), std::memory_order_relaxed);
+            next_entity_ = std::exchange(other.next_entity_, EntityIdType{});
+            track_changes_ = std::exchange(other.track_changes_, false);
+            created_entities_ = std::move(other.created_entities_);
+            destroyed_entities_ = std::move(other.destroyed_entities_);
+            free_list_low_water_ = std::exchange(other.free_list_low_water_, 0);
+        }
+        return *this;
+    }
 
     ~Registry() = default;
 
     constexpr EntityOriginalType CreateEntity() {
+        FlushReservedEntities();
+
         if (free_list_.empty()) {
             free_list_.push_back(MakeEntityUnderlying<EntityOriginalType>(next_entity_, 0));
             ++next_entity_;
@@ -47,12 +92,66 @@ public:
 
         const auto underlying = free_list_.back();
         free_list_.pop_back();
+        free_cursor_ = static_cast<std::int64_t>(free_list_.size());
+        free_list_low_water_ = std::min(free_list_low_water_, free_list_.size());
 
         const auto entity = ToOriginal<EntityOriginalType>(underlying);
         entity_to_components_[entity] = {};
+        RecordCreated(entity);
         return entity;
     }
 
+    /// 预留一个实体，线程安全，可以在 System 中并发调用
+    ///
+    /// 先从空闲列表的末尾取，空闲列表用完之后再从 next_entity_ 往后取新的 id。
+    /// 预留的实体在 FlushReservedEntities 之前不会出现在 registry 中，
+    /// 期间不能并发调用 CreateEntity、DestroyEntity 等非线程安全的函数
+    EntityOriginalType ReserveEntity() noexcept {
+        const auto cursor = free_cursor_.fetch_sub(1, std::memory_order_relaxed);
+        if (cursor > 0) {
+            return ToOriginal<EntityOriginalType>(free_list_[cursor - 1]);
+        }
+
+        // cursor 为 0 时是 next_entity_，为 -1 时是 next_entity_ + 1，以此类推
+        const auto id = next_entity_ + static_cast<EntityIdType>(-cursor);
+        return ToOriginal<EntityOriginalType>(MakeEntityUnderlying<EntityOriginalType>(id, 0));
+    }
+
+    /// 让所有预留的实体真正出现在 registry 中，非线程安全
+    ///
+    /// flushed 不为空时，新出现的实体会被追加到其中
+    constexpr void FlushReservedEntities(std::vector<EntityOriginalType>* flushed = nullptr) {
+        const auto cursor = free_cursor_.load(std::memory_order_relaxed);
+        const auto size = static_cast<std::int64_t>(free_list_.size());
+        if (cursor >= size) return;
+
+        // 从空闲列表中预留的实体
+        const auto kept = static_cast<std::size_t>(std::max<std::int64_t>(cursor, 0));
+        for (auto i = free_list_.size(); i > kept; --i) {
+            const auto entity = ToOriginal<EntityOriginalType>(free_list_[i - 1]);
+            entity_to_components_[entity] = {};
+            RecordCreated(entity);
+            if (flushed) flushed->push_back(entity);
+        }
+        free_list_.resize(kept);
+        free_list_low_water_ = std::min(free_list_low_water_, free_list_.size());
+
+        // 空闲列表用完之后预留的新实体
+        if (cursor < 0) {
+            const auto count = static_cast<EntityIdType>(-cursor);
+            for (EntityIdType i = 0; i < count; ++i) {
+                const auto underlying = MakeEntityUnderlying<EntityOriginalType>(next_entity_ + i, 0);
+                const auto entity = ToOriginal<EntityOriginalType>(underlying);
+                entity_to_components_[entity] = {};
+                RecordCreated(entity);
+                if (flushed) flushed->push_back(entity);
+            }
+            next_entity_ += count;
+        }
+
+        free_cursor_.store(static_cast<std::int64_t>(free_list_.size()), std::memory_order_relaxed);
+    }
+
     constexpr bool ContainsEntity(const EntityOriginalType entity) const {
         return entity_to_components_.contains(entity);
     }
@@ -116,6 +215,26 @@ public:
         return true;
     }
 
+    template <AllowedComponentType Component>
+    static std::unique_ptr<BasicStorageType> MakeStorage() {
+        return std::make_unique<Storage<Entity, Component>>();
+    }
+
+    template <AllowedComponentType Component>
+    static std::unique_ptr<BasicStorageType> MakeSharedStorage() {
+        return std::make_unique<SharedStorage<Entity, Component>>();
+    }
+
+    constexpr BasicStorageType& GetOrCreateBasicStorage(const ComponentTypeId type_id,
+                                                        const MakeStorageType make_storage) {
+        auto& storage = storages_[type_id];
+        if (!storage) {
+            storage = make_storage();
+            InitStorage(type_id, *storage);
+        }
+        return *storage;
+    }
+
     template <AllowedComponentType Component>
     constexpr Storage<Entity, Component>& GetOrCreateStorageOfComponent() {
         const auto type_id = ecs::GetTypeId<Component>();
@@ -123,7 +242,7 @@ public:
 
         if (!storage) {
             storage = std::make_unique<Storage<Entity, Component>>();
-            storages_[type_id] = std::move(storage);
+            InitStorage(type_id, *storage);
         }
 
         return *static_cast<Storage<Entity, Component>*>(storage.get());
@@ -150,6 +269,169 @@ public:
         (AttachComponent(entity, components), ...);
     }
 
+    /// 按描述创建 Storage，已经存在时检查组件大小是否一致
+    BasicStorageType& GetOrCreateStorage(const ComponentDescriptorType& descriptor) {
+        auto& storage = storages_[descriptor.type_id];
+        if (!storage) {
+            storage = descriptor.MakeStorage();
+            InitStorage(descriptor.type_id, *storage);
+        } else if (storage->ComponentSize() != descriptor.size) {
+            throw std::runtime_error("Registry::GetOrCreateStorage: Component size mismatch");
+        }
+        return *storage;
+    }
+
+    /// 挂载运行时类型的组件，component 是 descriptor.size 个字节
+    void AttachComponent(const EntityOriginalType entity,
+                         const ComponentDescriptorType& descriptor,
+                         const std::byte* component) {
+        auto& storage = GetOrCreateStorage(descriptor);
+        storage.UpsertRange(&entity, component, 1);
+        entity_to_components_[entity].insert(descriptor.type_id);
+    }
+
+    /// 批量挂载运行时类型的组件，components 是和 entities 一一对应、紧密排列的组件字节
+    void AttachComponentsBulk(const ComponentDescriptorType& descriptor,
+                              const std::span<const EntityOriginalType> entities,
+                              const std::byte* components) {
+        auto& storage = GetOrCreateStorage(descriptor);
+        storage.UpsertRange(entities.data(), components, entities.size());
+        MarkComponentsAttached(descriptor.type_id, entities);
+    }
+
+    /// 组件的字节，不存在时返回 nullptr，编译期类型和运行时类型的组件都可以用
+    [[nodiscard]] std::byte* GetComponentBytes(const EntityOriginalType entity, const ComponentTypeId type_id) {
+        auto* storage = FindBasicStorage(type_id);
+        if (!storage || !storage->ContainsEntity(entity)) return nullptr;
+
+        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
+        return storage->ComponentBytesOf(GetId<EntityOriginalType>(underlying));
+    }
+
+    /// 捕获实体当前的所有组件
+    ///
+    /// 共享组件捕获的是 SharedStorage 中的句柄，所以只能在同一个 Registry 中实例化
+    [[nodiscard]] PrefabType MakePrefab(const EntityOriginalType entity) const {
+        PrefabType prefab;
+        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
+        const auto entity_id = GetId<EntityOriginalType>(underlying);
+
+        for (const auto type_id : entity_to_components_.at(entity)) {
+            const auto& storage = *storages_.at(type_id);
+            const auto size = storage.ComponentSize();
+            prefab.Add(type_id, storage.ComponentData() + storage.IndexOf(entity_id) * size, size);
+        }
+        return prefab;
+    }
+
+    /// 创建 count 个和预制体相同的实体，返回新的实体
+    std::vector<EntityOriginalType> Instantiate(const PrefabType& prefab, const std::size_t count) {
+        std::vector<EntityOriginalType> entities(count);
+        for (auto& entity : entities) {
+            entity = CreateEntity();
+        }
+        InstantiateInto(prefab, entities);
+        return entities;
+    }
+
+    /// 复制 count 份实体，只复制组件
+    std::vector<EntityOriginalType> Clone(const EntityOriginalType entity, const std::size_t count) {
+        return Instantiate(MakePrefab(entity), count);
+    }
+
+    /// 把预制体的组件挂载到已经存在的实体上，实体已经有的组件保持不变
+    ///
+    /// 每种组件只查找一次 Storage，实体都还没有这种组件时用 BasicStorage::AppendRepeated 一次追加所有实体
+    void InstantiateInto(const PrefabType& prefab, const std::span<const EntityOriginalType> entities) {
+        if (entities.empty()) return;
+
+        // 先检查所有的组件，出错时不会留下只挂载了一部分组件的实体
+        for (const auto& entry : prefab.Components()) {
+            const auto* storage = FindBasicStorage(entry.type_id);
+            if (!storage && !entry.make_storage) {
+                throw std::runtime_error("Registry::InstantiateInto: Storage of component not found");
+            }
+            if (storage && storage->ComponentSize() != entry.size) {
+                throw std::runtime_error("Registry::InstantiateInto: Component size mismatch");
+            }
+        }
+
+        for (const auto& entry : prefab.Components()) {
+            auto* storage = FindBasicStorage(entry.type_id);
+            if (!storage) {
+                storage = &GetOrCreateBasicStorage(entry.type_id, entry.make_storage);
+            }
+
+            const auto* component = prefab.ComponentBytes(entry);
+            const auto contains = [storage](const EntityOriginalType entity) {
+                return storage->ContainsEntity(entity);
+            };
+            if (std::ranges::none_of(entities, contains)) {
+                storage->AppendRepeated(entities.data(), component, entities.size());
+                continue;
+            }
+            for (const auto entity : entities) {
+                if (!contains(entity)) storage->UpsertRange(&entity, component, 1);
+            }
+        }
+
+        for (const auto entity : entities) {
+            auto& components = entity_to_components_[entity];
+            components.reserve(components.size() + prefab.Size());
+            for (const auto& entry : prefab.Components()) {
+                components.insert(entry.type_id);
+            }
+        }
+    }
+
+    /// 不存在时返回 nullptr
+    constexpr BasicStorageType* FindBasicStorage(const ComponentTypeId type_id) {
+        const auto it = storages_.find(type_id);
+        return it == storages_.end() ? nullptr : it->second.get();
+    }
+
+    /// 批量挂载同一种组件，components 是和 entities 一一对应、紧密排列的组件字节
+    constexpr void AttachComponentsBulk(const ComponentTypeId type_id,
+                                        const MakeStorageType make_storage,
+                                        const std::span<const EntityOriginalType> entities,
+                                        const std::byte* components) {
+        auto& storage = GetOrCreateBasicStorage(type_id, make_storage);
+        storage.UpsertRange(entities.data(), components, entities.size());
+        MarkComponentsAttached(type_id, entities);
+    }
+
+    /// 批量卸载同一种组件，只查找一次 Storage
+    constexpr void DetachComponentBulk(const ComponentTypeId type_id,
+                                       const std::span<const EntityOriginalType> entities) {
+        auto* storage = FindBasicStorage(type_id);
+        if (!storage) return;
+
+        for (const auto entity : entities) {
+            const auto underlying = ToUnderlying<EntityOriginalType>(entity);
+            storage->Pop(GetId<EntityOriginalType>(underlying));
+        }
+        MarkComponentsDetached(type_id, entities);
+    }
+
+    /// 只更新实体到组件的索引，不修改 Storage，用于 Storage 已经被直接修改过的情况
+    constexpr void MarkComponentsAttached(const ComponentTypeId type_id,
+                                          const std::span<const EntityOriginalType> entities) {
+        for (const auto entity : entities) {
+            entity_to_components_[entity].insert(type_id);
+        }
+    }
+
+    /// 只更新实体到组件的索引，不修改 Storage，用于 Storage 已经被直接修改过的情况
+    constexpr void MarkComponentsDetached(const ComponentTypeId type_id,
+                                          const std::span<const EntityOriginalType> entities) {
+        for (const auto entity : entities) {
+            if (const auto components = entity_to_components_.find(entity);
+                components != entity_to_components_.end()) {
+                components->second.erase(type_id);
+            }
+        }
+    }
+
     constexpr void DetachComponent(const EntityOriginalType entity,
                                    const ComponentTypeId type_id) {
         const auto underlying = ToUnderlying<EntityOriginalType>(entity);
@@ -164,11 +446,9 @@ public:
 
     template <AllowedComponentType Component>
     constexpr void DetachComponent(const EntityOriginalType entity) {
-        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
-
         if (!HasStorageOfComponent<Component>()) return;
         const auto type_id = ecs::GetTypeId<Component>();
-        DetachComponent(underlying, type_id);
+        DetachComponent(entity, type_id);
     }
 
     template <typename... ComponentTypeIds>
@@ -178,9 +458,7 @@ public:
         if (CheckDuplicateComponentTypeIds(type_ids...)) {
             throw std::runtime_error("Duplicate component type ids");
         }
-        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
-
-        (DetachComponent(underlying, type_ids), ...);
+        (DetachComponent(entity, type_ids), ...);
     }
 
     template <typename Iterator>
@@ -188,21 +466,20 @@ public:
         std::is_same_v<ComponentTypeId, std::decay_t<typename std::iterator_traits<Iterator>::value_type>>
     constexpr void DetachComponents(const EntityOriginalType entity,
                                     Iterator begin, Iterator end) {
-        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
-
         for (auto it = begin; it != end; ++it) {
-            DetachComponent(underlying, *it);
+            DetachComponent(entity, *it);
         }
     }
 
     template <typename... Components>
     constexpr void DetachComponents(const EntityOriginalType entity) {
         static_assert(!CheckDuplicateComponents<Components...>(), "Duplicate components");
-        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
-        (DetachComponent<Components>(underlying), ...);
+        (DetachComponent<Components>(entity), ...);
     }
 
     constexpr void DestroyEntity(const EntityOriginalType entity) {
+        FlushReservedEntities();
+
         const auto underlying = ToUnderlying<EntityOriginalType>(entity);
 
         const auto type_ids = entity_to_components_[entity];
@@ -211,9 +488,13 @@ public:
         }
 
         entity_to_components_.erase(entity);
+        if (track_changes_) {
+            destroyed_entities_.push_back(entity);
+        }
 
         const auto next_underlying = GenNextVersion<EntityOriginalType>(underlying);
         free_list_.push_back(next_underlying);
+        free_cursor_ = static_cast<std::int64_t>(free_list_.size());
     }
 
     constexpr bool ContainsComponent(const EntityOriginalType entity,
@@ -280,21 +561,41 @@ public:
         return false;
     }
 
+    /// Component 是 Shared<T> 时返回 const T&
+    ///
+    /// 记录变化时会把组件所在的块标记为修改过，有索引时这个组件的索引会在下一次查找前更新，
+    /// 多个 System 可以同时调用；只读取时用 GetConstComponentReference
     template <AllowedComponentType Component>
-    constexpr Component& GetComponentReference(const EntityOriginalType entity) {
+    constexpr ComponentReferenceType<Component> GetComponentReference(const EntityOriginalType entity) {
         const auto type_id = ecs::GetTypeId<Component>();
         auto& storage = GetBasicStorageOfComponent(type_id);
 
         const auto underlying = ToUnderlying<EntityOriginalType>(entity);
         const auto entity_id = GetId<EntityOriginalType>(underlying);
 
-        // 从 BasicStorage 转换成 Storage
-        auto* storage_ptr = static_cast<Storage<Entity, Component>*>(&storage);
-        return storage_ptr->ComponentOf(entity_id);
+        return ComponentOfStorage<Component>(storage, entity_id);
     }
 
+    /// 只读取，不会记录修改
     template <AllowedComponentType Component>
-    constexpr Component* GetComponentPointer(const EntityOriginalType entity) {
+    constexpr ComponentReferenceType<const Component> GetConstComponentReference(const EntityOriginalType entity) const {
+        const auto& storage = GetBasicStorageOfComponentConst(ecs::GetTypeId<Component>());
+
+        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
+        return ComponentOfStorage<Component>(storage, GetId<EntityOriginalType>(underlying));
+    }
+
+    /// 用于修改组件，记录变化时会把它标记为修改过，有索引时这个组件的索引会在下一次查找前更新
+    template <AllowedComponentType Component>
+        requires (!is_shared_component_k<Component>)
+    Component& GetMutableComponentReference(const EntityOriginalType entity) {
+        auto& storage = static_cast<Storage<Entity, Component>&>(GetBasicStorageOfComponent(ecs::GetTypeId<Component>()));
+        return storage.MutableComponentOf(GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(entity)));
+    }
+
+    /// Component 是 Shared<T> 时返回 const T*
+    template <AllowedComponentType Component>
+    constexpr ComponentPointerType<Component> GetComponentPointer(const EntityOriginalType entity) {
         const auto type_id = ecs::GetTypeId<Component>();
 
         if (!HasStorageOfComponent(type_id)) return nullptr;
@@ -306,20 +607,115 @@ public:
 
         if (!storage->Contains(entity_id)) return nullptr;
 
-        // 从 BasicStorage 转换成 Storage
-        auto* storage_ptr = static_cast<Storage<Entity, Component>*>(storage);
-        return &storage_ptr->ComponentOf(entity_id);
+        return &ComponentOfStorage<Component>(*storage, entity_id);
+    }
+
+    /// 只读取，不会记录修改，不存在时返回 nullptr
+    template <AllowedComponentType Component>
+    constexpr ComponentPointerType<const Component> GetConstComponentPointer(const EntityOriginalType entity) const {
+        const auto it = storages_.find(ecs::GetTypeId<Component>());
+        if (it == storages_.end()) return nullptr;
+
+        const auto& storage = *it->second;
+        const auto entity_id = GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(entity));
+        if (!storage.Contains(entity_id)) return nullptr;
+
+        return &ComponentOfStorage<Component>(storage, entity_id);
+    }
+
+    template <AllowedComponentType Component>
+    constexpr SharedStorage<Entity, Component>& GetOrCreateSharedStorage() {
+        auto& storage = storages_[ecs::GetTypeId<Shared<Component>>()];
+
+        if (!storage) {
+            storage = std::make_unique<SharedStorage<Entity, Component>>();
+            InitStorage(ecs::GetTypeId<Shared<Component>>(), *storage);
+        }
+
+        return *static_cast<SharedStorage<Entity, Component>*>(storage.get());
+    }
+
+    /// 挂载共享组件，相同的值只存一份，之后用 Shared<Component> 访问和卸载
+    template <AllowedComponentType Component>
+    void AttachSharedComponent(const EntityOriginalType entity, const Component& component) {
+        auto& storage = GetOrCreateSharedStorage<Component>();
+        entity_to_components_[entity].insert(ecs::GetTypeId<Shared<Component>>());
+        storage.Upsert(entity, component);
+    }
+
+    /// 双缓冲组件在上一帧的值，不存在时返回 nullptr，不是双缓冲的组件返回当前的值
+    template <AllowedComponentType Component>
+    constexpr const Component* GetPreviousComponentPointer(const EntityOriginalType entity) {
+        auto* storage = FindBasicStorage(ecs::GetTypeId<Component>());
+        if (!storage) return nullptr;
+
+        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
+        if (!storage->ContainsUnderlying(underlying)) return nullptr;
+
+        const auto* storage_ptr = static_cast<const Storage<Entity, Component>*>(storage);
+        return &storage_ptr->PreviousComponentOf(GetId<EntityOriginalType>(underlying));
+    }
+
+    /// 开启或关闭某种组件的双缓冲，见 Storage::SetDoubleBuffered
+    template <AllowedComponentType Component>
+    void SetDoubleBuffered(const bool enabled = true) {
+        auto& storage = GetOrCreateStorageOfComponent<Component>();
+        if (storage.IsDoubleBuffered() == enabled) return;
+
+        storage.SetDoubleBuffered(enabled);
+        if (enabled) {
+            double_buffered_.push_back(&storage);
+            double_buffered_types_.push_back(ecs::GetTypeId<Component>());
+        } else {
+            std::erase(double_buffered_, &storage);
+            std::erase(double_buffered_types_, ecs::GetTypeId<Component>());
+        }
+    }
+
+    /// 在一帧结束时交换所有双缓冲组件的读写缓冲区，和实体数量无关
+    constexpr void SwapComponentBuffers() noexcept {
+        for (auto* storage : double_buffered_) {
+            storage->SwapBuffers();
+        }
+    }
+
+    /// 为组件的字段建立索引，见 Storage::AddIndex
+    template <AllowedComponentType Component, auto Member>
+        requires IndexableFieldType<Member, Component>
+    ComponentIndex<Entity, Component, Member>& AddIndex() {
+        return GetOrCreateStorageOfComponent<Component>().template AddIndex<Member>();
+    }
+
+    template <AllowedComponentType Component, auto Member>
+        requires IndexableFieldType<Member, Component>
+    void RemoveIndex() {
+        if (auto* storage = FindBasicStorage(ecs::GetTypeId<Component>())) {
+            static_cast<Storage<Entity, Component>*>(storage)->template RemoveIndex<Member>();
+        }
+    }
+
+    /// 字段 Member 等于 value 的所有实体，例如 FindBy<NetworkId, &NetworkId::value>(id)
+    ///
+    /// 第一次查找时建立索引，之后每次查找是一次哈希，见 Storage::FindBy
+    template <AllowedComponentType Component, auto Member>
+        requires IndexableFieldType<Member, Component>
+    std::span<const EntityOriginalType> FindBy(
+        const typename ComponentIndex<Entity, Component, Member>::FieldType& value) {
+        auto* storage = FindBasicStorage(ecs::GetTypeId<Component>());
+        if (!storage) return {};
+
+        return static_cast<Storage<Entity, Component>*>(storage)->template FindBy<Member>(value);
     }
 
 
     template <AllowedComponentType... Components>
-    constexpr std::tuple<Components&...> GetComponentReferences(const EntityOriginalType entity) {
-        return std::tuple<Components&...>(GetComponentReference<Components>(entity)...);
+    constexpr std::tuple<ComponentReferenceType<Components>...> GetComponentReferences([[maybe_unused]] const EntityOriginalType entity) {
+        return std::tuple<ComponentReferenceType<Components>...>(GetComponentReference<Components>(entity)...);
     }
 
     template <AllowedComponentType... Components>
-    constexpr std::tuple<Components*...> GetComponentPointers(const EntityOriginalType entity) {
-        return std::tuple<Components*...>(GetComponentPointer<Components>(entity)...);
+    constexpr std::tuple<ComponentPointerType<Components>...> GetComponentPointers([[maybe_unused]] const EntityOriginalType entity) {
+        return std::tuple<ComponentPointerType<Components>...>(GetComponentPointer<Components>(entity)...);
     }
 
     template <AllowedComponentsTupleType ComponentsTuple>
@@ -371,18 +767,164 @@ public:
         return entity_to_components_.cend();
     }
 
+    /// 空闲列表，已经预留的实体也还在其中
+    [[nodiscard]] constexpr const FreeListType& FreeList() const noexcept {
+        return free_list_;
+    }
+
+    [[nodiscard]] constexpr EntityIdType NextEntity() const noexcept {
+        return next_entity_;
+    }
+
+    /// 清空整个 registry，只留下给定的实体和实体分配的状态，用于从快照中恢复
+    ///
+    /// 之后需要自己创建 Storage，并用 MarkComponentsAttached 更新实体到组件的索引。
+    /// 哪些组件开启了双缓冲会保留下来，重新创建的 Storage 仍然是双缓冲的
+    void ResetEntities(const std::span<const EntityOriginalType> entities,
+                       const std::span<const EntityUnderlyingType> free_list,
+                       const EntityIdType next_entity) {
+        storages_.clear();
+        double_buffered_.clear();
+        entity_to_components_.clear();
+        entity_to_components_.reserve(entities.size());
+        for (const auto entity : entities) {
+            entity_to_components_[entity] = {};
+        }
+
+        free_list_.assign(free_list.begin(), free_list.end());
+        free_cursor_ = static_cast<std::int64_t>(free_list_.size());
+        next_entity_ = next_entity;
+        ClearChanges();
+    }
+
+    /// 开始或停止记录变化，开始时会清空之前记录的变化
+    ///
+    /// 记录的是上一次 ClearChanges 之后创建和销毁的实体、空闲列表的变化，以及每个 Storage 中被修改过的块，
+    /// 用于生成增量快照
+    void SetChangeTracking(const bool enabled) {
+        track_changes_ = enabled;
+        for (auto& [_, storage] : storages_) {
+            storage->SetChangeTracking(enabled);
+        }
+        ClearChanges();
+    }
+
+    [[nodiscard]] constexpr bool IsTrackingChanges() const noexcept {
+        return track_changes_;
+    }
+
+    /// 把当前的状态当作新的基准，之后的变化重新开始记录
+    void ClearChanges() {
+        created_entities_.clear();
+        destroyed_entities_.clear();
+        free_list_low_water_ = free_list_.size();
+        for (auto& [_, storage] : storages_) {
+            storage->ClearChanges();
+        }
+    }
+
+    /// 上一次 ClearChanges 之后创建的实体，其中可能有已经被销毁的
+    [[nodiscard]] constexpr const std::vector<EntityOriginalType>& CreatedEntities() const noexcept {
+        return created_entities_;
+    }
+
+    /// 上一次 ClearChanges 之后销毁的实体
+    [[nodiscard]] constexpr const std::vector<EntityOriginalType>& DestroyedEntities() const noexcept {
+        return destroyed_entities_;
+    }
+
+    /// 上一次 ClearChanges 之后空闲列表的最小长度，在这之前的部分没有变化过
+    [[nodiscard]] constexpr std::size_t FreeListLowWater() const noexcept {
+        return std::min(free_list_low_water_, free_list_.size());
+    }
+
+    /// 应用增量快照中实体的变化：删除销毁的实体，加入新的实体，替换空闲列表的末尾
+    ///
+    /// 组件需要之后再通过 Storage 恢复，并更新实体到组件的索引
+    void ApplyEntityChanges(const std::span<const EntityOriginalType> destroyed,
+                            const std::span<const EntityOriginalType> created,
+                            const std::size_t free_list_low_water,
+                            const std::span<const EntityUnderlyingType> free_list_tail,
+                            const EntityIdType next_entity) {
+        for (const auto entity : destroyed) {
+            entity_to_components_.erase(entity);
+        }
+        for (const auto entity : created) {
+            entity_to_components_.try_emplace(entity);
+        }
+
+        free_list_.resize(std::min(free_list_low_water, free_list_.size()));
+        free_list_.insert(free_list_.end(), free_list_tail.begin(), free_list_tail.end());
+        free_cursor_ = static_cast<std::int64_t>(free_list_.size());
+        next_entity_ = next_entity;
+    }
+
+private:
+    /// 从 BasicStorage 转换成 Storage，共享组件转换成 SharedStorage
+    template <AllowedComponentType Component>
+    static constexpr ComponentReferenceType<Component> ComponentOfStorage(BasicStorageType& storage,
+                                                                           const EntityIdType entity_id) {
+        if constexpr (is_shared_component_k<Component>) {
+            using ValueType = typename Component::ValueType;
+            return static_cast<SharedStorage<Entity, ValueType>&>(storage).ComponentOf(entity_id);
+        } else {
+            return static_cast<Storage<Entity, Component>&>(storage).ComponentOf(entity_id);
+        }
+    }
+
+    template <AllowedComponentType Component>
+    static constexpr ComponentReferenceType<const Component> ComponentOfStorage(const BasicStorageType& storage,
+                                                                                 const EntityIdType entity_id) {
+        if constexpr (is_shared_component_k<Component>) {
+            using ValueType = typename Component::ValueType;
+            return static_cast<const SharedStorage<Entity, ValueType>&>(storage).ComponentOf(entity_id);
+        } else {
+            return static_cast<const Storage<Entity, Component>&>(storage).ComponentOf(entity_id);
+        }
+    }
+
+    /// 新创建的 Storage 沿用 registry 的变化记录和这种组件的双缓冲设置
+    void InitStorage(const ComponentTypeId type_id, BasicStorageType& storage) {
+        storage.SetChangeTracking(track_changes_);
+        if (std::ranges::find(double_buffered_types_, type_id) != double_buffered_types_.end()) {
+            storage.SetDoubleBuffered(true);
+            double_buffered_.push_back(&storage);
+        }
+    }
+
+    constexpr void RecordCreated(const EntityOriginalType entity) {
+        if (track_changes_) {
+            created_entities_.push_back(entity);
+        }
+    }
+
 private:
     // 每种 Component 对应一个 Storage
     StoragesType storages_;
 
+    // 开启了双缓冲的 Storage
+    std::vector<BasicStorageType*> double_buffered_;
+
+    // 开启了双缓冲的组件类型，清空 Storage 之后用来恢复双缓冲
+    std::vector<ComponentTypeId> double_buffered_types_;
+
     // 存储每个 Entity 由哪些 Component 组成
     EntityToComponentsType entity_to_components_;
 
     // 里面存的是不用的 Entity 和 Version（已经加 1 的）
     FreeListType free_list_;
 
+    // free_list_ 中还没有被预留的数量，变成负数表示预留了 next_entity_ 之后的新实体
+    std::atomic<std::int64_t> free_cursor_{0};
+
     // 当前最大的 Entity 之后的那个
-    EntityIdType next_entity_;
+    EntityIdType next_entity_{};
+
+    // 增量快照需要的变化记录，只在 track_changes_ 时记录
+    bool track_changes_{false};
+    std::vector<EntityOriginalType> created_entities_;
+    std::vector<EntityOriginalType> destroyed_entities_;
+    std::size_t free_list_low_water_{0};
 };
 } // namespace ecs
 
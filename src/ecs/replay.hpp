@@ -0,0 +1,458 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "world.hpp"
+
+namespace ecs {
+/// 命令日志中每条记录的种类
+enum class CommandRecordKind : std::uint8_t {
+    Frame,
+    Spawn,
+    Destroy,
+    Attach,
+    Detach,
+    UpsertResource,
+    RemoveResource,
+    AttachShared,
+};
+
+namespace internal {
+/// 命令日志的文件头，之后是一条条紧密排列的记录，所有数值都使用本机字节序
+struct CommandLogHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t entity_size;
+};
+
+inline constexpr char command_log_magic_k[4] = {'E', 'C', 'S', 'L'};
+inline constexpr std::uint32_t command_log_version_k = 1;
+} // namespace internal
+
+
+/// 命令记录器，把 Commands 实际执行的每一条命令写进紧凑的二进制日志
+///
+/// 记录的是合并、抵消之后真正作用到 World 上的命令，所以回放的结果和原来的 World 相同。
+/// 每次 Commands::Execute 对应日志中的一帧
+template <AllowedEntityType Entity>
+class CommandRecorder {
+public:
+    using EntityTraits = EntityTraits<Entity>;
+
+    using EntityOriginalType = typename EntityTraits::OriginalType;
+    using EntityUnderlyingType = typename EntityTraits::UnderlyingType;
+
+    CommandRecorder() {
+        const internal::CommandLogHeader header{
+            {
+                internal::command_log_magic_k[0], internal::command_log_magic_k[1],
+                internal::command_log_magic_k[2], internal::command_log_magic_k[3]
+            },
+            internal::command_log_version_k,
+            sizeof(EntityUnderlyingType)
+        };
+        Write(header);
+    }
+
+    CommandRecorder(const CommandRecorder&) = delete;
+    CommandRecorder& operator=(const CommandRecorder&) = delete;
+
+    CommandRecorder(CommandRecorder&&) noexcept = default;
+    CommandRecorder& operator=(CommandRecorder&&) noexcept = default;
+
+    ~CommandRecorder() = default;
+
+    void RecordFrame() {
+        WriteKind(CommandRecordKind::Frame);
+        ++frame_count_;
+    }
+
+    void RecordSpawn(const EntityOriginalType entity) {
+        WriteKind(CommandRecordKind::Spawn);
+        WriteEntity(entity);
+    }
+
+    void RecordDestroy(const EntityOriginalType entity) {
+        WriteKind(CommandRecordKind::Destroy);
+        WriteEntity(entity);
+    }
+
+    void RecordAttach(const EntityOriginalType entity, const ComponentTypeId type_id,
+                      const std::byte* component, const std::size_t size) {
+        WriteKind(CommandRecordKind::Attach);
+        WriteEntity(entity);
+        Write(static_cast<std::uint64_t>(type_id));
+        WriteBytes(component, size);
+    }
+
+    /// 共享组件记录的是值而不是句柄，句柄只在原来的 SharedStorage 中有意义
+    void RecordAttachShared(const EntityOriginalType entity, const ComponentTypeId type_id,
+                            const std::byte* value, const std::size_t size) {
+        WriteKind(CommandRecordKind::AttachShared);
+        WriteEntity(entity);
+        Write(static_cast<std::uint64_t>(type_id));
+        WriteBytes(value, size);
+    }
+
+    void RecordDetach(const EntityOriginalType entity, const ComponentTypeId type_id) {
+        WriteKind(CommandRecordKind::Detach);
+        WriteEntity(entity);
+        Write(static_cast<std::uint64_t>(type_id));
+    }
+
+    template <typename Resource>
+    void RecordUpsertResource(const Resource& resource) {
+        static_assert(std::is_trivially_copyable_v<Resource>,
+                      "CommandRecorder::RecordUpsertResource: Resource must be trivially copyable");
+
+        WriteKind(CommandRecordKind::UpsertResource);
+        Write(static_cast<std::uint64_t>(GetTypeId<Resource>()));
+        WriteBytes(reinterpret_cast<const std::byte*>(&resource), sizeof(Resource));
+    }
+
+    template <typename Resource>
+    void RecordRemoveResource() {
+        WriteKind(CommandRecordKind::RemoveResource);
+        Write(static_cast<std::uint64_t>(GetTypeId<Resource>()));
+    }
+
+    [[nodiscard]] const std::vector<std::byte>& Data() const noexcept {
+        return data_;
+    }
+
+    [[nodiscard]] std::size_t FrameCount() const noexcept {
+        return frame_count_;
+    }
+
+    void Save(const std::filesystem::path& path) const {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("CommandRecorder::Save: Cannot open file");
+        }
+        file.write(reinterpret_cast<const char*>(data_.data()), static_cast<std::streamsize>(data_.size()));
+    }
+
+private:
+    template <typename T>
+    void Write(const T& value) {
+        WriteBytes(reinterpret_cast<const std::byte*>(&value), sizeof(T));
+    }
+
+    void WriteBytes(const std::byte* data, const std::size_t size) {
+        data_.insert(data_.end(), data, data + size);
+    }
+
+    void WriteKind(const CommandRecordKind kind) {
+        Write(kind);
+    }
+
+    void WriteEntity(const EntityOriginalType entity) {
+        Write(ToUnderlying<EntityOriginalType>(entity));
+    }
+
+private:
+    std::vector<std::byte> data_;
+    std::size_t frame_count_{0};
+};
+
+
+/// 命令回放器，把 CommandRecorder 记录的日志重新作用到一个新的 World 上
+///
+/// 日志里只有类型的 id，所以回放之前需要注册日志中出现的所有组件和资源类型，
+/// 共享组件用 RegisterSharedComponent 注册，运行时类型的组件用它的 ComponentDescriptor 注册。
+/// 日志中的实体会被映射到回放时新创建的实体上
+template <AllowedEntityType Entity>
+class CommandReplayer {
+public:
+    using WorldType = World<Entity>;
+    using RegistryType = Registry<Entity>;
+    using ComponentDescriptorType = ComponentDescriptor<Entity>;
+
+    using EntityTraits = EntityTraits<Entity>;
+
+    using EntityOriginalType = typename EntityTraits::OriginalType;
+    using EntityUnderlyingType = typename EntityTraits::UnderlyingType;
+
+private:
+    struct ComponentInfo {
+        ComponentDescriptorType descriptor;
+
+        // 共享组件的值的字节数和按值挂载的函数，其他组件为 0 和 nullptr
+        std::size_t value_size;
+        void (*attach_shared)(RegistryType&, EntityOriginalType, const std::byte*);
+    };
+
+    struct ResourceInfo {
+        std::size_t size;
+        void (*upsert)(WorldType&, const std::byte*);
+        void (*remove)(WorldType&);
+    };
+
+public:
+    explicit CommandReplayer(std::vector<std::byte> data) : data_(std::move(data)) {
+        internal::CommandLogHeader header{};
+        if (data_.size() < sizeof(header)) {
+            throw std::runtime_error("CommandReplayer: Log is too short");
+        }
+        std::memcpy(&header, data_.data(), sizeof(header));
+
+        if (std::memcmp(header.magic, internal::command_log_magic_k, sizeof(header.magic)) != 0 ||
+            header.version != internal::command_log_version_k) {
+            throw std::runtime_error("CommandReplayer: Invalid log header");
+        }
+        if (header.entity_size != sizeof(EntityUnderlyingType)) {
+            throw std::runtime_error("CommandReplayer: Entity type mismatch");
+        }
+
+        Rewind();
+    }
+
+    static CommandReplayer Load(const std::filesystem::path& path) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            throw std::runtime_error("CommandReplayer::Load: Cannot open file");
+        }
+
+        std::vector<std::byte> data(static_cast<std::size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        return CommandReplayer(std::move(data));
+    }
+
+    template <AllowedComponentType Component>
+    CommandReplayer& RegisterComponent() {
+        components_[GetTypeId<Component>()] = {
+            {
+                GetTypeId<Component>(), sizeof(Component), alignof(Component), {},
+                &RegistryType::template MakeStorage<Component>
+            },
+            0, nullptr
+        };
+        return *this;
+    }
+
+    /// 按描述注册，运行时类型的组件回放到 RuntimeStorage 中
+    CommandReplayer& RegisterComponent(const ComponentDescriptorType& descriptor) {
+        components_[descriptor.type_id] = {descriptor, 0, nullptr};
+        return *this;
+    }
+
+    /// 注册 Shared<Component>，回放时按值挂载，相同的值在回放的 World 中重新去重
+    template <AllowedComponentType Component>
+    CommandReplayer& RegisterSharedComponent() {
+        using HandleType = typename SharedStorage<Entity, Component>::HandleType;
+
+        components_[GetTypeId<Shared<Component>>()] = {
+            {
+                GetTypeId<Shared<Component>>(), sizeof(HandleType), alignof(HandleType), {},
+                &RegistryType::template MakeSharedStorage<Component>
+            },
+            sizeof(Component),
+            [](RegistryType& registry, const EntityOriginalType entity, const std::byte* data) {
+                Component component;
+                std::memcpy(&component, data, sizeof(Component));
+                registry.AttachSharedComponent(entity, component);
+            }
+        };
+        return *this;
+    }
+
+    template <typename Resource>
+    CommandReplayer& RegisterResource() {
+        static_assert(std::is_trivially_copyable_v<Resource>,
+                      "CommandReplayer::RegisterResource: Resource must be trivially copyable");
+
+        resources_[GetTypeId<Resource>()] = {
+            sizeof(Resource),
+            [](WorldType& world, const std::byte* data) {
+                Resource resource;
+                std::memcpy(&resource, data, sizeof(Resource));
+                world.resources().UpsertResource(resource);
+            },
+            [](WorldType& world) {
+                world.resources().template RemoveResource<Resource>();
+            }
+        };
+        return *this;
+    }
+
+    /// 回到日志的开头，并清空实体的映射
+    void Rewind() noexcept {
+        cursor_ = sizeof(internal::CommandLogHeader);
+        entities_.clear();
+    }
+
+    [[nodiscard]] bool Finished() const noexcept {
+        return cursor_ >= data_.size();
+    }
+
+    /// 回放下一帧，没有更多的帧时返回 false
+    bool ReplayFrame(WorldType& world) {
+        if (Finished()) return false;
+
+        if (Read<CommandRecordKind>() != CommandRecordKind::Frame) {
+            throw std::runtime_error("CommandReplayer: Frame record expected");
+        }
+
+        while (!Finished() && Peek() != CommandRecordKind::Frame) {
+            ReplayRecord(world);
+        }
+        return true;
+    }
+
+    /// 不停顿地回放所有剩余的帧，返回回放的帧数
+    std::size_t ReplayAll(WorldType& world) {
+        std::size_t frames = 0;
+        while (ReplayFrame(world)) {
+            ++frames;
+        }
+        return frames;
+    }
+
+    /// 按固定的帧间隔回放所有剩余的帧，返回回放的帧数
+    template <typename Rep, typename Period>
+    std::size_t ReplayPaced(WorldType& world, const std::chrono::duration<Rep, Period> frame_time) {
+        auto next = std::chrono::steady_clock::now();
+
+        std::size_t frames = 0;
+        while (ReplayFrame(world)) {
+            ++frames;
+            next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(frame_time);
+            std::this_thread::sleep_until(next);
+        }
+        return frames;
+    }
+
+    /// 日志中的实体在回放的 World 中对应的实体
+    [[nodiscard]] EntityOriginalType MapEntity(const EntityOriginalType recorded) const {
+        const auto it = entities_.find(recorded);
+        if (it == entities_.end()) {
+            throw std::runtime_error("CommandReplayer::MapEntity: Entity not found");
+        }
+        return it->second;
+    }
+
+private:
+    void ReplayRecord(WorldType& world) {
+        auto& registry = world.registry();
+
+        switch (Read<CommandRecordKind>()) {
+        case CommandRecordKind::Spawn: {
+            const auto recorded = ReadEntity();
+            entities_[recorded] = registry.CreateEntity();
+            break;
+        }
+        case CommandRecordKind::Destroy: {
+            const auto recorded = ReadEntity();
+            const auto entity = MapEntity(recorded);
+            if (registry.ContainsEntity(entity)) {
+                registry.DestroyEntity(entity);
+            }
+            entities_.erase(recorded);
+            break;
+        }
+        case CommandRecordKind::Attach: {
+            const auto entity = MapEntity(ReadEntity());
+            const auto type_id = static_cast<ComponentTypeId>(Read<std::uint64_t>());
+            const auto& info = GetComponentInfo(type_id);
+            if (info.attach_shared) {
+                throw std::runtime_error("CommandReplayer: Shared component recorded by handle");
+            }
+            registry.AttachComponentsBulk(info.descriptor, std::span(&entity, 1), ReadBytes(info.descriptor.size));
+            break;
+        }
+        case CommandRecordKind::AttachShared: {
+            const auto entity = MapEntity(ReadEntity());
+            const auto type_id = static_cast<ComponentTypeId>(Read<std::uint64_t>());
+            const auto& info = GetComponentInfo(type_id);
+            if (!info.attach_shared) {
+                throw std::runtime_error("CommandReplayer: Component is not registered as shared");
+            }
+            info.attach_shared(registry, entity, ReadBytes(info.value_size));
+            break;
+        }
+        case CommandRecordKind::Detach: {
+            const auto entity = MapEntity(ReadEntity());
+            const auto type_id = static_cast<ComponentTypeId>(Read<std::uint64_t>());
+            registry.DetachComponentBulk(type_id, std::span(&entity, 1));
+            break;
+        }
+        case CommandRecordKind::UpsertResource: {
+            const auto& info = GetResourceInfo(static_cast<TypeId>(Read<std::uint64_t>()));
+            info.upsert(world, ReadBytes(info.size));
+            break;
+        }
+        case CommandRecordKind::RemoveResource: {
+            GetResourceInfo(static_cast<TypeId>(Read<std::uint64_t>())).remove(world);
+            break;
+        }
+        default:
+            throw std::runtime_error("CommandReplayer: Invalid record");
+        }
+    }
+
+    const ComponentInfo& GetComponentInfo(const ComponentTypeId type_id) const {
+        const auto it = components_.find(type_id);
+        if (it == components_.end()) {
+            throw std::runtime_error("CommandReplayer: Component type is not registered");
+        }
+        return it->second;
+    }
+
+    const ResourceInfo& GetResourceInfo(const TypeId type_id) const {
+        const auto it = resources_.find(type_id);
+        if (it == resources_.end()) {
+            throw std::runtime_error("CommandReplayer: Resource type is not registered");
+        }
+        return it->second;
+    }
+
+    const std::byte* ReadBytes(const std::size_t size) {
+        if (data_.size() - cursor_ < size) {
+            throw std::runtime_error("CommandReplayer: Unexpected end of log");
+        }
+
+        const auto* data = data_.data() + cursor_;
+        cursor_ += size;
+        return data;
+    }
+
+    template <typename T>
+    T Read() {
+        T value;
+        std::memcpy(&value, ReadBytes(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    CommandRecordKind Peek() const {
+        CommandRecordKind kind;
+        std::memcpy(&kind, data_.data() + cursor_, sizeof(kind));
+        return kind;
+    }
+
+    EntityOriginalType ReadEntity() {
+        return ToOriginal<EntityOriginalType>(Read<EntityUnderlyingType>());
+    }
+
+private:
+    std::vector<std::byte> data_;
+    std::size_t cursor_{0};
+
+    std::unordered_map<ComponentTypeId, ComponentInfo> components_;
+    std::unordered_map<TypeId, ResourceInfo> resources_;
+
+    // 日志中的实体到回放的 World 中的实体
+    std::unordered_map<EntityOriginalType, EntityOriginalType> entities_;
+};
+} // namespace ecs
+
+#endif // REPLAY_HPP
@@ -0,0 +1,252 @@
+#ifndef RESOURCE_HPP
+#define RESOURCE_HPP
+
+#include <atomic>
+#include <cassert>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "entity.hpp"
+#include "scheduler.hpp"
+
+namespace ecs {
+/// 资源类型，必须是 decay 过的、可以移动构造的类型
+template <typename Type>
+concept AllowedResourceType = std::is_object_v<Type> &&
+    std::is_same_v<Type, std::decay_t<Type>> &&
+    std::is_move_constructible_v<Type>;
+
+namespace internal {
+inline std::size_t NextResourceIndex() noexcept {
+    static std::atomic<std::size_t> next{0};
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+/// 每种资源在进程内唯一的、紧密排列的下标，第一次使用时分配，之后访问不需要哈希
+template <AllowedResourceType Resource>
+std::size_t ResourceIndex() noexcept {
+    static const std::size_t index = NextResourceIndex();
+    return index;
+}
+} // namespace internal
+
+/// 持有资源的引用，以及可能持有的锁
+template <typename Resource, typename Lock>
+class ResourceGuard {
+public:
+    ResourceGuard(Resource& resource, Lock lock) noexcept : resource_(resource), lock_(std::move(lock)) {
+    }
+
+    ResourceGuard(const ResourceGuard&) = delete;
+    ResourceGuard& operator=(const ResourceGuard&) = delete;
+
+    ResourceGuard(ResourceGuard&&) noexcept = default;
+
+    ~ResourceGuard() = default;
+
+    [[nodiscard]] constexpr Resource& operator*() const noexcept {
+        return resource_;
+    }
+
+    [[nodiscard]] constexpr Resource* operator->() const noexcept {
+        return &resource_;
+    }
+
+    [[nodiscard]] constexpr Resource& Get() const noexcept {
+        return resource_;
+    }
+
+private:
+    Resource& resource_;
+    Lock lock_;
+};
+
+template <typename Resource>
+using ResourceReadGuard = ResourceGuard<const Resource, std::shared_lock<std::shared_mutex>>;
+
+template <typename Resource>
+using ResourceWriteGuard = ResourceGuard<Resource, std::unique_lock<std::shared_mutex>>;
+
+
+/// 资源管理，每种资源最多一个
+///
+/// 资源按 internal::ResourceIndex 放在紧密的槽位数组中，访问是一次下标和一次判空。
+/// 插入和删除不是线程安全的，由 Commands 在 Execute 时执行。
+/// 可以对某种资源开启读写锁，之后 ReadResource 和 WriteResource 会加锁；
+/// 调度器在调用线程上串行执行 Stage 时，已经保证了独占访问，所以会跳过锁
+template <AllowedEntityType Entity>
+class Resources {
+private:
+    struct Slot {
+        void* data{nullptr};
+        void (*destroy)(void* data) noexcept {nullptr};
+
+        // 只有开启了锁的资源才有
+        std::unique_ptr<std::shared_mutex> mutex{};
+    };
+
+public:
+    Resources() noexcept = default;
+
+    Resources(const Resources&) = delete;
+    Resources& operator=(const Resources&) = delete;
+
+    Resources(Resources&& other) noexcept : slots_(std::move(other.slots_)), size_(other.size_) {
+        other.size_ = 0;
+    }
+
+    Resources& operator=(Resources&& other) noexcept {
+        // 一定要检查自赋值
+        if (this != &other) {
+            Clear();
+            slots_ = std::move(other.slots_);
+            size_ = other.size_;
+            other.size_ = 0;
+        }
+
+        return *this;
+    }
+
+    ~Resources() {
+        Clear();
+    }
+
+    /// 插入或覆盖资源
+    template <AllowedResourceType Resource>
+    void UpsertResource(Resource resource) {
+        auto& slot = AssureSlot<Resource>();
+        if (slot.data) {
+            if constexpr (std::is_move_assignable_v<Resource>) {
+                *static_cast<Resource*>(slot.data) = std::move(resource);
+                return;
+            } else {
+                DestroySlot(slot);
+            }
+        }
+
+        slot.data = new Resource(std::move(resource));
+        slot.destroy = [](void* data) noexcept {
+            delete static_cast<Resource*>(data);
+        };
+        ++size_;
+    }
+
+    template <AllowedResourceType Resource>
+    void RemoveResource() {
+        const auto index = internal::ResourceIndex<Resource>();
+        if (index >= slots_.size() || !slots_[index].data) return;
+
+        DestroySlot(slots_[index]);
+    }
+
+    template <AllowedResourceType Resource>
+    [[nodiscard]] bool ContainsResource() const noexcept {
+        return GetResourcePointer<Resource>() != nullptr;
+    }
+
+    /// 不存在时返回 nullptr，不加锁
+    template <AllowedResourceType Resource>
+    [[nodiscard]] Resource* GetResourcePointer() const noexcept {
+        const auto index = internal::ResourceIndex<Resource>();
+        if (index >= slots_.size()) return nullptr;
+        return static_cast<Resource*>(slots_[index].data);
+    }
+
+    /// 资源必须存在，不加锁
+    template <AllowedResourceType Resource>
+    [[nodiscard]] Resource& GetResourceReference() const noexcept {
+        auto* resource = GetResourcePointer<Resource>();
+        assert(resource);
+        return *resource;
+    }
+
+    /// 开启或关闭某种资源的读写锁，不能在有 System 访问这种资源时调用
+    template <AllowedResourceType Resource>
+    void SetResourceLocking(const bool enabled) {
+        auto& slot = AssureSlot<Resource>();
+        if (enabled && !slot.mutex) {
+            slot.mutex = std::make_unique<std::shared_mutex>();
+        } else if (!enabled) {
+            slot.mutex.reset();
+        }
+    }
+
+    template <AllowedResourceType Resource>
+    [[nodiscard]] bool IsResourceLocking() const noexcept {
+        const auto index = internal::ResourceIndex<Resource>();
+        return index < slots_.size() && slots_[index].mutex;
+    }
+
+    /// 读取资源，开启了锁并且不是独占执行时持有共享锁，资源必须存在
+    template <AllowedResourceType Resource>
+    [[nodiscard]] ResourceReadGuard<Resource> ReadResource() const {
+        const auto index = internal::ResourceIndex<Resource>();
+        assert(index < slots_.size() && slots_[index].data);
+        const auto& slot = slots_[index];
+
+        std::shared_lock<std::shared_mutex> lock;
+        if (slot.mutex && !internal::exclusive_execution) {
+            lock = std::shared_lock(*slot.mutex);
+        }
+        return {*static_cast<const Resource*>(slot.data), std::move(lock)};
+    }
+
+    /// 修改资源，开启了锁并且不是独占执行时持有独占锁，资源必须存在
+    template <AllowedResourceType Resource>
+    [[nodiscard]] ResourceWriteGuard<Resource> WriteResource() const {
+        const auto index = internal::ResourceIndex<Resource>();
+        assert(index < slots_.size() && slots_[index].data);
+        const auto& slot = slots_[index];
+
+        std::unique_lock<std::shared_mutex> lock;
+        if (slot.mutex && !internal::exclusive_execution) {
+            lock = std::unique_lock(*slot.mutex);
+        }
+        return {*static_cast<Resource*>(slot.data), std::move(lock)};
+    }
+
+    /// 资源的数量
+    [[nodiscard]] constexpr std::size_t Size() const noexcept {
+        return size_;
+    }
+
+    [[nodiscard]] constexpr bool Empty() const noexcept {
+        return size_ == 0;
+    }
+
+    void Clear() noexcept {
+        for (auto& slot : slots_) {
+            if (slot.data) DestroySlot(slot);
+        }
+    }
+
+private:
+    template <AllowedResourceType Resource>
+    Slot& AssureSlot() {
+        const auto index = internal::ResourceIndex<Resource>();
+        if (index >= slots_.size()) {
+            slots_.resize(index + 1);
+        }
+        return slots_[index];
+    }
+
+    void DestroySlot(Slot& slot) noexcept {
+        slot.destroy(slot.data);
+        slot.data = nullptr;
+        slot.destroy = nullptr;
+        --size_;
+    }
+
+private:
+    // 下标是 internal::ResourceIndex
+    std::vector<Slot> slots_;
+
+    std::size_t size_{0};
+};
+} // namespace ecs
+
+#endif // RESOURCE_HPP
@@ -0,0 +1,505 @@
+#ifndef ROLLBACK_HPP
+#define ROLLBACK_HPP
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "registry.hpp"
+#include "resource.hpp"
+#include "world.hpp"
+
+namespace ecs {
+/// 回滚缓冲区，保存最近若干帧的 Registry 状态，可以回到之前的某一帧重新模拟
+///
+/// 每个 Storage 的 sparse_ 和 packed 数组按 BasicStorage::dirty_block_size_k 分页，
+/// 每 64 页组成一个页块，对应变化位图中的一个字。页表是写时复制的：
+/// 相邻的检查点之间共享没有变化的页、页块和整个页表，一个检查点只沿着位图中被标记的位复制写过的页
+/// 和它们所在的页块，没有变化的 Storage 直接共享上一个检查点的页表，开销和这一帧写过的页数成正比。
+/// 依赖 Registry 的变化记录，构造时会打开它。
+///
+/// 共享组件只保存句柄，不保存值表，SharedStorage::Compact 重新编号句柄之后不能再回滚到之前的检查点。
+///
+/// 资源没有变化记录，用 TrackResource 登记的资源在每个检查点整体复制一份
+template <AllowedEntityType Entity>
+class RollbackBuffer {
+public:
+    using RegistryType = Registry<Entity>;
+    using ResourcesType = Resources<Entity>;
+    using WorldType = World<Entity>;
+    using BasicStorageType = BasicStorage<Entity>;
+
+    using EntityTraits = EntityTraits<Entity>;
+
+    using EntityOriginalType = typename EntityTraits::OriginalType;
+    using EntityIdType = typename EntityTraits::IdType;
+    using EntityUnderlyingType = typename EntityTraits::UnderlyingType;
+
+private:
+    using DirtyBitsType = typename BasicStorageType::DirtyBitsType;
+
+    // 一页的内容，检查点之间通过共享指针共享
+    using PageType = std::shared_ptr<const std::vector<std::byte>>;
+
+    // 页块中页的数量，和变化位图中一个字的位数相同，位图中的第 i 个字正好对应第 i 个页块
+    static constexpr std::size_t chunk_pages_k = 64;
+
+    using PageChunkType = std::array<PageType, chunk_pages_k>;
+    using ChunkType = std::shared_ptr<const PageChunkType>;
+
+    // 页块的数组，为空时表示没有页
+    using PageTableType = std::shared_ptr<const std::vector<ChunkType>>;
+
+    // 资源的副本，资源不存在时为空
+    using ResourceCopyType = std::shared_ptr<const void>;
+
+    struct ResourceHooks {
+        ResourceCopyType (*capture)(const ResourcesType& resources);
+        void (*restore)(ResourcesType& resources, const void* copy);
+    };
+
+    struct StorageState {
+        std::size_t sparse_size{0};
+        std::size_t count{0};
+        PageTableType sparse_pages;
+        PageTableType packed_pages;
+
+        // 见 BasicStorage::ValueGeneration
+        std::size_t value_generation{0};
+    };
+
+    struct FrameState {
+        std::unordered_map<ComponentTypeId, StorageState> storages;
+
+        // 和上一个检查点相比，新建的实体和销毁的实体，两者没有交集
+        std::vector<EntityOriginalType> created;
+        std::vector<EntityOriginalType> destroyed;
+
+        // 空闲列表从 free_low_water 开始被替换了，free_removed 是被替换掉的部分
+        std::size_t free_low_water{0};
+        std::vector<EntityUnderlyingType> free_removed;
+
+        EntityIdType next_entity{};
+
+        // 和 resource_hooks_ 一一对应，登记得比这个检查点晚的资源没有副本
+        std::vector<ResourceCopyType> resources;
+    };
+
+    static constexpr std::size_t block_size_k = BasicStorageType::dirty_block_size_k;
+
+public:
+    RollbackBuffer(RegistryType& registry, const std::size_t capacity)
+        : registry_(registry), checkpoints_(capacity) {
+        if (capacity == 0) {
+            throw std::runtime_error("RollbackBuffer: Capacity must be positive");
+        }
+        registry_.SetChangeTracking(true);
+    }
+
+    RollbackBuffer(RegistryType& registry, ResourcesType& resources, const std::size_t capacity)
+        : RollbackBuffer(registry, capacity) {
+        resources_ = &resources;
+    }
+
+    RollbackBuffer(WorldType& world, const std::size_t capacity)
+        : RollbackBuffer(world.registry(), world.resources(), capacity) {
+    }
+
+    RollbackBuffer(const RollbackBuffer&) = delete;
+    RollbackBuffer& operator=(const RollbackBuffer&) = delete;
+
+    ~RollbackBuffer() = default;
+
+    /// 保存的检查点数量
+    [[nodiscard]] std::size_t Size() const noexcept {
+        return size_;
+    }
+
+    [[nodiscard]] std::size_t Capacity() const noexcept {
+        return checkpoints_.size();
+    }
+
+    /// 之后的检查点会保存这种资源，回滚时恢复它的值，回滚到的检查点中不存在时删除它
+    ///
+    /// 需要在构造时给出 Resources，已经登记过时什么都不做
+    template <AllowedResourceType Resource>
+        requires std::is_copy_constructible_v<Resource>
+    void TrackResource() {
+        if (!resources_) {
+            throw std::runtime_error("RollbackBuffer::TrackResource: Resources are not available");
+        }
+
+        const auto hooks = ResourceHooks{&CaptureResource<Resource>, &RestoreResource<Resource>};
+        const auto same = [&hooks](const ResourceHooks& other) { return other.capture == hooks.capture; };
+        if (std::ranges::none_of(resource_hooks_, same)) {
+            resource_hooks_.push_back(hooks);
+        }
+    }
+
+    /// 保存当前的状态，缓冲区满了时丢弃最旧的检查点
+    void Checkpoint() {
+        const FrameState* previous = size_ > 0 ? &Latest() : nullptr;
+
+        FrameState checkpoint;
+        CollectEntityChanges(checkpoint.created, checkpoint.destroyed);
+        checkpoint.next_entity = registry_.NextEntity();
+
+        // 空闲列表只有末尾会变化
+        const auto& free_list = registry_.FreeList();
+        if (previous) {
+            const auto low_water = std::min(registry_.FreeListLowWater(), free_list_.size());
+            checkpoint.free_low_water = low_water;
+            checkpoint.free_removed.assign(free_list_.begin() + low_water, free_list_.end());
+            free_list_.resize(low_water);
+            free_list_.insert(free_list_.end(), free_list.begin() + low_water, free_list.end());
+        } else {
+            free_list_.assign(free_list.begin(), free_list.end());
+        }
+
+        for (auto it = registry_.StoragesBegin(); it != registry_.StoragesEnd(); ++it) {
+            const auto& storage = *it->second;
+
+            StorageState state;
+            if (previous) {
+                if (const auto found = previous->storages.find(it->first); found != previous->storages.end()) {
+                    state = found->second;
+                }
+            }
+
+            const auto sparse_size = storage.Sparse().size();
+            const auto count = storage.Size();
+            UpdatePages(state.sparse_pages, storage.SparseDirtyBits(), state.sparse_size, sparse_size,
+                        [&storage](const std::size_t first, const std::size_t n) {
+                            return CaptureSparse(storage, first, n);
+                        });
+            UpdatePages(state.packed_pages, storage.PackedDirtyBits(), state.count, count,
+                        [&storage](const std::size_t first, const std::size_t n) {
+                            return CapturePacked(storage, first, n);
+                        });
+            state.sparse_size = sparse_size;
+            state.count = count;
+            state.value_generation = storage.ValueGeneration();
+
+            checkpoint.storages.emplace(it->first, std::move(state));
+        }
+
+        registry_.ClearChanges();
+
+        checkpoint.resources.reserve(resource_hooks_.size());
+        for (const auto& hooks : resource_hooks_) {
+            checkpoint.resources.push_back(hooks.capture(*resources_));
+        }
+
+        if (size_ < checkpoints_.size()) {
+            ++size_;
+        } else {
+            head_ = (head_ + 1) % checkpoints_.size();
+        }
+        Latest() = std::move(checkpoint);
+    }
+
+    /// 回到 frames 个检查点之前的状态，0 表示回到最近的检查点，之后的检查点都会被丢弃
+    void Rewind(const std::size_t frames = 0) {
+        if (frames >= size_) {
+            throw std::runtime_error("RollbackBuffer::Rewind: Not enough checkpoints");
+        }
+
+        const auto& latest = Latest();
+        const auto& target = At(size_ - 1 - frames);
+
+        // 检查点中的句柄只在同一代的值表中有意义，先检查完再修改 registry
+        for (auto it = registry_.StoragesBegin(); it != registry_.StoragesEnd(); ++it) {
+            const auto found = target.storages.find(it->first);
+            if (found != target.storages.end() && found->second.value_generation != it->second->ValueGeneration()) {
+                throw std::runtime_error("RollbackBuffer::Rewind: Value table was compacted after the checkpoint");
+            }
+        }
+
+        RewindEntities(frames);
+
+        for (auto it = registry_.StoragesBegin(); it != registry_.StoragesEnd(); ++it) {
+            const auto found_target = target.storages.find(it->first);
+            const auto found_latest = latest.storages.find(it->first);
+            RestoreStorage(it->first, *it->second,
+                           found_target == target.storages.end() ? empty_state_ : found_target->second,
+                           found_latest == latest.storages.end() ? empty_state_ : found_latest->second);
+        }
+
+        registry_.ClearChanges();
+
+        for (std::size_t i = 0; i < target.resources.size(); ++i) {
+            resource_hooks_[i].restore(*resources_, target.resources[i].get());
+        }
+
+        size_ -= frames;
+    }
+
+private:
+    FrameState& At(const std::size_t index) noexcept {
+        return checkpoints_[(head_ + index) % checkpoints_.size()];
+    }
+
+    FrameState& Latest() noexcept {
+        return At(size_ - 1);
+    }
+
+    /// 上一次 ClearChanges 之后的实体变化，去掉这段时间内创建又销毁的实体
+    void CollectEntityChanges(std::vector<EntityOriginalType>& created,
+                              std::vector<EntityOriginalType>& destroyed) const {
+        const auto& all_created = registry_.CreatedEntities();
+        const std::unordered_set<EntityOriginalType> created_set(all_created.begin(), all_created.end());
+
+        for (const auto entity : all_created) {
+            if (registry_.ContainsEntity(entity)) {
+                created.push_back(entity);
+            }
+        }
+        for (const auto entity : registry_.DestroyedEntities()) {
+            if (!created_set.contains(entity)) {
+                destroyed.push_back(entity);
+            }
+        }
+    }
+
+    /// 从新到旧依次撤销实体的变化和空闲列表的变化
+    void RewindEntities(const std::size_t frames) {
+        std::vector<EntityOriginalType> created;
+        std::vector<EntityOriginalType> destroyed;
+        CollectEntityChanges(created, destroyed);
+
+        const auto current_size = registry_.FreeList().size();
+        auto low_water = std::min(registry_.FreeListLowWater(), free_list_.size());
+
+        // 最近的检查点之后还没有保存的变化
+        registry_.ApplyEntityChanges(created, destroyed, current_size, {}, registry_.NextEntity());
+
+        for (std::size_t i = 0; i < frames; ++i) {
+            const auto& checkpoint = At(size_ - 1 - i);
+            registry_.ApplyEntityChanges(checkpoint.created, checkpoint.destroyed,
+                                         registry_.FreeList().size(), {}, registry_.NextEntity());
+
+            free_list_.resize(checkpoint.free_low_water);
+            free_list_.insert(free_list_.end(), checkpoint.free_removed.begin(), checkpoint.free_removed.end());
+            low_water = std::min(low_water, checkpoint.free_low_water);
+        }
+
+        const auto tail = std::span(free_list_).subspan(low_water);
+        registry_.ApplyEntityChanges({}, {}, low_water, tail, At(size_ - 1 - frames).next_entity);
+    }
+
+    void RestoreStorage(const ComponentTypeId type_id, BasicStorageType& storage,
+                        const StorageState& target, const StorageState& latest) {
+        const auto sparse_blocks = CollectRestoreBlocks(target.sparse_pages, target.sparse_size,
+                                                        latest.sparse_pages, latest.sparse_size,
+                                                        storage.SparseDirtyBits());
+        const auto packed_blocks = CollectRestoreBlocks(target.packed_pages, target.count,
+                                                        latest.packed_pages, latest.count,
+                                                        storage.PackedDirtyBits());
+
+        // 被覆盖或者被截掉的位置上原来的实体
+        const auto& packed = storage.PackedEntities();
+        std::vector<EntityOriginalType> moved;
+        for (const auto block : packed_blocks) {
+            const auto first = block * block_size_k;
+            if (first >= packed.size()) break;
+            moved.insert(moved.end(), packed.begin() + first,
+                         packed.begin() + std::min(first + block_size_k, packed.size()));
+        }
+        if (target.count < packed.size()) {
+            moved.insert(moved.end(), packed.begin() + target.count, packed.end());
+        }
+
+        storage.ResizeForRestore(target.sparse_size, target.count);
+
+        for (const auto block : sparse_blocks) {
+            const auto& page = *PageAt(target.sparse_pages, block);
+            storage.WriteSparse(block * block_size_k,
+                                std::span(reinterpret_cast<const EntityIdType*>(page.data()),
+                                          page.size() / sizeof(EntityIdType)));
+        }
+
+        const auto element_size = sizeof(EntityOriginalType) + storage.ComponentSize();
+        for (const auto block : packed_blocks) {
+            const auto& page = *PageAt(target.packed_pages, block);
+            const auto count = page.size() / element_size;
+            const auto entities = std::span(reinterpret_cast<const EntityOriginalType*>(page.data()), count);
+
+            storage.WritePacked(block * block_size_k, entities, page.data() + count * sizeof(EntityOriginalType));
+            registry_.MarkComponentsAttached(type_id, entities);
+        }
+
+        std::erase_if(moved, [&storage](const EntityOriginalType entity) {
+            return storage.ContainsEntity(entity);
+        });
+        registry_.MarkComponentsDetached(type_id, moved);
+    }
+
+    static constexpr std::size_t BlockCount(const std::size_t size) noexcept {
+        return (size + block_size_k - 1) / block_size_k;
+    }
+
+    static constexpr std::size_t ChunkCount(const std::size_t blocks) noexcept {
+        return (blocks + chunk_pages_k - 1) / chunk_pages_k;
+    }
+
+    static const PageType& PageAt(const PageTableType& table, const std::size_t block) noexcept {
+        return (*(*table)[block / chunk_pages_k])[block % chunk_pages_k];
+    }
+
+    /// 需要重写的页：和最近的检查点不同的页，以及最近的检查点之后被修改过的页
+    ///
+    /// 两边共享的页块在这段时间内没有被修改时整块跳过
+    static std::vector<std::size_t> CollectRestoreBlocks(const PageTableType& target, const std::size_t target_size,
+                                                         const PageTableType& latest, const std::size_t latest_size,
+                                                         const DirtyBitsType& dirty) {
+        const auto target_blocks = BlockCount(target_size);
+        const auto latest_blocks = BlockCount(latest_size);
+
+        std::vector<std::size_t> blocks;
+        for (std::size_t chunk = 0; chunk < ChunkCount(target_blocks); ++chunk) {
+            const auto first = chunk * chunk_pages_k;
+            const auto last = std::min(first + chunk_pages_k, target_blocks);
+            const auto& target_chunk = (*target)[chunk];
+            const auto* latest_chunk = chunk < ChunkCount(latest_blocks) ? (*latest)[chunk].get() : nullptr;
+            const auto dirty_word = chunk < dirty.size() ? dirty[chunk] : 0;
+
+            if (target_chunk.get() == latest_chunk && dirty_word == 0 && last <= latest_blocks) continue;
+
+            for (auto block = first; block < last; ++block) {
+                const auto index = block - first;
+                if (block >= latest_blocks || (*target_chunk)[index] != (*latest_chunk)[index] ||
+                    (dirty_word >> index & 1) != 0) {
+                    blocks.push_back(block);
+                }
+            }
+        }
+        return blocks;
+    }
+
+    /// 更新页表，只复制新增的页和被修改过的页
+    ///
+    /// 只遍历位图中被标记的位，全为 0 的字整个跳过。第一次修改时才复制页块数组，
+    /// 每个被修改的页块只复制一次，没有修改时继续共享原来的页表
+    template <typename Capture>
+    static void UpdatePages(PageTableType& table, const DirtyBitsType& dirty,
+                            const std::size_t old_size, const std::size_t size, Capture&& capture) {
+        const auto old_blocks = BlockCount(old_size);
+        const auto blocks = BlockCount(size);
+
+        // 从 fresh 开始的页都要重新复制：新增的页，以及长度变了时原来的最后一页，sparse_ 变长时新的元素不会被标记
+        const auto fresh = std::min(size != old_size && old_blocks > 0 ? old_blocks - 1 : old_blocks, blocks);
+
+        std::shared_ptr<std::vector<ChunkType>> next;
+        std::shared_ptr<PageChunkType> writable;
+        std::size_t writable_chunk = 0;
+
+        const auto prepare = [&] {
+            if (next) return;
+            next = table ? std::make_shared<std::vector<ChunkType>>(*table)
+                         : std::make_shared<std::vector<ChunkType>>();
+            next->resize(ChunkCount(blocks));
+        };
+
+        // 页按下标递增的顺序写入，所以每个页块只会被复制一次
+        const auto set_page = [&](const std::size_t block, PageType page) {
+            prepare();
+            const auto chunk = block / chunk_pages_k;
+            if (!writable || writable_chunk != chunk) {
+                const auto& shared = (*next)[chunk];
+                writable = shared ? std::make_shared<PageChunkType>(*shared) : std::make_shared<PageChunkType>();
+                (*next)[chunk] = writable;
+                writable_chunk = chunk;
+            }
+            (*writable)[block % chunk_pages_k] = std::move(page);
+        };
+
+        // 长度没有变化时最后一页也可能不完整
+        const auto capture_page = [&](const std::size_t block) {
+            const auto first = block * block_size_k;
+            set_page(block, capture(first, std::min(block_size_k, size - first)));
+        };
+
+        const auto dirty_words = std::min(dirty.size(), ChunkCount(fresh));
+        for (std::size_t word = 0; word < dirty_words; ++word) {
+            for (auto rest = dirty[word]; rest != 0; rest &= rest - 1) {
+                const auto block = word * chunk_pages_k + static_cast<std::size_t>(std::countr_zero(rest));
+                if (block >= fresh) break;
+                capture_page(block);
+            }
+        }
+
+        for (auto block = fresh; block < blocks; ++block) {
+            capture_page(block);
+        }
+
+        // 变短时释放最后一个页块中已经不用的页
+        if (blocks < old_blocks) {
+            for (auto block = blocks; block < std::min(old_blocks, ChunkCount(blocks) * chunk_pages_k); ++block) {
+                set_page(block, nullptr);
+            }
+            prepare();
+        }
+
+        if (next) {
+            table = std::move(next);
+        }
+    }
+
+    template <AllowedResourceType Resource>
+    static ResourceCopyType CaptureResource(const ResourcesType& resources) {
+        const auto* resource = resources.template GetResourcePointer<Resource>();
+        if (!resource) return nullptr;
+        return std::make_shared<const Resource>(*resource);
+    }
+
+    template <AllowedResourceType Resource>
+    static void RestoreResource(ResourcesType& resources, const void* copy) {
+        if (!copy) {
+            resources.template RemoveResource<Resource>();
+            return;
+        }
+        resources.UpsertResource(Resource(*static_cast<const Resource*>(copy)));
+    }
+
+    static PageType CaptureSparse(const BasicStorageType& storage, const std::size_t first, const std::size_t count) {
+        const auto* data = reinterpret_cast<const std::byte*>(storage.Sparse().data() + first);
+        return std::make_shared<const std::vector<std::byte>>(data, data + count * sizeof(EntityIdType));
+    }
+
+    static PageType CapturePacked(const BasicStorageType& storage, const std::size_t first, const std::size_t count) {
+        const auto component_size = storage.ComponentSize();
+
+        std::vector<std::byte> page(count * (sizeof(EntityOriginalType) + component_size));
+        std::memcpy(page.data(), storage.PackedEntities().data() + first, count * sizeof(EntityOriginalType));
+        if (component_size > 0) {
+            std::memcpy(page.data() + count * sizeof(EntityOriginalType),
+                        storage.ComponentData() + first * component_size, count * component_size);
+        }
+        return std::make_shared<const std::vector<std::byte>>(std::move(page));
+    }
+
+private:
+    RegistryType& registry_;
+    ResourcesType* resources_{nullptr};
+    std::vector<ResourceHooks> resource_hooks_;
+
+    // 环形缓冲区，head_ 是最旧的检查点
+    std::vector<FrameState> checkpoints_;
+    std::size_t head_{0};
+    std::size_t size_{0};
+
+    // 最近的检查点的空闲列表
+    std::vector<EntityUnderlyingType> free_list_;
+
+    const StorageState empty_state_{};
+};
+} // namespace ecs
+
+#endif // ROLLBACK_HPP
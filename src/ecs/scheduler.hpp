@@ -1,20 +1,179 @@
 #ifndef SCHEDULER_HPP
 #define SCHEDULER_HPP
 
+#include <atomic>
 #include <condition_variable>
+#include <exception>
+#include <fstream>
 #include <future>
+#include <latch>
+#include <mutex>
+#include <optional>
 #include <queue>
+#include <string>
+#include <string_view>
+#include <system_error>
 #include <thread>
+#include <unordered_map>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#endif
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 
 #include "system.hpp"
 
 namespace ecs {
+/// 工作线程在任务队列为空时的等待策略
+///
+/// 先执行 spin_count 次 pause 指令忙等，再 yield yield_count 次，最后在 atomic 上休眠（Linux 上是 futex）
+struct WaitPolicy {
+    std::size_t spin_count{4096};
+    std::size_t yield_count{64};
+};
+
+/// 工作线程的创建选项，修改之后会在线程池重启时生效
+struct WorkerOptions {
+    /// 第 i 个工作线程绑定到 cpus[i % cpus.size()]，为空时不绑定
+    std::vector<std::size_t> cpus{};
+
+    /// 第 i 个工作线程命名为 name_prefix + i，方便在 profiler 中区分，为空时不命名
+    std::string name_prefix{};
+};
+
+namespace internal {
+/// 解析 Linux 的 cpulist 格式，比如 "0-3,8,10-11"，NUMA 节点列表也是这个格式
+inline std::vector<std::size_t> ParseIdList(const std::string_view id_list) {
+    std::vector<std::size_t> ids;
+
+    std::size_t pos = 0;
+    while (pos < id_list.size()) {
+        auto comma = id_list.find(',', pos);
+        if (comma == std::string_view::npos) comma = id_list.size();
+
+        const auto range = id_list.substr(pos, comma - pos);
+        pos = comma + 1;
+
+        const auto dash = range.find('-');
+        const auto first_part = range.substr(0, dash);
+        if (first_part.empty() || first_part.find_first_not_of("0123456789") != std::string_view::npos) continue;
+
+        const auto first = std::stoul(std::string(first_part));
+        auto last = first;
+        if (dash != std::string_view::npos) {
+            last = std::stoul(std::string(range.substr(dash + 1)));
+        }
+
+        for (auto id = first; id <= last; ++id) {
+            ids.push_back(id);
+        }
+    }
+
+    return ids;
+}
+
+/// 按选项设置当前线程的 CPU 亲和性和名字，只在 Linux 上生效，其他平台什么都不做
+///
+/// 成功时返回 0，否则返回第一个失败的错误码，比如 CPU 不在允许的 cpuset 中时是 EINVAL
+inline int ConfigureCurrentThread(const WorkerOptions& options, const std::size_t index) {
+#if defined(__linux__)
+    if (!options.cpus.empty()) {
+        const auto cpu = options.cpus[index % options.cpus.size()];
+        if (cpu >= CPU_SETSIZE) return EINVAL;
+
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu, &cpu_set);
+        if (const int error = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set); error != 0) {
+            return error;
+        }
+    }
+
+    if (!options.name_prefix.empty()) {
+        // Linux 的线程名最多 15 个字符
+        const auto name = (options.name_prefix + std::to_string(index)).substr(0, 15);
+        if (const int error = pthread_setname_np(pthread_self(), name.c_str()); error != 0) {
+            return error;
+        }
+    }
+#else
+    (void)options;
+    (void)index;
+#endif
+    return 0;
+}
+} // namespace internal
+
+/// NUMA 节点的数量，无法获取时返回 1
+inline std::size_t GetNumaNodeCount() {
+#if defined(__linux__)
+    std::ifstream file("/sys/devices/system/node/online");
+    std::string online;
+    if (file && std::getline(file, online)) {
+        const auto nodes = internal::ParseIdList(online);
+        if (!nodes.empty()) return nodes.back() + 1;
+    }
+#endif
+    return 1;
+}
+
+/// NUMA 节点上的所有 CPU，可以直接作为 WorkerOptions::cpus，让线程和它访问的内存在同一个节点上
+///
+/// 线程绑定之后，Linux 默认的首次访问策略会把它分配的内存放在本地节点上
+inline std::vector<std::size_t> GetNumaNodeCpus(const std::size_t node) {
+#if defined(__linux__)
+    std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    std::string cpu_list;
+    if (file && std::getline(file, cpu_list)) {
+        return internal::ParseIdList(cpu_list);
+    }
+#else
+    (void)node;
+#endif
+    return {};
+}
+
 namespace internal {
+/// 当前线程在线程池中的下标加 1，不是工作线程时为 0，用于 WorkerLocal
+///
+/// 同一时刻只有一个线程池在执行 System，所以不同线程池的工作线程共用这些下标不会冲突
+inline thread_local std::size_t current_worker_slot = 0;
+
+/// 告诉 CPU 当前处于忙等循环中，降低功耗并让出超线程的执行资源
+inline void CpuRelax() noexcept {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
 class ThreadPool {
 public:
-    using TaskType = std::function<void()>;
+    /// 轻量的任务记录，只有一个函数指针和它的参数，入队出队都不需要分配内存
+    struct TaskRecord {
+        void (*function)(void* context, std::size_t index){nullptr};
+        void* context{nullptr};
+        std::size_t index{0};
+
+        void operator()() const {
+            function(context, index);
+        }
+    };
+
+    using TaskType = TaskRecord;
 
-    explicit ThreadPool(const std::size_t num_threads) : num_threads_(num_threads) {
+    explicit ThreadPool(const std::size_t num_threads,
+                        const WaitPolicy wait_policy = {},
+                        WorkerOptions worker_options = {})
+        : worker_options_(std::move(worker_options)), num_threads_(num_threads) {
+        SetWaitPolicy(wait_policy);
         InitializeWorkers();
     }
 
@@ -27,16 +186,24 @@ public:
         requires std::invocable<InvokeType&&, Args&&...>
     auto Enqueue(InvokeType&& f, Args&&... args) {
         using ReturnType = std::invoke_result_t<InvokeType&&, Args&&...>;
+        using PackagedTaskType = std::packaged_task<ReturnType()>;
 
-        // 将任务包装成一个 packaged_task
-        auto task = std::make_shared<std::packaged_task<ReturnType()>>(
+        // 将任务包装成一个 packaged_task，由 RunPackagedTask 负责释放
+        auto task = std::make_unique<PackagedTaskType>(
             std::bind(std::forward<InvokeType>(f), std::forward<Args>(args)...)
         );
 
         std::future<ReturnType> result = task->get_future();
 
+        Submit({RunPackagedTask<PackagedTaskType>, task.get(), 0});
+        task.release();
+
+        return result;
+    }
+
+    /// 直接提交一个任务记录，不会分配内存，也没有返回值
+    void Submit(const TaskType task) {
         {
-            // 与 WorkerThread 中的条件变量配合使用
             std::lock_guard lock(queue_mutex_);
 
             // 如果线程池停止了，就不能再添加任务了
@@ -44,18 +211,28 @@ public:
                 throw std::runtime_error("enqueue on stopped ThreadPool");
             }
 
-            tasks_.emplace([task]() { (*task)(); });
+            tasks_.push(task);
+            task_count_.fetch_add(1);
         }
-        condition_.notify_one();
 
-        return result;
+        // 先推进 epoch，再检查有没有休眠的线程，和 Idle 中的顺序相反，这样不会丢失唤醒
+        epoch_.fetch_add(1);
+        if (sleeping_.load() > 0) {
+            epoch_.notify_one();
+        }
     }
 
     [[nodiscard]] bool IsStopped() const noexcept {
         return stop_;
     }
 
-    void Restart() noexcept {
+    /// 工作线程的数量，工作线程的槽位是 1 到 ThreadCount()，见 current_worker_slot
+    [[nodiscard]] std::size_t ThreadCount() const noexcept {
+        return num_threads_;
+    }
+
+    /// 工作线程配置失败时停止线程池并抛出 std::system_error
+    void Restart() {
         if (!stop_) {
             Stop();
         }
@@ -70,12 +247,12 @@ public:
 
         // 通知所有线程停止
         {
-            std::unique_lock lock(queue_mutex_);
+            std::lock_guard lock(queue_mutex_);
             stop_ = true;
         }
 
-        // 通知所有线程
-        condition_.notify_all();
+        // 唤醒所有休眠的线程
+        WakeAll();
 
         // 等待所有线程结束
         for (auto& worker : workers_) {
@@ -85,41 +262,152 @@ public:
         workers_.clear();
     }
 
+    /// 可以在任何时候修改，工作线程下一次空闲时生效
+    void SetWaitPolicy(const WaitPolicy wait_policy) noexcept {
+        spin_count_ = wait_policy.spin_count;
+        yield_count_ = wait_policy.yield_count;
+    }
+
+    [[nodiscard]] WaitPolicy GetWaitPolicy() const noexcept {
+        return {spin_count_.load(), yield_count_.load()};
+    }
+
+    /// 让工作线程保持活跃，空闲时只忙等和 yield，不会休眠，适合在一帧之内使用
+    void KeepHot() noexcept {
+        hot_ = true;
+        WakeAll();
+    }
+
+    /// 允许工作线程在等待策略用完之后休眠，适合在帧与帧之间使用
+    void Park() noexcept {
+        hot_ = false;
+    }
+
+    [[nodiscard]] bool IsHot() const noexcept {
+        return hot_;
+    }
+
+    [[nodiscard]] const WorkerOptions& GetWorkerOptions() const noexcept {
+        return worker_options_;
+    }
+
+    /// 修改工作线程的选项，如果线程池正在运行，会重启所有的工作线程，不能在有任务的时候调用
+    ///
+    /// 重启时有工作线程绑定 CPU 或命名失败，会停止线程池并抛出 std::system_error
+    void SetWorkerOptions(WorkerOptions worker_options) {
+        const bool running = !stop_;
+        if (running) {
+            Stop();
+        }
+
+        worker_options_ = std::move(worker_options);
+
+        if (running) {
+            Restart();
+        }
+    }
+
 private:
+    /// 等所有工作线程都配置完再返回，这样配置的错误可以在调用线程上抛出
     void InitializeWorkers() {
         workers_.clear();
+        configure_error_ = 0;
+
+        std::latch configured(static_cast<std::ptrdiff_t>(num_threads_));
+        configured_ = &configured;
         for (std::size_t i = 0; i < num_threads_; ++i) {
-            workers_.emplace_back(WorkerThread, this);
+            workers_.emplace_back(WorkerThread, this, i);
+        }
+        configured.wait();
+        configured_ = nullptr;
+
+        if (const int error = configure_error_.load(); error != 0) {
+            Stop();
+            throw std::system_error(error, std::generic_category(), "ThreadPool: failed to configure worker thread");
         }
     }
 
-    static void WorkerThread(ThreadPool* pool) {
-        while (true) {
-            std::function<void()> task;
+    void WakeAll() noexcept {
+        epoch_.fetch_add(1);
+        epoch_.notify_all();
+    }
 
-            // 临界区
-            {
-                // 先获取锁
-                std::unique_lock<std::mutex> lock(pool->queue_mutex_);
+    [[nodiscard]] bool HasWorkOrStop() const noexcept {
+        return task_count_.load(std::memory_order_acquire) > 0 || stop_.load(std::memory_order_acquire);
+    }
 
-                // 等待条件变量，这里就是等待任务队列不为空
-                // 或者如果线程池停止了，这里应该要继续执行
-                pool->condition_.wait(lock, [pool] {
-                    return pool->stop_ || !pool->tasks_.empty();
-                });
+    bool TryPop(TaskType& task) {
+        // 先不加锁检查一次，忙等的线程不会去争抢锁
+        if (task_count_.load(std::memory_order_acquire) == 0) return false;
 
-                // 如果线程池停止了，且任务队列为空，就退出
-                if (pool->stop_ && pool->tasks_.empty()) {
-                    return;
-                }
+        std::lock_guard lock(queue_mutex_);
+        if (tasks_.empty()) return false;
+
+        task = tasks_.front();
+        tasks_.pop();
+        task_count_.fetch_sub(1);
+        return true;
+    }
+
+    /// 按等待策略等待新的任务，返回之后需要重新检查任务队列
+    void Idle() {
+        const auto epoch = epoch_.load();
+
+        const auto spin_count = spin_count_.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < spin_count; ++i) {
+            if (HasWorkOrStop()) return;
+            CpuRelax();
+        }
+
+        const auto yield_count = yield_count_.load(std::memory_order_relaxed);
+        for (std::size_t i = 0; i < yield_count; ++i) {
+            if (HasWorkOrStop()) return;
+            std::this_thread::yield();
+        }
+
+        // 保持活跃时不休眠，回到循环继续等待
+        if (hot_.load(std::memory_order_relaxed)) {
+            std::this_thread::yield();
+            return;
+        }
+
+        // 读取 epoch 之前提交的任务可能已经跳过了唤醒，登记休眠之后必须再检查一次队列，
+        // 之后提交的任务要么被这里看到，要么会看到 sleeping_ 并唤醒，两边都要用 seq_cst
+        sleeping_.fetch_add(1);
+        if (task_count_.load() == 0 && !stop_.load()) {
+            epoch_.wait(epoch);
+        }
+        sleeping_.fetch_sub(1);
+    }
+
+    template <typename PackagedTaskType>
+    static void RunPackagedTask(void* context, std::size_t) {
+        const std::unique_ptr<PackagedTaskType> task(static_cast<PackagedTaskType*>(context));
+        (*task)();
+    }
+
+    static void WorkerThread(ThreadPool* pool, const std::size_t index) {
+        // 只记录第一个错误，线程仍然正常运行，由 InitializeWorkers 停止线程池
+        if (const int error = ConfigureCurrentThread(pool->worker_options_, index); error != 0) {
+            int expected = 0;
+            pool->configure_error_.compare_exchange_strong(expected, error);
+        }
+        current_worker_slot = index + 1;
+        pool->configured_->count_down();
+
+        TaskType task;
+        while (true) {
+            if (pool->TryPop(task)) {
+                task();
+                continue;
+            }
 
-                // 从任务队列中取出任务并 pop
-                task = std::move(pool->tasks_.front());
-                pool->tasks_.pop();
+            // 如果线程池停止了，且任务队列为空，就退出
+            if (pool->stop_) {
+                return;
             }
-            // 临界区结束
 
-            task();
+            pool->Idle();
         }
     }
 
@@ -127,16 +415,138 @@ private:
     std::vector<std::thread> workers_;
     std::queue<TaskType> tasks_;
     std::mutex queue_mutex_;
-    std::condition_variable condition_;
 
-    bool stop_{false};
+    // 队列中的任务数量，用于不加锁地检查队列是否为空
+    std::atomic<std::size_t> task_count_{0};
+
+    // 每次有新任务或者需要唤醒时递增，休眠的线程在它上面等待
+    std::atomic<std::uint32_t> epoch_{0};
+    std::atomic<std::size_t> sleeping_{0};
+
+    std::atomic<std::size_t> spin_count_{0};
+    std::atomic<std::size_t> yield_count_{0};
+    std::atomic<bool> hot_{false};
+
+    std::atomic<bool> stop_{false};
+
+    // 只在 InitializeWorkers 期间有效
+    std::latch* configured_{nullptr};
+    std::atomic<int> configure_error_{0};
+
+    WorkerOptions worker_options_;
     std::size_t num_threads_;
+};
+
+/// 在线程池上并行执行 function(0) 到 function(count - 1)，第 0 个由当前线程执行
+///
+/// 不论当前线程还是工作线程抛出异常，都会等所有提交了的任务结束之后才返回，
+/// 所以任务不会访问已经销毁的栈上状态。当前线程的异常优先，否则在当前线程上重新抛出工作线程的第一个异常
+template <typename Function>
+void ForkJoin(ThreadPool& pool, const std::size_t count, Function& function) {
+    if (count == 0) return;
+
+    struct Context {
+        Function* function;
+        std::latch done;
+        std::mutex error_mutex;
+        std::exception_ptr error;
+
+        Context(Function* function, const std::size_t count)
+            : function(function), done(static_cast<std::ptrdiff_t>(count - 1)) {
+        }
+
+        static void Run(void* context, const std::size_t index) {
+            auto* self = static_cast<Context*>(context);
+            try {
+                (*self->function)(index);
+            } catch (...) {
+                std::lock_guard lock(self->error_mutex);
+                if (!self->error) {
+                    self->error = std::current_exception();
+                }
+            }
+            self->done.count_down();
+        }
+    };
 
-    friend void WorkerThread(ThreadPool* pool);
+    // 离开作用域时替没能提交的任务计数，然后等待所有提交了的任务
+    class JoinGuard {
+    public:
+        JoinGuard(Context& context, const std::size_t count, const std::size_t& submitted) noexcept
+            : context_(context), count_(count), submitted_(submitted) {
+        }
+
+        JoinGuard(const JoinGuard&) = delete;
+        JoinGuard& operator=(const JoinGuard&) = delete;
+
+        ~JoinGuard() {
+            context_.done.count_down(static_cast<std::ptrdiff_t>(count_ - submitted_));
+            context_.done.wait();
+        }
+
+    private:
+        Context& context_;
+        std::size_t count_;
+        const std::size_t& submitted_;
+    };
+
+    Context context(&function, count);
+    std::size_t submitted = 1;
+    {
+        const JoinGuard guard(context, count, submitted);
+        for (; submitted < count; ++submitted) {
+            pool.Submit({Context::Run, &context, submitted});
+        }
+        function(0);
+    }
+
+    if (context.error) {
+        std::rethrow_exception(context.error);
+    }
+}
+} // namespace internal
+
+
+namespace internal {
+/// 当前线程是否在独占执行 System，调度器在调用线程上串行执行一个 Stage 时为 true
+///
+/// 这时不会有其他 System 同时运行，资源的读写锁可以跳过，见 Resources
+inline thread_local bool exclusive_execution = false;
+
+class ExclusiveExecutionScope {
+public:
+    ExclusiveExecutionScope() noexcept : previous_(exclusive_execution) {
+        exclusive_execution = true;
+    }
+
+    ExclusiveExecutionScope(const ExclusiveExecutionScope&) = delete;
+    ExclusiveExecutionScope& operator=(const ExclusiveExecutionScope&) = delete;
+
+    ~ExclusiveExecutionScope() {
+        exclusive_execution = previous_;
+    }
+
+private:
+    bool previous_;
 };
 } // namespace internal
 
 
+/// Stage 的执行策略
+enum class ExecutionPolicy {
+    /// 根据图的形状自动选择：System 很少或者是一条单链时，直接在调用线程上执行
+    Automatic,
+    /// 总是交给线程池并行执行
+    Parallel,
+    /// 总是在调用线程上按拓扑序执行，不经过线程池
+    Inline,
+};
+
+
+template <typename... SystemArgs>
+class Scheduler;
+
+
 template <typename... SystemArgs>
 class StageScheduler {
 public:
@@ -144,6 +554,12 @@ public:
     using SystemType = typename SystemGraphType::SystemType;
     using SystemIdType = typename SystemGraphType::SystemIdType;
 
+    /// Stage 执行完之后调用的函数，用于合并 WorkerLocal 之类的每个线程的累加器
+    using CompletionHookType = SmallFunction<void()>;
+
+    /// 执行期间 System 参数的引用，交给工作线程使用
+    using SystemArgsTupleType = std::tuple<SystemArgs&...>;
+
     StageScheduler() noexcept : StageScheduler(std::thread::hardware_concurrency()) {
     }
 
@@ -163,14 +579,18 @@ public:
         return graph_.Size();
     }
 
-    constexpr SystemIdType AddSystem(const SystemType& system) {
+    constexpr SystemIdType AddSystem(SystemType system) {
         std::lock_guard lock(graph_mutex_);
-        return graph_.AddSystem(system);
+        return graph_.AddSystem(std::move(system));
     }
 
     constexpr void RemoveSystem(const SystemIdType id) {
         std::lock_guard lock(graph_mutex_);
         graph_.RemoveSystem(id);
+
+        std::erase_if(cross_stage_constraints_, [id](const CrossStageConstraint& constraint) {
+            return constraint.to_id == id;
+        });
     }
 
     constexpr void AddConstraint(const SystemIdType from_id, const SystemIdType to_id) {
@@ -199,80 +619,246 @@ public:
         return graph_.CheckCycle();
     }
 
+    [[nodiscard]] constexpr ExecutionPolicy GetExecutionPolicy() const {
+        std::lock_guard lock(graph_mutex_);
+        return execution_policy_;
+    }
+
+    constexpr void SetExecutionPolicy(const ExecutionPolicy policy) {
+        std::lock_guard lock(graph_mutex_);
+        execution_policy_ = policy;
+    }
+
+    /// 流水线执行时，这个 Stage 是否要等待上一个 Stage 全部执行完毕，默认为 true
+    ///
+    /// 设置为 false 之后，这个 Stage 的 System 只等待显式添加的跨 Stage 约束
+    [[nodiscard]] constexpr bool GetWaitForPreviousStage() const {
+        std::lock_guard lock(graph_mutex_);
+        return wait_for_previous_stage_;
+    }
+
+    constexpr void SetWaitForPreviousStage(const bool wait) {
+        std::lock_guard lock(graph_mutex_);
+        wait_for_previous_stage_ = wait;
+    }
+
+    [[nodiscard]] WaitPolicy GetWaitPolicy() const noexcept {
+        return pool_.GetWaitPolicy();
+    }
+
+    void SetWaitPolicy(const WaitPolicy wait_policy) noexcept {
+        pool_.SetWaitPolicy(wait_policy);
+    }
+
+    [[nodiscard]] const WorkerOptions& GetWorkerOptions() const noexcept {
+        return pool_.GetWorkerOptions();
+    }
+
+    /// 会重启工作线程，不能在 Execute 期间调用
+    void SetWorkerOptions(WorkerOptions worker_options) {
+        pool_.SetWorkerOptions(std::move(worker_options));
+    }
+
+    /// 让工作线程在空闲时保持忙等而不休眠，通常在一帧开始时调用
+    void KeepWorkersHot() noexcept {
+        pool_.KeepHot();
+    }
+
+    /// 下一次 Execute 是否会用到线程池，空的和串行执行的 Stage 不会
+    [[nodiscard]] bool WillExecuteParallel() {
+        std::lock_guard lock(graph_mutex_);
+        return !graph_.Empty() && !ShouldExecuteInline(graph_, execution_policy_);
+    }
+
+    /// 允许工作线程休眠，通常在一帧结束时调用
+    void ParkWorkers() noexcept {
+        pool_.Park();
+    }
+
+    [[nodiscard]] bool AreWorkersHot() const noexcept {
+        return pool_.IsHot();
+    }
+
+    /// 这个 Stage 的线程池，可以在 Execute 之外借给其他并行任务，不能在 Execute 的过程中调用
+    internal::ThreadPool& GetThreadPool() {
+        if (pool_.IsStopped()) {
+            pool_.Restart();
+        }
+        return pool_;
+    }
+
+    /// 添加一个在 Stage 执行完之后调用的函数，多个函数按添加的顺序调用
+    void AddCompletionHook(CompletionHookType hook) {
+        std::lock_guard lock(graph_mutex_);
+        completion_hooks_.push_back(std::move(hook));
+    }
+
+    void ClearCompletionHooks() {
+        std::lock_guard lock(graph_mutex_);
+        completion_hooks_.clear();
+    }
+
+    /// 执行整个 Stage，所有 System 完成之后在调用线程上执行完成函数
+    ///
+    /// 执行期间会一直持有图的锁，System 不会被拷贝，所以 System 内部不能修改同一个 Stage
     constexpr void Execute(SystemArgs... args) {
-        // 拷贝一份图，用于拓扑排序
-        SystemGraphType graph_copy;
+        std::lock_guard graph_lock(graph_mutex_);
 
-        {
-            std::lock_guard graph_lock(graph_mutex_);
+        if (graph_.CheckCycle()) {
+            throw std::runtime_error("Cycle detected in SystemGraph");
+        }
 
-            if (graph_.CheckCycle()) {
-                throw std::runtime_error("Cycle detected in SystemGraph");
+        if (!graph_.Empty()) {
+            if (ShouldExecuteInline(graph_, execution_policy_)) {
+                ExecuteInline(graph_, args...);
+            } else {
+                ExecuteParallel(args...);
             }
+        }
 
-            graph_copy = graph_;
+        RunCompletionHooks();
+    }
+
+private:
+    static bool ShouldExecuteInline(const SystemGraphType& graph, const ExecutionPolicy policy) {
+        switch (policy) {
+        case ExecutionPolicy::Inline:
+            return true;
+        case ExecutionPolicy::Parallel:
+            return false;
+        case ExecutionPolicy::Automatic:
+        default:
+            // 没有可以并行的 System 时，线程池只会带来唤醒和任务包装的开销
+            return graph.Size() <= inline_threshold_k || graph.IsSerial();
         }
+    }
 
-        if (graph_copy.Empty()) {
-            return;
+    /// 在调用线程上按拓扑序依次执行，不经过线程池
+    static void ExecuteInline(const SystemGraphType& graph, SystemArgs&... args) {
+        internal::ExclusiveExecutionScope exclusive;
+        for (const auto id : graph.TopologicalOrder()) {
+            graph.FindSystem(id).system(args...);
+        }
+    }
+
+    /// 调用者需要持有 graph_mutex_
+    void RunCompletionHooks() const {
+        for (const auto& hook : completion_hooks_) {
+            hook();
         }
+    }
+
+    /// 来自之前某个 Stage 的约束，只在流水线执行时使用
+    struct CrossStageConstraint {
+        const StageScheduler* from_stage;
+        SystemIdType from_id;
+        SystemIdType to_id;
+
+        constexpr bool operator==(const CrossStageConstraint&) const = default;
+    };
+
+    void AddCrossStageConstraint(const CrossStageConstraint& constraint) {
+        std::lock_guard lock(graph_mutex_);
+        if (!ContainsCrossStageConstraintNoThreadSafe(constraint)) {
+            cross_stage_constraints_.push_back(constraint);
+        }
+    }
+
+    void RemoveCrossStageConstraint(const CrossStageConstraint& constraint) {
+        std::lock_guard lock(graph_mutex_);
+        std::erase(cross_stage_constraints_, constraint);
+    }
+
+    [[nodiscard]] bool ContainsCrossStageConstraint(const CrossStageConstraint& constraint) const {
+        std::lock_guard lock(graph_mutex_);
+        return ContainsCrossStageConstraintNoThreadSafe(constraint);
+    }
+
+    [[nodiscard]] bool ContainsCrossStageConstraintNoThreadSafe(const CrossStageConstraint& constraint) const {
+        return std::find(cross_stage_constraints_.begin(), cross_stage_constraints_.end(), constraint) !=
+            cross_stage_constraints_.end();
+    }
 
-        // 先初始化线程池
-        pool_.Restart();
+    /// 删除所有来自 from_stage 的约束，from_id 为空时删除整个 Stage 的约束
+    void RemoveCrossStageConstraintsFrom(const StageScheduler* from_stage,
+                                         const std::optional<SystemIdType> from_id = std::nullopt) {
+        std::lock_guard lock(graph_mutex_);
+        std::erase_if(cross_stage_constraints_, [from_stage, from_id](const CrossStageConstraint& constraint) {
+            return constraint.from_stage == from_stage && (!from_id || constraint.from_id == *from_id);
+        });
+    }
+
+    /// 调用者需要持有 graph_mutex_
+    void ExecuteParallel(SystemArgs&... args) {
+        SystemArgsTupleType args_tuple(args...);
+        args_ = &args_tuple;
+
+        // 每个 System 还没有完成的前驱数量，复用上一帧的内存
+        const auto& nodes = graph_.nodes();
+        in_degrees_.assign(nodes.size(), 0);
+        std::size_t pending = 0;
+
+        // 线程池在多次执行之间保持存活，空闲的线程按等待策略休眠
+        if (pool_.IsStopped()) {
+            pool_.Restart();
+        }
 
         // 将没有依赖的 System 入队
-        for (const auto& node : graph_copy.nodes()) {
-            if (node.InDegree() == 0) {
-                pool_.Enqueue(RunSystem, this, node.system, node.id, std::ref(args)...);
+        for (SystemIdType id = 0; id < nodes.size(); ++id) {
+            if (!graph_.ContainsSystem(id)) continue;
+
+            ++pending;
+            in_degrees_[id] = nodes[id].InDegree();
+            if (in_degrees_[id] == 0) {
+                Dispatch(id);
             }
         }
 
-
         // 等待所有 System 执行完毕
-        while (true) {
-            std::unique_lock lock(successes_mutex_);
-            successes_condition_.wait(lock, [this] {
-                return !successes_.empty();
-            });
+        while (pending > 0) {
+            {
+                std::unique_lock lock(successes_mutex_);
+                successes_condition_.wait(lock, [this] {
+                    return !successes_.empty();
+                });
+                completed_.swap(successes_);
+            }
 
-            // 这里不用担心线程安全问题，因为只有一个线程会修改这个图
-            while (!successes_.empty()) {
-                const auto id = successes_.front();
-                const auto& node = graph_copy.FindSystem(id);
-                successes_.pop();
+            // 这里不用担心线程安全问题，因为只有这个线程会修改 in_degrees_
+            for (const auto id : completed_) {
+                --pending;
 
                 // 将没有依赖的 System 入队
-                for (const auto tos = node.tos; const auto& next_id : tos) {
-                    auto& next_node = graph_copy.FindSystem(next_id);
-                    graph_copy.RemoveConstraint(id, next_id);
-                    if (next_node.InDegree() == 0) {
-                        pool_.Enqueue(RunSystem, this, next_node.system, next_node.id, std::ref(args)...);
+                for (const auto next_id : graph_.FindSystem(id).tos) {
+                    if (--in_degrees_[next_id] == 0) {
+                        Dispatch(next_id);
                     }
                 }
-
-                // 从图中删除这个 System
-                graph_copy.RemoveSystem(id);
-            }
-
-            if (graph_copy.Empty()) {
-                break;
             }
+            completed_.clear();
         }
 
-        // 等待所有线程结束
-        pool_.Stop();
+        args_ = nullptr;
     }
 
-private:
-    static void RunSystem(StageScheduler* scheduler, const SystemType system, const SystemIdType id,
-                          SystemArgs&... args) {
+    void Dispatch(const SystemIdType id) {
+        pool_.Submit({RunSystem, this, id});
+    }
+
+    static void RunSystem(void* context, const std::size_t index) {
+        auto* scheduler = static_cast<StageScheduler*>(context);
+        const auto id = static_cast<SystemIdType>(index);
+
         // 先执行 System
-        system(args...);
+        const auto& system = scheduler->graph_.FindSystem(id).system;
+        std::apply([&system](SystemArgs&... args) {
+            system(args...);
+        }, *scheduler->args_);
 
         // 将 id 放入成功队列
         {
             std::lock_guard lock(scheduler->successes_mutex_);
-            scheduler->successes_.push(id);
+            scheduler->successes_.push_back(id);
         }
 
         // 通知主线程
@@ -283,11 +869,29 @@ private:
     SystemGraphType graph_;
     mutable std::mutex graph_mutex_;
 
+    ExecutionPolicy execution_policy_{ExecutionPolicy::Automatic};
+
+    std::vector<CompletionHookType> completion_hooks_;
+
+    // 以下成员只在 Scheduler 流水线执行时使用
+    bool wait_for_previous_stage_{true};
+    std::vector<CrossStageConstraint> cross_stage_constraints_;
+
     internal::ThreadPool pool_;
 
-    std::queue<SystemIdType> successes_;
+    // 以下成员只在 ExecuteParallel 期间使用
+    SystemArgsTupleType* args_{nullptr};
+    std::vector<std::size_t> in_degrees_;
+    std::vector<SystemIdType> completed_;
+
+    std::vector<SystemIdType> successes_;
     std::condition_variable successes_condition_;
     mutable std::mutex successes_mutex_;
+
+    /// Automatic 策略下，System 数量不超过这个值时直接在调用线程上执行
+    static constexpr std::size_t inline_threshold_k = 2;
+
+    friend class Scheduler<SystemArgs...>;
 };
 
 
@@ -306,10 +910,19 @@ public:
     explicit Scheduler(const std::size_t num_threads) : num_threads_(num_threads) {
     }
 
+    Scheduler(const std::size_t num_threads, const WaitPolicy wait_policy)
+        : num_threads_(num_threads), wait_policy_(wait_policy) {
+    }
+
     [[nodiscard]] constexpr std::size_t StageCount() const {
         return schedulers_.size();
     }
 
+    /// 每个线程池的工作线程数量，WorkerLocal 和 EventChannel 的槽位数需要不小于它
+    [[nodiscard]] constexpr std::size_t ThreadCount() const noexcept {
+        return num_threads_;
+    }
+
     [[nodiscard]] constexpr bool Empty() const {
         return schedulers_.empty();
     }
@@ -330,22 +943,26 @@ public:
 
     constexpr StageIdType AddStageBefore(const StageIdType index) {
         assert(ContainsStage(index) || index == schedulers_.size());
+        pipeline_dirty_ = true;
         schedulers_.emplace(schedulers_.begin() + index, MakeScheduler());
         return index;
     }
 
     constexpr StageIdType AddStageAfter(const StageIdType index) {
         assert(ContainsStage(index));
+        pipeline_dirty_ = true;
         schedulers_.emplace(schedulers_.begin() + index + 1, MakeScheduler());
         return index + 1;
     }
 
     constexpr StageIdType AddStageToFront() {
+        pipeline_dirty_ = true;
         schedulers_.emplace(schedulers_.begin(), MakeScheduler());
         return 0;
     }
 
     constexpr StageIdType AddStageToBack() {
+        pipeline_dirty_ = true;
         schedulers_.emplace_back(MakeScheduler());
         return schedulers_.size() - 1;
     }
@@ -353,22 +970,29 @@ public:
 
     constexpr void RemoveStage(const StageIdType index) {
         assert(ContainsStage(index));
+
+        // 删除其他 Stage 中来自这个 Stage 的约束
+        const auto* removed = schedulers_[index].get();
+        for (auto& scheduler : schedulers_) {
+            scheduler->RemoveCrossStageConstraintsFrom(removed);
+        }
+
         schedulers_.erase(schedulers_.begin() + index);
+        pipeline_dirty_ = true;
     }
 
-    constexpr StageSystemIdType AddSystemToStage(const StageIdType index, const SystemType& system) {
-        const auto id = GetScheduler(index).AddSystem(system);
+    constexpr StageSystemIdType AddSystemToStage(const StageIdType index, SystemType system) {
+        const auto id = GetScheduler(index).AddSystem(std::move(system));
+        pipeline_dirty_ = true;
         return {index, id};
     }
 
-    constexpr StageSystemIdType AddSystemToFirstStage(const SystemType& system) {
-        const auto index = GetFirstStage();
-        const auto id = GetScheduler(index).AddSystem(system);
-        return {index, id};
+    constexpr StageSystemIdType AddSystemToFirstStage(SystemType system) {
+        return AddSystemToStage(GetFirstStage(), std::move(system));
     }
 
-    constexpr Scheduler& AddSystemToFirstStageV(const SystemType& system) {
-        AddSystemToFirstStage(system);
+    constexpr Scheduler& AddSystemToFirstStageV(SystemType system) {
+        AddSystemToFirstStage(std::move(system));
         return *this;
     }
 
@@ -377,22 +1001,63 @@ public:
     }
 
     constexpr void RemoveSystemFromStage(const StageIdType index, const SystemIdType id) {
-        GetScheduler(index).RemoveSystem(id);
+        auto& stage = GetScheduler(index);
+        stage.RemoveSystem(id);
+
+        // 删除之后的 Stage 中来自这个 System 的约束
+        for (auto i = index + 1; i < schedulers_.size(); ++i) {
+            schedulers_[i]->RemoveCrossStageConstraintsFrom(&stage, id);
+        }
+
+        pipeline_dirty_ = true;
     }
 
     constexpr void AddConstraintToStage(const StageIdType index, const SystemIdType from_id, const SystemIdType to_id) {
         GetScheduler(index).AddConstraint(from_id, to_id);
+        pipeline_dirty_ = true;
     }
 
+    /// 添加约束，两个 System 可以在不同的 Stage 中，但是 from 所在的 Stage 不能在 to 之后
+    ///
+    /// 跨 Stage 的约束只在流水线执行时有意义，否则 Stage 之间本来就是完全串行的
     constexpr void AddConstraint(const StageSystemIdType from_id, const StageSystemIdType to_id) {
-        assert(from_id.first == to_id.first);
-        const auto index = from_id.first;
-        AddConstraintToStage(index, from_id.second, to_id.second);
+        if (from_id.first == to_id.first) {
+            AddConstraintToStage(from_id.first, from_id.second, to_id.second);
+            return;
+        }
+
+        const auto constraint = MakeCrossStageConstraint(from_id, to_id);
+        GetScheduler(to_id.first).AddCrossStageConstraint(constraint);
+        pipeline_dirty_ = true;
+    }
+
+    constexpr void RemoveConstraint(const StageSystemIdType from_id, const StageSystemIdType to_id) {
+        if (from_id.first == to_id.first) {
+            RemoveConstraintFromStage(from_id.first, from_id.second, to_id.second);
+            return;
+        }
+
+        const auto constraint = MakeCrossStageConstraint(from_id, to_id);
+        GetScheduler(to_id.first).RemoveCrossStageConstraint(constraint);
+        pipeline_dirty_ = true;
+    }
+
+    [[nodiscard]] constexpr bool ContainsConstraint(const StageSystemIdType from_id,
+                                                    const StageSystemIdType to_id) const {
+        if (from_id.first == to_id.first) {
+            return ContainsConstraintInStage(from_id.first, from_id.second, to_id.second);
+        }
+        if (from_id.first > to_id.first) return false;
+
+        return GetScheduler(to_id.first).ContainsCrossStageConstraint({
+            &GetScheduler(from_id.first), from_id.second, to_id.second
+        });
     }
 
     constexpr void RemoveConstraintFromStage(const StageIdType index, const SystemIdType from_id,
                                              const SystemIdType to_id) {
         GetScheduler(index).RemoveConstraint(from_id, to_id);
+        pipeline_dirty_ = true;
     }
 
     constexpr bool ContainsConstraintInStage(const StageIdType index, const SystemIdType from_id,
@@ -400,9 +1065,128 @@ public:
         return GetScheduler(index).ContainsConstraint(from_id, to_id);
     }
 
+    constexpr void SetStageExecutionPolicy(const StageIdType index, const ExecutionPolicy policy) {
+        GetScheduler(index).SetExecutionPolicy(policy);
+    }
+
+    [[nodiscard]] constexpr ExecutionPolicy GetStageExecutionPolicy(const StageIdType index) const {
+        return GetScheduler(index).GetExecutionPolicy();
+    }
+
+    /// 见 StageScheduler::AddCompletionHook，流水线执行时所有 Stage 的完成函数在最后按 Stage 的顺序调用
+    void AddStageCompletionHook(const StageIdType index, typename StageSchedulerType::CompletionHookType hook) {
+        GetScheduler(index).AddCompletionHook(std::move(hook));
+    }
+
+    /// 流水线执行：把所有 Stage 合并成一个 DAG 一起执行，而不是一个 Stage 执行完再执行下一个
+    ///
+    /// 默认每个 Stage 仍然会等待上一个 Stage 全部完成（只是不再等线程池空闲），
+    /// 对某个 Stage 关闭 SetStageWaitForPreviousStage 之后，它只等待跨 Stage 的约束，可以提前开始
+    [[nodiscard]] constexpr bool IsPipelined() const {
+        return pipelined_;
+    }
+
+    constexpr void SetPipelined(const bool pipelined) {
+        pipelined_ = pipelined;
+    }
+
+    constexpr void SetStageWaitForPreviousStage(const StageIdType index, const bool wait) {
+        GetScheduler(index).SetWaitForPreviousStage(wait);
+        pipeline_dirty_ = true;
+    }
+
+    [[nodiscard]] constexpr bool GetStageWaitForPreviousStage(const StageIdType index) const {
+        return GetScheduler(index).GetWaitForPreviousStage();
+    }
+
+    /// 修改所有 Stage 的等待策略，之后新建的 Stage 也会使用这个策略
+    void SetWaitPolicy(const WaitPolicy wait_policy) {
+        wait_policy_ = wait_policy;
+        for (auto& scheduler : schedulers_) {
+            scheduler->SetWaitPolicy(wait_policy);
+        }
+        if (pool_) {
+            pool_->SetWaitPolicy(wait_policy);
+        }
+    }
+
+    void SetStageWaitPolicy(const StageIdType index, const WaitPolicy wait_policy) {
+        GetScheduler(index).SetWaitPolicy(wait_policy);
+    }
+
+    /// 修改所有 Stage 的工作线程选项，之后新建的 Stage 也会使用这个选项
+    void SetWorkerOptions(const WorkerOptions& worker_options) {
+        worker_options_ = worker_options;
+        for (auto& scheduler : schedulers_) {
+            scheduler->SetWorkerOptions(worker_options);
+        }
+        if (pool_) {
+            pool_->SetWorkerOptions(worker_options);
+        }
+    }
+
+    void SetStageWorkerOptions(const StageIdType index, WorkerOptions worker_options) {
+        GetScheduler(index).SetWorkerOptions(std::move(worker_options));
+    }
+
+    [[nodiscard]] bool AreStageWorkersHot(const StageIdType index) const noexcept {
+        return GetScheduler(index).AreWorkersHot();
+    }
+
+    /// 在一帧开始时调用，让接下来要用到的工作线程保持活跃
+    ///
+    /// 不会让所有线程池同时保持活跃，否则空闲的线程会和正在工作的线程争抢 CPU。
+    /// 逐个执行 Stage 时，只有正在执行的 Stage 和下一个会并行执行的 Stage 的线程池是活跃的，
+    /// 执行完的 Stage 立即休眠；流水线执行时只有共用的线程池是活跃的
+    void KeepWorkersHot() {
+        keep_hot_ = true;
+        if (pipelined_) {
+            GetSharedThreadPool().KeepHot();
+        } else {
+            WarmNextParallelStage(0);
+        }
+    }
+
+    /// 在一帧结束时调用，让所有 Stage 的工作线程可以休眠
+    void ParkWorkers() {
+        keep_hot_ = false;
+        for (auto& scheduler : schedulers_) {
+            scheduler->ParkWorkers();
+        }
+        if (pool_) {
+            pool_->Park();
+        }
+    }
+
+    /// 流水线执行和命令执行共用的线程池，第一次使用时创建
+    ///
+    /// 不能在 Execute 的过程中调用
+    internal::ThreadPool& GetSharedThreadPool() {
+        if (!pool_) {
+            pool_ = std::make_unique<internal::ThreadPool>(num_threads_, wait_policy_, worker_options_);
+        } else if (pool_->IsStopped()) {
+            pool_->Restart();
+        }
+        return *pool_;
+    }
+
+    /// 在 Execute 之后执行命令时借用的线程池，不会为此新建线程，没有 Stage 时返回 nullptr
+    ///
+    /// 流水线执行时是共用的线程池，否则是最后一个 Stage 的线程池，它的工作线程刚刚执行完 System。
+    /// 不能在 Execute 的过程中调用
+    internal::ThreadPool* GetCommandThreadPool() {
+        if (pipelined_) {
+            return &GetSharedThreadPool();
+        }
+        if (schedulers_.empty()) {
+            return nullptr;
+        }
+        return &schedulers_.back()->GetThreadPool();
+    }
+
     [[nodiscard]] constexpr bool CheckCycle() const {
         for (const auto& scheduler : schedulers_) {
-            if (scheduler.CheckCycle()) {
+            if (scheduler->CheckCycle()) {
                 return true;
             }
         }
@@ -410,12 +1194,232 @@ public:
     }
 
     constexpr void Execute(SystemArgs... args) {
-        for (auto& scheduler : schedulers_) {
-            scheduler->Execute(args...);
+        if (pipelined_) {
+            ExecutePipelined(args...);
+            return;
+        }
+
+        if (keep_hot_) {
+            WarmNextParallelStage(0);
+        }
+
+        for (StageIdType index = 0; index < schedulers_.size(); ++index) {
+            if (keep_hot_) {
+                WarmNextParallelStage(index + 1);
+            }
+
+            schedulers_[index]->Execute(args...);
+
+            if (keep_hot_) {
+                schedulers_[index]->ParkWorkers();
+            }
         }
     }
 
 private:
+    /// 让 first 之后第一个会并行执行的 Stage 的线程池保持活跃
+    void WarmNextParallelStage(const StageIdType first) {
+        for (auto index = first; index < schedulers_.size(); ++index) {
+            if (schedulers_[index]->WillExecuteParallel()) {
+                schedulers_[index]->KeepWorkersHot();
+                return;
+            }
+        }
+    }
+
+    using CrossStageConstraintType = typename StageSchedulerType::CrossStageConstraint;
+    using SystemArgsTupleType = typename StageSchedulerType::SystemArgsTupleType;
+
+    /// 合并之后的 DAG 节点，system 为空时表示 Stage 之间的屏障节点或者已经删除的 System
+    struct PipelineNode {
+        const SystemType* system{nullptr};
+        bool alive{false};
+        std::size_t in_degree{0};
+        std::vector<std::size_t> tos{};
+    };
+
+    CrossStageConstraintType MakeCrossStageConstraint(const StageSystemIdType from_id,
+                                                      const StageSystemIdType to_id) const {
+        if (from_id.first > to_id.first) {
+            throw std::runtime_error("Constraint from a later stage to an earlier stage is not allowed");
+        }
+
+        const auto& from_stage = GetScheduler(from_id.first);
+        const auto& to_stage = GetScheduler(to_id.first);
+        if (!from_stage.ContainsSystem(from_id.second) || !to_stage.ContainsSystem(to_id.second)) {
+            throw std::runtime_error("System not found");
+        }
+
+        return {&from_stage, from_id.second, to_id.second};
+    }
+
+    /// 合并所有 Stage 的图，调用者需要持有所有 Stage 的 graph_mutex_
+    void BuildPipeline() {
+        pipeline_.clear();
+        stage_offsets_.clear();
+
+        std::unordered_map<const StageSchedulerType*, std::size_t> stage_offset_of;
+
+        // 最近的一个屏障，以及它还没有覆盖到的第一个 Stage
+        // 屏障之前的 Stage 都已经在它之前完成，之后不等待的 Stage 需要由下一个屏障等待
+        std::optional<std::size_t> previous_barrier;
+        std::size_t first_uncovered_stage = 0;
+
+        for (std::size_t stage_index = 0; stage_index < schedulers_.size(); ++stage_index) {
+            const auto& stage = *schedulers_[stage_index];
+            const auto& graph = stage.graph_;
+            const auto& nodes = graph.nodes();
+
+            // 屏障节点：上一个屏障，以及它之后每个 Stage 的所有汇点 -> 屏障 -> 这个 Stage 的所有源点
+            // 这样即使中间有不等待的 Stage 或者空的 Stage，这个 Stage 也在之前所有的 Stage 之后执行
+            std::optional<std::size_t> barrier;
+            if (stage_index > 0 && stage.wait_for_previous_stage_) {
+                barrier = pipeline_.size();
+                pipeline_.push_back({.alive = true});
+
+                if (previous_barrier) {
+                    pipeline_[*previous_barrier].tos.push_back(*barrier);
+                }
+
+                for (auto previous = first_uncovered_stage; previous < stage_index; ++previous) {
+                    const auto previous_offset = stage_offsets_[previous];
+                    const auto& previous_graph = schedulers_[previous]->graph_;
+                    for (SystemIdType id = 0; id < previous_graph.nodes().size(); ++id) {
+                        if (previous_graph.ContainsSystem(id) && previous_graph.FindSystem(id).OutDegree() == 0) {
+                            pipeline_[previous_offset + id].tos.push_back(*barrier);
+                        }
+                    }
+                }
+
+                previous_barrier = barrier;
+                first_uncovered_stage = stage_index;
+            }
+
+            const auto offset = pipeline_.size();
+            stage_offsets_.push_back(offset);
+            stage_offset_of[&stage] = offset;
+            pipeline_.resize(offset + nodes.size());
+
+            for (SystemIdType id = 0; id < nodes.size(); ++id) {
+                if (!graph.ContainsSystem(id)) continue;
+
+                auto& node = pipeline_[offset + id];
+                node.system = &nodes[id].system;
+                node.alive = true;
+                for (const auto to_id : nodes[id].tos) {
+                    node.tos.push_back(offset + to_id);
+                }
+
+                if (barrier && nodes[id].InDegree() == 0) {
+                    pipeline_[*barrier].tos.push_back(offset + id);
+                }
+            }
+
+            for (const auto& constraint : stage.cross_stage_constraints_) {
+                pipeline_[stage_offset_of.at(constraint.from_stage) + constraint.from_id].tos.push_back(
+                    offset + constraint.to_id);
+            }
+        }
+
+        for (const auto& node : pipeline_) {
+            for (const auto to : node.tos) {
+                ++pipeline_[to].in_degree;
+            }
+        }
+
+        pipeline_dirty_ = false;
+    }
+
+    void ExecutePipelined(SystemArgs&... args) {
+        // 执行期间锁住所有 Stage 的图
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(schedulers_.size());
+        for (const auto& scheduler : schedulers_) {
+            locks.emplace_back(scheduler->graph_mutex_);
+            if (scheduler->graph_.CheckCycle()) {
+                throw std::runtime_error("Cycle detected in SystemGraph");
+            }
+        }
+
+        if (pipeline_dirty_) {
+            BuildPipeline();
+        }
+
+        GetSharedThreadPool();
+
+        SystemArgsTupleType args_tuple(args...);
+        args_ = &args_tuple;
+
+        in_degrees_.resize(pipeline_.size());
+        pending_ = 0;
+        for (std::size_t index = 0; index < pipeline_.size(); ++index) {
+            in_degrees_[index] = pipeline_[index].in_degree;
+            if (pipeline_[index].alive) ++pending_;
+        }
+
+        for (std::size_t index = 0; index < pipeline_.size(); ++index) {
+            if (pipeline_[index].alive && in_degrees_[index] == 0) {
+                Ready(index);
+            }
+        }
+
+        // 等待所有 System 执行完毕
+        while (pending_ > 0) {
+            {
+                std::unique_lock lock(successes_mutex_);
+                successes_condition_.wait(lock, [this] {
+                    return !successes_.empty();
+                });
+                completed_.swap(successes_);
+            }
+
+            for (const auto index : completed_) {
+                Complete(index);
+            }
+            completed_.clear();
+        }
+
+        args_ = nullptr;
+
+        for (const auto& scheduler : schedulers_) {
+            scheduler->RunCompletionHooks();
+        }
+    }
+
+    /// 节点的所有前驱都完成了，屏障节点直接在当前线程完成，System 交给线程池
+    void Ready(const std::size_t index) {
+        if (pipeline_[index].system) {
+            pool_->Submit({RunPipelineSystem, this, index});
+        } else {
+            Complete(index);
+        }
+    }
+
+    void Complete(const std::size_t index) {
+        --pending_;
+        for (const auto to : pipeline_[index].tos) {
+            if (--in_degrees_[to] == 0) {
+                Ready(to);
+            }
+        }
+    }
+
+    static void RunPipelineSystem(void* context, const std::size_t index) {
+        auto* scheduler = static_cast<Scheduler*>(context);
+
+        const auto& system = *scheduler->pipeline_[index].system;
+        std::apply([&system](SystemArgs&... args) {
+            system(args...);
+        }, *scheduler->args_);
+
+        {
+            std::lock_guard lock(scheduler->successes_mutex_);
+            scheduler->successes_.push_back(index);
+        }
+
+        scheduler->successes_condition_.notify_one();
+    }
+
     const StageSchedulerType& GetScheduler(const StageIdType index) const {
         assert(ContainsStage(index));
         return *schedulers_[index];
@@ -427,12 +1431,38 @@ private:
     }
 
     std::unique_ptr<StageSchedulerType> MakeScheduler() {
-        return std::make_unique<StageSchedulerType>(num_threads_);
+        auto scheduler = std::make_unique<StageSchedulerType>(num_threads_);
+        scheduler->SetWaitPolicy(wait_policy_);
+        if (!worker_options_.cpus.empty() || !worker_options_.name_prefix.empty()) {
+            scheduler->SetWorkerOptions(worker_options_);
+        }
+        return scheduler;
     }
 
 private:
     std::vector<std::unique_ptr<StageSchedulerType>> schedulers_;
     const std::size_t num_threads_;
+    WaitPolicy wait_policy_{};
+    WorkerOptions worker_options_{};
+
+    // KeepWorkersHot 和 ParkWorkers 之间为 true
+    bool keep_hot_{false};
+
+    // 以下成员只在流水线执行时使用，线程池在第一次流水线执行时才创建
+    bool pipelined_{false};
+    bool pipeline_dirty_{true};
+    std::vector<PipelineNode> pipeline_;
+    std::vector<std::size_t> stage_offsets_;
+    std::unique_ptr<internal::ThreadPool> pool_;
+
+    SystemArgsTupleType* args_{nullptr};
+    std::vector<std::size_t> in_degrees_;
+    std::size_t pending_{0};
+    std::vector<std::size_t> completed_;
+
+    std::vector<std::size_t> successes_;
+    std::condition_variable successes_condition_;
+    std::mutex successes_mutex_;
 };
 } // namespace ecs
 
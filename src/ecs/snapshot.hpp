@@ -0,0 +1,666 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "registry.hpp"
+
+namespace ecs {
+namespace internal {
+/// 快照的文件头
+///
+/// 文件头之后依次是空闲列表、所有实体，然后是每个 Storage 的 SnapshotStorageHeader、
+/// 值表（只有共享组件有）、sparse_、entity_packed_、component_packed_。每一块都按 snapshot_alignment_k 对齐，
+/// 所有数值都使用本机字节序
+struct SnapshotHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t entity_size;
+    std::uint32_t reserved;
+    std::uint64_t next_entity;
+    std::uint64_t free_list_size;
+    std::uint64_t entity_count;
+    std::uint64_t storage_count;
+};
+
+struct SnapshotStorageHeader {
+    std::uint64_t type_id;
+    std::uint64_t component_size;
+    std::uint64_t sparse_size;
+    std::uint64_t count;
+    std::uint64_t value_size;
+    std::uint64_t value_count;
+};
+
+/// 增量快照的文件头
+///
+/// 文件头之后依次是销毁的实体、新建的实体、空闲列表从 free_list_low_water 开始的部分，
+/// 然后是每个有变化的 Storage 的 DeltaStorageHeader、值表从 value_first 开始新增的值、
+/// 变化的块的下标、sparse_ 中变化的块、packed 数组中变化的块（先实体后组件）。对齐方式和完整的快照相同
+struct DeltaSnapshotHeader {
+    char magic[4];
+    std::uint32_t version;
+    std::uint32_t entity_size;
+    std::uint32_t reserved;
+    std::uint64_t next_entity;
+    std::uint64_t destroyed_count;
+    std::uint64_t created_count;
+    std::uint64_t free_list_low_water;
+    std::uint64_t free_list_size;
+    std::uint64_t storage_count;
+};
+
+struct DeltaStorageHeader {
+    std::uint64_t type_id;
+    std::uint64_t component_size;
+    std::uint64_t sparse_size;
+    std::uint64_t count;
+    std::uint64_t sparse_block_count;
+    std::uint64_t packed_block_count;
+    std::uint64_t value_size;
+    std::uint64_t value_first;
+    std::uint64_t value_count;
+};
+
+inline constexpr char snapshot_magic_k[4] = {'E', 'C', 'S', 'S'};
+inline constexpr char delta_snapshot_magic_k[4] = {'E', 'C', 'S', 'D'};
+inline constexpr std::uint32_t snapshot_version_k = 2;
+
+/// 每一块数据的对齐，对齐到缓存行，直接映射文件时组件数组也是对齐的
+inline constexpr std::size_t snapshot_alignment_k = 64;
+
+constexpr std::size_t AlignSnapshotOffset(const std::size_t offset) noexcept {
+    return (offset + snapshot_alignment_k - 1) / snapshot_alignment_k * snapshot_alignment_k;
+}
+
+/// 只读的文件映射，不支持 mmap 的平台上退化为把整个文件读进内存
+class MappedFile {
+public:
+    explicit MappedFile(const std::filesystem::path& path) {
+#if defined(__unix__) || defined(__APPLE__)
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("MappedFile: Cannot open file");
+        }
+
+        struct stat status{};
+        if (::fstat(fd, &status) != 0) {
+            ::close(fd);
+            throw std::runtime_error("MappedFile: Cannot stat file");
+        }
+
+        size_ = static_cast<std::size_t>(status.st_size);
+        if (size_ > 0) {
+            void* address = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (address == MAP_FAILED) {
+                ::close(fd);
+                throw std::runtime_error("MappedFile: Cannot map file");
+            }
+
+            // 恢复时是从头到尾顺序读取的
+            ::madvise(address, size_, MADV_SEQUENTIAL);
+            data_ = static_cast<const std::byte*>(address);
+        }
+        ::close(fd);
+#else
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file) {
+            throw std::runtime_error("MappedFile: Cannot open file");
+        }
+
+        buffer_.resize(static_cast<std::size_t>(file.tellg()));
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(buffer_.data()), static_cast<std::streamsize>(buffer_.size()));
+        data_ = buffer_.data();
+        size_ = buffer_.size();
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (data_) {
+            ::munmap(const_cast<std::byte*>(data_), size_);
+        }
+#endif
+    }
+
+    [[nodiscard]] std::span<const std::byte> Data() const noexcept {
+        return {data_, size_};
+    }
+
+private:
+    const std::byte* data_{nullptr};
+    std::size_t size_{0};
+
+#if !(defined(__unix__) || defined(__APPLE__))
+    std::vector<std::byte> buffer_;
+#endif
+};
+} // namespace internal
+
+
+/// Registry 的二进制快照
+///
+/// 每个 Storage 的 sparse_、entity_packed_、component_packed_ 都原样写成对齐的数据块，
+/// 恢复时每个数组只需要一次拷贝，不需要重新执行 startup 的 System。
+/// 快照中只有组件的类型 id，所以恢复之前需要注册其中出现的所有组件类型，
+/// 共享组件用 RegisterSharedComponent 注册，它的值表和句柄一起保存；
+/// 运行时类型的组件用它的 ComponentDescriptor 注册。
+///
+/// 打开 Registry 的变化记录之后，还可以生成增量快照，只包含上一次快照之后变化过的实体和块，
+/// 恢复时先加载完整的快照，再按顺序应用增量快照
+template <AllowedEntityType Entity>
+class Snapshot {
+public:
+    using RegistryType = Registry<Entity>;
+    using BasicStorageType = BasicStorage<Entity>;
+    using ComponentDescriptorType = ComponentDescriptor<Entity>;
+
+    using EntityTraits = EntityTraits<Entity>;
+
+    using EntityOriginalType = typename EntityTraits::OriginalType;
+    using EntityIdType = typename EntityTraits::IdType;
+    using EntityUnderlyingType = typename EntityTraits::UnderlyingType;
+
+private:
+    struct ComponentInfo {
+        ComponentDescriptorType descriptor;
+        std::size_t value_size;
+    };
+
+public:
+    template <AllowedComponentType Component>
+    Snapshot& RegisterComponent() {
+        components_[GetTypeId<Component>()] = {
+            {
+                GetTypeId<Component>(), sizeof(Component), alignof(Component), {},
+                &RegistryType::template MakeStorage<Component>
+            },
+            0
+        };
+        return *this;
+    }
+
+    /// 按描述注册，运行时类型的组件恢复到 RuntimeStorage 中
+    Snapshot& RegisterComponent(const ComponentDescriptorType& descriptor) {
+        components_[descriptor.type_id] = {descriptor, 0};
+        return *this;
+    }
+
+    /// 注册 Shared<Component>，恢复时创建 SharedStorage
+    template <AllowedComponentType Component>
+    Snapshot& RegisterSharedComponent() {
+        using SharedStorageType = SharedStorage<Entity, Component>;
+
+        using HandleType = typename SharedStorageType::HandleType;
+
+        components_[GetTypeId<Shared<Component>>()] = {
+            {
+                GetTypeId<Shared<Component>>(), sizeof(HandleType), alignof(HandleType), {},
+                &RegistryType::template MakeSharedStorage<Component>
+            },
+            sizeof(Component)
+        };
+        return *this;
+    }
+
+    /// 把 registry 写进 out，预留但还没有 Flush 的实体不会被保存
+    static void Save(const RegistryType& registry, std::ostream& out) {
+        std::vector<EntityOriginalType> entities;
+        entities.reserve(registry.EntityCount());
+        for (auto it = registry.EntityToComponentsBegin(); it != registry.EntityToComponentsEnd(); ++it) {
+            entities.push_back(it->first);
+        }
+        const auto& free_list = registry.FreeList();
+
+        const internal::SnapshotHeader header{
+            {
+                internal::snapshot_magic_k[0], internal::snapshot_magic_k[1],
+                internal::snapshot_magic_k[2], internal::snapshot_magic_k[3]
+            },
+            internal::snapshot_version_k,
+            sizeof(EntityUnderlyingType),
+            0,
+            static_cast<std::uint64_t>(registry.NextEntity()),
+            free_list.size(),
+            entities.size(),
+            registry.StorageSize()
+        };
+
+        std::size_t offset = 0;
+        WriteBlock(out, offset, &header, sizeof(header));
+        WriteBlock(out, offset, free_list.data(), free_list.size() * sizeof(EntityUnderlyingType));
+        WriteBlock(out, offset, entities.data(), entities.size() * sizeof(EntityOriginalType));
+
+        for (auto it = registry.StoragesBegin(); it != registry.StoragesEnd(); ++it) {
+            const auto& storage = *it->second;
+            const auto& sparse = storage.Sparse();
+            const auto& packed = storage.PackedEntities();
+
+            const internal::SnapshotStorageHeader storage_header{
+                static_cast<std::uint64_t>(it->first),
+                storage.ComponentSize(),
+                sparse.size(),
+                packed.size(),
+                storage.ValueSize(),
+                storage.ValueCount()
+            };
+
+            WriteBlock(out, offset, &storage_header, sizeof(storage_header));
+            WriteBlock(out, offset, storage.ValueData(), storage.ValueCount() * storage.ValueSize());
+            WriteBlock(out, offset, sparse.data(), sparse.size() * sizeof(EntityIdType));
+            WriteBlock(out, offset, packed.data(), packed.size() * sizeof(EntityOriginalType));
+            WriteBlock(out, offset, storage.ComponentData(), packed.size() * storage.ComponentSize());
+        }
+
+        if (!out) {
+            throw std::runtime_error("Snapshot::Save: Write failed");
+        }
+    }
+
+    static void Save(const RegistryType& registry, const std::filesystem::path& path) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Snapshot::Save: Cannot open file");
+        }
+        Save(registry, file);
+    }
+
+    /// 把上一次 ClearChanges 之后的变化写进 out，然后清空 registry 记录的变化
+    ///
+    /// 大小和变化的数量成正比，与 registry 的大小无关。registry 需要打开变化记录
+    static void SaveDelta(RegistryType& registry, std::ostream& out) {
+        if (!registry.IsTrackingChanges()) {
+            throw std::runtime_error("Snapshot::SaveDelta: Change tracking is disabled");
+        }
+
+        // 在这段时间内创建又销毁的实体只需要出现在销毁的列表中
+        std::vector<EntityOriginalType> created;
+        for (const auto entity : registry.CreatedEntities()) {
+            if (registry.ContainsEntity(entity)) {
+                created.push_back(entity);
+            }
+        }
+        const auto& destroyed = registry.DestroyedEntities();
+
+        const auto& free_list = registry.FreeList();
+        const auto low_water = registry.FreeListLowWater();
+
+        std::vector<const BasicStorageType*> changed;
+        std::vector<ComponentTypeId> changed_ids;
+        for (auto it = registry.StoragesBegin(); it != registry.StoragesEnd(); ++it) {
+            if (it->second->HasChanges()) {
+                changed.push_back(it->second.get());
+                changed_ids.push_back(it->first);
+            }
+        }
+
+        const internal::DeltaSnapshotHeader header{
+            {
+                internal::delta_snapshot_magic_k[0], internal::delta_snapshot_magic_k[1],
+                internal::delta_snapshot_magic_k[2], internal::delta_snapshot_magic_k[3]
+            },
+            internal::snapshot_version_k,
+            sizeof(EntityUnderlyingType),
+            0,
+            static_cast<std::uint64_t>(registry.NextEntity()),
+            destroyed.size(),
+            created.size(),
+            low_water,
+            free_list.size(),
+            changed.size()
+        };
+
+        std::size_t offset = 0;
+        WriteBlock(out, offset, &header, sizeof(header));
+        WriteBlock(out, offset, destroyed.data(), destroyed.size() * sizeof(EntityOriginalType));
+        WriteBlock(out, offset, created.data(), created.size() * sizeof(EntityOriginalType));
+        WriteBlock(out, offset, free_list.data() + low_water, (free_list.size() - low_water) * sizeof(EntityUnderlyingType));
+
+        std::vector<std::uint64_t> sparse_blocks;
+        std::vector<std::uint64_t> packed_blocks;
+        for (std::size_t i = 0; i < changed.size(); ++i) {
+            const auto& storage = *changed[i];
+            const auto& sparse = storage.Sparse();
+            const auto& packed = storage.PackedEntities();
+            const auto component_size = storage.ComponentSize();
+
+            CollectDirtyBlocks(storage.SparseDirtyBits(), sparse.size(), sparse_blocks);
+            CollectDirtyBlocks(storage.PackedDirtyBits(), packed.size(), packed_blocks);
+
+            // 只需要写上一次清空变化之后新加入的值，Compact 之后 value_first 是 0，写出整个值表
+            const auto value_size = storage.ValueSize();
+            const auto value_first = storage.ClearedValueCount();
+            const auto value_count = storage.ValueCount() - value_first;
+
+            const internal::DeltaStorageHeader storage_header{
+                static_cast<std::uint64_t>(changed_ids[i]),
+                component_size,
+                sparse.size(),
+                packed.size(),
+                sparse_blocks.size(),
+                packed_blocks.size(),
+                value_size,
+                value_first,
+                value_count
+            };
+
+            WriteBlock(out, offset, &storage_header, sizeof(storage_header));
+            WriteBlock(out, offset, storage.ValueData() + value_first * value_size, value_count * value_size);
+            WriteBlock(out, offset, sparse_blocks.data(), sparse_blocks.size() * sizeof(std::uint64_t));
+            WriteBlock(out, offset, packed_blocks.data(), packed_blocks.size() * sizeof(std::uint64_t));
+
+            for (const auto block : sparse_blocks) {
+                const auto [first, count] = BlockRange(block, sparse.size());
+                WriteBlock(out, offset, sparse.data() + first, count * sizeof(EntityIdType));
+            }
+            for (const auto block : packed_blocks) {
+                const auto [first, count] = BlockRange(block, packed.size());
+                WriteBlock(out, offset, packed.data() + first, count * sizeof(EntityOriginalType));
+                WriteBlock(out, offset, storage.ComponentData() + first * component_size, count * component_size);
+            }
+        }
+
+        if (!out) {
+            throw std::runtime_error("Snapshot::SaveDelta: Write failed");
+        }
+
+        registry.ClearChanges();
+    }
+
+    static void SaveDelta(RegistryType& registry, const std::filesystem::path& path) {
+        std::ofstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Snapshot::SaveDelta: Cannot open file");
+        }
+        SaveDelta(registry, file);
+    }
+
+    /// 在 registry 上应用一个增量快照，registry 必须正好处于生成这个增量快照之前的状态
+    void LoadDelta(const std::span<const std::byte> data, RegistryType& registry) const {
+        std::size_t offset = 0;
+
+        internal::DeltaSnapshotHeader header{};
+        std::memcpy(&header, ReadBlock(data, offset, sizeof(header)), sizeof(header));
+        if (std::memcmp(header.magic, internal::delta_snapshot_magic_k, sizeof(header.magic)) != 0 ||
+            header.version != internal::snapshot_version_k) {
+            throw std::runtime_error("Snapshot::LoadDelta: Invalid snapshot header");
+        }
+        if (header.entity_size != sizeof(EntityUnderlyingType)) {
+            throw std::runtime_error("Snapshot::LoadDelta: Entity type mismatch");
+        }
+        if (header.free_list_low_water > header.free_list_size) {
+            throw std::runtime_error("Snapshot::LoadDelta: Invalid free list");
+        }
+
+        const auto destroyed = ReadArray<EntityOriginalType>(data, offset, header.destroyed_count);
+        const auto created = ReadArray<EntityOriginalType>(data, offset, header.created_count);
+        const auto free_list_tail = ReadArray<EntityUnderlyingType>(
+            data, offset, header.free_list_size - header.free_list_low_water);
+        registry.ApplyEntityChanges(destroyed, created, header.free_list_low_water, free_list_tail,
+                                    static_cast<EntityIdType>(header.next_entity));
+
+        std::vector<EntityOriginalType> moved;
+        for (std::uint64_t i = 0; i < header.storage_count; ++i) {
+            internal::DeltaStorageHeader storage_header{};
+            std::memcpy(&storage_header, ReadBlock(data, offset, sizeof(storage_header)), sizeof(storage_header));
+
+            const auto type_id = static_cast<ComponentTypeId>(storage_header.type_id);
+            const auto& info = GetComponentInfo(type_id, storage_header.component_size, storage_header.value_size);
+
+            const auto* values = ReadValues(data, offset, storage_header.value_count, storage_header.value_size);
+            const auto sparse_blocks = ReadArray<std::uint64_t>(data, offset, storage_header.sparse_block_count);
+            const auto packed_blocks = ReadArray<std::uint64_t>(data, offset, storage_header.packed_block_count);
+
+            auto& storage = registry.GetOrCreateStorage(info.descriptor);
+
+            // 组件中的句柄可能引用新加入的值，所以先恢复值表
+            storage.AppendValues(storage_header.value_first, values, storage_header.value_count);
+            const auto& packed = storage.PackedEntities();
+
+            // 被覆盖或者被截掉的位置上原来的实体，之后要检查它们是否还有这个组件
+            moved.clear();
+            for (const auto block : packed_blocks) {
+                // 新增加的块原来没有实体
+                if (block * BasicStorageType::dirty_block_size_k >= packed.size()) continue;
+
+                const auto [first, count] = BlockRange(block, packed.size());
+                moved.insert(moved.end(), packed.begin() + first, packed.begin() + first + count);
+            }
+            if (storage_header.count < packed.size()) {
+                moved.insert(moved.end(), packed.begin() + storage_header.count, packed.end());
+            }
+
+            storage.ResizeForRestore(storage_header.sparse_size, storage_header.count);
+
+            for (const auto block : sparse_blocks) {
+                const auto [first, count] = BlockRange(block, storage_header.sparse_size);
+                storage.WriteSparse(first, ReadArray<EntityIdType>(data, offset, count));
+            }
+            for (const auto block : packed_blocks) {
+                const auto [first, count] = BlockRange(block, storage_header.count);
+                const auto entities = ReadArray<EntityOriginalType>(data, offset, count);
+                const auto* components = ReadBlock(data, offset, count * storage_header.component_size);
+                storage.WritePacked(first, entities, components);
+                registry.MarkComponentsAttached(type_id, entities);
+            }
+
+            std::erase_if(moved, [&storage](const EntityOriginalType entity) {
+                return storage.ContainsEntity(entity);
+            });
+            registry.MarkComponentsDetached(type_id, moved);
+        }
+    }
+
+    void LoadDelta(const std::filesystem::path& path, RegistryType& registry) const {
+        const internal::MappedFile file(path);
+        LoadDelta(file.Data(), registry);
+    }
+
+    /// 用快照替换 registry 中的所有内容
+    void Load(const std::span<const std::byte> data, RegistryType& registry) const {
+        std::size_t offset = 0;
+
+        internal::SnapshotHeader header{};
+        std::memcpy(&header, ReadBlock(data, offset, sizeof(header)), sizeof(header));
+        if (std::memcmp(header.magic, internal::snapshot_magic_k, sizeof(header.magic)) != 0 ||
+            header.version != internal::snapshot_version_k) {
+            throw std::runtime_error("Snapshot::Load: Invalid snapshot header");
+        }
+        if (header.entity_size != sizeof(EntityUnderlyingType)) {
+            throw std::runtime_error("Snapshot::Load: Entity type mismatch");
+        }
+
+        const auto free_list = ReadArray<EntityUnderlyingType>(data, offset, header.free_list_size);
+        const auto entities = ReadArray<EntityOriginalType>(data, offset, header.entity_count);
+
+        // 先读完并检查所有的 Storage，再修改 registry，快照有问题时 registry 保持原样
+        const std::unordered_set<EntityOriginalType> alive(entities.begin(), entities.end());
+        std::vector<StorageBlocks> storages;
+        storages.reserve(static_cast<std::size_t>(std::min<std::uint64_t>(header.storage_count, data.size())));
+        for (std::uint64_t i = 0; i < header.storage_count; ++i) {
+            internal::SnapshotStorageHeader storage_header{};
+            std::memcpy(&storage_header, ReadBlock(data, offset, sizeof(storage_header)), sizeof(storage_header));
+
+            const auto type_id = static_cast<ComponentTypeId>(storage_header.type_id);
+            const auto& info = GetComponentInfo(type_id, storage_header.component_size, storage_header.value_size);
+
+            const auto* values = ReadValues(data, offset, storage_header.value_count, storage_header.value_size);
+            const auto sparse = ReadArray<EntityIdType>(data, offset, storage_header.sparse_size);
+            const auto packed = ReadArray<EntityOriginalType>(data, offset, storage_header.count);
+            const auto* components = ReadValues(data, offset, storage_header.count, storage_header.component_size);
+
+            CheckSparseSet(sparse, packed, alive);
+            if (info.value_size != 0) {
+                CheckHandles(components, storage_header.count, storage_header.value_count);
+            }
+            storages.push_back({type_id, &info, values, storage_header.value_count, sparse, packed, components});
+        }
+
+        registry.ResetEntities(entities, free_list, static_cast<EntityIdType>(header.next_entity));
+        for (const auto& blocks : storages) {
+            auto& storage = registry.GetOrCreateStorage(blocks.info->descriptor);
+            storage.AppendValues(0, blocks.values, blocks.value_count);
+            storage.Assign(blocks.sparse, blocks.packed, blocks.components);
+            registry.MarkComponentsAttached(blocks.type_id, blocks.packed);
+        }
+    }
+
+    /// 映射快照文件并恢复，恢复的时间基本就是把文件读进内存的时间
+    void Load(const std::filesystem::path& path, RegistryType& registry) const {
+        const internal::MappedFile file(path);
+        Load(file.Data(), registry);
+    }
+
+private:
+    /// 完整快照中一个 Storage 的所有数据块，都指向快照的数据
+    struct StorageBlocks {
+        ComponentTypeId type_id;
+        const ComponentInfo* info;
+        const std::byte* values;
+        std::uint64_t value_count;
+        std::span<const EntityIdType> sparse;
+        std::span<const EntityOriginalType> packed;
+        const std::byte* components;
+    };
+
+    /// 检查 sparse 和 packed 是同一个 sparse set 的两半：每个 packed 中的实体都存在，
+    /// sparse 中它的位置正好指回它，并且 sparse 中没有其它非空的位置
+    static void CheckSparseSet(const std::span<const EntityIdType> sparse,
+                               const std::span<const EntityOriginalType> packed,
+                               const std::unordered_set<EntityOriginalType>& alive) {
+        for (std::size_t i = 0; i < packed.size(); ++i) {
+            const auto id = GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(packed[i]));
+            if (!alive.contains(packed[i]) || static_cast<std::size_t>(id) >= sparse.size() ||
+                static_cast<std::size_t>(sparse[id]) != i + 1) {
+                throw std::runtime_error("Snapshot::Load: Inconsistent storage");
+            }
+        }
+
+        const auto used = std::ranges::count_if(sparse, [](const EntityIdType index) { return index != 0; });
+        if (static_cast<std::size_t>(used) != packed.size()) {
+            throw std::runtime_error("Snapshot::Load: Inconsistent storage");
+        }
+    }
+
+    /// 共享组件的句柄都要在值表之内，否则 SharedStorage::Assign 会在 registry 被重置之后才抛出异常
+    static void CheckHandles(const std::byte* components, const std::uint64_t count, const std::uint64_t value_count) {
+        using HandleType = internal::SharedHandleType;
+
+        for (std::uint64_t i = 0; i < count; ++i) {
+            HandleType handle{};
+            std::memcpy(&handle, components + i * sizeof(HandleType), sizeof(HandleType));
+            if (handle >= value_count) {
+                throw std::runtime_error("Snapshot::Load: Invalid shared component handle");
+            }
+        }
+    }
+
+    const ComponentInfo& GetComponentInfo(const ComponentTypeId type_id, const std::uint64_t size,
+                                          const std::uint64_t value_size) const {
+        const auto it = components_.find(type_id);
+        if (it == components_.end()) {
+            throw std::runtime_error("Snapshot: Component type is not registered");
+        }
+        if (it->second.descriptor.size != size || it->second.value_size != value_size) {
+            throw std::runtime_error("Snapshot: Component size mismatch");
+        }
+        return it->second;
+    }
+
+    /// 位图中被标记的、在 size 范围之内的块
+    static void CollectDirtyBlocks(const std::vector<std::uint64_t>& bits, const std::size_t size,
+                                   std::vector<std::uint64_t>& blocks) {
+        constexpr auto block_size = BasicStorageType::dirty_block_size_k;
+
+        blocks.clear();
+        for (std::size_t word = 0; word < bits.size(); ++word) {
+            for (auto rest = bits[word]; rest != 0; rest &= rest - 1) {
+                const auto block = word * 64 + static_cast<std::size_t>(std::countr_zero(rest));
+                if (block * block_size >= size) return;
+                blocks.push_back(block);
+            }
+        }
+    }
+
+    /// 块在数组中的范围，最后一块可能不完整
+    static std::pair<std::size_t, std::size_t> BlockRange(const std::uint64_t block, const std::size_t size) {
+        constexpr auto block_size = BasicStorageType::dirty_block_size_k;
+
+        if (block >= (size + block_size - 1) / block_size) {
+            throw std::runtime_error("Snapshot: Invalid block");
+        }
+
+        const auto first = static_cast<std::size_t>(block) * block_size;
+        return {first, std::min(block_size, size - first)};
+    }
+
+    static void WriteBlock(std::ostream& out, std::size_t& offset, const void* data, const std::size_t size) {
+        static constexpr char padding[internal::snapshot_alignment_k]{};
+
+        if (size > 0) {
+            out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        }
+
+        const auto end = offset + size;
+        offset = internal::AlignSnapshotOffset(end);
+        out.write(padding, static_cast<std::streamsize>(offset - end));
+    }
+
+    static const std::byte* ReadBlock(const std::span<const std::byte> data, std::size_t& offset,
+                                      const std::size_t size) {
+        if (offset > data.size() || data.size() - offset < size) {
+            throw std::runtime_error("Snapshot::Load: Unexpected end of snapshot");
+        }
+
+        const auto* block = data.data() + offset;
+        offset = internal::AlignSnapshotOffset(offset + size);
+        return block;
+    }
+
+    /// 数据块是对齐的，映射的文件也是按页对齐的，所以可以直接当作数组使用
+    template <typename T>
+    static std::span<const T> ReadArray(const std::span<const std::byte> data, std::size_t& offset,
+                                        const std::uint64_t count) {
+        if (count > data.size() / sizeof(T)) {
+            throw std::runtime_error("Snapshot::Load: Unexpected end of snapshot");
+        }
+
+        const auto* block = ReadBlock(data, offset, count * sizeof(T));
+        return {reinterpret_cast<const T*>(block), static_cast<std::size_t>(count)};
+    }
+
+    /// 共享组件的值表，value_size 已经和注册的类型核对过
+    static const std::byte* ReadValues(const std::span<const std::byte> data, std::size_t& offset,
+                                       const std::uint64_t count, const std::uint64_t value_size) {
+        if (value_size != 0 && count > data.size() / value_size) {
+            throw std::runtime_error("Snapshot::Load: Unexpected end of snapshot");
+        }
+        return ReadBlock(data, offset, count * value_size);
+    }
+
+private:
+    std::unordered_map<ComponentTypeId, ComponentInfo> components_;
+};
+} // namespace ecs
+
+#endif // SNAPSHOT_HPP
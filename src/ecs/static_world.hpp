@@ -0,0 +1,230 @@
+#ifndef STATIC_WORLD_HPP
+#define STATIC_WORLD_HPP
+
+#include <algorithm>
+#include <array>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <vector>
+
+#include "component.hpp"
+#include "entity.hpp"
+#include "storage.hpp"
+
+namespace ecs {
+/// 组件类型在编译期全部确定的 World
+///
+/// 直接持有 std::tuple<Storage<Entity, Components>...>，查找 Storage 在编译期完成，
+/// 没有哈希表查找，也没有虚函数调用（Storage 是 final 的，通过具体类型调用可以内联）。
+/// 销毁实体时对所有已知的 Storage 展开调用 Pop。
+/// 只能使用 Components 中列出的组件，使用其他组件会在编译期报错
+template <AllowedEntityType Entity, AllowedComponentType... Components>
+class StaticWorld {
+    static_assert(!CheckDuplicateComponents<Components...>(), "StaticWorld: Duplicate components");
+
+public:
+    using EntityTraits = EntityTraits<Entity>;
+
+    using EntityOriginalType = typename EntityTraits::OriginalType;
+    using EntityIdType = typename EntityTraits::IdType;
+    using EntityUnderlyingType = typename EntityTraits::UnderlyingType;
+
+    using BasicStorageType = BasicStorage<Entity>;
+
+    template <AllowedComponentType Component>
+    using StorageType = Storage<Entity, Component>;
+
+    using StoragesType = std::tuple<StorageType<Components>...>;
+
+    /// Component 是否是这个 World 中的组件
+    template <typename Component>
+    static constexpr bool has_component_k = (std::is_same_v<Component, Components> || ...);
+
+    static constexpr std::size_t component_count_k = sizeof...(Components);
+
+    StaticWorld() = default;
+
+    StaticWorld(const StaticWorld&) = delete;
+    StaticWorld& operator=(const StaticWorld&) = delete;
+
+    StaticWorld(StaticWorld&&) noexcept = default;
+    StaticWorld& operator=(StaticWorld&&) noexcept = default;
+
+    ~StaticWorld() = default;
+
+    EntityOriginalType CreateEntity() {
+        if (free_list_.empty()) {
+            free_list_.push_back(MakeEntityUnderlying<EntityOriginalType>(next_entity_, 0));
+            ++next_entity_;
+        }
+
+        const auto underlying = free_list_.back();
+        free_list_.pop_back();
+
+        const auto id = GetId<EntityOriginalType>(underlying);
+        if (id >= entities_.size()) {
+            entities_.resize(id + 1, NullEntity<EntityOriginalType>());
+        }
+        entities_[id] = underlying;
+        ++entity_count_;
+
+        return ToOriginal<EntityOriginalType>(underlying);
+    }
+
+    void DestroyEntity(const EntityOriginalType entity) {
+        if (!ContainsEntity(entity)) return;
+
+        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
+        const auto id = GetId<EntityOriginalType>(underlying);
+
+        std::apply([id](auto&... storages) {
+            (storages.Pop(id), ...);
+        }, storages_);
+
+        entities_[id] = NullEntity<EntityOriginalType>();
+        --entity_count_;
+        free_list_.push_back(GenNextVersion<EntityOriginalType>(underlying));
+    }
+
+    [[nodiscard]] constexpr bool ContainsEntity(const EntityOriginalType entity) const noexcept {
+        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
+        const auto id = GetId<EntityOriginalType>(underlying);
+        return id < entities_.size() && entities_[id] == underlying;
+    }
+
+    [[nodiscard]] constexpr std::size_t EntityCount() const noexcept {
+        return entity_count_;
+    }
+
+    template <AllowedComponentType Component>
+        requires has_component_k<Component>
+    [[nodiscard]] constexpr StorageType<Component>& GetStorageOfComponent() noexcept {
+        return std::get<StorageType<Component>>(storages_);
+    }
+
+    template <AllowedComponentType Component>
+        requires has_component_k<Component>
+    [[nodiscard]] constexpr const StorageType<Component>& GetStorageOfComponent() const noexcept {
+        return std::get<StorageType<Component>>(storages_);
+    }
+
+    template <AllowedComponentType Component>
+        requires has_component_k<Component>
+    void AttachComponent(const EntityOriginalType entity, Component component) {
+        if (!ContainsEntity(entity)) {
+            throw std::runtime_error("StaticWorld::AttachComponent: Entity not found");
+        }
+        GetStorageOfComponent<Component>().Upsert(entity, component);
+    }
+
+    template <AllowedComponentType... AttachedComponents>
+    void AttachComponents(const EntityOriginalType entity, AttachedComponents... components) {
+        static_assert(!CheckDuplicateComponents<AttachedComponents...>(), "Duplicate components");
+        (AttachComponent(entity, components), ...);
+    }
+
+    template <AllowedComponentType Component>
+        requires has_component_k<Component>
+    void DetachComponent(const EntityOriginalType entity) {
+        if (!ContainsEntity(entity)) return;
+        GetStorageOfComponent<Component>().Pop(ToId(entity));
+    }
+
+    template <AllowedComponentType... DetachedComponents>
+    void DetachComponents(const EntityOriginalType entity) {
+        static_assert(!CheckDuplicateComponents<DetachedComponents...>(), "Duplicate components");
+        (DetachComponent<DetachedComponents>(entity), ...);
+    }
+
+    template <AllowedComponentType Component>
+        requires has_component_k<Component>
+    [[nodiscard]] constexpr bool ContainsComponent(const EntityOriginalType entity) const {
+        return GetStorageOfComponent<Component>().ContainsEntity(entity);
+    }
+
+    template <AllowedComponentType... ContainedComponents>
+    [[nodiscard]] constexpr bool ContainsAllComponents(const EntityOriginalType entity) const {
+        return (ContainsComponent<ContainedComponents>(entity) && ...);
+    }
+
+    template <AllowedComponentType... ContainedComponents>
+    [[nodiscard]] constexpr bool ContainsAnyComponents(const EntityOriginalType entity) const {
+        return (ContainsComponent<ContainedComponents>(entity) || ...);
+    }
+
+    template <AllowedComponentType Component>
+        requires has_component_k<Component>
+    constexpr Component& GetComponentReference(const EntityOriginalType entity) {
+        auto* component = GetComponentPointer<Component>(entity);
+        if (!component) {
+            throw std::runtime_error("StaticWorld::GetComponentReference: Component not found");
+        }
+        return *component;
+    }
+
+    template <AllowedComponentType Component>
+        requires has_component_k<Component>
+    constexpr Component* GetComponentPointer(const EntityOriginalType entity) {
+        auto& storage = GetStorageOfComponent<Component>();
+        if (!storage.ContainsEntity(entity)) return nullptr;
+        return &storage.ComponentOf(ToId(entity));
+    }
+
+    template <AllowedComponentType... GotComponents>
+    constexpr std::tuple<GotComponents&...> GetComponentReferences(const EntityOriginalType entity) {
+        return std::tuple<GotComponents&...>(GetComponentReference<GotComponents>(entity)...);
+    }
+
+    template <AllowedComponentType... GotComponents>
+    constexpr std::tuple<GotComponents*...> GetComponentPointers(const EntityOriginalType entity) {
+        return std::tuple<GotComponents*...>(GetComponentPointer<GotComponents>(entity)...);
+    }
+
+    /// 对每个拥有所有 Required 组件的实体调用 function(entity, components...)
+    ///
+    /// 遍历 Required 中最小的 Storage，再检查其他 Storage 是否包含这个实体。
+    /// function 中不能挂载、卸载组件或者销毁实体
+    template <AllowedComponentType... Required, typename Function>
+    void Each(Function&& function) {
+        static_assert(sizeof...(Required) > 0, "StaticWorld::Each: Required components is empty");
+        static_assert(!CheckDuplicateComponents<Required...>(), "Duplicate components");
+
+        const std::array<const BasicStorageType*, sizeof...(Required)> storages = {
+            &GetStorageOfComponent<Required>().ToBasicStorage()...
+        };
+        const auto* smallest = *std::ranges::min_element(storages, {}, &BasicStorageType::Size);
+
+        for (const auto entity : smallest->PackedEntities()) {
+            const auto id = ToId(entity);
+            if ((GetStorageOfComponent<Required>().Contains(id) && ...)) {
+                function(entity, GetStorageOfComponent<Required>().ComponentOf(id)...);
+            }
+        }
+    }
+
+    void Reserve(const std::size_t n) {
+        entities_.reserve(n);
+        std::apply([n](auto&... storages) {
+            (storages.Reserve(n), ...);
+        }, storages_);
+    }
+
+private:
+    static constexpr EntityIdType ToId(const EntityOriginalType entity) noexcept {
+        return GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(entity));
+    }
+
+private:
+    StoragesType storages_;
+
+    // 以实体 id 为下标，存活的实体存它当前的版本，否则存空实体
+    std::vector<EntityUnderlyingType> entities_;
+    std::size_t entity_count_{0};
+
+    std::vector<EntityUnderlyingType> free_list_;
+    EntityIdType next_entity_{};
+};
+} // namespace ecs
+
+#endif // STATIC_WORLD_HPP
@@ -1,12 +1,23 @@
 #ifndef STORAGE_HPP
 #define STORAGE_HPP
 
+#include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cassert>
+#include <cstring>
+#include <limits>
 #include <memory>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "entity.hpp"
 #include "component.hpp"
+#include "index.hpp"
 
 namespace ecs {
 namespace internal {
@@ -179,20 +190,61 @@ public:
     using ConstIteratorType = internal::BasicStorageIterator<const BasicStorage>;
     using ReverseIteratorType = std::reverse_iterator<IteratorType>;
 
+    // 记录变化的位图，每一位表示一块是否被修改过
+    using DirtyBitsType = std::vector<std::uint64_t>;
+
+    // 记录变化的粒度，sparse_ 和 packed 数组每这么多个元素为一块
+    static constexpr std::size_t dirty_block_size_k = 256;
+
+    /// 组件类型的描述，每种 Storage 一个，删除组件时只用到它，不需要虚函数调用
+    struct Descriptor {
+        // 单个组件的字节数
+        std::size_t component_size;
+
+        // 去掉最后一个组件，组件已经用 memcpy 移动好了，所以只需要缩短数组
+        void (*truncate)(BasicStorage& storage) noexcept;
+    };
+
+    /// 只有建立了索引的 Storage 才有，删除组件和被记录的修改通过它通知派生类更新索引
+    ///
+    /// write 可以在多个线程中同时调用
+    struct IndexHooks {
+        void (*pop)(BasicStorage& storage, EntityIdType entity_id) noexcept;
+        void (*write)(BasicStorage& storage, EntityIdType entity_id) noexcept;
+    };
+
     BasicStorage() noexcept : sparse_(), entity_packed_() {
     }
 
     BasicStorage(const BasicStorage&) = delete;
     BasicStorage& operator=(const BasicStorage&) = delete;
 
+    /// component_data_、previous_data_ 和 index_hooks_ 由派生类在移动之后重新设置
     BasicStorage(BasicStorage&& other) noexcept : sparse_(std::move(other.sparse_)),
-                                                  entity_packed_(std::move(other.entity_packed_)) {
+                                                  entity_packed_(std::move(other.entity_packed_)),
+                                                  track_changes_(other.track_changes_),
+                                                  sparse_dirty_(std::move(other.sparse_dirty_)),
+                                                  packed_dirty_(std::move(other.packed_dirty_)),
+                                                  descriptor_(other.descriptor_),
+                                                  component_data_(other.component_data_),
+                                                  previous_data_(other.previous_data_),
+                                                  index_hooks_(other.index_hooks_),
+                                                  cleared_value_count_(other.cleared_value_count_) {
     }
 
     BasicStorage& operator=(BasicStorage&& other) noexcept {
         // 一定要检查自赋值
         if (this != &other) {
             sparse_ = std::move(other.sparse_);
+            entity_packed_ = std::move(other.entity_packed_);
+            track_changes_ = other.track_changes_;
+            sparse_dirty_ = std::move(other.sparse_dirty_);
+            packed_dirty_ = std::move(other.packed_dirty_);
+            descriptor_ = other.descriptor_;
+            component_data_ = other.component_data_;
+            previous_data_ = other.previous_data_;
+            index_hooks_ = other.index_hooks_;
+            cleared_value_count_ = other.cleared_value_count_;
         }
 
         return *this;
@@ -236,19 +288,52 @@ public:
         if (Contains(id)) {
             const auto index = sparse_[id] - 1;
             EntityOf(id) = entity;
+            MarkPackedDirty(index);
         } else {
             AssureEntity(id);
             sparse_[id] = entity_packed_.size() + 1;
+            MarkSparseDirty(id);
+            MarkPackedDirty(entity_packed_.size());
             entity_packed_.push_back(entity);
         }
     }
 
-    virtual constexpr void Pop(const EntityIdType entity_id) {
+    /// 删除一个实体，用最后一个元素填补空位
+    ///
+    /// 不是虚函数，只查找一次 sparse_，组件按 Descriptor 中的大小用 memcpy 移动，
+    /// 所以在 Registry 中销毁一个有很多组件的实体只是一串 memcpy
+    constexpr void Pop(const EntityIdType entity_id) {
         if (!Contains(entity_id)) return;
 
-        BasicStorage::SwapToBack(entity_id);
+        MarkPopDirty(entity_id);
+        if (index_hooks_) {
+            index_hooks_->pop(*this, entity_id);
+        }
+
+        const auto index = IndexOf(entity_id);
+        const auto last = entity_packed_.size() - 1;
+        if (index != last) {
+            const auto moved = entity_packed_[last];
+            const auto moved_id = GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(moved));
+
+            entity_packed_[index] = moved;
+            sparse_[moved_id] = index + 1;
+            MarkSparseDirty(moved_id);
+
+            if (descriptor_) {
+                const auto size = descriptor_->component_size;
+                std::memcpy(component_data_ + index * size, component_data_ + last * size, size);
+                if (previous_data_) {
+                    std::memcpy(previous_data_ + index * size, previous_data_ + last * size, size);
+                }
+            }
+        }
+
         entity_packed_.pop_back();
         sparse_[entity_id] = 0;
+        if (descriptor_) {
+            descriptor_->truncate(*this);
+        }
     }
 
     virtual constexpr void SwapToBack(const EntityIdType entity_id) {
@@ -269,6 +354,211 @@ public:
 
         sparse_[entity_id1] = index2 + 1;
         sparse_[entity_id2] = index1 + 1;
+
+        MarkSparseDirty(entity_id1);
+        MarkSparseDirty(entity_id2);
+        MarkPackedDirty(index1);
+        MarkPackedDirty(index2);
+    }
+
+    /// 批量插入，components 是 count 个紧密排列的组件字节，BasicStorage 本身不存组件，所以忽略它
+    virtual void UpsertRange(const EntityOriginalType* entities, [[maybe_unused]] const std::byte* components,
+                             const std::size_t count) {
+        ReserveForAppend(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            BasicStorage::Upsert(entities[i]);
+        }
+    }
+
+    /// 在末尾追加 count 个实体，它们的组件都是同一个 component，用于批量实例化预制体
+    ///
+    /// 实体必须都不在 Storage 中。只 reserve 一次，组件按块复制，不会逐个插入
+    virtual void AppendRepeated(const EntityOriginalType* entities, [[maybe_unused]] const std::byte* component,
+                                const std::size_t count) {
+        AppendEntities(entities, count);
+    }
+
+    /// 单个组件的字节数，BasicStorage 不存组件，所以是 0
+    [[nodiscard]] constexpr std::size_t ComponentSize() const noexcept {
+        return descriptor_ ? descriptor_->component_size : 0;
+    }
+
+    /// 紧密排列的组件字节，和 entity_packed_ 一一对应
+    [[nodiscard]] virtual const std::byte* ComponentData() const noexcept {
+        return nullptr;
+    }
+
+    [[nodiscard]] constexpr const SparseContainerType& Sparse() const noexcept {
+        return sparse_;
+    }
+
+    [[nodiscard]] constexpr const PackedEntityContainerType& PackedEntities() const noexcept {
+        return entity_packed_;
+    }
+
+    /// 用原始数组整体替换 Storage 的内容，每个数组只拷贝一次，用于从快照中恢复
+    ///
+    /// 调用者需要保证三个数组是某个 Storage 一致的状态
+    virtual void Assign(const std::span<const EntityIdType> sparse,
+                        const std::span<const EntityOriginalType> entities,
+                        [[maybe_unused]] const std::byte* components) {
+        sparse_.assign(sparse.begin(), sparse.end());
+        entity_packed_.assign(entities.begin(), entities.end());
+        ClearChanges();
+    }
+
+    /// 开始或停止记录修改过的块，用于增量快照
+    ///
+    /// 会记录所有经过 Storage 的修改，包括通过非 const 的 ComponentOf 和 MutableComponentOf 取得组件；
+    /// const 的 ComponentOf 只用于读取，通过迭代器直接修改组件不会被记录，需要自己调用 MarkComponentDirty
+    constexpr void SetChangeTracking(const bool enabled) {
+        track_changes_ = enabled;
+        AssurePackedDirtyBits();
+    }
+
+    [[nodiscard]] constexpr bool IsTrackingChanges() const noexcept {
+        return track_changes_;
+    }
+
+    constexpr void ClearChanges() {
+        std::fill(sparse_dirty_.begin(), sparse_dirty_.end(), 0);
+        std::fill(packed_dirty_.begin(), packed_dirty_.end(), 0);
+        AssurePackedDirtyBits();
+        cleared_value_count_ = ValueCount();
+    }
+
+    [[nodiscard]] constexpr bool HasChanges() const noexcept {
+        const auto any = [](const std::uint64_t bits) { return bits != 0; };
+        return std::ranges::any_of(sparse_dirty_, any) || std::ranges::any_of(packed_dirty_, any) ||
+            ValueCount() > cleared_value_count_;
+    }
+
+    /// 上一次 ClearChanges 时值表的长度，之后的值都是新加入的
+    ///
+    /// SharedStorage::Compact 会把它设为 0，下一个增量快照会写出整个值表
+    [[nodiscard]] constexpr std::size_t ClearedValueCount() const noexcept {
+        return cleared_value_count_;
+    }
+
+    [[nodiscard]] constexpr const DirtyBitsType& SparseDirtyBits() const noexcept {
+        return sparse_dirty_;
+    }
+
+    [[nodiscard]] constexpr const DirtyBitsType& PackedDirtyBits() const noexcept {
+        return packed_dirty_;
+    }
+
+    /// 通过迭代器修改了组件之后调用，同时会让这个组件的索引在下一次查找前更新
+    constexpr void MarkComponentDirty(const EntityIdType entity_id) {
+        MarkPackedDirty(IndexOf(entity_id));
+        if (index_hooks_) {
+            index_hooks_->write(*this, entity_id);
+        }
+    }
+
+    /// 组件的字节，用于只知道 ComponentTypeId 的地方，BasicStorage 不存组件，所以返回 nullptr
+    ///
+    /// 和非 const 的 ComponentOf 一样，记录变化时把所在的块标记为修改过，有索引时让它在下一次查找前更新，
+    /// 可以在多个线程中同时调用
+    [[nodiscard]] constexpr std::byte* ComponentBytesOf(const EntityIdType entity_id) noexcept {
+        if (!descriptor_) return nullptr;
+
+        const auto index = IndexOf(entity_id);
+        MarkPackedWritten(index);
+        if (index_hooks_) {
+            index_hooks_->write(*this, entity_id);
+        }
+        return component_data_ + index * descriptor_->component_size;
+    }
+
+    [[nodiscard]] constexpr const std::byte* ComponentBytesOf(const EntityIdType entity_id) const noexcept {
+        if (!descriptor_) return nullptr;
+        return component_data_ + IndexOf(entity_id) * descriptor_->component_size;
+    }
+
+    /// 和 MutableComponentOf 一样，记录变化时会把它标记为修改过
+    [[nodiscard]] constexpr std::byte* MutableComponentBytesOf(const EntityIdType entity_id) {
+        if (!descriptor_) return nullptr;
+
+        MarkComponentDirty(entity_id);
+        return ComponentBytesOf(entity_id);
+    }
+
+    /// 值表中每个值的字节数，只有 SharedStorage 有值表，组件数组中存的是值的句柄
+    [[nodiscard]] virtual std::size_t ValueSize() const noexcept {
+        return 0;
+    }
+
+    /// 值表的长度，没有值表时是 0
+    [[nodiscard]] virtual std::size_t ValueCount() const noexcept {
+        return 0;
+    }
+
+    /// 紧密排列的值的字节，用于保存快照
+    [[nodiscard]] virtual const std::byte* ValueData() const noexcept {
+        return nullptr;
+    }
+
+    /// 值表被重新编号的次数，句柄只在同一代之内有意义，见 SharedStorage::Compact
+    [[nodiscard]] virtual std::size_t ValueGeneration() const noexcept {
+        return 0;
+    }
+
+    /// 组件的字节是句柄时，句柄对应的值的字节，用于按值记录共享组件；没有值表时返回 nullptr
+    [[nodiscard]] virtual const std::byte* ValueBytesOf([[maybe_unused]] const std::byte* component) const {
+        return nullptr;
+    }
+
+    /// 从 first 开始用 count 个值替换值表的末尾，first 不能超过当前值表的长度，用于从快照中恢复
+    ///
+    /// 通常 first 等于当前的长度，只是追加；保存方调用过 SharedStorage::Compact 时 first 是 0，替换整个值表。
+    /// 需要在写入引用这些值的组件之前调用
+    virtual void AppendValues(const std::size_t first, [[maybe_unused]] const std::byte* values,
+                              const std::size_t count) {
+        if (first != 0 || count != 0) {
+            throw std::runtime_error("BasicStorage::AppendValues: Storage has no value table");
+        }
+    }
+
+    /// 开启或关闭双缓冲，见 Storage::SetDoubleBuffered，其他 Storage 不支持双缓冲
+    virtual void SetDoubleBuffered(const bool enabled) {
+        if (enabled) {
+            throw std::runtime_error("BasicStorage::SetDoubleBuffered: Double buffering is not supported");
+        }
+    }
+
+    [[nodiscard]] virtual bool IsDoubleBuffered() const noexcept {
+        return false;
+    }
+
+    /// 交换双缓冲组件的读写缓冲区，不是双缓冲的 Storage 什么都不做
+    virtual void SwapBuffers() noexcept {
+    }
+
+    /// 改变数组的长度，新的元素都是 0，用于应用增量快照
+    virtual void ResizeForRestore(const std::size_t sparse_size, const std::size_t count) {
+        sparse_.resize(sparse_size);
+        entity_packed_.resize(count);
+        AssurePackedDirtyBits();
+    }
+
+    /// 覆盖 sparse_ 中的一段，用于应用增量快照
+    void WriteSparse(const std::size_t first, const std::span<const EntityIdType> sparse) {
+        std::copy(sparse.begin(), sparse.end(), sparse_.begin() + first);
+    }
+
+    /// 覆盖 packed 数组中的一段，用于应用增量快照
+    virtual void WritePacked(const std::size_t first, const std::span<const EntityOriginalType> entities,
+                             [[maybe_unused]] const std::byte* components) {
+        std::copy(entities.begin(), entities.end(), entity_packed_.begin() + first);
+    }
+
+    /// 保证还能再放下 n 个元素，按倍数增长，避免每帧都精确 reserve 导致反复搬迁
+    constexpr void ReserveForAppend(const std::size_t n) {
+        const auto required = Size() + n;
+        if (required > Capacity()) {
+            Reserve(std::max(required, Capacity() * 2));
+        }
     }
 
     constexpr void AssureEntity(const EntityIdType entity_id) {
@@ -321,6 +611,10 @@ public:
         return ReverseIteratorType(this, entity_packed_.size());
     }
 
+protected:
+    explicit BasicStorage(const Descriptor* descriptor) noexcept : descriptor_(descriptor) {
+    }
+
 private:
     friend struct internal::StorageIterator<BasicStorage, void>;
 
@@ -331,15 +625,111 @@ private:
     friend ReverseIteratorType rbegin(BasicStorage& storage) noexcept { return storage.ReverseBegin(); }
     friend ReverseIteratorType rend(BasicStorage& storage) noexcept { return storage.ReverseEnd(); }
 
+protected:
+    constexpr void MarkSparseDirty(const EntityIdType entity_id) {
+        MarkDirty(sparse_dirty_, entity_id);
+    }
+
+    constexpr void MarkPackedDirty(const std::size_t index) {
+        MarkDirty(packed_dirty_, index);
+    }
+
+    /// 和 MarkPackedDirty 一样，但是只原子地设置一位，不会改变位图的大小，所以可以在多个线程中同时调用，
+    /// 用于取得可写的组件引用。记录变化时位图总是能放下所有的元素，见 AssurePackedDirtyBits
+    void MarkPackedWritten(const std::size_t index) noexcept {
+        if (!track_changes_) return;
+
+        const auto block = index / dirty_block_size_k;
+        assert(block / 64 < packed_dirty_.size());
+
+        const std::atomic_ref bits(packed_dirty_[block / 64]);
+        const auto bit = std::uint64_t{1} << (block % 64);
+        if ((bits.load(std::memory_order_relaxed) & bit) == 0) {
+            bits.fetch_or(bit, std::memory_order_relaxed);
+        }
+    }
+
+    /// 只追加实体，组件由派生类自己追加
+    constexpr void AppendEntities(const EntityOriginalType* entities, const std::size_t count) {
+        ReserveForAppend(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            const auto id = GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(entities[i]));
+            assert(!Contains(id));
+
+            AssureEntity(id);
+            sparse_[id] = entity_packed_.size() + 1;
+            MarkSparseDirty(id);
+            MarkPackedDirty(entity_packed_.size());
+            entity_packed_.push_back(entities[i]);
+        }
+    }
+
+    constexpr void MarkAllPackedDirty() {
+        if (!track_changes_ || entity_packed_.empty()) return;
+        MarkPackedDirty(entity_packed_.size() - 1);
+        for (auto& bits : packed_dirty_) {
+            bits = ~std::uint64_t{0};
+        }
+    }
+
+    /// 删除时被移动的两个位置
+    constexpr void MarkPopDirty(const EntityIdType entity_id) {
+        if (!track_changes_) return;
+
+        MarkSparseDirty(entity_id);
+        MarkPackedDirty(IndexOf(entity_id));
+        MarkPackedDirty(entity_packed_.size() - 1);
+    }
+
+private:
+    /// 追加元素时都会标记新的位置，只有开始记录、整体替换和改变长度之后需要补齐位图
+    constexpr void AssurePackedDirtyBits() {
+        if (!track_changes_) return;
+
+        const auto words = (entity_packed_.size() + dirty_block_size_k * 64 - 1) / (dirty_block_size_k * 64);
+        if (packed_dirty_.size() < words) {
+            packed_dirty_.resize(words);
+        }
+    }
+
+    constexpr void MarkDirty(DirtyBitsType& bits, const std::size_t index) {
+        if (!track_changes_) return;
+
+        const auto block = index / dirty_block_size_k;
+        const auto word = block / 64;
+        if (word >= bits.size()) {
+            bits.resize(word + 1);
+        }
+        bits[word] |= std::uint64_t{1} << (block % 64);
+    }
+
 protected:
     SparseContainerType sparse_;
     PackedEntityContainerType entity_packed_;
+
+    bool track_changes_{false};
+    DirtyBitsType sparse_dirty_;
+    DirtyBitsType packed_dirty_;
+
+    // 组件的描述和组件数组的起点，由 Storage 在数组可能重新分配之后更新
+    const Descriptor* descriptor_{nullptr};
+    std::byte* component_data_{nullptr};
+    std::byte* previous_data_{nullptr};
+
+    // 没有索引时为空，删除组件时只多一次判空
+    const IndexHooks* index_hooks_{nullptr};
+
+    // 见 ClearedValueCount
+    std::size_t cleared_value_count_{0};
 };
 
 /// 使用稀疏集合存储组件
 template <AllowedEntityType Entity, AllowedComponentType Component>
 class Storage final : public BasicStorage<Entity> {
 public:
+    static_assert(!is_shared_component_k<Component>,
+                  "Storage: Shared<T> is stored in SharedStorage, use Registry::AttachSharedComponent");
+
     // 基类，定义在这里是为了方便使用其中的类型
     using BasicStorageType = BasicStorage<Entity>;
 
@@ -368,14 +758,23 @@ public:
     using BasicConstIteratorType = typename BasicStorageType::ConstIteratorType;
     using BasicReverseIteratorType = typename BasicStorageType::ReverseIteratorType;
 
-    Storage() noexcept : BasicStorageType(), component_packed_() {
+    Storage() noexcept : BasicStorageType(&descriptor_k), component_packed_() {
     }
 
     Storage(const Storage&) = delete;
     Storage& operator=(const Storage&) = delete;
 
     Storage(Storage&& other) noexcept : BasicStorageType(std::move(other)),
-                                        component_packed_(std::move(other.component_packed_)) {
+                                        component_packed_(std::move(other.component_packed_)),
+                                        double_buffered_(other.double_buffered_),
+                                        previous_packed_(std::move(other.previous_packed_)),
+                                        indices_(std::move(other.indices_)),
+                                        stale_bits_(std::move(other.stale_bits_)),
+                                        stale_words_(std::move(other.stale_words_)),
+                                        stale_any_(other.stale_any_),
+                                        indices_invalid_(other.indices_invalid_) {
+        SyncComponentData();
+        SyncIndexHooks();
     }
 
     Storage& operator=(Storage&& other) noexcept {
@@ -383,6 +782,15 @@ public:
         if (this != &other) {
             BasicStorageType::operator=(std::move(other));
             component_packed_ = std::move(other.component_packed_);
+            double_buffered_ = other.double_buffered_;
+            previous_packed_ = std::move(other.previous_packed_);
+            indices_ = std::move(other.indices_);
+            stale_bits_ = std::move(other.stale_bits_);
+            stale_words_ = std::move(other.stale_words_);
+            stale_any_ = other.stale_any_;
+            indices_invalid_ = other.indices_invalid_;
+            SyncComponentData();
+            SyncIndexHooks();
         }
 
         return *this;
@@ -390,14 +798,69 @@ public:
 
     ~Storage() override = default;
 
-    constexpr ComponentType& ComponentOf(const EntityIdType entity_id) {
-        return component_packed_[BasicStorageType::IndexOf(entity_id)];
+    /// 记录变化时把所在的块原子地标记为修改过，有索引时原子地把这个组件标记为需要更新索引，
+    /// 所以多个 System 可以同时调用；只读取时用 const 的重载
+    constexpr ComponentType& ComponentOf(const EntityIdType entity_id) noexcept {
+        const auto index = BasicStorageType::IndexOf(entity_id);
+        BasicStorageType::MarkPackedWritten(index);
+        if (BasicStorageType::index_hooks_) {
+            MarkIndexStale(entity_id);
+        }
+        return component_packed_[index];
+    }
+
+    /// 用于修改组件，记录变化时会把它标记为修改过
+    /// 有索引时，这个组件的索引会在下一次查找前更新
+    constexpr ComponentType& MutableComponentOf(const EntityIdType entity_id) {
+        const auto index = BasicStorageType::IndexOf(entity_id);
+        BasicStorageType::MarkPackedDirty(index);
+        if (BasicStorageType::index_hooks_) {
+            MarkIndexStale(entity_id);
+        }
+        return component_packed_[index];
     }
 
     constexpr const ComponentType& ComponentOf(const EntityIdType entity_id) const {
         return component_packed_[BasicStorageType::IndexOf(entity_id)];
     }
 
+    /// 开启或关闭双缓冲
+    ///
+    /// 双缓冲时，ComponentOf 读写的是这一帧的缓冲区，PreviousComponentOf 读的是上一帧的缓冲区，
+    /// 所以读上一帧、写这一帧的 System 之间不需要约束。每一帧结束时用 SwapBuffers 交换，
+    /// 交换之后写缓冲区里是上上一帧的值，写的 System 需要每一帧重新写入所有组件。
+    /// 挂载、卸载等结构性修改会同时作用于两个缓冲区
+    void SetDoubleBuffered(const bool enabled) override {
+        double_buffered_ = enabled;
+        if (enabled) {
+            previous_packed_ = component_packed_;
+        } else {
+            previous_packed_.clear();
+            previous_packed_.shrink_to_fit();
+        }
+        SyncComponentData();
+    }
+
+    [[nodiscard]] constexpr bool IsDoubleBuffered() const noexcept override {
+        return double_buffered_;
+    }
+
+    /// 上一帧的组件，不是双缓冲时和 ComponentOf 相同
+    constexpr const ComponentType& PreviousComponentOf(const EntityIdType entity_id) const {
+        const auto index = BasicStorageType::IndexOf(entity_id);
+        return double_buffered_ ? previous_packed_[index] : component_packed_[index];
+    }
+
+    /// 只交换两个数组，O(1)
+    void SwapBuffers() noexcept override {
+        if (!double_buffered_) return;
+
+        component_packed_.swap(previous_packed_);
+        SyncComponentData();
+        BasicStorageType::MarkAllPackedDirty();
+        InvalidateIndices();
+    }
+
     /// 将 Component 插入到 Storage 中，使用万能引用
     constexpr void Upsert(const EntityOriginalType entity, ComponentType component) {
         BasicStorageType::Upsert(entity);
@@ -410,23 +873,197 @@ public:
 
         if (index == component_packed_.size()) {
             component_packed_.emplace_back(component);
+            if (double_buffered_) {
+                previous_packed_.emplace_back(component);
+            }
+            SyncComponentData();
         } else if (index < component_packed_.size()) {
             component_packed_[index] = component;
         }
+
+        if (BasicStorageType::index_hooks_) {
+            AssureStaleBits();
+            UpdateIndices(id, entity, component);
+        }
     }
 
     constexpr void Upsert(const EntityOriginalType entity) override {
         Storage::Upsert(entity, {});
     }
 
-    constexpr void Pop(const EntityIdType entity_id) override {
-        if (!BasicStorageType::Contains(entity_id)) return;
+    void UpsertRange(const EntityOriginalType* entities, const std::byte* components,
+                     const std::size_t count) override {
+        BasicStorageType::ReserveForAppend(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            // 组件是平凡可复制的，可以直接从字节中拷贝
+            ComponentType component;
+            std::memcpy(&component, components + i * sizeof(ComponentType), sizeof(ComponentType));
+            Storage::Upsert(entities[i], component);
+        }
+    }
+
+    void AppendRepeated(const EntityOriginalType* entities, const std::byte* component,
+                        const std::size_t count) override {
+        BasicStorageType::AppendEntities(entities, count);
+
+        ComponentType value;
+        std::memcpy(&value, component, sizeof(ComponentType));
+        component_packed_.insert(component_packed_.end(), count, value);
+        if (double_buffered_) {
+            previous_packed_.insert(previous_packed_.end(), count, value);
+        }
+        SyncComponentData();
+
+        if (BasicStorageType::index_hooks_) {
+            AssureStaleBits();
+            for (std::size_t i = 0; i < count; ++i) {
+                UpdateIndices(GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(entities[i])), entities[i], value);
+            }
+        }
+    }
+
+    [[nodiscard]] const std::byte* ComponentData() const noexcept override {
+        return reinterpret_cast<const std::byte*>(component_packed_.data());
+    }
 
-        Storage::SwapToBack(entity_id);
+    void Assign(const std::span<const EntityIdType> sparse,
+                const std::span<const EntityOriginalType> entities,
+                const std::byte* components) override {
+        BasicStorageType::Assign(sparse, entities, components);
 
-        component_packed_.pop_back();
-        BasicStorageType::entity_packed_.pop_back();
-        BasicStorageType::sparse_[entity_id] = 0;
+        // 组件是平凡可复制的，直接拷贝整个数组
+        component_packed_.resize(entities.size());
+        if (!entities.empty()) {
+            std::memcpy(component_packed_.data(), components, entities.size() * sizeof(ComponentType));
+        }
+        if (double_buffered_) {
+            previous_packed_ = component_packed_;
+        }
+        SyncComponentData();
+        InvalidateIndices();
+    }
+
+    void ResizeForRestore(const std::size_t sparse_size, const std::size_t count) override {
+        BasicStorageType::ResizeForRestore(sparse_size, count);
+        component_packed_.resize(count);
+        if (double_buffered_) {
+            previous_packed_.resize(count);
+        }
+        SyncComponentData();
+        InvalidateIndices();
+    }
+
+    void WritePacked(const std::size_t first, const std::span<const EntityOriginalType> entities,
+                     const std::byte* components) override {
+        BasicStorageType::WritePacked(first, entities, components);
+        if (!entities.empty()) {
+            std::memcpy(component_packed_.data() + first, components, entities.size() * sizeof(ComponentType));
+            if (double_buffered_) {
+                std::memcpy(previous_packed_.data() + first, components, entities.size() * sizeof(ComponentType));
+            }
+        }
+        InvalidateIndices();
+    }
+
+    template <auto Member>
+        requires IndexableFieldType<Member, ComponentType>
+    using ComponentIndexType = ComponentIndex<Entity, ComponentType, Member>;
+
+    /// 为字段 Member 建立索引，已经存在时直接返回
+    ///
+    /// 建立时遍历一次所有组件，之后插入、删除组件时立即更新；通过非 const 的 ComponentOf、ComponentBytesOf
+    /// 取得组件（包括 View 和 Registry::GetComponentReference），或者调用 MarkComponentDirty 之后，
+    /// 在下一次 FindBy 之前更新
+    template <auto Member>
+        requires IndexableFieldType<Member, ComponentType>
+    ComponentIndexType<Member>& AddIndex() {
+        if (auto* index = FindIndex<Member>()) {
+            return *index;
+        }
+
+        RefreshIndices();
+        AssureStaleBits();
+
+        auto index = std::make_unique<ComponentIndexType<Member>>();
+        auto& result = *index;
+        for (std::size_t i = 0; i < component_packed_.size(); ++i) {
+            const auto entity = BasicStorageType::entity_packed_[i];
+            result.Update(GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(entity)), entity,
+                          component_packed_[i]);
+        }
+
+        indices_.push_back(std::move(index));
+        SyncIndexHooks();
+        return result;
+    }
+
+    template <auto Member>
+        requires IndexableFieldType<Member, ComponentType>
+    void RemoveIndex() {
+        std::erase_if(indices_, [](const auto& index) {
+            return index->Key() == ComponentIndexType<Member>::key_k;
+        });
+        if (indices_.empty()) {
+            RefreshIndices();
+        }
+        SyncIndexHooks();
+    }
+
+    /// 没有这个索引时返回 nullptr，不会更新索引
+    template <auto Member>
+        requires IndexableFieldType<Member, ComponentType>
+    [[nodiscard]] ComponentIndexType<Member>* FindIndex() noexcept {
+        for (const auto& index : indices_) {
+            if (index->Key() == ComponentIndexType<Member>::key_k) {
+                return static_cast<ComponentIndexType<Member>*>(index.get());
+            }
+        }
+        return nullptr;
+    }
+
+    /// 字段 Member 等于 value 的所有实体，没有索引时先建立索引，下一次修改 Storage 之后失效
+    ///
+    /// 会先更新被修改过的组件的索引，所以不能和修改这个 Storage 的操作同时调用
+    template <auto Member>
+        requires IndexableFieldType<Member, ComponentType>
+    std::span<const EntityOriginalType> FindBy(const typename ComponentIndexType<Member>::FieldType& value) {
+        auto& index = AddIndex<Member>();
+        RefreshIndices();
+        return index.Find(value);
+    }
+
+    /// 让所有索引和组件保持一致，只处理上一次之后被修改过的组件
+    ///
+    /// 没有被修改过的组件时只读取一个标记，否则按两级位图跳过没有修改的部分
+    void RefreshIndices() {
+        if (indices_invalid_) {
+            indices_invalid_ = false;
+            for (const auto& index : indices_) {
+                index->Clear();
+            }
+            for (std::size_t i = 0; i < component_packed_.size(); ++i) {
+                const auto entity = BasicStorageType::entity_packed_[i];
+                UpdateIndices(GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(entity)), entity,
+                              component_packed_[i]);
+            }
+            ClearStaleBits();
+            return;
+        }
+        if (!stale_any_) return;
+
+        for (std::size_t summary = 0; summary < stale_words_.size(); ++summary) {
+            for (auto words = std::exchange(stale_words_[summary], 0); words != 0; words &= words - 1) {
+                const auto word = summary * 64 + static_cast<std::size_t>(std::countr_zero(words));
+                for (auto bits = std::exchange(stale_bits_[word], 0); bits != 0; bits &= bits - 1) {
+                    const auto entity_id = static_cast<EntityIdType>(word * 64 + std::countr_zero(bits));
+                    if (BasicStorageType::Contains(entity_id)) {
+                        UpdateIndices(entity_id, BasicStorageType::EntityOf(entity_id),
+                                      component_packed_[BasicStorageType::IndexOf(entity_id)]);
+                    }
+                }
+            }
+        }
+        stale_any_ = 0;
     }
 
     constexpr IteratorType Begin() noexcept {
@@ -484,11 +1121,17 @@ public:
     constexpr void Reserve(const std::size_t n) override {
         BasicStorageType::Reserve(n);
         component_packed_.reserve(n);
+        if (double_buffered_) {
+            previous_packed_.reserve(n);
+        }
+        SyncComponentData();
     }
 
     constexpr void ShrinkToFit() override {
         BasicStorageType::ShrinkToFit();
         component_packed_.shrink_to_fit();
+        previous_packed_.shrink_to_fit();
+        SyncComponentData();
     }
 
     constexpr void SwapToBack(const EntityIdType entity_id) override {
@@ -501,11 +1144,102 @@ public:
     constexpr void Swap(const EntityIdType entity_id1,
                         const EntityIdType entity_id2) override {
         BasicStorageType::Swap(entity_id1, entity_id2);
-        std::swap(component_packed_[BasicStorageType::IndexOf(entity_id1)],
-                  component_packed_[BasicStorageType::IndexOf(entity_id2)]);
+        const auto index1 = BasicStorageType::IndexOf(entity_id1);
+        const auto index2 = BasicStorageType::IndexOf(entity_id2);
+        std::swap(component_packed_[index1], component_packed_[index2]);
+        if (double_buffered_) {
+            std::swap(previous_packed_[index1], previous_packed_[index2]);
+        }
     }
 
 private:
+    static void Truncate(BasicStorageType& storage) noexcept {
+        auto& self = static_cast<Storage&>(storage);
+        self.component_packed_.pop_back();
+        if (self.double_buffered_) {
+            self.previous_packed_.pop_back();
+        }
+    }
+
+    void UpdateIndices(const EntityIdType entity_id, const EntityOriginalType entity, const ComponentType& component) {
+        for (const auto& index : indices_) {
+            index->Update(entity_id, entity, component);
+        }
+    }
+
+    /// 记录可能被修改过的组件，和 MarkPackedWritten 一样只原子地设置位，不会改变位图的大小，
+    /// 所以可以在多个线程中同时调用。有索引时位图总是能放下所有的实体，见 AssureStaleBits
+    void MarkIndexStale(const EntityIdType entity_id) noexcept {
+        // 下一次查找前会重建所有索引
+        if (indices_invalid_) return;
+
+        const auto word = static_cast<std::size_t>(entity_id) / 64;
+        assert(word < stale_bits_.size());
+
+        if (!SetBitAtomic(stale_bits_[word], static_cast<std::size_t>(entity_id) % 64)) return;
+        SetBitAtomic(stale_words_[word / 64], word % 64);
+        if (std::atomic_ref(stale_any_).load(std::memory_order_relaxed) == 0) {
+            std::atomic_ref(stale_any_).store(1, std::memory_order_relaxed);
+        }
+    }
+
+    /// 返回这一位之前是否没有设置
+    static bool SetBitAtomic(std::uint64_t& word, const std::size_t bit) noexcept {
+        const std::atomic_ref bits(word);
+        const auto mask = std::uint64_t{1} << bit;
+        if ((bits.load(std::memory_order_relaxed) & mask) != 0) return false;
+        return (bits.fetch_or(mask, std::memory_order_relaxed) & mask) == 0;
+    }
+
+    /// 让位图能放下 sparse_ 中的所有实体，只在插入、整体替换组件和建立索引时调用，这时不会有并发的修改
+    void AssureStaleBits() {
+        const auto words = (BasicStorageType::sparse_.size() + 63) / 64;
+        if (stale_bits_.size() < words) {
+            stale_bits_.resize(words);
+            stale_words_.resize((words + 63) / 64);
+        }
+    }
+
+    void ClearStaleBits() noexcept {
+        std::ranges::fill(stale_bits_, 0);
+        std::ranges::fill(stale_words_, 0);
+        stale_any_ = 0;
+    }
+
+    /// 组件被整体替换之后，下一次查找前重建所有索引
+    void InvalidateIndices() {
+        indices_invalid_ = !indices_.empty();
+        if (indices_invalid_) {
+            AssureStaleBits();
+        }
+    }
+
+    static void IndexPop(BasicStorageType& storage, const EntityIdType entity_id) noexcept {
+        for (const auto& index : static_cast<Storage&>(storage).indices_) {
+            index->Erase(entity_id);
+        }
+    }
+
+    static void IndexWrite(BasicStorageType& storage, const EntityIdType entity_id) noexcept {
+        static_cast<Storage&>(storage).MarkIndexStale(entity_id);
+    }
+
+    constexpr void SyncIndexHooks() noexcept {
+        BasicStorageType::index_hooks_ = indices_.empty() ? nullptr : &index_hooks_k;
+    }
+
+    static constexpr typename BasicStorageType::IndexHooks index_hooks_k{&Storage::IndexPop, &Storage::IndexWrite};
+
+    /// 组件数组可能重新分配之后，更新基类中用于删除的指针
+    constexpr void SyncComponentData() noexcept {
+        BasicStorageType::component_data_ = reinterpret_cast<std::byte*>(component_packed_.data());
+        BasicStorageType::previous_data_ = double_buffered_
+                                               ? reinterpret_cast<std::byte*>(previous_packed_.data())
+                                               : nullptr;
+    }
+
+    static constexpr typename BasicStorageType::Descriptor descriptor_k{sizeof(ComponentType), &Storage::Truncate};
+
     friend struct internal::StorageIterator<Storage, ComponentType>;
     friend struct internal::StorageIterator<Storage, void>;
 
@@ -518,6 +1252,549 @@ private:
 
 private:
     PackedComponentContainerType component_packed_;
+
+    // 双缓冲时上一帧的组件，和 component_packed_ 一一对应
+    bool double_buffered_{false};
+    PackedComponentContainerType previous_packed_;
+
+    // 字段索引，见 AddIndex
+    std::vector<std::unique_ptr<internal::BasicComponentIndex<Entity, ComponentType>>> indices_;
+
+    // 上一次 RefreshIndices 之后可能被修改过的组件，stale_bits_ 每一位是一个实体 ID，
+    // stale_words_ 每一位表示 stale_bits_ 中的一个字是否有被设置的位，stale_any_ 表示是否有被设置的位
+    std::vector<std::uint64_t> stale_bits_;
+    std::vector<std::uint64_t> stale_words_;
+    std::uint64_t stale_any_{0};
+
+    // 组件被整体替换过，需要重建所有索引
+    bool indices_invalid_{false};
+};
+
+
+/// 组件类型只在运行时知道的 Storage，组件按字节紧密排列
+///
+/// 用于脚本、编辑器和数据驱动的预制体，组件大小和对齐在构造时给出，
+/// 对齐不能超过 std::max_align_t。插入时直接 memcpy 组件的字节
+template <AllowedEntityType Entity>
+class RuntimeStorage final : public BasicStorage<Entity> {
+public:
+    using BasicStorageType = BasicStorage<Entity>;
+
+    using EntityOriginalType = typename BasicStorageType::EntityOriginalType;
+    using EntityIdType = typename BasicStorageType::EntityIdType;
+    using EntityUnderlyingType = typename BasicStorageType::EntityUnderlyingType;
+
+    // 紧凑数组，存储组件的字节
+    using PackedComponentContainerType = std::vector<std::byte>;
+
+    RuntimeStorage(const std::size_t component_size, const std::size_t alignment)
+        : BasicStorageType(&descriptor_), descriptor_{component_size, &RuntimeStorage::Truncate} {
+        if (alignment > alignof(std::max_align_t)) {
+            throw std::runtime_error("RuntimeStorage: Alignment is too large");
+        }
+    }
+
+    // 基类保存了指向 descriptor_ 的指针，所以不能移动
+    RuntimeStorage(const RuntimeStorage&) = delete;
+    RuntimeStorage& operator=(const RuntimeStorage&) = delete;
+
+    ~RuntimeStorage() override = default;
+
+    [[nodiscard]] std::byte* ComponentOf(const EntityIdType entity_id) noexcept {
+        return BasicStorageType::ComponentBytesOf(entity_id);
+    }
+
+    [[nodiscard]] std::byte* MutableComponentOf(const EntityIdType entity_id) {
+        return BasicStorageType::MutableComponentBytesOf(entity_id);
+    }
+
+    [[nodiscard]] const std::byte* ComponentOf(const EntityIdType entity_id) const {
+        return component_packed_.data() + BasicStorageType::IndexOf(entity_id) * descriptor_.component_size;
+    }
+
+    /// 插入或覆盖一个组件，component 是 ComponentSize() 个字节
+    void Upsert(const EntityOriginalType entity, const std::byte* component) {
+        BasicStorageType::Upsert(entity);
+
+        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
+        const auto index = BasicStorageType::IndexOf(GetId<EntityOriginalType>(underlying));
+        const auto size = descriptor_.component_size;
+
+        if (index * size == component_packed_.size()) {
+            component_packed_.resize(component_packed_.size() + size);
+            SyncComponentData();
+        }
+        std::memcpy(component_packed_.data() + index * size, component, size);
+    }
+
+    void Upsert(const EntityOriginalType entity) override {
+        const auto size = descriptor_.component_size;
+        BasicStorageType::Upsert(entity);
+
+        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
+        const auto index = BasicStorageType::IndexOf(GetId<EntityOriginalType>(underlying));
+        if (index * size == component_packed_.size()) {
+            component_packed_.resize(component_packed_.size() + size);
+            SyncComponentData();
+        }
+        std::fill_n(component_packed_.data() + index * size, size, std::byte{0});
+    }
+
+    void UpsertRange(const EntityOriginalType* entities, const std::byte* components,
+                     const std::size_t count) override {
+        BasicStorageType::ReserveForAppend(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            RuntimeStorage::Upsert(entities[i], components + i * descriptor_.component_size);
+        }
+    }
+
+    void AppendRepeated(const EntityOriginalType* entities, const std::byte* component,
+                        const std::size_t count) override {
+        BasicStorageType::AppendEntities(entities, count);
+
+        const auto size = descriptor_.component_size;
+        const auto first = component_packed_.size();
+        component_packed_.resize(first + count * size);
+        SyncComponentData();
+        if (count == 0 || size == 0) return;
+
+        // 先放一个，之后每次复制已经填好的部分，memcpy 的次数是 log(count)
+        auto* begin = component_packed_.data() + first;
+        std::memcpy(begin, component, size);
+        for (std::size_t filled = size, total = count * size; filled < total;) {
+            const auto n = std::min(filled, total - filled);
+            std::memcpy(begin + filled, begin, n);
+            filled += n;
+        }
+    }
+
+    [[nodiscard]] const std::byte* ComponentData() const noexcept override {
+        return component_packed_.data();
+    }
+
+    void Assign(const std::span<const EntityIdType> sparse,
+                const std::span<const EntityOriginalType> entities,
+                const std::byte* components) override {
+        BasicStorageType::Assign(sparse, entities, components);
+        component_packed_.assign(components, components + entities.size() * descriptor_.component_size);
+        SyncComponentData();
+    }
+
+    void ResizeForRestore(const std::size_t sparse_size, const std::size_t count) override {
+        BasicStorageType::ResizeForRestore(sparse_size, count);
+        component_packed_.resize(count * descriptor_.component_size);
+        SyncComponentData();
+    }
+
+    void WritePacked(const std::size_t first, const std::span<const EntityOriginalType> entities,
+                     const std::byte* components) override {
+        BasicStorageType::WritePacked(first, entities, components);
+        const auto size = descriptor_.component_size;
+        std::copy_n(components, entities.size() * size, component_packed_.data() + first * size);
+    }
+
+    void Reserve(const std::size_t n) override {
+        BasicStorageType::Reserve(n);
+        component_packed_.reserve(n * descriptor_.component_size);
+        SyncComponentData();
+    }
+
+    void ShrinkToFit() override {
+        BasicStorageType::ShrinkToFit();
+        component_packed_.shrink_to_fit();
+        SyncComponentData();
+    }
+
+    void SwapToBack(const EntityIdType entity_id) override {
+        const auto last_underlying = ToUnderlying<EntityOriginalType>(BasicStorageType::entity_packed_.back());
+        RuntimeStorage::Swap(entity_id, GetId<EntityOriginalType>(last_underlying));
+    }
+
+    void Swap(const EntityIdType entity_id1, const EntityIdType entity_id2) override {
+        BasicStorageType::Swap(entity_id1, entity_id2);
+        const auto size = descriptor_.component_size;
+        auto* first = component_packed_.data() + BasicStorageType::IndexOf(entity_id1) * size;
+        auto* second = component_packed_.data() + BasicStorageType::IndexOf(entity_id2) * size;
+        std::swap_ranges(first, first + size, second);
+    }
+
+private:
+    static void Truncate(BasicStorageType& storage) noexcept {
+        auto& self = static_cast<RuntimeStorage&>(storage);
+        self.component_packed_.resize(self.component_packed_.size() - self.descriptor_.component_size);
+    }
+
+    void SyncComponentData() noexcept {
+        BasicStorageType::component_data_ = component_packed_.data();
+    }
+
+private:
+    typename BasicStorageType::Descriptor descriptor_;
+    PackedComponentContainerType component_packed_;
+};
+
+namespace internal {
+/// 共享组件的值在值表中的下标，所有 SharedStorage 都相同
+using SharedHandleType = std::uint32_t;
+} // namespace internal
+
+/// 共享组件的 Storage，相同的值只存一份，实体只保存值的句柄
+///
+/// 值按字节的哈希去重，比较时用 memcmp，所以组件中的填充字节不同时会被当成不同的值。
+/// 卸载组件不会删除值，值表只增不减，句柄一直有效，所以回滚时只需要恢复句柄。
+/// 不再被引用的值只能用 Compact 显式回收，它会重新编号所有的句柄。组件数组中存的是句柄，
+/// 快照会同时保存值表，恢复时先恢复值表，再恢复句柄
+template <AllowedEntityType Entity, AllowedComponentType Component>
+class SharedStorage final : public BasicStorage<Entity> {
+public:
+    using BasicStorageType = BasicStorage<Entity>;
+
+    using EntityOriginalType = typename BasicStorageType::EntityOriginalType;
+    using EntityIdType = typename BasicStorageType::EntityIdType;
+    using EntityUnderlyingType = typename BasicStorageType::EntityUnderlyingType;
+
+    using ComponentType = Component;
+
+    // 值在 values_ 中的下标
+    using HandleType = internal::SharedHandleType;
+
+    using PackedHandleContainerType = std::vector<HandleType>;
+
+    SharedStorage() noexcept : BasicStorageType(&descriptor_k) {
+    }
+
+    SharedStorage(const SharedStorage&) = delete;
+    SharedStorage& operator=(const SharedStorage&) = delete;
+
+    ~SharedStorage() override = default;
+
+    /// 取得值的句柄，没有相同的值时加入值表
+    HandleType Intern(const ComponentType& component) {
+        const auto hash = Hash(component);
+        const auto [begin, end] = index_.equal_range(hash);
+        for (auto it = begin; it != end; ++it) {
+            if (std::memcmp(&values_[it->second], &component, sizeof(ComponentType)) == 0) {
+                return it->second;
+            }
+        }
+
+        const auto handle = static_cast<HandleType>(values_.size());
+        values_.push_back(component);
+        index_.emplace(hash, handle);
+        return handle;
+    }
+
+    /// 删除没有实体引用的值，剩下的值保持原来的顺序重新编号，返回删除的值的数量
+    ///
+    /// 之前取得的句柄和捕获了这种共享组件的 Prefab 都会失效。打开变化记录时，所有句柄都会被标记为修改过，
+    /// 下一个增量快照会写出整个值表，加载时替换原来的值表，所以增量快照的链条不会断开。
+    /// RollbackBuffer 只保存句柄，不能再回滚到 Compact 之前的检查点，Rewind 会抛出异常
+    std::size_t Compact() {
+        constexpr auto unused = std::numeric_limits<HandleType>::max();
+
+        std::vector<HandleType> remap(values_.size(), unused);
+        for (const auto handle : handles_) {
+            remap[handle] = 0;
+        }
+
+        HandleType next = 0;
+        for (std::size_t handle = 0; handle < values_.size(); ++handle) {
+            if (remap[handle] == unused) continue;
+            remap[handle] = next;
+            values_[next++] = values_[handle];
+        }
+
+        const auto removed = values_.size() - next;
+        if (removed == 0) return 0;
+
+        values_.resize(next);
+        RebuildIndex();
+        for (auto& handle : handles_) {
+            handle = remap[handle];
+        }
+
+        ++generation_;
+        BasicStorageType::MarkAllPackedDirty();
+        BasicStorageType::cleared_value_count_ = 0;
+        return removed;
+    }
+
+    [[nodiscard]] std::size_t ValueGeneration() const noexcept override {
+        return generation_;
+    }
+
+    [[nodiscard]] constexpr const ComponentType& Value(const HandleType handle) const {
+        return values_[handle];
+    }
+
+    [[nodiscard]] std::size_t ValueSize() const noexcept override {
+        return sizeof(ComponentType);
+    }
+
+    /// 不同的值的数量
+    [[nodiscard]] constexpr std::size_t ValueCount() const noexcept override {
+        return values_.size();
+    }
+
+    [[nodiscard]] const std::byte* ValueData() const noexcept override {
+        return reinterpret_cast<const std::byte*>(values_.data());
+    }
+
+    /// 句柄不存在时抛出异常
+    [[nodiscard]] const std::byte* ValueBytesOf(const std::byte* component) const override {
+        return reinterpret_cast<const std::byte*>(&values_[ReadHandle(component)]);
+    }
+
+    /// 值表和保存快照时不一致时抛出异常，不会修改 Storage
+    ///
+    /// 替换已有的值时句柄被重新编号了，和 Compact 一样进入新的一代
+    void AppendValues(const std::size_t first, const std::byte* values, const std::size_t count) override {
+        if (first > values_.size()) {
+            throw std::runtime_error("SharedStorage::AppendValues: Value table mismatch");
+        }
+
+        const bool replaced = first < values_.size();
+        values_.resize(first + count);
+        if (count > 0) {
+            std::memcpy(values_.data() + first, values, count * sizeof(ComponentType));
+        }
+
+        if (replaced) {
+            ++generation_;
+            RebuildIndex();
+            return;
+        }
+        for (auto handle = first; handle < values_.size(); ++handle) {
+            index_.emplace(Hash(values_[handle]), static_cast<HandleType>(handle));
+        }
+    }
+
+    [[nodiscard]] constexpr HandleType HandleOf(const EntityIdType entity_id) const {
+        return handles_[BasicStorageType::IndexOf(entity_id)];
+    }
+
+    [[nodiscard]] constexpr const ComponentType& ComponentOf(const EntityIdType entity_id) const {
+        return values_[HandleOf(entity_id)];
+    }
+
+    void Upsert(const EntityOriginalType entity, const ComponentType& component) {
+        UpsertHandle(entity, Intern(component));
+    }
+
+    void Upsert(const EntityOriginalType entity) override {
+        SharedStorage::Upsert(entity, ComponentType{});
+    }
+
+    /// 插入或覆盖一个实体的句柄
+    void UpsertHandle(const EntityOriginalType entity, const HandleType handle) {
+        BasicStorageType::Upsert(entity);
+
+        const auto underlying = ToUnderlying<EntityOriginalType>(entity);
+        const auto index = BasicStorageType::IndexOf(GetId<EntityOriginalType>(underlying));
+        if (index == handles_.size()) {
+            handles_.push_back(handle);
+            SyncComponentData();
+        } else {
+            handles_[index] = handle;
+        }
+    }
+
+    /// 和 ComponentData 一样，组件的字节是句柄，例如 Registry::MakePrefab 捕获的共享组件，
+    /// 所以只能用于同一个 SharedStorage；句柄不存在时抛出异常，不会修改 Storage
+    void UpsertRange(const EntityOriginalType* entities, const std::byte* components,
+                     const std::size_t count) override {
+        ValidateHandles(components, count);
+
+        BasicStorageType::ReserveForAppend(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            UpsertHandle(entities[i], ReadHandle(components + i * sizeof(HandleType)));
+        }
+    }
+
+    /// 组件的字节是句柄，见 UpsertRange
+    void AppendRepeated(const EntityOriginalType* entities, const std::byte* component,
+                        const std::size_t count) override {
+        const auto handle = ReadHandle(component);
+
+        BasicStorageType::AppendEntities(entities, count);
+        handles_.insert(handles_.end(), count, handle);
+        SyncComponentData();
+    }
+
+    /// 按值重新排列实体，之后相同值的实体是连续的，见 EachGroup
+    void SortByValue() {
+        auto& entities = BasicStorageType::entity_packed_;
+        if (std::ranges::is_sorted(handles_)) return;
+
+        std::vector<std::size_t> order(handles_.size());
+        for (std::size_t i = 0; i < order.size(); ++i) order[i] = i;
+        std::ranges::stable_sort(order, {}, [this](const std::size_t i) { return handles_[i]; });
+
+        PackedHandleContainerType handles(handles_.size());
+        typename BasicStorageType::PackedEntityContainerType sorted(entities.size());
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            handles[i] = handles_[order[i]];
+            sorted[i] = entities[order[i]];
+
+            const auto entity_id = GetId<EntityOriginalType>(ToUnderlying<EntityOriginalType>(sorted[i]));
+            BasicStorageType::sparse_[entity_id] = i + 1;
+            BasicStorageType::MarkSparseDirty(entity_id);
+        }
+        handles_.swap(handles);
+        entities.swap(sorted);
+        SyncComponentData();
+        BasicStorageType::MarkAllPackedDirty();
+    }
+
+    /// 按值分组遍历，按句柄的顺序对每个不同的值调用 function(value, entities)
+    ///
+    /// 不会修改 Storage，所以可以和其他读取同时调用；调用过 SortByValue 时直接使用 Storage 中的实体，
+    /// 否则先按句柄把实体分到一个临时数组中。遍历期间不能挂载或卸载这种组件
+    template <typename Function>
+    void EachGroup(Function&& function) const {
+        const auto& entities = BasicStorageType::entity_packed_;
+        if (std::ranges::is_sorted(handles_)) {
+            for (std::size_t begin = 0; begin < handles_.size();) {
+                auto end = begin + 1;
+                while (end < handles_.size() && handles_[end] == handles_[begin]) ++end;
+
+                function(values_[handles_[begin]],
+                         std::span<const EntityOriginalType>(entities.data() + begin, end - begin));
+                begin = end;
+            }
+            return;
+        }
+
+        // 计数排序，offsets[handle] 是这个值的第一个实体在 grouped 中的位置
+        std::vector<std::size_t> offsets(values_.size() + 1, 0);
+        for (const auto handle : handles_) {
+            ++offsets[handle + 1];
+        }
+        for (std::size_t handle = 0; handle < values_.size(); ++handle) {
+            offsets[handle + 1] += offsets[handle];
+        }
+
+        std::vector<EntityOriginalType> grouped(entities.size());
+        std::vector<std::size_t> cursors(offsets.begin(), offsets.end() - 1);
+        for (std::size_t i = 0; i < handles_.size(); ++i) {
+            grouped[cursors[handles_[i]]++] = entities[i];
+        }
+
+        for (std::size_t handle = 0; handle < values_.size(); ++handle) {
+            const auto begin = offsets[handle];
+            const auto end = offsets[handle + 1];
+            if (begin == end) continue;
+
+            function(values_[handle], std::span<const EntityOriginalType>(grouped.data() + begin, end - begin));
+        }
+    }
+
+    [[nodiscard]] const std::byte* ComponentData() const noexcept override {
+        return reinterpret_cast<const std::byte*>(handles_.data());
+    }
+
+    /// 句柄不存在时抛出异常，不会修改 Storage
+    void Assign(const std::span<const EntityIdType> sparse,
+                const std::span<const EntityOriginalType> entities,
+                const std::byte* components) override {
+        ValidateHandles(components, entities.size());
+
+        BasicStorageType::Assign(sparse, entities, components);
+        handles_.resize(entities.size());
+        if (!entities.empty()) {
+            std::memcpy(handles_.data(), components, entities.size() * sizeof(HandleType));
+        }
+        SyncComponentData();
+    }
+
+    void ResizeForRestore(const std::size_t sparse_size, const std::size_t count) override {
+        BasicStorageType::ResizeForRestore(sparse_size, count);
+        handles_.resize(count);
+        SyncComponentData();
+    }
+
+    /// 句柄不存在时抛出异常，不会修改 Storage
+    void WritePacked(const std::size_t first, const std::span<const EntityOriginalType> entities,
+                     const std::byte* components) override {
+        ValidateHandles(components, entities.size());
+
+        BasicStorageType::WritePacked(first, entities, components);
+        if (!entities.empty()) {
+            std::memcpy(handles_.data() + first, components, entities.size() * sizeof(HandleType));
+        }
+    }
+
+    void Reserve(const std::size_t n) override {
+        BasicStorageType::Reserve(n);
+        handles_.reserve(n);
+        SyncComponentData();
+    }
+
+    void ShrinkToFit() override {
+        BasicStorageType::ShrinkToFit();
+        handles_.shrink_to_fit();
+        SyncComponentData();
+    }
+
+    void SwapToBack(const EntityIdType entity_id) override {
+        const auto last_underlying = ToUnderlying<EntityOriginalType>(BasicStorageType::entity_packed_.back());
+        SharedStorage::Swap(entity_id, GetId<EntityOriginalType>(last_underlying));
+    }
+
+    void Swap(const EntityIdType entity_id1, const EntityIdType entity_id2) override {
+        BasicStorageType::Swap(entity_id1, entity_id2);
+        std::swap(handles_[BasicStorageType::IndexOf(entity_id1)], handles_[BasicStorageType::IndexOf(entity_id2)]);
+    }
+
+private:
+    /// 值只会被 Compact 删除，所以在两次 Compact 之间同一个 SharedStorage 的句柄一直有效
+    HandleType ReadHandle(const std::byte* bytes) const {
+        HandleType handle;
+        std::memcpy(&handle, bytes, sizeof(HandleType));
+        if (handle >= values_.size()) {
+            throw std::runtime_error("SharedStorage: Invalid handle");
+        }
+        return handle;
+    }
+
+    void ValidateHandles(const std::byte* components, const std::size_t count) const {
+        for (std::size_t i = 0; i < count; ++i) {
+            ReadHandle(components + i * sizeof(HandleType));
+        }
+    }
+
+    void RebuildIndex() {
+        index_.clear();
+        for (std::size_t handle = 0; handle < values_.size(); ++handle) {
+            index_.emplace(Hash(values_[handle]), static_cast<HandleType>(handle));
+        }
+    }
+
+    static std::size_t Hash(const ComponentType& component) noexcept {
+        return internal::fnv1a_64({reinterpret_cast<const char*>(&component), sizeof(ComponentType)});
+    }
+
+    static void Truncate(BasicStorageType& storage) noexcept {
+        static_cast<SharedStorage&>(storage).handles_.pop_back();
+    }
+
+    void SyncComponentData() noexcept {
+        BasicStorageType::component_data_ = reinterpret_cast<std::byte*>(handles_.data());
+    }
+
+    static constexpr typename BasicStorageType::Descriptor descriptor_k{sizeof(HandleType), &SharedStorage::Truncate};
+
+private:
+    // 和 entity_packed_ 一一对应
+    PackedHandleContainerType handles_;
+
+    std::vector<ComponentType> values_;
+
+    // 值的哈希到句柄
+    std::unordered_multimap<std::size_t, HandleType> index_;
+
+    // 见 ValueGeneration
+    std::size_t generation_{0};
 };
 } // namespace esc
 
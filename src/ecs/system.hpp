@@ -1,6 +1,9 @@
 #ifndef SYSTEM_HPP
 #define SYSTEM_HPP
-#include <functional>
+#include <unordered_set>
+#include <vector>
+
+#include "function.hpp"
 
 namespace ecs {
 namespace internal {
@@ -27,7 +30,7 @@ using FirstNArgsTuple = typename FirstNArgs<N, Args...>::Type;
 template <typename... SystemArgs>
 struct SystemNode {
     using SystemIdType = std::uint32_t;
-    using SystemType = std::function<void(SystemArgs...)>;
+    using SystemType = SmallFunction<void(SystemArgs...)>;
 
 
     SystemIdType id{};
@@ -36,10 +39,18 @@ struct SystemNode {
     std::unordered_set<SystemIdType> tos;
     std::unordered_set<SystemIdType> froms;
 
-    SystemNode(const SystemIdType id, const SystemType& system)
-        : id(id), system(system), tos(), froms() {
+    SystemNode(const SystemIdType id, SystemType system)
+        : id(id), system(std::move(system)), tos(), froms() {
     }
 
+    SystemNode(const SystemNode&) = delete;
+    SystemNode& operator=(const SystemNode&) = delete;
+
+    SystemNode(SystemNode&&) noexcept = default;
+    SystemNode& operator=(SystemNode&&) noexcept = default;
+
+    ~SystemNode() = default;
+
     [[nodiscard]] constexpr std::size_t InDegree() const {
         return froms.size();
     }
@@ -64,7 +75,7 @@ struct SystemNode {
 
 /// System 依赖图，用于管理 System 之间的依赖关系，交给调度器来更好地并行执行
 ///
-/// 非线程安全
+/// 非线程安全，System 只能移动，所以图本身也只能移动
 template <typename... SystemArgs>
 class SystemGraph {
 public:
@@ -74,15 +85,20 @@ public:
 
     SystemGraph() noexcept = default;
 
-    SystemGraph(const SystemGraph&) = default;
-    SystemGraph& operator=(const SystemGraph&) = default;
+    SystemGraph(const SystemGraph&) = delete;
+    SystemGraph& operator=(const SystemGraph&) = delete;
 
     SystemGraph(SystemGraph&&) noexcept = default;
     SystemGraph& operator=(SystemGraph&&) noexcept = default;
 
     ~SystemGraph() = default;
 
-    constexpr SystemIdType AddSystem(const SystemType& system) {
+    /// 空的 System 永远不会执行，依赖它的 System 也就永远等不到它，所以直接拒绝
+    constexpr SystemIdType AddSystem(SystemType system) {
+        if (!system) {
+            throw std::runtime_error("Empty system is not allowed");
+        }
+
         SystemIdType node_id = 0;
         if (!free_ids_.empty()) {
             node_id = free_ids_.back();
@@ -94,9 +110,9 @@ public:
         assert(node_id <= nodes_.size());
 
         if (node_id == nodes_.size()) {
-            nodes_.emplace_back(node_id, system);
+            nodes_.emplace_back(node_id, std::move(system));
         } else {
-            nodes_[node_id] = {node_id, system};
+            nodes_[node_id] = SystemNodeType(node_id, std::move(system));
         }
 
         return node_id;
@@ -154,8 +170,7 @@ public:
     }
 
     constexpr bool ContainsSystem(const SystemIdType id) const {
-        const auto underlying_id = ToUnderlying<SystemType>(id);
-        return underlying_id < nodes_.size() && nodes_[underlying_id].id == id;
+        return id < nodes_.size() && IsAlive(id);
     }
 
     [[nodiscard]] constexpr bool CheckCycle() const {
@@ -195,7 +210,52 @@ public:
         free_ids_.clear();
     }
 
+    /// 按拓扑序返回所有 System 的 id，要求图中没有环
+    [[nodiscard]] std::vector<SystemIdType> TopologicalOrder() const {
+        std::vector<std::size_t> in_degrees(nodes_.size());
+        std::vector<SystemIdType> order;
+        order.reserve(Size());
+
+        for (SystemIdType id = 0; id < nodes_.size(); ++id) {
+            if (!IsAlive(id)) continue;
+
+            in_degrees[id] = nodes_[id].InDegree();
+            if (in_degrees[id] == 0) {
+                order.push_back(id);
+            }
+        }
+
+        // order 本身就是 Kahn 算法的队列
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            for (const auto to_id : nodes_[order[i]].tos) {
+                if (--in_degrees[to_id] == 0) {
+                    order.push_back(to_id);
+                }
+            }
+        }
+
+        return order;
+    }
+
+    /// 判断图是否是一条单链，也就是任何时刻最多只有一个 System 可以执行
+    [[nodiscard]] bool IsSerial() const {
+        std::size_t roots = 0;
+        for (SystemIdType id = 0; id < nodes_.size(); ++id) {
+            if (!IsAlive(id)) continue;
+
+            const auto& node = nodes_[id];
+            if (node.InDegree() > 1 || node.OutDegree() > 1) return false;
+            if (node.InDegree() == 0) ++roots;
+        }
+        return roots <= 1;
+    }
+
 private:
+    /// 被删除的节点 id 会被置为 invalid_id_k，system 会被置空
+    [[nodiscard]] constexpr bool IsAlive(const SystemIdType id) const {
+        return nodes_[id].id == id && static_cast<bool>(nodes_[id].system);
+    }
+
     constexpr bool CheckCycleDfs(const SystemIdType id,
                                  std::unordered_set<SystemIdType>& visited,
                                  std::unordered_set<SystemIdType>& stack) const {
@@ -1,6 +1,11 @@
 #ifndef VIEWER_HPP
 #define VIEWER_HPP
 
+#include <algorithm>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
 #include "component.hpp"
 #include "world.hpp"
 
@@ -12,8 +17,8 @@ class Viewer;
 ///
 /// @tparam Entity 实体类型
 /// @tparam WithEntity 是否包含实体 ID
-/// @tparam Required 必须的组件类型
-/// @tparam Optional 可选的组件类型
+/// @tparam Required 必须的组件类型，写成 const T 时只读取，否则记录变化时会被当作修改过
+/// @tparam Optional 可选的组件类型，和 Required 一样可以写成 const T
 /// @tparam Exclude 排除的组件类型
 ///
 template <AllowedEntityType Entity,
@@ -23,6 +28,9 @@ template <AllowedEntityType Entity,
     AllowedUniqueComponentsTupleType Exclude = std::tuple<>>
 class View;
 
+template <AllowedEntityType Entity>
+class RuntimeView;
+
 namespace internal {
 template <typename View>
 class ViewIterator {
@@ -35,7 +43,7 @@ public:
     constexpr explicit ViewIterator(view_type& view, const bool is_end = false) noexcept
         : view_(view), is_end_(is_end) {
         if (!is_end_) {
-            value_ = view.Next();
+            Advance();
         }
     }
 
@@ -48,7 +56,7 @@ public:
             return *this;
         }
 
-        value_ = view_.Next();
+        Advance();
         if (!value_) {
             is_end_ = true;
         }
@@ -59,6 +67,15 @@ public:
         return value_.has_value();
     }
 
+private:
+    /// 返回的元组中有引用，不能赋值，只能重新构造
+    constexpr void Advance() {
+        value_.reset();
+        if (auto next = view_.Next()) {
+            value_.emplace(std::move(*next));
+        }
+    }
+
 private:
     view_type& view_;
     bool is_end_;
@@ -97,6 +114,31 @@ public:
         return ViewWithEntityType<Required, Optional, Exclude>{*this};
     }
 
+    /// 组件类型在运行时给出的视图，见 RuntimeView
+    [[nodiscard]] ecs::RuntimeView<Entity> RuntimeView(std::vector<ComponentTypeId> required,
+                                                       std::vector<ComponentTypeId> exclude = {}) {
+        return ecs::RuntimeView<Entity>{registry(), std::move(required), std::move(exclude)};
+    }
+
+    /// 按共享组件的值分组遍历，对每个不同的值调用 function(value, entities)，见 SharedStorage::EachGroup
+    ///
+    /// 只读取 Storage，所以可以在多个 System 中同时调用
+    template <AllowedComponentType Component, typename Function>
+    void EachSharedGroup(Function&& function) {
+        const auto* storage = registry().FindBasicStorage(GetTypeId<Shared<Component>>());
+        if (!storage) return;
+
+        static_cast<const SharedStorage<Entity, Component>*>(storage)->EachGroup(std::forward<Function>(function));
+    }
+
+    /// 双缓冲组件在上一帧的值，不存在时返回 nullptr
+    ///
+    /// 上一帧的缓冲区在这一帧内不会被修改，所以可以和写这个组件的 System 并行读取
+    template <AllowedComponentType Component>
+    [[nodiscard]] constexpr const Component* Previous(const Entity entity) {
+        return registry().template GetPreviousComponentPointer<Component>(entity);
+    }
+
 private:
     explicit Viewer(WorldType& world): world_(world) {
     }
@@ -290,14 +332,49 @@ private:
         return true;
     }
 
+    /// 写成 const T 的组件只读取，其他组件在记录变化时会被标记为修改过，见 Registry::GetComponentReference
     constexpr ReturnTupleType GetComponents(Entity entity) const {
-        const auto required_tuple = registry().template GetComponentsReferencesTuple<RequiredTupleType>(entity);
+        const auto required_tuple = GetRequiredComponents(entity, std::make_index_sequence<required_size_k>());
 
-        const auto optional_tuple = registry().template GetComponentsPointersTuple<OptionalTupleType>(entity);
+        const auto optional_tuple = GetOptionalComponents(entity, std::make_index_sequence<optional_size_k>());
 
         return {required_tuple, optional_tuple};
     }
 
+    template <std::size_t... Indices>
+    constexpr RequiredReferenceTupleType GetRequiredComponents(const Entity entity, std::index_sequence<Indices...>) const {
+        return RequiredReferenceTupleType(
+            GetRequiredComponent<std::tuple_element_t<Indices, RequiredTupleType>,
+                std::tuple_element_t<Indices, RequiredReferenceTupleType>>(entity)...
+        );
+    }
+
+    template <std::size_t... Indices>
+    constexpr OptionalPointerTupleType GetOptionalComponents([[maybe_unused]] const Entity entity, std::index_sequence<Indices...>) const {
+        return OptionalPointerTupleType(
+            GetOptionalComponent<std::tuple_element_t<Indices, OptionalTupleType>,
+                std::tuple_element_t<Indices, OptionalPointerTupleType>>(entity)...
+        );
+    }
+
+    template <AllowedComponentType Component, typename Reference>
+    constexpr Reference GetRequiredComponent(const Entity entity) const {
+        if constexpr (std::is_const_v<std::remove_reference_t<Reference>>) {
+            return registry().template GetConstComponentReference<Component>(entity);
+        } else {
+            return registry().template GetComponentReference<Component>(entity);
+        }
+    }
+
+    template <AllowedComponentType Component, typename Pointer>
+    constexpr Pointer GetOptionalComponent(const Entity entity) const {
+        if constexpr (std::is_const_v<std::remove_pointer_t<Pointer>>) {
+            return registry().template GetConstComponentPointer<Component>(entity);
+        } else {
+            return registry().template GetComponentPointer<Component>(entity);
+        }
+    }
+
 private:
     friend class World<Entity>;
     friend class Viewer<Entity>;
@@ -376,6 +453,102 @@ private:
         return IteratorType(view, true);
     }
 };
+
+
+/// 组件类型在运行时给出的视图，用于脚本和编辑器
+///
+/// 遍历 required 中最小的 Storage，返回实体和 required 中每个组件的字节，顺序和 required 相同。
+/// 返回的 span 在下一次调用 Next 之前有效
+template <AllowedEntityType Entity>
+class RuntimeView {
+public:
+    using EntityType = Entity;
+
+    using RegistryType = Registry<Entity>;
+    using BasicStorageType = BasicStorage<Entity>;
+    using PackedEntityContainerType = typename BasicStorageType::PackedEntityContainerType;
+
+    using ReturnTupleType = std::tuple<EntityType, std::span<std::byte* const>>;
+
+    using IteratorType = internal::ViewIterator<RuntimeView>;
+
+    RuntimeView(RegistryType& registry, const std::vector<ComponentTypeId>& required,
+                const std::vector<ComponentTypeId>& exclude = {}) {
+        if (required.empty()) {
+            throw std::runtime_error("RuntimeView: Required components is empty");
+        }
+
+        for (const auto type_id : required) {
+            auto* storage = registry.FindBasicStorage(type_id);
+            if (!storage) {
+                // 有一种组件不存在，没有实体符合条件
+                required_.clear();
+                return;
+            }
+            required_.push_back(storage);
+        }
+        for (const auto type_id : exclude) {
+            if (auto* storage = registry.FindBasicStorage(type_id)) {
+                exclude_.push_back(storage);
+            }
+        }
+
+        components_.resize(required_.size());
+        candidates_ = &(*std::ranges::min_element(required_, {}, &BasicStorageType::Size))->PackedEntities();
+    }
+
+    std::optional<ReturnTupleType> Next() {
+        if (!candidates_) return std::nullopt;
+
+        while (index_ < candidates_->size()) {
+            const auto entity = (*candidates_)[index_++];
+            const auto entity_id = GetId<Entity>(ToUnderlying<Entity>(entity));
+            if (!CheckEntity(entity_id)) continue;
+
+            for (std::size_t i = 0; i < required_.size(); ++i) {
+                components_[i] = required_[i]->ComponentBytesOf(entity_id);
+            }
+            return ReturnTupleType{entity, std::span<std::byte* const>(components_)};
+        }
+        return std::nullopt;
+    }
+
+    /// 对每个符合条件的实体调用 function(entity, components)
+    template <typename Function>
+    void Each(Function&& function) {
+        while (const auto next = Next()) {
+            function(std::get<0>(*next), std::get<1>(*next));
+        }
+    }
+
+private:
+    bool CheckEntity(const typename BasicStorageType::EntityIdType entity_id) const {
+        for (const auto* storage : required_) {
+            if (!storage->Contains(entity_id)) return false;
+        }
+        for (const auto* storage : exclude_) {
+            if (storage->Contains(entity_id)) return false;
+        }
+        return true;
+    }
+
+    friend IteratorType begin(RuntimeView& view) {
+        return IteratorType(view);
+    }
+
+    friend IteratorType end(RuntimeView& view) {
+        return IteratorType(view, true);
+    }
+
+private:
+    std::vector<BasicStorageType*> required_;
+    std::vector<BasicStorageType*> exclude_;
+
+    const PackedEntityContainerType* candidates_{nullptr};
+    std::size_t index_{0};
+
+    std::vector<std::byte*> components_;
+};
 } // namespace ecs
 
 #endif // VIEWER_HPP
@@ -0,0 +1,103 @@
+#ifndef WORKER_LOCAL_HPP
+#define WORKER_LOCAL_HPP
+
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "function.hpp"
+#include "scheduler.hpp"
+
+namespace ecs {
+namespace internal {
+/// 假定的缓存行大小，用于避免不同线程的槽位伪共享
+inline constexpr std::size_t cache_line_size_k = 64;
+} // namespace internal
+
+/// 每个工作线程一份的累加器，用于并行的 System 统计数据、收集事件等，不需要加锁
+///
+/// System 通过 Local 访问当前线程的槽位，槽位按缓存行对齐。
+/// Stage 执行完之后调用 Merge，按槽位下标的顺序把每个槽位合并到 Total 中，并把槽位重置为初始值。
+/// System 被分配到哪个线程是不确定的，所以合并函数需要同时满足结合律和交换律（求和、计数、取最大值），
+/// 结果才是确定的；拼接数组之类的合并只保证内容相同，不保证顺序。
+/// 通常用 Scheduler::AddStageCompletionHook 在 Stage 完成时调用 Merge；它也可以作为资源放进 Resources
+template <typename Value>
+class WorkerLocal {
+public:
+    static_assert(std::is_copy_constructible_v<Value> && std::is_copy_assignable_v<Value>,
+                  "WorkerLocal requires a copyable value to reset its slots");
+
+    /// 把 local 合并到 total 中
+    using MergeType = SmallFunction<void(Value& total, Value& local)>;
+
+    /// num_threads 需要不小于执行 System 的线程池的线程数，另外还有一个槽位留给调用线程。
+    /// 默认值是 hardware_concurrency，调度器使用其他线程数时传入 Scheduler::ThreadCount 或 Application::ThreadCount
+    explicit WorkerLocal(MergeType merge, Value initial = Value{},
+                         const std::size_t num_threads = std::thread::hardware_concurrency())
+        : slots_(num_threads + 1, Slot{initial}), initial_(initial), total_(initial_), merge_(std::move(merge)) {
+    }
+
+    WorkerLocal(const WorkerLocal&) = delete;
+    WorkerLocal& operator=(const WorkerLocal&) = delete;
+
+    WorkerLocal(WorkerLocal&&) noexcept = default;
+    WorkerLocal& operator=(WorkerLocal&&) noexcept = default;
+
+    ~WorkerLocal() = default;
+
+    /// 当前线程的槽位，只能在当前线程使用
+    ///
+    /// 线程池的线程数比构造时给出的多时抛出异常；槽位不能在并行执行时增加
+    [[nodiscard]] Value& Local() {
+        const auto slot = internal::current_worker_slot;
+        if (slot >= slots_.size()) {
+            throw std::runtime_error("WorkerLocal::Local: Fewer slots than the thread pool");
+        }
+        return slots_[slot].value;
+    }
+
+    /// 按槽位下标的顺序合并所有槽位，然后重置槽位，不能和 Local 同时调用
+    void Merge() {
+        for (auto& slot : slots_) {
+            merge_(total_, slot.value);
+            slot.value = initial_;
+        }
+    }
+
+    [[nodiscard]] Value& Total() noexcept {
+        return total_;
+    }
+
+    [[nodiscard]] const Value& Total() const noexcept {
+        return total_;
+    }
+
+    /// 把合并结果和所有槽位重置为初始值
+    void Reset() {
+        total_ = initial_;
+        for (auto& slot : slots_) {
+            slot.value = initial_;
+        }
+    }
+
+    [[nodiscard]] std::size_t SlotCount() const noexcept {
+        return slots_.size();
+    }
+
+private:
+    struct alignas(internal::cache_line_size_k) Slot {
+        Value value;
+    };
+
+private:
+    std::vector<Slot> slots_;
+    Value initial_;
+    Value total_;
+    MergeType merge_;
+};
+} // namespace ecs
+
+#endif // WORKER_LOCAL_HPP
@@ -66,3 +66,28 @@ TEST(AppTest, AppTest1) {
         return should_exit;
     });
 }
+
+TEST(AppTest, AppTestBufferedSystem) {
+    EcsApplication app;
+
+    // 两个 System 可以并行执行，但是命令总是按添加的顺序合并
+    for (std::uint32_t i = 0; i < 2; ++i) {
+        app.AddBufferedSystem(app.startup_scheduler(), app.startup_scheduler().GetFirstStage(),
+                              [i](const EcsSystemArgPack& args) {
+                                  args.commands.Spawn<MyComponent>(MyComponent{i});
+                              });
+    }
+
+    app.Run([] { return true; });
+
+    std::uint32_t sum = 0;
+    std::size_t count = 0;
+    for (auto res : app.viewer().View<std::tuple<MyComponent>>()) {
+        const auto [required, optional] = res;
+        const auto [component] = required;
+        sum += component.value;
+        ++count;
+    }
+    ASSERT_EQ(count, 2);
+    ASSERT_EQ(sum, 1);
+}
@@ -0,0 +1,139 @@
+#include "ecs/ecs.hpp"
+
+#include <gtest/gtest.h>
+
+struct ArchetypePosition {
+    float x;
+    float y;
+};
+
+struct ArchetypeVelocity {
+    float x;
+    float y;
+};
+
+struct ArchetypeTag {
+    std::uint8_t value;
+};
+
+struct alignas(64) ArchetypeAligned {
+    float values[4];
+};
+
+TEST(ArchetypeTest, ArchetypeTest1) {
+    ecs::ArchetypeRegistry<ecs::EntityU32Enum> reg;
+
+    const auto entity = reg.CreateEntity();
+    reg.AttachComponents<ArchetypePosition, ArchetypeVelocity>(entity, {1, 2}, {3, 4});
+
+    ASSERT_TRUE(reg.ContainsEntity(entity));
+    ASSERT_TRUE((reg.ContainsAllComponents<ArchetypePosition, ArchetypeVelocity>(entity)));
+    ASSERT_FALSE(reg.ContainsComponent<ArchetypeTag>(entity));
+    ASSERT_EQ(reg.GetComponentReference<ArchetypePosition>(entity).x, 1);
+    ASSERT_EQ(reg.GetComponentReference<ArchetypeVelocity>(entity).y, 4);
+
+    reg.AttachComponent<ArchetypeTag>(entity, {7});
+    ASSERT_EQ(reg.GetComponentReference<ArchetypePosition>(entity).y, 2);
+    ASSERT_EQ(reg.GetComponentReference<ArchetypeTag>(entity).value, 7);
+
+    reg.DetachComponent<ArchetypePosition>(entity);
+    ASSERT_FALSE(reg.ContainsComponent<ArchetypePosition>(entity));
+    ASSERT_EQ(reg.GetComponentPointer<ArchetypePosition>(entity), nullptr);
+    ASSERT_EQ(reg.GetComponentReference<ArchetypeVelocity>(entity).x, 3);
+    ASSERT_EQ(reg.GetComponentReference<ArchetypeTag>(entity).value, 7);
+
+    reg.DestroyEntity(entity);
+    ASSERT_FALSE(reg.ContainsEntity(entity));
+    ASSERT_EQ(reg.EntityCount(), 0);
+    ASSERT_THROW(reg.AttachComponent<ArchetypeTag>(entity, {1}), std::runtime_error);
+
+    const auto entity2 = reg.CreateEntity();
+    ASSERT_NE(entity, entity2);
+    ASSERT_FALSE(reg.ContainsComponent<ArchetypeVelocity>(entity2));
+}
+
+TEST(ArchetypeTest, ArchetypeTestView) {
+    ecs::ArchetypeRegistry<std::uint32_t> reg;
+
+    std::vector<std::uint32_t> entities;
+    for (std::uint32_t i = 0; i < 5000; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachComponent<ArchetypePosition>(entity, {static_cast<float>(i), 0});
+        if (i % 2 == 0) {
+            reg.AttachComponent<ArchetypeVelocity>(entity, {1, 1});
+        }
+        if (i % 3 == 0) {
+            reg.AttachComponent<ArchetypeTag>(entity, {1});
+        }
+        entities.push_back(entity);
+    }
+
+    // 销毁一部分实体，让表中的行发生移动
+    for (std::uint32_t i = 0; i < 5000; i += 7) {
+        reg.DestroyEntity(entities[i]);
+    }
+
+    std::size_t moving = 0;
+    reg.Each<ArchetypePosition, ArchetypeVelocity>([&](const std::uint32_t entity,
+                                                       ArchetypePosition& position,
+                                                       const ArchetypeVelocity& velocity) {
+        ASSERT_EQ(position.x, static_cast<float>(entity));
+        position.y += velocity.y;
+        ++moving;
+    });
+
+    std::size_t expected = 0;
+    for (std::uint32_t i = 0; i < 5000; ++i) {
+        if (i % 2 == 0 && i % 7 != 0) ++expected;
+    }
+    ASSERT_EQ(moving, expected);
+
+    std::size_t count = 0;
+    auto view = reg.ViewWithEntity<std::tuple<ArchetypePosition>,
+                                   std::tuple<ArchetypeVelocity>,
+                                   std::tuple<ArchetypeTag>>();
+    for (auto [entity, required, optional] : view) {
+        auto& [position] = required;
+        auto [velocity] = optional;
+
+        ASSERT_NE(entity % 3, 0);
+        ASSERT_EQ(position.x, static_cast<float>(entity));
+        ASSERT_EQ(velocity != nullptr, entity % 2 == 0);
+        ASSERT_EQ(position.y, velocity ? 1.0f : 0.0f);
+        ++count;
+    }
+
+    expected = 0;
+    for (std::uint32_t i = 0; i < 5000; ++i) {
+        if (i % 3 != 0 && i % 7 != 0) ++expected;
+    }
+    ASSERT_EQ(count, expected);
+}
+
+TEST(ArchetypeTest, ArchetypeTestAlignment) {
+    ecs::ArchetypeRegistry<ecs::EntityU32Enum> reg;
+
+    // 每一列都按组件自己的对齐方式对齐，包括超过 max_align_t 的对齐
+    std::vector<ecs::EntityU32Enum> entities;
+    for (std::uint32_t i = 0; i < 1000; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachComponents(entity, ArchetypeTag{static_cast<std::uint8_t>(i)},
+                             ArchetypeAligned{{static_cast<float>(i)}});
+        entities.push_back(entity);
+    }
+
+    for (std::uint32_t i = 0; i < 1000; ++i) {
+        const auto* aligned = reg.GetComponentPointer<ArchetypeAligned>(entities[i]);
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(aligned) % alignof(ArchetypeAligned), 0);
+        ASSERT_EQ(aligned->values[0], static_cast<float>(i));
+    }
+
+    std::size_t count = 0;
+    reg.Each<ArchetypeTag, ArchetypeAligned>([&](const ecs::EntityU32Enum, const ArchetypeTag& tag,
+                                                  const ArchetypeAligned& aligned) {
+        ASSERT_EQ(reinterpret_cast<std::uintptr_t>(&aligned) % alignof(ArchetypeAligned), 0);
+        ASSERT_EQ(tag.value, static_cast<std::uint8_t>(aligned.values[0]));
+        ++count;
+    });
+    ASSERT_EQ(count, 1000);
+}
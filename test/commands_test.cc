@@ -40,3 +40,183 @@ TEST(CommandsTest, CommandsTest1) {
     ASSERT_EQ(storage1.Size(), 0);
     ASSERT_EQ(storage2.Size(), 0);
 }
+
+
+TEST(CommandsTest, CommandsTestSpawnEntity) {
+    ecs::World<MyEntity> world;
+
+    auto& commands = world.commands();
+
+    // 在同一帧中就可以使用新实体
+    const auto entity = commands.SpawnEntity<MyComponent>(MyComponent{32});
+    commands.Attach<MyComponent2>(entity, MyComponent2{64});
+
+    ASSERT_FALSE(world.registry().ContainsEntity(entity));
+
+    commands.Execute();
+
+    auto& reg = world.registry();
+    ASSERT_TRUE(reg.ContainsEntity(entity));
+    ASSERT_EQ(reg.GetComponentReference<MyComponent>(entity).value, 32);
+    ASSERT_EQ(reg.GetComponentReference<MyComponent2>(entity).value, 64);
+}
+
+
+TEST(CommandsTest, CommandsTestCoalesce) {
+    ecs::World<MyEntity> world;
+
+    auto& commands = world.commands();
+    auto& reg = world.registry();
+
+    const auto entity1 = commands.SpawnEntity<MyComponent>(MyComponent{1});
+    const auto entity2 = commands.SpawnEntity<MyComponent, MyComponent2>(MyComponent{2}, MyComponent2{2});
+
+    // 同一个组件上只有最后一条命令有效
+    commands.Attach<MyComponent>(entity1, MyComponent{10})
+            .Attach<MyComponent2>(entity1, MyComponent2{20})
+            .Detach<MyComponent2>(entity1)
+            .Attach<MyComponent>(entity1, MyComponent{11});
+
+    // 在同一帧中创建又销毁的实体不会留下任何组件
+    commands.Attach<MyComponent2>(entity2, MyComponent2{3})
+            .Destroy(entity2);
+
+    ASSERT_FALSE(commands.Empty());
+    commands.Execute();
+    ASSERT_TRUE(commands.Empty());
+
+    ASSERT_TRUE(reg.ContainsEntity(entity1));
+    ASSERT_FALSE(reg.ContainsEntity(entity2));
+
+    ASSERT_EQ(reg.GetStorageOfComponent<MyComponent>().Size(), 1);
+    ASSERT_EQ(reg.GetComponentReference<MyComponent>(entity1).value, 11);
+    ASSERT_FALSE(reg.ContainsComponent<MyComponent2>(entity1));
+    // 所有 MyComponent2 的命令都被抵消了，所以不会创建它的 Storage
+    ASSERT_FALSE(reg.HasStorageOfComponent<MyComponent2>());
+
+    // 已经存在的组件可以在之后的帧中被卸载
+    commands.Detach<MyComponent>(entity1).Execute();
+    ASSERT_EQ(reg.GetStorageOfComponent<MyComponent>().Size(), 0);
+}
+
+TEST(CommandsTest, CommandsTestParallel) {
+    ecs::World<MyEntity> world;
+    ecs::internal::ThreadPool pool(4);
+
+    auto& commands = world.commands();
+    auto& reg = world.registry();
+
+    constexpr std::uint32_t count = 2000;
+    std::vector<MyEntity> entities;
+    for (std::uint32_t i = 0; i < count; ++i) {
+        entities.push_back(commands.SpawnEntity<MyComponent, MyComponent2>(MyComponent{i}, MyComponent2{static_cast<std::uint64_t>(count + i)}));
+    }
+    commands.Execute(&pool);
+
+    ASSERT_EQ(reg.GetStorageOfComponent<MyComponent>().Size(), count);
+    ASSERT_EQ(reg.GetStorageOfComponent<MyComponent2>().Size(), count);
+
+    // 两种组件的命令分别在不同的线程中执行
+    for (std::uint32_t i = 0; i < count; ++i) {
+        if (i % 2 == 0) {
+            commands.Detach<MyComponent>(entities[i]);
+        } else {
+            commands.Attach<MyComponent2>(entities[i], MyComponent2{static_cast<std::uint64_t>(i * 2)});
+        }
+    }
+    commands.Execute(&pool);
+
+    ASSERT_EQ(reg.GetStorageOfComponent<MyComponent>().Size(), count / 2);
+    for (std::uint32_t i = 0; i < count; ++i) {
+        ASSERT_EQ(reg.ContainsComponent<MyComponent>(entities[i]), i % 2 != 0);
+        ASSERT_EQ(reg.GetComponentReference<MyComponent2>(entities[i]).value, static_cast<std::uint64_t>(i % 2 == 0 ? count + i : i * 2));
+    }
+}
+
+TEST(CommandsTest, CommandsTestAppend) {
+    ecs::World<MyEntity> world;
+
+    auto& commands = world.commands();
+    auto& reg = world.registry();
+
+    ecs::Commands<MyEntity> buffer1(world);
+    ecs::Commands<MyEntity> buffer2(world);
+
+    const auto entity = buffer1.SpawnEntity<MyComponent>(MyComponent{1});
+    buffer2.Attach<MyComponent>(entity, MyComponent{2})
+           .Attach<MyComponent2>(entity, MyComponent2{3});
+    ASSERT_EQ(buffer1.Size(), 1);
+    ASSERT_EQ(buffer2.Size(), 2);
+
+    // 按顺序合并，buffer2 中的命令在 buffer1 之后
+    commands.Append(buffer1);
+    commands.Append(buffer2);
+    ASSERT_TRUE(buffer1.Empty());
+    ASSERT_TRUE(buffer2.Empty());
+    ASSERT_EQ(buffer2.Size(), 0);
+    ASSERT_EQ(commands.Size(), 3);
+
+    commands.Execute();
+    ASSERT_EQ(commands.Size(), 0);
+
+    ASSERT_EQ(reg.GetComponentReference<MyComponent>(entity).value, 2);
+    ASSERT_EQ(reg.GetComponentReference<MyComponent2>(entity).value, 3);
+
+    // 合并到不为空的队列，合并之后记录的命令排在被合并的命令之后
+    commands.Attach<MyComponent>(entity, MyComponent{4});
+    buffer1.Attach<MyComponent>(entity, MyComponent{5})
+           .AddResource<MyComponent2>(MyComponent2{6});
+    buffer2.Attach<MyComponent2>(entity, MyComponent2{7});
+    commands.Append(buffer1);
+    buffer1.Attach<MyComponent>(entity, MyComponent{8});
+    commands.Append(buffer2);
+    commands.Attach<MyComponent2>(entity, MyComponent2{9});
+    commands.Append(buffer1);
+    ASSERT_TRUE(buffer1.Empty());
+    ASSERT_EQ(commands.Size(), 6);
+
+    commands.Execute();
+    ASSERT_TRUE(commands.Empty());
+    ASSERT_EQ(reg.GetComponentReference<MyComponent>(entity).value, 8);
+    ASSERT_EQ(reg.GetComponentReference<MyComponent2>(entity).value, 9);
+    ASSERT_EQ(world.resources().GetResourceReference<MyComponent2>().value, 6);
+}
+
+namespace {
+struct ThrowingResource {
+    static inline bool throw_on_copy = false;
+
+    ThrowingResource() = default;
+
+    ThrowingResource(const ThrowingResource&) {
+        if (throw_on_copy) throw std::runtime_error("ThrowingResource");
+    }
+
+    ThrowingResource& operator=(const ThrowingResource&) = default;
+};
+} // namespace
+
+TEST(CommandsTest, CommandsTestThrow) {
+    ecs::World<MyEntity> world;
+
+    auto& commands = world.commands();
+    auto& reg = world.registry();
+
+    const auto entity = commands.SpawnEntity<MyComponent>(MyComponent{1});
+    commands.AddResource(ThrowingResource{});
+    commands.Attach<MyComponent2>(entity, MyComponent2{2});
+
+    ThrowingResource::throw_on_copy = true;
+    ASSERT_THROW(commands.Execute(), std::runtime_error);
+    ThrowingResource::throw_on_copy = false;
+
+    // 抛出异常之前执行过的命令不会在下一次 Execute 时再执行一次
+    ASSERT_TRUE(commands.Empty());
+    ASSERT_EQ(commands.Size(), 0);
+    ASSERT_TRUE(reg.ContainsComponent<MyComponent>(entity));
+    ASSERT_FALSE(reg.ContainsComponent<MyComponent2>(entity));
+
+    reg.GetComponentReference<MyComponent>(entity).value = 3;
+    commands.Execute();
+    ASSERT_EQ(reg.GetComponentReference<MyComponent>(entity).value, 3);
+}
@@ -0,0 +1,86 @@
+#include "ecs/ecs.hpp"
+
+#include <gtest/gtest.h>
+
+struct DescriptorPosition {
+    float x;
+    float y;
+};
+
+TEST(DescriptorTest, DescriptorTest1) {
+    ecs::ComponentDescriptorRegistry<std::uint32_t> descriptors;
+
+    const auto& position = descriptors.Register<DescriptorPosition>("Position");
+    const auto& health = descriptors.Register("Health", sizeof(std::int32_t), alignof(std::int32_t));
+
+    ASSERT_EQ(position.type_id, ecs::GetTypeId<DescriptorPosition>());
+    ASSERT_FALSE(position.IsRuntime());
+    ASSERT_TRUE(health.IsRuntime());
+    ASSERT_EQ(descriptors.Find("Health"), &health);
+    ASSERT_EQ(descriptors.Find(position.type_id), &position);
+    ASSERT_EQ(descriptors.Size(), 2);
+
+    // 重复注册相同的描述是允许的，冲突的描述会抛出异常
+    ASSERT_EQ(&descriptors.Register("Health", sizeof(std::int32_t), alignof(std::int32_t)), &health);
+    ASSERT_THROW(descriptors.Register("Health", 8, 8), std::runtime_error);
+    ASSERT_THROW(descriptors.Register("Big", 64, 128), std::runtime_error);
+}
+
+TEST(DescriptorTest, DescriptorTestRegistry) {
+    ecs::ComponentDescriptorRegistry<std::uint32_t> descriptors;
+    const auto& position = descriptors.Register<DescriptorPosition>("Position");
+    const auto& health = descriptors.Register("Health", sizeof(std::int32_t), alignof(std::int32_t));
+    const auto& dead = descriptors.Register("Dead", 1, 1);
+
+    ecs::Registry<std::uint32_t> reg;
+
+    // 从预制体的字节批量生成
+    std::vector<std::uint32_t> entities;
+    std::vector<std::int32_t> healths;
+    for (std::int32_t i = 0; i < 100; ++i) {
+        entities.push_back(reg.CreateEntity());
+        healths.push_back(i);
+    }
+    reg.AttachComponentsBulk(health, entities, reinterpret_cast<const std::byte*>(healths.data()));
+
+    for (std::uint32_t i = 0; i < 100; i += 2) {
+        const DescriptorPosition value{static_cast<float>(i), 1};
+        reg.AttachComponent(entities[i], position, reinterpret_cast<const std::byte*>(&value));
+    }
+    constexpr std::byte flag{1};
+    for (std::uint32_t i = 0; i < 100; i += 10) {
+        reg.AttachComponent(entities[i], dead, &flag);
+    }
+    reg.DestroyEntity(entities[4]);
+
+    // 编译期类型用运行时的方式挂载之后，也可以用模板访问
+    ASSERT_EQ(reg.GetComponentReference<DescriptorPosition>(entities[2]).x, 2);
+    ASSERT_TRUE(reg.ContainsComponent(entities[3], health.type_id));
+
+    std::int32_t value = 0;
+    std::memcpy(&value, reg.GetComponentBytes(entities[7], health.type_id), sizeof(value));
+    ASSERT_EQ(value, 7);
+    ASSERT_EQ(reg.GetComponentBytes(entities[7], position.type_id), nullptr);
+
+    std::size_t count = 0;
+    ecs::RuntimeView<std::uint32_t> view(reg, {health.type_id, position.type_id}, {dead.type_id});
+    for (auto [entity, components] : view) {
+        ASSERT_EQ(components.size(), 2);
+
+        std::int32_t health_value = 0;
+        std::memcpy(&health_value, components[0], sizeof(health_value));
+        DescriptorPosition position_value{};
+        std::memcpy(&position_value, components[1], sizeof(position_value));
+
+        ASSERT_EQ(entity % 2, 0);
+        ASSERT_NE(entity % 10, 0);
+        ASSERT_EQ(health_value, static_cast<std::int32_t>(entity));
+        ASSERT_EQ(position_value.x, static_cast<float>(entity));
+        ++count;
+    }
+    // 50 个偶数，去掉 10 个 Dead 和被销毁的 4
+    ASSERT_EQ(count, 39);
+
+    ecs::RuntimeView<std::uint32_t> missing(reg, {ecs::internal::fnv1a_64("Missing")});
+    ASSERT_FALSE(missing.Next().has_value());
+}
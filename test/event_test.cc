@@ -0,0 +1,114 @@
+#include "ecs/ecs.hpp"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+
+struct EventDamage {
+    std::uint32_t target;
+    std::uint32_t amount;
+};
+
+TEST(EventTest, EventTest1) {
+    constexpr std::size_t threads = 4;
+    constexpr std::size_t systems = 8;
+    constexpr std::uint32_t count = 1000;
+
+    ecs::EventChannel<EventDamage> channel(threads);
+    ASSERT_TRUE(channel.Empty());
+
+    // 并行写入，不需要加锁
+    ecs::Scheduler<> scheduler(threads);
+    scheduler.AddStageToBack();
+    scheduler.SetStageExecutionPolicy(0, ecs::ExecutionPolicy::Parallel);
+    for (std::uint32_t i = 0; i < systems; ++i) {
+        scheduler.AddSystemToFirstStage([&channel, i] {
+            for (std::uint32_t j = 0; j < count; ++j) {
+                channel.Send({i, j});
+            }
+        });
+    }
+    scheduler.Execute();
+
+    // 交换之前读不到这一帧的事件
+    ASSERT_TRUE(channel.Empty());
+    channel.Swap();
+    ASSERT_EQ(channel.Size(), systems * count);
+
+    // 多个 System 同时读取
+    std::atomic<std::uint64_t> total{0};
+    std::atomic<std::size_t> spans{0};
+    ecs::Scheduler<> readers(threads);
+    readers.AddStageToBack();
+    readers.SetStageExecutionPolicy(0, ecs::ExecutionPolicy::Parallel);
+    for (std::size_t i = 0; i < threads; ++i) {
+        readers.AddSystemToFirstStage([&channel, &total, &spans] {
+            std::uint64_t sum = 0;
+            channel.EachSpan([&sum, &spans](const std::span<const EventDamage> events) {
+                spans.fetch_add(1, std::memory_order_relaxed);
+                for (const auto& event : events) {
+                    sum += event.amount;
+                }
+            });
+            total.fetch_add(sum, std::memory_order_relaxed);
+        });
+    }
+    readers.Execute();
+    ASSERT_EQ(total.load(), threads * systems * (static_cast<std::uint64_t>(count) * (count - 1) / 2));
+    ASSERT_GE(spans.load(), threads);
+
+    // 再次交换之后上一帧的事件被丢弃
+    channel.Emplace(EventDamage{1, 2});
+    channel.Swap();
+    ASSERT_EQ(channel.Size(), 1);
+    channel.Each([](const EventDamage& event) {
+        ASSERT_EQ(event.amount, 2);
+    });
+    channel.Swap();
+    ASSERT_TRUE(channel.Empty());
+}
+
+TEST(EventTest, EventTestApplication) {
+    ecs::EcsApplication app;
+    app.AddEventChannel<EventDamage>();
+
+    std::size_t frame = 0;
+    std::vector<std::size_t> received;
+
+    app.update_scheduler().AddSystemToFirstStage([](const ecs::EcsSystemArgPack& args) {
+        args.resources.GetResourceReference<ecs::EventChannel<EventDamage>>().Send({0, 1});
+    });
+    app.update_scheduler().AddStageToBack();
+    app.update_scheduler().AddSystemToStage(1, [&received](const ecs::EcsSystemArgPack& args) {
+        received.push_back(args.resources.GetResourceReference<ecs::EventChannel<EventDamage>>().Size());
+    });
+
+    app.Run([&frame] { return frame++ == 3; });
+
+    // 第一帧读不到事件，之后每一帧读到上一帧发送的一个事件
+    ASSERT_EQ(received, (std::vector<std::size_t>{0, 1, 1}));
+}
+
+TEST(EventTest, EventTestApplicationThreads) {
+    // 缓冲区的数量按调度器的线程数分配，而不是 hardware_concurrency
+    ecs::EcsApplication app(3);
+    ASSERT_EQ(app.ThreadCount(), 3);
+    ASSERT_EQ(app.AddEventChannel<EventDamage>().BufferCount(), 4);
+}
+
+TEST(EventTest, EventTestTooFewBuffers) {
+    ecs::EventChannel<EventDamage> channel(1);
+    ASSERT_EQ(channel.BufferCount(), 2);
+
+    // 模拟一个超出缓冲区数量的工作线程
+    std::thread worker([&channel] {
+        ecs::internal::current_worker_slot = channel.BufferCount();
+        ASSERT_THROW(channel.Send({1, 2}), std::runtime_error);
+        ASSERT_THROW(channel.Emplace(1u, 2u), std::runtime_error);
+    });
+    worker.join();
+
+    channel.Send({3, 4});
+    channel.Swap();
+    ASSERT_EQ(channel.Size(), 1);
+}
@@ -0,0 +1,76 @@
+#include "ecs/ecs.hpp"
+
+#include <gtest/gtest.h>
+
+using namespace ecs;
+
+struct Counter {
+    int* count;
+
+    void operator()(const int n) const {
+        *count += n;
+    }
+};
+
+struct LargeCounter {
+    int* count;
+    std::array<char, 128> padding;
+
+    void operator()(const int n) const {
+        *count += n;
+    }
+};
+
+TEST(FunctionTest, FunctionTest1) {
+    int count = 0;
+
+    SmallFunction<void(int)> function = Counter{&count};
+    ASSERT_TRUE(function);
+
+    function(1);
+    ASSERT_EQ(count, 1);
+
+    // 移动之后原来的对象应该是空的
+    SmallFunction<void(int)> moved = std::move(function);
+    ASSERT_FALSE(function);
+    ASSERT_TRUE(moved);
+
+    moved(2);
+    ASSERT_EQ(count, 3);
+
+    moved = nullptr;
+    ASSERT_FALSE(moved);
+    ASSERT_THROW(moved(1), std::bad_function_call);
+}
+
+TEST(FunctionTest, FunctionTestLarge) {
+    int count = 0;
+
+    // 超过缓冲区大小的可调用对象会放在堆上
+    SmallFunction<void(int)> function = LargeCounter{&count, {}};
+    SmallFunction<void(int)> moved = std::move(function);
+
+    moved(5);
+    ASSERT_EQ(count, 5);
+
+    SmallFunction<int(int, int)> add = [](const int a, const int b) { return a + b; };
+    ASSERT_EQ(add(1, 2), 3);
+}
+
+static int FunctionTestTwice(const int n) {
+    return n * 2;
+}
+
+TEST(FunctionTest, FunctionTestNull) {
+    // 函数的引用不会被当作空的
+    SmallFunction<int(int)> reference = FunctionTestTwice;
+    ASSERT_TRUE(reference);
+    ASSERT_EQ(reference(3), 6);
+
+    int (*pointer)(int) = nullptr;
+    SmallFunction<int(int)> from_pointer = pointer;
+    ASSERT_FALSE(from_pointer);
+
+    SmallFunction<int(int)> from_function = std::function<int(int)>{};
+    ASSERT_FALSE(from_function);
+}
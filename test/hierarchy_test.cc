@@ -0,0 +1,181 @@
+#include "ecs/ecs.hpp"
+
+#include <gtest/gtest.h>
+
+#include <random>
+
+using HierarchyEntity = std::uint32_t;
+using HierarchyType = ecs::Hierarchy<HierarchyEntity, std::int64_t>;
+
+namespace {
+std::int64_t Combine(const std::int64_t parent, const std::int64_t local) {
+    return parent + local;
+}
+
+/// 沿着父节点逐个累加，和 Propagate 的结果比较
+std::int64_t ExpectedWorld(const HierarchyType& hierarchy, HierarchyEntity entity) {
+    std::int64_t world = hierarchy.GetLocal(entity);
+    while (const auto parent = hierarchy.ParentOf(entity)) {
+        entity = *parent;
+        world += hierarchy.GetLocal(entity);
+    }
+    return world;
+}
+
+void CheckLayout(const HierarchyType& hierarchy) {
+    std::size_t size = 0;
+    for (std::size_t depth = 0; depth < hierarchy.LevelCount(); ++depth) {
+        ASSERT_FALSE(hierarchy.Level(depth).empty());
+        for (const auto entity : hierarchy.Level(depth)) {
+            ASSERT_EQ(hierarchy.DepthOf(entity), depth);
+            const auto parent = hierarchy.ParentOf(entity);
+            ASSERT_EQ(parent.has_value(), depth != 0);
+            if (parent) {
+                ASSERT_EQ(hierarchy.DepthOf(*parent), depth - 1);
+            }
+            ASSERT_EQ(hierarchy.GetWorld(entity), ExpectedWorld(hierarchy, entity));
+        }
+        size += hierarchy.Level(depth).size();
+    }
+    ASSERT_EQ(size, hierarchy.Size());
+}
+} // namespace
+
+TEST(HierarchyTest, HierarchyTest1) {
+    HierarchyType hierarchy;
+    hierarchy.Insert(0, 1);
+    hierarchy.Insert(1, 10, 0);
+    hierarchy.Insert(2, 100, 1);
+    hierarchy.Insert(3, 1000, 0);
+    hierarchy.Propagate(Combine);
+
+    ASSERT_EQ(hierarchy.LevelCount(), 3);
+    ASSERT_EQ(hierarchy.GetWorld(2), 111);
+    ASSERT_EQ(hierarchy.GetWorld(3), 1001);
+
+    // 只修改根节点，整棵树都会重新计算
+    hierarchy.SetLocal(0, 2);
+    hierarchy.Propagate(Combine);
+    ASSERT_EQ(hierarchy.GetWorld(2), 112);
+
+    // 深度改变时整棵子树移动到新的层
+    hierarchy.SetParent(1, 3);
+    hierarchy.Propagate(Combine);
+    ASSERT_EQ(hierarchy.DepthOf(2), 3);
+    ASSERT_EQ(hierarchy.GetWorld(2), 1112);
+    CheckLayout(hierarchy);
+
+    ASSERT_THROW(hierarchy.SetParent(3, 2), std::runtime_error);
+    ASSERT_THROW(hierarchy.Insert(2, 0), std::runtime_error);
+
+    // 删除节点之后子节点成为根节点
+    hierarchy.Remove(3);
+    hierarchy.Propagate(Combine);
+    ASSERT_FALSE(hierarchy.Contains(3));
+    ASSERT_FALSE(hierarchy.ParentOf(1).has_value());
+    ASSERT_EQ(hierarchy.GetWorld(2), 110);
+    CheckLayout(hierarchy);
+
+    // 不在层级中的实体
+    ASSERT_THROW((void)hierarchy.ParentOf(3), std::runtime_error);
+    ASSERT_THROW((void)hierarchy.DepthOf(3), std::runtime_error);
+    ASSERT_THROW((void)hierarchy.GetLocal(3), std::runtime_error);
+    ASSERT_THROW(hierarchy.SetLocal(3, 1), std::runtime_error);
+    ASSERT_THROW((void)hierarchy.GetWorld(100), std::runtime_error);
+}
+
+TEST(HierarchyTest, HierarchyTestRandom) {
+    constexpr HierarchyEntity count = 20000;
+
+    std::mt19937 random(42);
+    ecs::internal::ThreadPool pool(4);
+
+    HierarchyType hierarchy;
+    for (HierarchyEntity entity = 0; entity < count; ++entity) {
+        if (entity == 0 || random() % 16 == 0) {
+            hierarchy.Insert(entity, entity);
+        } else {
+            // 偏向最近插入的实体，产生比较深的树
+            const auto parent = entity - 1 - random() % std::min<HierarchyEntity>(entity, 8);
+            hierarchy.Insert(entity, entity, parent);
+        }
+    }
+    hierarchy.Propagate(Combine, &pool);
+    CheckLayout(hierarchy);
+
+    for (std::size_t round = 0; round < 5; ++round) {
+        for (std::size_t i = 0; i < 200; ++i) {
+            const auto entity = static_cast<HierarchyEntity>(random() % count);
+            const auto parent = static_cast<HierarchyEntity>(random() % count);
+            switch (random() % 4) {
+                case 0:
+                    hierarchy.SetLocal(entity, random() % 100);
+                    break;
+                case 1:
+                    hierarchy.RemoveParent(entity);
+                    break;
+                default:
+                    try {
+                        hierarchy.SetParent(entity, parent);
+                    } catch (const std::runtime_error&) {
+                        // 形成环的修改会被拒绝
+                    }
+                    break;
+            }
+        }
+        hierarchy.Propagate(Combine, round % 2 ? &pool : nullptr);
+        CheckLayout(hierarchy);
+    }
+
+    for (HierarchyEntity entity = 0; entity < count; entity += 3) {
+        hierarchy.Remove(entity);
+    }
+    hierarchy.Propagate(Combine, &pool);
+    CheckLayout(hierarchy);
+}
+
+TEST(HierarchyTest, HierarchyTestWide) {
+    // 每一层都超过 propagate_chunk_size_k，会分组并行计算
+    constexpr HierarchyEntity width = 3 * HierarchyType::propagate_chunk_size_k;
+
+    ecs::internal::ThreadPool pool(4);
+    HierarchyType hierarchy;
+    hierarchy.Insert(0, 1);
+    for (HierarchyEntity i = 1; i <= width; ++i) {
+        hierarchy.Insert(i, 1, 0);
+        hierarchy.Insert(width + i, 1, i);
+    }
+    hierarchy.Propagate(Combine, &pool);
+    ASSERT_EQ(hierarchy.LevelCount(), 3);
+    ASSERT_EQ(hierarchy.GetWorld(2 * width), 3);
+
+    // 只有一棵子树被标记
+    hierarchy.SetLocal(width, 5);
+    hierarchy.Propagate(Combine, &pool);
+    ASSERT_EQ(hierarchy.GetWorld(2 * width), 7);
+    ASSERT_EQ(hierarchy.GetWorld(width + 1), 3);
+    CheckLayout(hierarchy);
+}
+
+TEST(HierarchyTest, HierarchyTestThrow) {
+    constexpr HierarchyEntity width = 3 * HierarchyType::propagate_chunk_size_k;
+
+    ecs::internal::ThreadPool pool(4);
+    HierarchyType hierarchy;
+    hierarchy.Insert(0, 1);
+    for (HierarchyEntity i = 1; i <= width; ++i) {
+        hierarchy.Insert(i, 1, 0);
+    }
+
+    // 最后一组由工作线程计算，它抛出的异常在调用线程上重新抛出
+    hierarchy.SetLocal(width, -1);
+    const auto throwing = [](const std::int64_t parent, const std::int64_t local) {
+        if (local < 0) throw std::runtime_error("Combine");
+        return parent + local;
+    };
+    ASSERT_THROW(hierarchy.Propagate(throwing, &pool), std::runtime_error);
+
+    hierarchy.SetLocal(width, 5);
+    hierarchy.Propagate(Combine, &pool);
+    CheckLayout(hierarchy);
+}
@@ -0,0 +1,138 @@
+#include "ecs/ecs.hpp"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <random>
+
+struct IndexNetworkId {
+    std::uint64_t value;
+};
+
+struct IndexTeam {
+    std::uint32_t id;
+    float score;
+};
+
+TEST(IndexTest, IndexTest1) {
+    ecs::Registry<std::uint32_t> reg;
+
+    std::vector<std::uint32_t> entities;
+    for (std::uint32_t i = 0; i < 100; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachComponents<IndexNetworkId, IndexTeam>(entity, {1000 + i}, {i % 4, 0.0f});
+        entities.push_back(entity);
+    }
+
+    const auto find_network_id = [&reg](const std::uint64_t value) {
+        return reg.FindBy<IndexNetworkId, &IndexNetworkId::value>(value);
+    };
+    const auto find_team = [&reg](const std::uint32_t id) {
+        return reg.FindBy<IndexTeam, &IndexTeam::id>(id);
+    };
+
+    // 第一次查找时建立索引
+    auto found = find_network_id(1042);
+    ASSERT_EQ(found.size(), 1);
+    ASSERT_EQ(found[0], entities[42]);
+    ASSERT_EQ(find_team(3).size(), 25);
+    ASSERT_TRUE(find_network_id(7).empty());
+
+    // 通过引用修改之后，下一次查找前更新
+    reg.GetMutableComponentReference<IndexNetworkId>(entities[42]).value = 7;
+    ASSERT_TRUE(find_network_id(1042).empty());
+    ASSERT_EQ(find_network_id(7).size(), 1);
+
+    // 挂载和卸载立即更新
+    reg.AttachComponent<IndexTeam>(entities[0], {3, 1.0f});
+    ASSERT_EQ(find_team(3).size(), 26);
+    reg.DestroyEntity(entities[3]);
+    reg.DetachComponent<IndexTeam>(entities[7]);
+    ASSERT_EQ(find_team(3).size(), 24);
+    ASSERT_EQ(find_team(0).size(), 24);
+
+    // 通过迭代器修改需要自己标记
+    auto& storage = reg.GetStorageOfComponent<IndexTeam>();
+    for (auto [entity, team] : storage) {
+        if (team.id == 2) {
+            team.id = 1;
+            storage.MarkComponentDirty(entity);
+        }
+    }
+    ASSERT_TRUE(find_team(2).empty());
+    ASSERT_EQ(find_team(1).size(), 50);
+
+    reg.RemoveIndex<IndexTeam, &IndexTeam::id>();
+    ASSERT_EQ(storage.FindIndex<&IndexTeam::id>(), nullptr);
+}
+
+TEST(IndexTest, IndexTestRandom) {
+    ecs::Storage<std::uint32_t, IndexTeam> storage;
+    auto& index = storage.AddIndex<&IndexTeam::id>();
+
+    std::mt19937 random(7);
+    for (std::size_t i = 0; i < 20000; ++i) {
+        const auto entity = static_cast<std::uint32_t>(random() % 512);
+        const auto team = static_cast<std::uint32_t>(random() % 8);
+        switch (random() % 3) {
+            case 0:
+                storage.Upsert(entity, {team, 0.0f});
+                break;
+            case 1:
+                storage.Pop(entity);
+                break;
+            default:
+                if (storage.Contains(entity)) storage.MutableComponentOf(entity).id = team;
+                break;
+        }
+    }
+
+    storage.RefreshIndices();
+    for (std::uint32_t team = 0; team < 8; ++team) {
+        std::vector<std::uint32_t> expected;
+        for (const auto [entity, component] : storage) {
+            if (component.id == team) expected.push_back(entity);
+        }
+        const auto found = index.Find(team);
+        std::vector<std::uint32_t> actual(found.begin(), found.end());
+        std::ranges::sort(expected);
+        std::ranges::sort(actual);
+        ASSERT_EQ(actual, expected);
+    }
+}
+
+TEST(IndexTest, IndexTestView) {
+    ecs::World<std::uint32_t> world;
+    auto& reg = world.registry();
+
+    std::vector<std::uint32_t> entities;
+    for (std::uint32_t i = 0; i < 1000; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachComponent<IndexTeam>(entity, {i % 4, 0.0f});
+        entities.push_back(entity);
+    }
+    ASSERT_EQ((reg.FindBy<IndexTeam, &IndexTeam::id>(3).size()), 250);
+
+    // 通过 View 修改组件之后，下一次查找前更新
+    auto view = world.viewer().View<std::tuple<IndexTeam>>();
+    while (auto res = view.Next()) {
+        auto& [team] = std::get<0>(*res);
+        if (team.id == 0) team.id = 3;
+    }
+    ASSERT_TRUE((reg.FindBy<IndexTeam, &IndexTeam::id>(0).empty()));
+    ASSERT_EQ((reg.FindBy<IndexTeam, &IndexTeam::id>(3).size()), 500);
+
+    // 通过 GetComponentReference 和组件的字节修改也一样
+    reg.GetComponentReference<IndexTeam>(entities[1]).id = 2;
+    constexpr std::uint32_t id = 2;
+    std::memcpy(reg.GetComponentBytes(entities[5], ecs::GetTypeId<IndexTeam>()), &id, sizeof(id));
+    ASSERT_EQ((reg.FindBy<IndexTeam, &IndexTeam::id>(1).size()), 248);
+    ASSERT_EQ((reg.FindBy<IndexTeam, &IndexTeam::id>(2).size()), 252);
+
+    // 之后新加入的实体也会被记录
+    const auto entity = reg.CreateEntity();
+    reg.AttachComponent<IndexTeam>(entity, {7, 0.0f});
+    reg.GetComponentReference<IndexTeam>(entity).id = 8;
+    ASSERT_TRUE((reg.FindBy<IndexTeam, &IndexTeam::id>(7).empty()));
+    ASSERT_EQ((reg.FindBy<IndexTeam, &IndexTeam::id>(8).size()), 1);
+}
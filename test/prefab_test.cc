@@ -0,0 +1,118 @@
+#include "ecs/ecs.hpp"
+
+#include <gtest/gtest.h>
+
+struct PrefabPosition {
+    float x;
+    float y;
+};
+
+struct PrefabHealth {
+    std::int32_t value;
+};
+
+enum class PrefabEntity : std::uint32_t {
+};
+
+TEST(PrefabTest, PrefabTestClone) {
+    ecs::Registry<std::uint32_t> reg;
+
+    const auto origin = reg.CreateEntity();
+    reg.AttachComponents(origin, PrefabPosition{1, 2}, PrefabHealth{100});
+    reg.SetDoubleBuffered<PrefabHealth>();
+
+    const auto clones = reg.Clone(origin, 1000);
+    ASSERT_EQ(clones.size(), 1000);
+    ASSERT_EQ(reg.EntityCount(), 1001);
+    ASSERT_EQ(reg.GetStorageOfComponent<PrefabPosition>().Size(), 1001);
+
+    for (const auto entity : clones) {
+        ASSERT_EQ(reg.GetComponentReference<PrefabPosition>(entity).y, 2);
+        ASSERT_EQ(reg.GetComponentReference<PrefabHealth>(entity).value, 100);
+        ASSERT_EQ(reg.GetPreviousComponentPointer<PrefabHealth>(entity)->value, 100);
+    }
+
+    // 克隆出来的实体和普通的实体一样可以销毁
+    reg.DestroyEntity(clones[10]);
+    ASSERT_FALSE(reg.ContainsComponent<PrefabHealth>(clones[10]));
+    ASSERT_EQ(reg.GetComponentReference<PrefabHealth>(clones[999]).value, 100);
+
+    // 运行时类型的组件也可以克隆
+    ecs::ComponentDescriptorRegistry<std::uint32_t> descriptors;
+    const auto& tag = descriptors.Register("Tag", 3, 1);
+    constexpr std::byte bytes[3]{std::byte{1}, std::byte{2}, std::byte{3}};
+    reg.AttachComponent(origin, tag, bytes);
+
+    const auto tagged = reg.Clone(origin, 37);
+    for (const auto entity : tagged) {
+        ASSERT_EQ(std::memcmp(reg.GetComponentBytes(entity, tag.type_id), bytes, 3), 0);
+    }
+}
+
+TEST(PrefabTest, PrefabTestShared) {
+    ecs::Registry<std::uint32_t> reg;
+
+    const auto origin = reg.CreateEntity();
+    reg.AttachComponent(origin, PrefabHealth{100});
+    reg.AttachSharedComponent(origin, PrefabPosition{1, 2});
+
+    // 共享组件按句柄复制，不会加入新的值
+    const auto clones = reg.Clone(origin, 100);
+    auto& storage = reg.GetOrCreateSharedStorage<PrefabPosition>();
+    ASSERT_EQ(storage.Size(), 101);
+    ASSERT_EQ(storage.ValueCount(), 1);
+    for (const auto entity : clones) {
+        ASSERT_EQ(reg.GetComponentReference<ecs::Shared<PrefabPosition>>(entity).y, 2);
+        ASSERT_EQ(reg.GetComponentReference<PrefabHealth>(entity).value, 100);
+    }
+
+    // 已经有共享组件的实体保持不变，其他实体逐个挂载
+    const auto other = reg.CreateEntity();
+    const auto fresh = reg.CreateEntity();
+    reg.AttachSharedComponent(other, PrefabPosition{5, 6});
+    reg.InstantiateInto(reg.MakePrefab(origin), std::vector{other, fresh});
+    ASSERT_EQ(reg.GetComponentReference<ecs::Shared<PrefabPosition>>(other).x, 5);
+    ASSERT_EQ(reg.GetComponentReference<ecs::Shared<PrefabPosition>>(fresh).x, 1);
+    ASSERT_EQ(storage.ValueCount(), 2);
+
+    // 不存在的句柄会抛出异常
+    ecs::Prefab<std::uint32_t> invalid;
+    constexpr std::uint32_t handle = 7;
+    invalid.Add(ecs::GetTypeId<ecs::Shared<PrefabPosition>>(), reinterpret_cast<const std::byte*>(&handle), sizeof(handle));
+    ASSERT_THROW(reg.Instantiate(invalid, 1), std::runtime_error);
+    ASSERT_EQ(storage.Size(), 103);
+}
+
+TEST(PrefabTest, PrefabTestCommands) {
+    ecs::World<PrefabEntity> world;
+    auto& commands = world.commands();
+    auto& reg = world.registry();
+
+    ecs::Prefab<PrefabEntity> prefab;
+    prefab.Add(PrefabPosition{3, 4}).Add(PrefabHealth{1}).Add(PrefabHealth{50});
+    ASSERT_EQ(prefab.Size(), 2);
+
+    // 在同一帧中就可以使用新实体，之后的命令在实例化之后执行
+    const auto entities = commands.Instantiate(prefab, 100);
+    commands.Attach(entities[0], PrefabHealth{7});
+    commands.Destroy(entities[1]);
+    commands.Detach<PrefabPosition>(entities[2]);
+    commands.Execute();
+
+    ASSERT_EQ(reg.EntityCount(), 99);
+    ASSERT_EQ(reg.GetComponentReference<PrefabHealth>(entities[0]).value, 7);
+    ASSERT_FALSE(reg.ContainsEntity(entities[1]));
+    ASSERT_FALSE(reg.ContainsComponent<PrefabPosition>(entities[2]));
+    ASSERT_EQ(reg.GetComponentReference<PrefabHealth>(entities[2]).value, 50);
+
+    for (std::size_t i = 3; i < entities.size(); ++i) {
+        ASSERT_EQ(reg.GetComponentReference<PrefabPosition>(entities[i]).x, 3);
+        ASSERT_EQ(reg.GetComponentReference<PrefabHealth>(entities[i]).value, 50);
+    }
+
+    // 缺少 Storage 的捕获组件会抛出异常，不会挂载任何组件
+    ecs::Registry<PrefabEntity> other;
+    const auto captured = reg.MakePrefab(entities[3]);
+    ASSERT_THROW(other.Instantiate(captured, 1), std::runtime_error);
+    ASSERT_EQ(other.StorageSize(), 0);
+}
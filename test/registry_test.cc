@@ -50,4 +50,94 @@ TEST(RegistryTest, RegistryTestDuplicate) {
     reg.DetachComponents(entity, my_component_type_id, my_component2_type_id);
 
     ASSERT_THROW(reg.DetachComponents(entity, my_component_type_id, my_component_type_id), std::runtime_error);
-}
\ No newline at end of file
+}
+
+TEST(RegistryTest, RegistryTestReserve) {
+    ecs::Registry<std::uint32_t> reg;
+    const auto entity = reg.CreateEntity();
+    reg.DestroyEntity(entity);
+
+    // 第一个预留的实体来自空闲列表，之后的是新实体
+    std::vector<std::uint32_t> reserved(64);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&reg, &reserved, t]() {
+            for (std::size_t i = t; i < reserved.size(); i += 4) {
+                reserved[i] = reg.ReserveEntity();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    ASSERT_EQ(reg.EntityCount(), 0);
+    reg.FlushReservedEntities();
+    ASSERT_EQ(reg.EntityCount(), reserved.size());
+
+    std::unordered_set<std::uint32_t> unique(reserved.begin(), reserved.end());
+    ASSERT_EQ(unique.size(), reserved.size());
+    ASSERT_TRUE(unique.contains(ecs::GenNextVersion<std::uint32_t>(entity)));
+
+    for (const auto reserved_entity : reserved) {
+        ASSERT_TRUE(reg.ContainsEntity(reserved_entity));
+    }
+
+    // 新创建的实体不能和预留的实体重复
+    ASSERT_FALSE(unique.contains(reg.CreateEntity()));
+}
+
+TEST(RegistryTest, RegistryTestMove) {
+    static_assert(std::is_nothrow_move_constructible_v<ecs::Registry<std::uint32_t>>);
+    static_assert(std::is_nothrow_move_assignable_v<ecs::Registry<std::uint32_t>>);
+
+    ecs::Registry<std::uint32_t> reg;
+    const auto entity = reg.CreateEntity();
+    reg.AttachComponent<MyComponent>(entity, {32});
+    reg.DestroyEntity(reg.CreateEntity());
+
+    // 移动之后预留的实体仍然先来自空闲列表
+    ecs::Registry<std::uint32_t> moved(std::move(reg));
+    const auto reserved = moved.ReserveEntity();
+    moved.FlushReservedEntities();
+    ASSERT_EQ(moved.EntityCount(), 2);
+    ASSERT_EQ(moved.GetStorageOfComponent<MyComponent>().ComponentOf(entity).value, 32);
+
+    ecs::Registry<std::uint32_t> assigned;
+    assigned = std::move(moved);
+    ASSERT_TRUE(assigned.ContainsEntity(reserved));
+    ASSERT_NE(assigned.CreateEntity(), reserved);
+    ASSERT_EQ(assigned.EntityCount(), 3);
+}
+
+TEST(RegistryTest, RegistryTestDoubleBuffered) {
+    ecs::Registry<std::uint32_t> reg;
+    reg.SetDoubleBuffered<MyComponent>();
+
+    const auto entity1 = reg.CreateEntity();
+    const auto entity2 = reg.CreateEntity();
+    reg.AttachComponent(entity1, MyComponent{1});
+    reg.AttachComponent(entity2, MyComponent{2});
+
+    // 新挂载的组件在两个缓冲区中都有
+    ASSERT_EQ(reg.GetPreviousComponentPointer<MyComponent>(entity1)->value, 1);
+
+    // 写入的是这一帧的缓冲区，读到的上一帧的值不变
+    reg.GetComponentReference<MyComponent>(entity1).value = reg.GetPreviousComponentPointer<MyComponent>(entity2)->value;
+    reg.GetComponentReference<MyComponent>(entity2).value = reg.GetPreviousComponentPointer<MyComponent>(entity1)->value;
+    ASSERT_EQ(reg.GetPreviousComponentPointer<MyComponent>(entity1)->value, 1);
+
+    reg.SwapComponentBuffers();
+    ASSERT_EQ(reg.GetPreviousComponentPointer<MyComponent>(entity1)->value, 2);
+    ASSERT_EQ(reg.GetPreviousComponentPointer<MyComponent>(entity2)->value, 1);
+
+    // 卸载时两个缓冲区保持一致
+    reg.DetachComponent<MyComponent>(entity1);
+    ASSERT_EQ(reg.GetPreviousComponentPointer<MyComponent>(entity1), nullptr);
+    ASSERT_EQ(reg.GetPreviousComponentPointer<MyComponent>(entity2)->value, 1);
+
+    // 不是双缓冲的组件读到的就是当前的值
+    reg.AttachComponent(entity2, MyComponent2{3});
+    reg.SwapComponentBuffers();
+    ASSERT_EQ(reg.GetPreviousComponentPointer<MyComponent2>(entity2)->value, 3);
+}
@@ -0,0 +1,148 @@
+#include "ecs/ecs.hpp"
+
+#include <gtest/gtest.h>
+
+struct MyComponent {
+    std::uint32_t value;
+};
+
+struct MyComponent2 {
+    std::uint64_t value;
+};
+
+struct MyResource {
+    std::uint32_t value;
+};
+
+enum class MyEntity : std::uint32_t {
+};
+
+
+TEST(ReplayTest, ReplayTest1) {
+    ecs::World<MyEntity> world;
+    ecs::CommandRecorder<MyEntity> recorder;
+
+    auto& commands = world.commands();
+    auto& reg = world.registry();
+    commands.SetRecorder(&recorder);
+
+    // 第一帧
+    const auto entity1 = commands.SpawnEntity<MyComponent, MyComponent2>(MyComponent{1}, MyComponent2{2});
+    const auto entity2 = commands.SpawnEntity<MyComponent>(MyComponent{3});
+    commands.AddResource(MyResource{4});
+    commands.Execute();
+
+    // 第二帧
+    commands.Detach<MyComponent2>(entity1)
+            .Attach<MyComponent>(entity1, MyComponent{5})
+            .Destroy(entity2);
+    const auto entity3 = commands.SpawnEntity<MyComponent2>(MyComponent2{6});
+    commands.Execute();
+
+    commands.SetRecorder(nullptr);
+    ASSERT_EQ(recorder.FrameCount(), 2);
+
+    ecs::World<MyEntity> replay_world;
+    ecs::CommandReplayer<MyEntity> replayer(recorder.Data());
+    replayer.RegisterComponent<MyComponent>()
+            .RegisterComponent<MyComponent2>()
+            .RegisterResource<MyResource>();
+
+    auto& replay_reg = replay_world.registry();
+
+    ASSERT_TRUE(replayer.ReplayFrame(replay_world));
+    ASSERT_EQ(replay_reg.GetStorageOfComponent<MyComponent>().Size(), 2);
+    ASSERT_EQ(replay_reg.GetComponentReference<MyComponent2>(replayer.MapEntity(entity1)).value, 2);
+
+    ASSERT_EQ(replayer.ReplayAll(replay_world), 1);
+    ASSERT_TRUE(replayer.Finished());
+    ASSERT_FALSE(replayer.ReplayFrame(replay_world));
+
+    // 回放之后的 World 和原来的 World 相同
+    ASSERT_EQ(replay_reg.GetStorageOfComponent<MyComponent>().Size(), reg.GetStorageOfComponent<MyComponent>().Size());
+    ASSERT_EQ(replay_reg.GetStorageOfComponent<MyComponent2>().Size(), reg.GetStorageOfComponent<MyComponent2>().Size());
+    ASSERT_EQ(replay_reg.GetComponentReference<MyComponent>(replayer.MapEntity(entity1)).value, 5);
+    ASSERT_FALSE(replay_reg.ContainsComponent<MyComponent2>(replayer.MapEntity(entity1)));
+    ASSERT_EQ(replay_reg.GetComponentReference<MyComponent2>(replayer.MapEntity(entity3)).value, 6);
+    ASSERT_THROW((void)replayer.MapEntity(entity2), std::runtime_error);
+}
+
+TEST(ReplayTest, ReplayTestInvalid) {
+    ecs::CommandRecorder<MyEntity> recorder;
+    ecs::World<MyEntity> world;
+    world.commands().SetRecorder(&recorder);
+    world.commands().Spawn<MyComponent>(MyComponent{1}).Execute();
+
+    // 没有注册组件类型时无法回放
+    ecs::World<MyEntity> replay_world;
+    ecs::CommandReplayer<MyEntity> replayer(recorder.Data());
+    ASSERT_THROW(replayer.ReplayAll(replay_world), std::runtime_error);
+
+    // 实体类型不同
+    ASSERT_THROW(ecs::CommandReplayer<std::uint64_t>(recorder.Data()), std::runtime_error);
+    ASSERT_THROW(ecs::CommandReplayer<MyEntity>(std::vector<std::byte>(3)), std::runtime_error);
+
+    // 不能平凡复制的资源可以添加，但是不能被记录
+    world.commands().SetRecorder(nullptr);
+    world.commands().AddResource(std::string("name")).Execute();
+    ASSERT_EQ(world.resources().GetResourceReference<std::string>(), "name");
+
+    // 记录时直接拒绝，不会在 Execute 的中途抛出异常
+    world.commands().SetRecorder(&recorder);
+    ASSERT_THROW(world.commands().AddResource(std::string("other")), std::runtime_error);
+    world.commands().Spawn<MyComponent>(MyComponent{2}).Execute();
+    ASSERT_EQ(world.resources().GetResourceReference<std::string>(), "name");
+    ASSERT_EQ(world.registry().GetStorageOfComponent<MyComponent>().Size(), 2);
+
+    // 还有没执行的这种命令时不能开始记录
+    world.commands().SetRecorder(nullptr);
+    world.commands().AddResource(std::string("other"));
+    ASSERT_THROW(world.commands().SetRecorder(&recorder), std::runtime_error);
+    world.commands().Execute();
+    ASSERT_EQ(world.resources().GetResourceReference<std::string>(), "other");
+    world.commands().SetRecorder(&recorder);
+}
+
+TEST(ReplayTest, ReplayTestPrefab) {
+    ecs::World<MyEntity> world;
+    ecs::CommandRecorder<MyEntity> recorder;
+    ecs::ComponentDescriptorRegistry<MyEntity> descriptors;
+    const auto& tag = descriptors.Register("Tag", 3, 1);
+    constexpr std::byte bytes[3]{std::byte{1}, std::byte{2}, std::byte{3}};
+
+    auto& reg = world.registry();
+    const auto origin = reg.CreateEntity();
+    reg.AttachComponent(origin, MyComponent{1});
+    reg.AttachSharedComponent(origin, MyComponent2{2});
+    reg.AttachComponent(origin, tag, bytes);
+
+    world.commands().SetRecorder(&recorder);
+    const auto entities = world.commands().Instantiate(reg.MakePrefab(origin), 10);
+    world.commands().Execute();
+    world.commands().SetRecorder(nullptr);
+
+    // 回放的 World 中没有原来的值表，共享组件按值重新挂载
+    ecs::World<MyEntity> replay_world;
+    auto& replay_reg = replay_world.registry();
+    replay_reg.AttachSharedComponent(replay_reg.CreateEntity(), MyComponent2{7});
+
+    ecs::CommandReplayer<MyEntity> replayer(recorder.Data());
+    replayer.RegisterComponent<MyComponent>()
+            .RegisterSharedComponent<MyComponent2>()
+            .RegisterComponent(tag);
+    ASSERT_EQ(replayer.ReplayAll(replay_world), 1);
+
+    for (const auto entity : entities) {
+        const auto replayed = replayer.MapEntity(entity);
+        ASSERT_EQ(replay_reg.GetComponentReference<MyComponent>(replayed).value, 1);
+        ASSERT_EQ(replay_reg.GetComponentReference<ecs::Shared<MyComponent2>>(replayed).value, 2);
+        ASSERT_EQ(std::memcmp(replay_reg.GetComponentBytes(replayed, tag.type_id), bytes, 3), 0);
+    }
+    ASSERT_EQ(replay_reg.GetOrCreateSharedStorage<MyComponent2>().ValueCount(), 2);
+
+    // 共享组件没有按共享组件注册时无法回放
+    ecs::World<MyEntity> other_world;
+    ecs::CommandReplayer<MyEntity> other(recorder.Data());
+    other.RegisterComponent<MyComponent>().RegisterComponent(tag);
+    ASSERT_THROW(other.ReplayAll(other_world), std::runtime_error);
+}
@@ -0,0 +1,75 @@
+#include "ecs/ecs.hpp"
+
+#include <gtest/gtest.h>
+
+struct ResourceTime {
+    double delta;
+};
+
+struct ResourceScore {
+    std::uint64_t value;
+};
+
+enum class ResourceEntity : std::uint32_t {
+};
+
+TEST(ResourceTest, ResourceTest1) {
+    ecs::Resources<ResourceEntity> resources;
+
+    ASSERT_EQ(resources.GetResourcePointer<ResourceTime>(), nullptr);
+
+    resources.UpsertResource(ResourceTime{0.5});
+    resources.UpsertResource(std::make_unique<int>(3));
+    ASSERT_EQ(resources.Size(), 2);
+    ASSERT_EQ(resources.GetResourceReference<ResourceTime>().delta, 0.5);
+    ASSERT_EQ(*resources.GetResourceReference<std::unique_ptr<int>>(), 3);
+
+    resources.UpsertResource(ResourceTime{0.25});
+    ASSERT_EQ(resources.Size(), 2);
+    ASSERT_EQ(resources.ReadResource<ResourceTime>()->delta, 0.25);
+
+    resources.RemoveResource<std::unique_ptr<int>>();
+    ASSERT_FALSE(resources.ContainsResource<std::unique_ptr<int>>());
+    ASSERT_EQ(resources.Size(), 1);
+
+    // 资源在 World 的命令中插入和删除
+    ecs::World<ResourceEntity> world;
+    world.commands().AddResource(ResourceScore{7}).Execute();
+    ASSERT_EQ(world.resources().GetResourceReference<ResourceScore>().value, 7);
+    world.commands().RemoveResource<ResourceScore>().Execute();
+    ASSERT_TRUE(world.resources().Empty());
+}
+
+TEST(ResourceTest, ResourceTestLocking) {
+    ecs::Resources<ResourceEntity> resources;
+    resources.UpsertResource(ResourceScore{0});
+    resources.SetResourceLocking<ResourceScore>(true);
+    ASSERT_TRUE(resources.IsResourceLocking<ResourceScore>());
+
+    constexpr std::size_t threads = 4;
+    constexpr std::size_t count = 10000;
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < threads; ++i) {
+        workers.emplace_back([&resources] {
+            for (std::size_t j = 0; j < count; ++j) {
+                resources.WriteResource<ResourceScore>()->value += 1;
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    ASSERT_EQ(resources.ReadResource<ResourceScore>()->value, threads * count);
+
+    // 串行执行的 Stage 中不加锁，持有写锁时也可以再次访问
+    ecs::Scheduler<ecs::Resources<ResourceEntity>&> scheduler(2);
+    scheduler.AddStageToBack();
+    scheduler.SetStageExecutionPolicy(0, ecs::ExecutionPolicy::Inline);
+    scheduler.AddSystemToFirstStage([](ecs::Resources<ResourceEntity>& res) {
+        const auto write = res.WriteResource<ResourceScore>();
+        write->value = res.ReadResource<ResourceScore>()->value + 1;
+    });
+    scheduler.Execute(resources);
+    ASSERT_EQ(resources.GetResourceReference<ResourceScore>().value, threads * count + 1);
+}
@@ -0,0 +1,270 @@
+#include "ecs/ecs.hpp"
+
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+
+struct MyComponent {
+    std::uint32_t value;
+};
+
+struct MyComponent2 {
+    std::uint64_t value;
+};
+
+enum class MyEntity : std::uint32_t {
+};
+
+namespace {
+using State = std::map<MyEntity, std::pair<std::optional<std::uint32_t>, std::optional<std::uint64_t>>>;
+
+State Capture(ecs::Registry<MyEntity>& reg) {
+    State state;
+    for (const auto entity : reg.GetAllEntities()) {
+        auto& [component, component2] = state[entity];
+        if (reg.ContainsComponent<MyComponent>(entity)) {
+            component = std::as_const(reg).GetStorageOfComponent<MyComponent>().ComponentOf(
+                ecs::GetId<MyEntity>(ecs::ToUnderlying<MyEntity>(entity))).value;
+        }
+        if (reg.ContainsComponent<MyComponent2>(entity)) {
+            component2 = reg.GetComponentReference<MyComponent2>(entity).value;
+        }
+    }
+    return state;
+}
+
+void Simulate(ecs::Registry<MyEntity>& reg, std::mt19937& random) {
+    auto entities = reg.GetAllEntities();
+    std::ranges::sort(entities);
+
+    for (int i = 0; i < 200; ++i) {
+        const auto op = random() % 6;
+        if (op == 0 || entities.empty()) {
+            const auto entity = reg.CreateEntity();
+            reg.AttachComponent(entity, MyComponent{static_cast<std::uint32_t>(random())});
+            entities.push_back(entity);
+            continue;
+        }
+
+        const auto index = random() % entities.size();
+        const auto entity = entities[index];
+        if (op == 1) {
+            reg.DestroyEntity(entity);
+            entities.erase(entities.begin() + static_cast<std::ptrdiff_t>(index));
+        } else if (op == 2) {
+            reg.AttachComponent(entity, MyComponent2{random()});
+        } else if (op == 3) {
+            reg.DetachComponent<MyComponent>(entity);
+        } else if (reg.ContainsComponent<MyComponent>(entity)) {
+            reg.GetMutableComponentReference<MyComponent>(entity).value = static_cast<std::uint32_t>(random());
+        }
+    }
+}
+} // namespace
+
+
+TEST(RollbackTest, RollbackTest1) {
+    ecs::Registry<MyEntity> reg;
+    std::mt19937 random(42);
+
+    for (int i = 0; i < 2000; ++i) {
+        reg.AttachComponent(reg.CreateEntity(), MyComponent{static_cast<std::uint32_t>(i)});
+    }
+
+    ecs::RollbackBuffer<MyEntity> rollback(reg, 4);
+    std::vector<State> states;
+
+    for (int frame = 0; frame < 6; ++frame) {
+        rollback.Checkpoint();
+        states.push_back(Capture(reg));
+        Simulate(reg, random);
+    }
+    ASSERT_EQ(rollback.Size(), 4);
+
+    // 撤销最近的检查点之后还没有保存的变化
+    rollback.Rewind();
+    ASSERT_EQ(Capture(reg), states[5]);
+
+    // 回到两个检查点之前，然后重新模拟
+    rollback.Rewind(2);
+    ASSERT_EQ(rollback.Size(), 2);
+    ASSERT_EQ(Capture(reg), states[3]);
+
+    Simulate(reg, random);
+    rollback.Checkpoint();
+    const auto resimulated = Capture(reg);
+    Simulate(reg, random);
+
+    rollback.Rewind();
+    ASSERT_EQ(Capture(reg), resimulated);
+
+    rollback.Rewind(1);
+    ASSERT_EQ(Capture(reg), states[3]);
+
+    ASSERT_THROW(rollback.Rewind(2), std::runtime_error);
+    rollback.Rewind(1);
+    ASSERT_EQ(Capture(reg), states[2]);
+    ASSERT_EQ(rollback.Size(), 1);
+}
+
+TEST(RollbackTest, RollbackTestLarge) {
+    // 超过一个页块，页块之间分别共享
+    ecs::Registry<MyEntity> reg;
+    std::vector<MyEntity> entities;
+    for (std::uint32_t i = 0; i < 40000; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachComponent(entity, MyComponent{i});
+        entities.push_back(entity);
+    }
+
+    ecs::RollbackBuffer<MyEntity> rollback(reg, 4);
+    std::vector<State> states;
+
+    rollback.Checkpoint();
+    states.push_back(Capture(reg));
+    reg.GetMutableComponentReference<MyComponent>(entities[39999]).value = 7;
+
+    rollback.Checkpoint();
+    states.push_back(Capture(reg));
+
+    // 截掉最后两个页块
+    for (std::uint32_t i = 10000; i < 40000; ++i) {
+        reg.DetachComponent<MyComponent>(entities[i]);
+    }
+    reg.GetMutableComponentReference<MyComponent>(entities[3]).value = 8;
+
+    rollback.Checkpoint();
+    states.push_back(Capture(reg));
+    for (std::uint32_t i = 20000; i < 30000; ++i) {
+        reg.AttachComponent(entities[i], MyComponent2{i});
+    }
+
+    rollback.Rewind();
+    ASSERT_EQ(Capture(reg), states[2]);
+
+    rollback.Rewind(1);
+    ASSERT_EQ(Capture(reg), states[1]);
+
+    rollback.Rewind(1);
+    ASSERT_EQ(Capture(reg), states[0]);
+}
+
+TEST(RollbackTest, RollbackTestSharedCompact) {
+    ecs::Registry<MyEntity> reg;
+    std::vector<MyEntity> entities;
+    for (std::uint32_t i = 0; i < 4; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachSharedComponent(entity, MyComponent{i});
+        entities.push_back(entity);
+    }
+
+    ecs::RollbackBuffer<MyEntity> rollback(reg, 2);
+    rollback.Checkpoint();
+
+    // 检查点中的句柄在 Compact 之后没有意义了，回滚失败时不修改 registry
+    reg.DetachComponent<ecs::Shared<MyComponent>>(entities[0]);
+    ASSERT_EQ(reg.GetOrCreateSharedStorage<MyComponent>().Compact(), 1);
+    ASSERT_THROW(rollback.Rewind(), std::runtime_error);
+    ASSERT_EQ(reg.GetComponentPointer<ecs::Shared<MyComponent>>(entities[0]), nullptr);
+    ASSERT_EQ(reg.GetComponentReference<ecs::Shared<MyComponent>>(entities[3]).value, 3);
+
+    rollback.Checkpoint();
+    reg.AttachSharedComponent(entities[1], MyComponent{9});
+    rollback.Rewind();
+    ASSERT_EQ(reg.GetComponentReference<ecs::Shared<MyComponent>>(entities[1]).value, 1);
+}
+
+TEST(RollbackTest, RollbackTestEntities) {
+    ecs::Registry<MyEntity> reg;
+    ecs::Registry<MyEntity> expected;
+
+    for (int i = 0; i < 10; ++i) {
+        reg.CreateEntity();
+        expected.CreateEntity();
+    }
+
+    ecs::RollbackBuffer<MyEntity> rollback(reg, 2);
+    rollback.Checkpoint();
+
+    reg.DestroyEntity(reg.GetAllEntities().front());
+    const auto entity = reg.CreateEntity();
+    reg.AttachComponent(entity, MyComponent{1});
+    reg.CreateEntity();
+    rollback.Rewind();
+
+    // 回滚之后实体的分配也和原来相同
+    ASSERT_EQ(reg.EntityCount(), 10);
+    ASSERT_EQ(reg.GetStorageOfComponent<MyComponent>().Size(), 0);
+    ASSERT_EQ(reg.CreateEntity(), expected.CreateEntity());
+    ASSERT_EQ(reg.CreateEntity(), expected.CreateEntity());
+}
+
+TEST(RollbackTest, RollbackTestViewWrites) {
+    ecs::World<MyEntity> world;
+    auto& reg = world.registry();
+
+    std::vector<MyEntity> entities;
+    for (std::uint32_t i = 0; i < 600; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachComponent(entity, MyComponent{i});
+        entities.push_back(entity);
+    }
+
+    ecs::RollbackBuffer<MyEntity> rollback(world, 2);
+    rollback.Checkpoint();
+
+    // 通过 GetComponentReference 和 View 的修改都要能被撤销
+    reg.GetComponentReference<MyComponent>(entities[5]).value = 99;
+    auto view = world.viewer().View<std::tuple<MyComponent>>();
+    while (auto res = view.Next()) {
+        std::get<0>(std::get<0>(*res)).value += 1000;
+    }
+
+    rollback.Rewind();
+    for (std::uint32_t i = 0; i < 600; ++i) {
+        ASSERT_EQ(reg.GetConstComponentReference<MyComponent>(entities[i]).value, i);
+    }
+}
+
+TEST(RollbackTest, RollbackTestResources) {
+    struct Score {
+        std::vector<int> values;
+    };
+
+    struct Seed {
+        std::uint64_t value;
+    };
+
+    ecs::World<MyEntity> world;
+    auto& resources = world.resources();
+
+    ecs::RollbackBuffer<MyEntity> rollback(world, 4);
+    rollback.TrackResource<Score>();
+    rollback.TrackResource<Seed>();
+
+    resources.UpsertResource(Score{{1, 2}});
+    rollback.Checkpoint();
+
+    resources.GetResourceReference<Score>().values.push_back(3);
+    resources.UpsertResource(Seed{7});
+    rollback.Checkpoint();
+
+    resources.RemoveResource<Score>();
+    resources.GetResourceReference<Seed>().value = 8;
+
+    // 回到最近的检查点
+    rollback.Rewind();
+    ASSERT_EQ(resources.GetResourceReference<Score>().values, std::vector<int>({1, 2, 3}));
+    ASSERT_EQ(resources.GetResourceReference<Seed>().value, 7);
+
+    // 回到第一个检查点，那时还没有 Seed
+    rollback.Rewind(1);
+    ASSERT_EQ(resources.GetResourceReference<Score>().values, std::vector<int>({1, 2}));
+    ASSERT_FALSE(resources.ContainsResource<Seed>());
+
+    // 没有给出 Resources 时不能登记资源
+    ecs::Registry<MyEntity> reg;
+    ecs::RollbackBuffer<MyEntity> registry_only(reg, 1);
+    ASSERT_THROW(registry_only.TrackResource<Seed>(), std::runtime_error);
+}
@@ -50,13 +50,13 @@ TEST(SchedulerTest, SchedulerTest1) {
     };
 
 
-    scheduler.AddSystem(system0);
-    scheduler.AddSystem(system1);
-    scheduler.AddSystem(system2);
-    scheduler.AddSystem(system3);
-    scheduler.AddSystem(system4);
-    scheduler.AddSystem(system5);
-    scheduler.AddSystem(system6);
+    scheduler.AddSystem(std::move(system0));
+    scheduler.AddSystem(std::move(system1));
+    scheduler.AddSystem(std::move(system2));
+    scheduler.AddSystem(std::move(system3));
+    scheduler.AddSystem(std::move(system4));
+    scheduler.AddSystem(std::move(system5));
+    scheduler.AddSystem(std::move(system6));
 
     scheduler.AddConstraint(0, 1);
     scheduler.AddConstraint(0, 2);
@@ -107,3 +107,316 @@ TEST(SchedulerTest, SchedulerTest1) {
 
     ASSERT_EQ(results[6], 6);
 }
+
+
+TEST(SchedulerTest, SchedulerTestInline) {
+    SchedulerType scheduler(4);
+    std::vector<int> results;
+    std::vector<std::thread::id> thread_ids;
+
+    for (int i = 0; i < 4; ++i) {
+        scheduler.AddSystem([&, i]() {
+            results.push_back(i);
+            thread_ids.push_back(std::this_thread::get_id());
+        });
+    }
+
+    // 0 -> 1 -> 2 -> 3，是一条单链
+    scheduler.AddConstraint(0, 1);
+    scheduler.AddConstraint(1, 2);
+    scheduler.AddConstraint(2, 3);
+
+    ASSERT_EQ(scheduler.GetExecutionPolicy(), ExecutionPolicy::Automatic);
+
+    scheduler.Execute();
+
+    ASSERT_EQ(results, std::vector<int>({0, 1, 2, 3}));
+    for (const auto thread_id : thread_ids) {
+        ASSERT_EQ(thread_id, std::this_thread::get_id());
+    }
+
+    results.clear();
+    thread_ids.clear();
+
+    scheduler.SetExecutionPolicy(ExecutionPolicy::Parallel);
+    scheduler.Execute();
+
+    ASSERT_EQ(results, std::vector<int>({0, 1, 2, 3}));
+    for (const auto thread_id : thread_ids) {
+        ASSERT_NE(thread_id, std::this_thread::get_id());
+    }
+}
+
+
+TEST(SchedulerTest, SchedulerTestWaitPolicy) {
+    SchedulerType scheduler(2);
+    std::atomic<int> count = 0;
+
+    scheduler.SetExecutionPolicy(ExecutionPolicy::Parallel);
+    scheduler.SetWaitPolicy({.spin_count = 16, .yield_count = 4});
+
+    ASSERT_EQ(scheduler.GetWaitPolicy().spin_count, 16);
+    ASSERT_EQ(scheduler.GetWaitPolicy().yield_count, 4);
+
+    for (int i = 0; i < 4; ++i) {
+        scheduler.AddSystem([&]() { ++count; });
+    }
+
+    // 一帧之内保持活跃，帧与帧之间休眠，线程池在多次执行之间是复用的
+    for (int frame = 0; frame < 8; ++frame) {
+        scheduler.KeepWorkersHot();
+        scheduler.Execute();
+        scheduler.ParkWorkers();
+    }
+
+    ASSERT_EQ(count, 32);
+}
+
+TEST(SchedulerTest, SchedulerTestWaitPolicyNoSpin) {
+    // 不忙等也不 yield 时，工作线程检查完队列就会立即休眠，提交的任务不能错过唤醒
+    internal::ThreadPool pool(2, {.spin_count = 0, .yield_count = 0});
+
+    for (int i = 0; i < 2000; ++i) {
+        auto result = pool.Enqueue([i] { return i; });
+        ASSERT_EQ(result.wait_for(std::chrono::seconds(5)), std::future_status::ready);
+        ASSERT_EQ(result.get(), i);
+    }
+
+    SchedulerType scheduler(2);
+    scheduler.SetExecutionPolicy(ExecutionPolicy::Parallel);
+    scheduler.SetWaitPolicy({.spin_count = 0, .yield_count = 0});
+    std::atomic<int> count = 0;
+    for (int i = 0; i < 4; ++i) {
+        scheduler.AddSystem([&]() { ++count; });
+    }
+    for (int frame = 0; frame < 500; ++frame) {
+        scheduler.Execute();
+    }
+    ASSERT_EQ(count, 2000);
+}
+
+
+TEST(SchedulerTest, SchedulerTestForkJoin) {
+    internal::ThreadPool pool(3);
+
+    std::vector<int> results(64, 0);
+    auto square = [&](const std::size_t index) { results[index] = static_cast<int>(index * index); };
+    internal::ForkJoin(pool, results.size(), square);
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        ASSERT_EQ(results[i], static_cast<int>(i * i));
+    }
+
+    // 工作线程的异常在当前线程上重新抛出
+    std::atomic<int> finished = 0;
+    auto worker_throws = [&](const std::size_t index) {
+        if (index == 5) throw std::runtime_error("worker");
+        ++finished;
+    };
+    ASSERT_THROW(internal::ForkJoin(pool, 16, worker_throws), std::runtime_error);
+    ASSERT_EQ(finished, 15);
+
+    // 当前线程抛出异常时，仍然要等其他任务结束之后才返回
+    finished = 0;
+    auto caller_throws = [&](const std::size_t index) {
+        if (index == 0) throw std::logic_error("caller");
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ++finished;
+    };
+    ASSERT_THROW(internal::ForkJoin(pool, 16, caller_throws), std::logic_error);
+    ASSERT_EQ(finished, 15);
+
+    // 线程池停止之后提交失败，不会一直等待没有提交的任务
+    pool.Stop();
+    finished = 0;
+    auto count = [&](const std::size_t) { ++finished; };
+    ASSERT_THROW(internal::ForkJoin(pool, 4, count), std::runtime_error);
+    ASSERT_EQ(finished, 0);
+}
+
+TEST(SchedulerTest, SchedulerTestCommandThreadPool) {
+    Scheduler<> scheduler(2);
+    ASSERT_EQ(scheduler.ThreadCount(), 2);
+    ASSERT_EQ(scheduler.GetCommandThreadPool(), nullptr);
+
+    // 逐个执行 Stage 时借用最后一个 Stage 的线程池，不会再新建一个
+    scheduler.AddStageToBack();
+    scheduler.AddStageToBack();
+    auto* pool = scheduler.GetCommandThreadPool();
+    ASSERT_NE(pool, nullptr);
+    ASSERT_NE(pool, &scheduler.GetSharedThreadPool());
+    ASSERT_EQ(pool->ThreadCount(), 2);
+    ASSERT_EQ(scheduler.GetCommandThreadPool(), pool);
+
+    scheduler.SetPipelined(true);
+    ASSERT_EQ(scheduler.GetCommandThreadPool(), &scheduler.GetSharedThreadPool());
+}
+
+TEST(SchedulerTest, SchedulerTestHotStages) {
+    Scheduler<> scheduler(2);
+    scheduler.AddStageToBack();
+    scheduler.AddStageToBack();
+    scheduler.AddStageToBack();
+    scheduler.SetStageExecutionPolicy(0, ExecutionPolicy::Inline);
+    scheduler.SetStageExecutionPolicy(1, ExecutionPolicy::Parallel);
+    scheduler.SetStageExecutionPolicy(2, ExecutionPolicy::Parallel);
+
+    std::array<std::atomic<bool>, 3> hot_during_stage0{};
+    std::array<std::atomic<bool>, 3> hot_during_stage1{};
+    const auto record = [&scheduler](std::array<std::atomic<bool>, 3>& hot) {
+        for (std::size_t i = 0; i < hot.size(); ++i) {
+            hot[i] = scheduler.AreStageWorkersHot(i);
+        }
+    };
+    scheduler.AddSystemToStage(0, [&] { record(hot_during_stage0); });
+    scheduler.AddSystemToStage(1, [&] { record(hot_during_stage1); });
+    scheduler.AddSystemToStage(2, [] {});
+
+    // 串行执行的 Stage 不需要线程池，只预热下一个会并行执行的 Stage
+    scheduler.KeepWorkersHot();
+    ASSERT_FALSE(scheduler.AreStageWorkersHot(0));
+    ASSERT_TRUE(scheduler.AreStageWorkersHot(1));
+    ASSERT_FALSE(scheduler.AreStageWorkersHot(2));
+
+    scheduler.Execute();
+    ASSERT_FALSE(hot_during_stage0[0]);
+    ASSERT_TRUE(hot_during_stage0[1]);
+    ASSERT_FALSE(hot_during_stage0[2]);
+
+    // 执行 Stage 1 时预热 Stage 2，执行完的 Stage 立即休眠
+    ASSERT_TRUE(hot_during_stage1[1]);
+    ASSERT_TRUE(hot_during_stage1[2]);
+    for (std::size_t i = 0; i < 3; ++i) {
+        ASSERT_FALSE(scheduler.AreStageWorkersHot(i));
+    }
+
+    scheduler.ParkWorkers();
+}
+
+TEST(SchedulerTest, SchedulerTestWorkerOptions) {
+    ASSERT_EQ(internal::ParseIdList("0-3,8,10-11"), std::vector<std::size_t>({0, 1, 2, 3, 8, 10, 11}));
+    ASSERT_EQ(internal::ParseIdList("0"), std::vector<std::size_t>({0}));
+    ASSERT_TRUE(internal::ParseIdList("").empty());
+
+    ASSERT_GE(GetNumaNodeCount(), 1);
+
+    // 绑定到当前线程允许使用的第一个 CPU，容器或 taskset 中不一定包含 CPU 0
+    int allowed_cpu = 0;
+#if defined(__linux__)
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    ASSERT_EQ(sched_getaffinity(0, sizeof(allowed), &allowed), 0);
+    while (!CPU_ISSET(allowed_cpu, &allowed)) {
+        ++allowed_cpu;
+    }
+#endif
+
+    SchedulerType scheduler(2);
+    scheduler.SetExecutionPolicy(ExecutionPolicy::Parallel);
+    scheduler.SetWorkerOptions({.cpus = {static_cast<std::size_t>(allowed_cpu)}, .name_prefix = "ecs-worker-"});
+
+    std::mutex mutex;
+    std::vector<int> cpus;
+    for (int i = 0; i < 4; ++i) {
+        scheduler.AddSystem([&]() {
+#if defined(__linux__)
+            std::lock_guard lock(mutex);
+            cpus.push_back(sched_getcpu());
+#endif
+        });
+    }
+
+    scheduler.Execute();
+
+#if defined(__linux__)
+    ASSERT_EQ(cpus, std::vector<int>(4, allowed_cpu));
+
+    // 无法绑定的 CPU 会在调用线程上报错，线程池停止
+    ASSERT_THROW(scheduler.SetWorkerOptions({.cpus = {CPU_SETSIZE}}), std::system_error);
+#endif
+}
+
+
+TEST(SchedulerTest, SchedulerTestPipelined) {
+    Scheduler<> scheduler(4);
+    const auto stage0 = scheduler.AddStageToBack();
+    const auto stage1 = scheduler.AddStageToBack();
+
+    std::mutex mutex;
+    std::vector<int> results;
+    const auto record = [&](const int value) {
+        std::lock_guard lock(mutex);
+        results.push_back(value);
+    };
+
+    // 打开之后，0 要等到 2 执行完才能完成，用来确认 2 没有等待 0
+    bool block_until_dependent = false;
+    std::condition_variable dependent_done;
+
+    // stage0: 0 和 1 互相独立；stage1: 2 只依赖 1
+    scheduler.AddSystemToStage(stage0, [&]() {
+        std::unique_lock lock(mutex);
+        if (block_until_dependent) {
+            dependent_done.wait(lock, [&] { return std::ranges::find(results, 2) != results.end(); });
+        }
+        results.push_back(0);
+    });
+    const auto fast = scheduler.AddSystemToStage(stage0, [&]() { record(1); });
+    const auto dependent = scheduler.AddSystemToStage(stage1, [&]() {
+        record(2);
+        dependent_done.notify_all();
+    });
+
+    scheduler.AddConstraint(fast, dependent);
+    ASSERT_TRUE(scheduler.ContainsConstraint(fast, dependent));
+    ASSERT_THROW(scheduler.AddConstraint(dependent, fast), std::runtime_error);
+
+    scheduler.SetPipelined(true);
+
+    // 默认仍然等待上一个 Stage 全部完成
+    scheduler.Execute();
+    ASSERT_EQ(results.size(), 3);
+    ASSERT_EQ(results[2], 2);
+
+    // 关闭屏障之后，2 只需要等待 1，可以在 0 完成之前执行，否则 0 会一直等待
+    results.clear();
+    block_until_dependent = true;
+    scheduler.SetStageWaitForPreviousStage(stage1, false);
+    scheduler.Execute();
+    ASSERT_EQ(results, std::vector<int>({1, 2, 0}));
+
+    // 删除 System 之后，跨 Stage 的约束也会被删除
+    scheduler.RemoveSystemFromStage(fast);
+    ASSERT_FALSE(scheduler.ContainsConstraint(fast, dependent));
+
+    results.clear();
+    scheduler.Execute();
+    ASSERT_EQ(results, std::vector<int>({2, 0}));
+}
+
+TEST(SchedulerTest, SchedulerTestPipelinedBarrier) {
+    // stage0: 0；stage1: 1，不等待；stage2: 空；stage3: 3
+    Scheduler<> scheduler(4);
+    for (int i = 0; i < 4; ++i) {
+        scheduler.AddStageToBack();
+    }
+    scheduler.SetStageWaitForPreviousStage(1, false);
+    scheduler.SetPipelined(true);
+
+    std::mutex mutex;
+    std::vector<int> results;
+    const auto record = [&](const int value) {
+        std::lock_guard lock(mutex);
+        results.push_back(value);
+    };
+    scheduler.AddSystemToStage(0, [&] { record(0); });
+    scheduler.AddSystemToStage(1, [&] { record(1); });
+    scheduler.AddSystemToStage(3, [&] { record(3); });
+
+    // 3 所在的 Stage 等待之前的所有 Stage，包括不等待的 stage1 和 stage1 之前的 stage0
+    for (int frame = 0; frame < 16; ++frame) {
+        results.clear();
+        scheduler.Execute();
+        ASSERT_EQ(results.size(), 3);
+        ASSERT_EQ(results.back(), 3);
+    }
+}
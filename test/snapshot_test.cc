@@ -0,0 +1,487 @@
+#include "ecs/ecs.hpp"
+
+#include <gtest/gtest.h>
+
+#include <sstream>
+
+struct MyComponent {
+    std::uint32_t value;
+};
+
+struct MyComponent2 {
+    std::uint64_t value;
+};
+
+enum class MyEntity : std::uint32_t {
+};
+
+
+TEST(SnapshotTest, SnapshotTest1) {
+    ecs::Registry<MyEntity> reg;
+
+    std::vector<MyEntity> entities;
+    for (std::uint32_t i = 0; i < 100; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachComponent(entity, MyComponent{i});
+        if (i % 3 == 0) {
+            reg.AttachComponent(entity, MyComponent2{i * 10ull});
+        }
+        entities.push_back(entity);
+    }
+
+    // 空闲列表和没有组件的实体也要保存下来
+    reg.DestroyEntity(entities[5]);
+    const auto empty_entity = reg.CreateEntity();
+    reg.DestroyEntity(entities[7]);
+
+    std::stringstream stream;
+    ecs::Snapshot<MyEntity>::Save(reg, stream);
+    const auto text = stream.str();
+    const auto* data = reinterpret_cast<const std::byte*>(text.data());
+
+    ecs::Registry<MyEntity> loaded;
+    loaded.CreateEntity();
+
+    ecs::Snapshot<MyEntity> snapshot;
+    snapshot.RegisterComponent<MyComponent>()
+            .RegisterComponent<MyComponent2>();
+    snapshot.Load(std::span(data, text.size()), loaded);
+
+    ASSERT_EQ(loaded.EntityCount(), reg.EntityCount());
+    ASSERT_TRUE(loaded.ContainsEntity(empty_entity));
+    ASSERT_FALSE(loaded.ContainsEntity(entities[7]));
+    ASSERT_EQ(loaded.GetStorageOfComponent<MyComponent>().Size(), 98);
+
+    for (std::uint32_t i = 0; i < 100; ++i) {
+        if (i == 7) continue;
+        const auto entity = entities[i];
+        if (i == 5) {
+            ASSERT_FALSE(loaded.ContainsComponent<MyComponent>(entity));
+            continue;
+        }
+        ASSERT_EQ(loaded.GetComponentReference<MyComponent>(entity).value, i);
+        ASSERT_EQ(loaded.ContainsComponent<MyComponent2>(entity), i % 3 == 0);
+    }
+
+    // 恢复之后实体的分配和原来的 registry 相同
+    ASSERT_EQ(loaded.CreateEntity(), reg.CreateEntity());
+    ASSERT_EQ(loaded.CreateEntity(), reg.CreateEntity());
+}
+
+TEST(SnapshotTest, SnapshotTestFile) {
+    ecs::Registry<MyEntity> reg;
+    const auto entity = reg.CreateEntity();
+    reg.AttachComponent(entity, MyComponent2{42});
+
+    const auto path = std::filesystem::temp_directory_path() / "ecs_snapshot_test.bin";
+    ecs::Snapshot<MyEntity>::Save(reg, path);
+
+    ecs::Registry<MyEntity> loaded;
+    ecs::Snapshot<MyEntity> snapshot;
+
+    // 没有注册组件类型时无法恢复
+    ASSERT_THROW(snapshot.Load(path, loaded), std::runtime_error);
+
+    snapshot.RegisterComponent<MyComponent2>();
+    snapshot.Load(path, loaded);
+    ASSERT_EQ(loaded.GetComponentReference<MyComponent2>(entity).value, 42);
+
+    std::filesystem::remove(path);
+}
+
+TEST(SnapshotTest, SnapshotTestInvalid) {
+    ecs::Registry<MyEntity> reg;
+    const auto entity = reg.CreateEntity();
+    reg.AttachComponent(entity, MyComponent{1});
+    reg.AttachComponent(entity, MyComponent2{2});
+
+    std::stringstream stream;
+    ecs::Snapshot<MyEntity>::Save(reg, stream);
+    const auto text = stream.str();
+    const auto as_bytes = [](const std::string& data) {
+        return std::span(reinterpret_cast<const std::byte*>(data.data()), data.size());
+    };
+
+    ecs::Registry<MyEntity> loaded;
+    const auto existing = loaded.CreateEntity();
+    loaded.CreateEntity();
+    loaded.AttachComponent(existing, MyComponent{7});
+
+    const auto check_unchanged = [&] {
+        ASSERT_EQ(loaded.EntityCount(), 2);
+        ASSERT_EQ(loaded.GetComponentReference<MyComponent>(existing).value, 7);
+        ASSERT_EQ(loaded.GetComponentPointer<MyComponent2>(existing), nullptr);
+    };
+
+    // 第二个 Storage 的类型没有注册，第一个 Storage 也不能被恢复
+    ecs::Snapshot<MyEntity> partial;
+    partial.RegisterComponent<MyComponent>();
+    ASSERT_THROW(partial.Load(as_bytes(text), loaded), std::runtime_error);
+    check_unchanged();
+
+    ecs::Snapshot<MyEntity> snapshot;
+    snapshot.RegisterComponent<MyComponent>()
+            .RegisterComponent<MyComponent2>();
+
+    // 截掉最后一个对齐的块
+    ASSERT_THROW(snapshot.Load(as_bytes(text.substr(0, text.size() - 64)), loaded), std::runtime_error);
+    check_unchanged();
+
+    // 文件头、实体和第一个 Storage 的头各占一个对齐的块，之后是它的 sparse_
+    auto corrupted = text;
+    const std::uint32_t index = 2;
+    std::memcpy(corrupted.data() + 3 * 64, &index, sizeof(index));
+    ASSERT_THROW(snapshot.Load(as_bytes(corrupted), loaded), std::runtime_error);
+    check_unchanged();
+
+    snapshot.Load(as_bytes(text), loaded);
+    ASSERT_EQ(loaded.EntityCount(), 1);
+    ASSERT_EQ(loaded.GetComponentReference<MyComponent2>(entity).value, 2);
+}
+
+TEST(SnapshotTest, SnapshotTestDelta) {
+    ecs::Registry<MyEntity> reg;
+
+    std::vector<MyEntity> entities;
+    for (std::uint32_t i = 0; i < 1000; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachComponent(entity, MyComponent{i});
+        entities.push_back(entity);
+    }
+
+    std::stringstream base;
+    ecs::Snapshot<MyEntity>::Save(reg, base);
+    reg.SetChangeTracking(true);
+
+    // 第一次增量：修改组件、销毁实体、创建实体、挂载新的组件
+    reg.GetMutableComponentReference<MyComponent>(entities[10]).value = 12345;
+    reg.DestroyEntity(entities[20]);
+    reg.DestroyEntity(entities[999]);
+    const auto created = reg.CreateEntity();
+    reg.AttachComponent(created, MyComponent2{7});
+    reg.AttachComponent(entities[30], MyComponent2{8});
+
+    std::stringstream delta1;
+    ecs::Snapshot<MyEntity>::SaveDelta(reg, delta1);
+
+    // 第二次增量：卸载组件、创建又销毁实体
+    reg.DetachComponent<MyComponent2>(entities[30]);
+    reg.DestroyEntity(reg.CreateEntity());
+    reg.DetachComponent<MyComponent>(entities[0]);
+
+    std::stringstream delta2;
+    ecs::Snapshot<MyEntity>::SaveDelta(reg, delta2);
+
+    // 增量快照的大小只和变化有关
+    ASSERT_LT(delta1.str().size(), base.str().size());
+    ASSERT_LT(delta2.str().size(), base.str().size());
+
+    ecs::Snapshot<MyEntity> snapshot;
+    snapshot.RegisterComponent<MyComponent>()
+            .RegisterComponent<MyComponent2>();
+
+    const auto base_data = base.str();
+    const auto delta1_data = delta1.str();
+    const auto delta2_data = delta2.str();
+    const auto as_bytes = [](const std::string& data) {
+        return std::span(reinterpret_cast<const std::byte*>(data.data()), data.size());
+    };
+
+    ecs::Registry<MyEntity> loaded;
+    snapshot.Load(as_bytes(base_data), loaded);
+    snapshot.LoadDelta(as_bytes(delta1_data), loaded);
+
+    ASSERT_EQ(loaded.GetComponentReference<MyComponent>(entities[10]).value, 12345);
+    ASSERT_FALSE(loaded.ContainsEntity(entities[20]));
+    ASSERT_EQ(loaded.GetComponentReference<MyComponent2>(created).value, 7);
+    ASSERT_EQ(loaded.GetComponentReference<MyComponent2>(entities[30]).value, 8);
+
+    snapshot.LoadDelta(as_bytes(delta2_data), loaded);
+
+    // 应用所有增量之后和原来的 registry 相同
+    ASSERT_EQ(loaded.EntityCount(), reg.EntityCount());
+    ASSERT_EQ(loaded.GetStorageOfComponent<MyComponent>().Size(), reg.GetStorageOfComponent<MyComponent>().Size());
+    ASSERT_EQ(loaded.GetStorageOfComponent<MyComponent2>().Size(), reg.GetStorageOfComponent<MyComponent2>().Size());
+    for (auto it = reg.EntityToComponentsBegin(); it != reg.EntityToComponentsEnd(); ++it) {
+        const auto entity = it->first;
+        ASSERT_TRUE(loaded.ContainsEntity(entity));
+        ASSERT_EQ(loaded.ContainsComponent<MyComponent>(entity), reg.ContainsComponent<MyComponent>(entity));
+        ASSERT_EQ(loaded.ContainsComponent<MyComponent2>(entity), reg.ContainsComponent<MyComponent2>(entity));
+        if (reg.ContainsComponent<MyComponent>(entity)) {
+            ASSERT_EQ(loaded.GetComponentReference<MyComponent>(entity).value,
+                      reg.GetComponentReference<MyComponent>(entity).value);
+        }
+    }
+    ASSERT_EQ(loaded.CreateEntity(), reg.CreateEntity());
+    ASSERT_EQ(loaded.CreateEntity(), reg.CreateEntity());
+}
+
+TEST(SnapshotTest, SnapshotTestDeltaReadOnly) {
+    ecs::World<MyEntity> world;
+    auto& reg = world.registry();
+
+    std::vector<MyEntity> entities;
+    for (std::uint32_t i = 0; i < 100; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachComponents(entity, MyComponent{i}, MyComponent2{i});
+        entities.push_back(entity);
+    }
+    reg.SetChangeTracking(true);
+
+    std::stringstream empty;
+    ecs::Snapshot<MyEntity>::SaveDelta(reg, empty);
+
+    // 只读的 View 和 GetConstComponentReference 不会被记录为修改
+    std::uint64_t sum = 0;
+    auto view = world.viewer().View<std::tuple<const MyComponent, const MyComponent2>>();
+    while (auto res = view.Next()) {
+        const auto& [component1, component2] = std::get<0>(*res);
+        sum += component1.value + component2.value;
+    }
+    sum += reg.GetConstComponentReference<MyComponent>(entities[1]).value;
+    ASSERT_EQ(sum, 9901);
+    ASSERT_FALSE(reg.GetStorageOfComponent<MyComponent>().HasChanges());
+    ASSERT_FALSE(reg.GetStorageOfComponent<MyComponent2>().HasChanges());
+
+    std::stringstream delta;
+    ecs::Snapshot<MyEntity>::SaveDelta(reg, delta);
+    ASSERT_EQ(delta.str(), empty.str());
+
+    // 通过 GetMutableComponentReference 的修改会被记录
+    reg.GetMutableComponentReference<MyComponent>(entities[1]).value = 7;
+    ASSERT_TRUE(reg.GetStorageOfComponent<MyComponent>().HasChanges());
+    ASSERT_FALSE(reg.GetStorageOfComponent<MyComponent2>().HasChanges());
+}
+
+TEST(SnapshotTest, SnapshotTestDeltaView) {
+    ecs::World<MyEntity> world;
+    auto& reg = world.registry();
+
+    std::vector<MyEntity> entities;
+    for (std::uint32_t i = 0; i < 1000; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachComponents(entity, MyComponent{i}, MyComponent2{i});
+        entities.push_back(entity);
+    }
+
+    std::stringstream base;
+    ecs::Snapshot<MyEntity>::Save(reg, base);
+    reg.SetChangeTracking(true);
+
+    // System 通过 View 修改组件，只读的 MyComponent2 不会被记录
+    auto view = world.viewer().ViewWithEntity<std::tuple<MyComponent, const MyComponent2>>();
+    while (auto res = view.Next()) {
+        auto& [component1, component2] = std::get<1>(*res);
+        if (std::get<0>(*res) == entities[600]) {
+            component1.value = 4321 + static_cast<std::uint32_t>(component2.value);
+        }
+    }
+    ASSERT_TRUE(reg.GetStorageOfComponent<MyComponent>().HasChanges());
+    ASSERT_FALSE(reg.GetStorageOfComponent<MyComponent2>().HasChanges());
+
+    std::stringstream delta;
+    ecs::Snapshot<MyEntity>::SaveDelta(reg, delta);
+
+    ecs::Snapshot<MyEntity> snapshot;
+    snapshot.RegisterComponent<MyComponent>()
+            .RegisterComponent<MyComponent2>();
+
+    const auto base_data = base.str();
+    const auto delta_data = delta.str();
+    const auto as_bytes = [](const std::string& data) {
+        return std::span(reinterpret_cast<const std::byte*>(data.data()), data.size());
+    };
+
+    ecs::Registry<MyEntity> loaded;
+    snapshot.Load(as_bytes(base_data), loaded);
+    snapshot.LoadDelta(as_bytes(delta_data), loaded);
+
+    ASSERT_EQ(loaded.GetConstComponentReference<MyComponent>(entities[600]).value, 4921);
+    for (std::uint32_t i = 0; i < 1000; ++i) {
+        ASSERT_EQ(loaded.GetConstComponentReference<MyComponent>(entities[i]).value,
+                  reg.GetConstComponentReference<MyComponent>(entities[i]).value);
+    }
+}
+
+TEST(SnapshotTest, SnapshotTestShared) {
+    ecs::Registry<MyEntity> reg;
+
+    std::vector<MyEntity> entities;
+    for (std::uint32_t i = 0; i < 600; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachSharedComponent(entity, MyComponent{i % 4});
+        entities.push_back(entity);
+    }
+
+    std::stringstream base;
+    ecs::Snapshot<MyEntity>::Save(reg, base);
+    reg.SetChangeTracking(true);
+
+    // 新的值只在增量快照中出现
+    reg.AttachSharedComponent(entities[500], MyComponent{99});
+    reg.DetachComponent<ecs::Shared<MyComponent>>(entities[1]);
+
+    std::stringstream delta;
+    ecs::Snapshot<MyEntity>::SaveDelta(reg, delta);
+
+    const auto base_data = base.str();
+    const auto delta_data = delta.str();
+    const auto as_bytes = [](const std::string& data) {
+        return std::span(reinterpret_cast<const std::byte*>(data.data()), data.size());
+    };
+
+    // 普通组件的注册方式无法恢复共享组件
+    ecs::Registry<MyEntity> unregistered;
+    ASSERT_THROW(ecs::Snapshot<MyEntity>().Load(as_bytes(base_data), unregistered), std::runtime_error);
+
+    ecs::Snapshot<MyEntity> snapshot;
+    snapshot.RegisterSharedComponent<MyComponent>();
+
+    ecs::Registry<MyEntity> loaded;
+    snapshot.Load(as_bytes(base_data), loaded);
+    ASSERT_EQ(loaded.GetOrCreateSharedStorage<MyComponent>().ValueCount(), 4);
+    ASSERT_EQ(loaded.GetComponentReference<ecs::Shared<MyComponent>>(entities[6]).value, 2);
+
+    snapshot.LoadDelta(as_bytes(delta_data), loaded);
+    ASSERT_EQ(loaded.GetOrCreateSharedStorage<MyComponent>().ValueCount(), 5);
+    ASSERT_EQ(loaded.GetComponentPointer<ecs::Shared<MyComponent>>(entities[1]), nullptr);
+    for (std::uint32_t i = 0; i < 600; ++i) {
+        if (i == 1) continue;
+        ASSERT_EQ(loaded.GetComponentReference<ecs::Shared<MyComponent>>(entities[i]).value,
+                  reg.GetComponentReference<ecs::Shared<MyComponent>>(entities[i]).value);
+    }
+
+    // 恢复的值表和原来的去重结果相同，相同的值得到相同的句柄
+    auto& storage = loaded.GetOrCreateSharedStorage<MyComponent>();
+    ASSERT_EQ(storage.Intern(MyComponent{99}), reg.GetOrCreateSharedStorage<MyComponent>().Intern(MyComponent{99}));
+
+    // 句柄超出值表时不会修改 Storage
+    const typename ecs::SharedStorage<MyEntity, MyComponent>::HandleType handle = 100;
+    const auto entity = static_cast<MyEntity>(0);
+    ASSERT_THROW(storage.WritePacked(0, std::span(&entity, 1), reinterpret_cast<const std::byte*>(&handle)),
+                 std::runtime_error);
+    ASSERT_EQ(loaded.GetComponentReference<ecs::Shared<MyComponent>>(entities[0]).value, 0);
+}
+
+TEST(SnapshotTest, SnapshotTestSharedCompact) {
+    ecs::Registry<MyEntity> reg;
+
+    std::vector<MyEntity> entities;
+    for (std::uint32_t i = 0; i < 10; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachSharedComponent(entity, MyComponent{i});
+        entities.push_back(entity);
+    }
+
+    std::stringstream base;
+    ecs::Snapshot<MyEntity>::Save(reg, base);
+    reg.SetChangeTracking(true);
+
+    // 卸载之后值还在值表中，Compact 之后才删除，剩下的值重新编号
+    for (std::uint32_t i = 0; i < 5; ++i) {
+        reg.DetachComponent<ecs::Shared<MyComponent>>(entities[i]);
+    }
+    auto& storage = reg.GetOrCreateSharedStorage<MyComponent>();
+    ASSERT_EQ(storage.ValueCount(), 10);
+    ASSERT_EQ(storage.Compact(), 5);
+    ASSERT_EQ(storage.Compact(), 0);
+    ASSERT_EQ(storage.ValueCount(), 5);
+    ASSERT_EQ(storage.ValueGeneration(), 1);
+    for (std::uint32_t i = 5; i < 10; ++i) {
+        ASSERT_EQ(reg.GetComponentReference<ecs::Shared<MyComponent>>(entities[i]).value, i);
+    }
+    ASSERT_EQ(storage.Intern(MyComponent{7}), 2);
+    ASSERT_EQ(storage.Intern(MyComponent{0}), 5);
+    reg.AttachSharedComponent(entities[0], MyComponent{0});
+
+    // 增量快照写出整个值表，加载时替换原来的值表
+    std::stringstream delta;
+    ecs::Snapshot<MyEntity>::SaveDelta(reg, delta);
+
+    const auto base_data = base.str();
+    const auto delta_data = delta.str();
+    const auto as_bytes = [](const std::string& data) {
+        return std::span(reinterpret_cast<const std::byte*>(data.data()), data.size());
+    };
+
+    ecs::Snapshot<MyEntity> snapshot;
+    snapshot.RegisterSharedComponent<MyComponent>();
+
+    ecs::Registry<MyEntity> loaded;
+    snapshot.Load(as_bytes(base_data), loaded);
+    snapshot.LoadDelta(as_bytes(delta_data), loaded);
+
+    auto& loaded_storage = loaded.GetOrCreateSharedStorage<MyComponent>();
+    ASSERT_EQ(loaded_storage.ValueCount(), 6);
+    ASSERT_EQ(loaded_storage.Intern(MyComponent{9}), storage.Intern(MyComponent{9}));
+    for (std::uint32_t i = 0; i < 10; ++i) {
+        const auto* component = loaded.GetComponentPointer<ecs::Shared<MyComponent>>(entities[i]);
+        if (i >= 1 && i < 5) {
+            ASSERT_EQ(component, nullptr);
+        } else {
+            ASSERT_EQ(component->value, i);
+        }
+    }
+}
+
+TEST(SnapshotTest, SnapshotTestDescriptor) {
+    ecs::ComponentDescriptorRegistry<MyEntity> descriptors;
+    const auto& health = descriptors.Register("Health", sizeof(std::int32_t), alignof(std::int32_t));
+    const auto& component = descriptors.Register<MyComponent>("MyComponent");
+
+    ecs::Registry<MyEntity> reg;
+    std::vector<MyEntity> entities;
+    for (std::int32_t i = 0; i < 100; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachComponent(entity, health, reinterpret_cast<const std::byte*>(&i));
+        reg.AttachComponent(entity, MyComponent{static_cast<std::uint32_t>(i) * 2});
+        entities.push_back(entity);
+    }
+
+    std::stringstream stream;
+    ecs::Snapshot<MyEntity>::Save(reg, stream);
+    const auto text = stream.str();
+    const auto data = std::span(reinterpret_cast<const std::byte*>(text.data()), text.size());
+
+    // 运行时类型只能按描述注册
+    ecs::Snapshot<MyEntity> snapshot;
+    snapshot.RegisterComponent(component);
+    ecs::Registry<MyEntity> loaded;
+    ASSERT_THROW(snapshot.Load(data, loaded), std::runtime_error);
+
+    snapshot.RegisterComponent(health);
+    snapshot.Load(data, loaded);
+    for (std::int32_t i = 0; i < 100; ++i) {
+        std::int32_t value = 0;
+        std::memcpy(&value, loaded.GetComponentBytes(entities[i], health.type_id), sizeof(value));
+        ASSERT_EQ(value, i);
+
+        // 编译期类型按描述注册之后，也可以用模板访问
+        ASSERT_EQ(loaded.GetComponentReference<MyComponent>(entities[i]).value, static_cast<std::uint32_t>(i) * 2);
+    }
+}
+
+TEST(SnapshotTest, SnapshotTestDoubleBuffered) {
+    ecs::Registry<MyEntity> reg;
+    const auto entity = reg.CreateEntity();
+    reg.AttachComponent(entity, MyComponent{1});
+
+    std::stringstream stream;
+    ecs::Snapshot<MyEntity>::Save(reg, stream);
+    const auto text = stream.str();
+
+    ecs::Registry<MyEntity> loaded;
+    loaded.SetDoubleBuffered<MyComponent>();
+
+    ecs::Snapshot<MyEntity> snapshot;
+    snapshot.RegisterComponent<MyComponent>();
+    snapshot.Load(std::span(reinterpret_cast<const std::byte*>(text.data()), text.size()), loaded);
+
+    // 恢复之后仍然是双缓冲的，两个缓冲区都是快照中的值
+    ASSERT_TRUE(loaded.GetStorageOfComponent<MyComponent>().IsDoubleBuffered());
+    loaded.GetComponentReference<MyComponent>(entity).value = 2;
+    ASSERT_EQ(loaded.GetPreviousComponentPointer<MyComponent>(entity)->value, 1);
+
+    loaded.SwapComponentBuffers();
+    ASSERT_EQ(loaded.GetPreviousComponentPointer<MyComponent>(entity)->value, 2);
+}
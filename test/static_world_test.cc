@@ -0,0 +1,117 @@
+#include "ecs/ecs.hpp"
+
+#include <gtest/gtest.h>
+
+struct StaticPosition {
+    float x;
+    float y;
+};
+
+struct StaticVelocity {
+    float x;
+    float y;
+};
+
+struct StaticHealth {
+    std::int32_t value;
+};
+
+using TestStaticWorld = ecs::StaticWorld<ecs::EntityU32Enum, StaticPosition, StaticVelocity, StaticHealth>;
+
+static_assert(TestStaticWorld::has_component_k<StaticHealth>);
+static_assert(!TestStaticWorld::has_component_k<int>);
+
+TEST(StaticWorldTest, StaticWorldTest1) {
+    TestStaticWorld world;
+
+    const auto entity = world.CreateEntity();
+    world.AttachComponents(entity, StaticPosition{1, 2}, StaticVelocity{3, 4});
+
+    ASSERT_TRUE(world.ContainsEntity(entity));
+    ASSERT_TRUE((world.ContainsAllComponents<StaticPosition, StaticVelocity>(entity)));
+    ASSERT_FALSE(world.ContainsComponent<StaticHealth>(entity));
+    ASSERT_EQ(world.GetComponentReference<StaticVelocity>(entity).x, 3);
+    ASSERT_EQ(world.GetComponentPointer<StaticHealth>(entity), nullptr);
+
+    world.DetachComponent<StaticVelocity>(entity);
+    ASSERT_FALSE(world.ContainsComponent<StaticVelocity>(entity));
+    ASSERT_EQ(world.GetStorageOfComponent<StaticVelocity>().Size(), 0);
+
+    world.DestroyEntity(entity);
+    ASSERT_FALSE(world.ContainsEntity(entity));
+    ASSERT_EQ(world.EntityCount(), 0);
+    ASSERT_EQ(world.GetStorageOfComponent<StaticPosition>().Size(), 0);
+    ASSERT_THROW(world.AttachComponent(entity, StaticHealth{1}), std::runtime_error);
+
+    const auto entity2 = world.CreateEntity();
+    ASSERT_NE(entity, entity2);
+    ASSERT_FALSE(world.ContainsComponent<StaticPosition>(entity2));
+}
+
+TEST(StaticWorldTest, StaticWorldTestEach) {
+    TestStaticWorld world;
+
+    for (std::uint32_t i = 0; i < 100; ++i) {
+        const auto entity = world.CreateEntity();
+        world.AttachComponent(entity, StaticPosition{0, 0});
+        if (i % 4 == 0) {
+            world.AttachComponent(entity, StaticVelocity{1, 2});
+        }
+    }
+
+    std::size_t count = 0;
+    world.Each<StaticPosition, StaticVelocity>([&](const ecs::EntityU32Enum,
+                                                   StaticPosition& position,
+                                                   const StaticVelocity& velocity) {
+        position.x += velocity.x;
+        position.y += velocity.y;
+        ++count;
+    });
+    ASSERT_EQ(count, 25);
+
+    float sum = 0;
+    world.Each<StaticPosition>([&](const ecs::EntityU32Enum, const StaticPosition& position) {
+        sum += position.x + position.y;
+    });
+    ASSERT_EQ(sum, 75);
+}
+
+TEST(StaticWorldTest, StaticWorldTestMove) {
+    TestStaticWorld source;
+
+    std::vector<ecs::EntityU32Enum> entities;
+    for (std::uint32_t i = 0; i < 50; ++i) {
+        const auto entity = source.CreateEntity();
+        source.AttachComponent(entity, StaticPosition{static_cast<float>(i), 0});
+        if (i % 2 == 0) {
+            source.AttachComponent(entity, StaticHealth{static_cast<std::int32_t>(i)});
+        }
+        entities.push_back(entity);
+    }
+
+    TestStaticWorld target;
+    const auto stale = target.CreateEntity();
+    target.AttachComponent(stale, StaticVelocity{1, 1});
+
+    target = std::move(source);
+    ASSERT_EQ(target.EntityCount(), 50);
+    ASSERT_EQ(target.GetStorageOfComponent<StaticPosition>().Size(), 50);
+    ASSERT_EQ(target.GetStorageOfComponent<StaticHealth>().Size(), 25);
+    ASSERT_EQ(target.GetStorageOfComponent<StaticVelocity>().Size(), 0);
+    for (std::uint32_t i = 0; i < 50; ++i) {
+        ASSERT_EQ(target.GetComponentReference<StaticPosition>(entities[i]).x, static_cast<float>(i));
+        ASSERT_EQ(target.ContainsComponent<StaticHealth>(entities[i]), i % 2 == 0);
+    }
+
+    TestStaticWorld moved(std::move(target));
+    std::int32_t sum = 0;
+    moved.Each<StaticHealth>([&](const ecs::EntityU32Enum, const StaticHealth& health) {
+        sum += health.value;
+    });
+    ASSERT_EQ(sum, 600);
+
+    moved.DestroyEntity(entities[0]);
+    moved.AttachComponent(entities[1], StaticHealth{7});
+    ASSERT_EQ(moved.GetStorageOfComponent<StaticHealth>().Size(), 25);
+    ASSERT_EQ(moved.GetComponentReference<StaticHealth>(entities[1]).value, 7);
+}
@@ -32,4 +32,31 @@ TEST(StorageTest, StorageTest1) {
     // for (const auto entity : storage.ToBasicStorage()) {
     //     std::cout << entity << std::endl;
     // }
-}
\ No newline at end of file
+}
+TEST(StorageTest, StorageTestPop) {
+    ecs::Storage<std::uint32_t, MyComponent> storage;
+    storage.SetDoubleBuffered(true);
+
+    for (std::uint32_t i = 0; i < 1000; ++i) {
+        storage.Upsert(i, MyComponent{i});
+    }
+    storage.SwapBuffers();
+    for (std::uint32_t i = 0; i < 1000; ++i) {
+        storage.ComponentOf(i).value = i * 2;
+    }
+
+    // 通过基类删除，组件按字节移动
+    auto& basic = storage.ToBasicStorage();
+    ASSERT_EQ(basic.ComponentSize(), sizeof(MyComponent));
+    for (std::uint32_t i = 0; i < 1000; i += 3) {
+        basic.Pop(i);
+    }
+
+    ASSERT_EQ(storage.Size(), 666);
+    for (std::uint32_t i = 0; i < 1000; ++i) {
+        ASSERT_EQ(storage.Contains(i), i % 3 != 0);
+        if (i % 3 == 0) continue;
+        ASSERT_EQ(storage.ComponentOf(i).value, i * 2);
+        ASSERT_EQ(storage.PreviousComponentOf(i).value, i);
+    }
+}
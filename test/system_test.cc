@@ -20,8 +20,8 @@ TEST(SystemTest, SystemTest1) {
 
 
     SystemGraphType graph;
-    const auto id1 = graph.AddSystem(system1);
-    const auto id2 = graph.AddSystem(system2);
+    const auto id1 = graph.AddSystem(std::move(system1));
+    const auto id2 = graph.AddSystem(std::move(system2));
 
     graph.AddConstraint(id1, id2);
 
@@ -38,7 +38,7 @@ TEST(SystemTest, SystemTest1) {
 
 
 TEST(SystemTest, SystemTestCycle) {
-    const std::array<SystemType, 5> systems = {
+    std::array<SystemType, 5> systems = {
         []() {
             std::cout << "System1" << std::endl;
         },
@@ -61,8 +61,8 @@ TEST(SystemTest, SystemTestCycle) {
     };
 
     SystemGraphType graph;
-    for (const auto& system : systems) {
-        graph.AddSystem(system);
+    for (auto& system : systems) {
+        graph.AddSystem(std::move(system));
     }
 
     for (const auto& [from, to] : constraints) {
@@ -104,4 +104,7 @@ TEST(SystemTest, SystemTest2) {
     ASSERT_THROW(graph.AddConstraint(0, 0), std::runtime_error);
     ASSERT_THROW(graph.AddConstraint(1, 1), std::runtime_error);
 
+    ASSERT_THROW(graph.AddSystem(SystemType{}), std::runtime_error);
+    ASSERT_EQ(graph.Size(), 8);
+
 }
\ No newline at end of file
@@ -70,3 +70,70 @@ TEST(ViewerTest, ViewerTest1) {
     ASSERT_EQ(results2[0], std::make_tuple(MyComponent{32}, std::optional<MyComponent2>{MyComponent2{64}}));
     ASSERT_EQ(results2[1], std::make_tuple(MyComponent{128}, std::optional<MyComponent2>{std::nullopt}));
 }
+
+struct MyMaterial {
+    float color[4];
+    std::uint32_t texture;
+};
+
+TEST(ViewerTest, ViewerTestShared) {
+    ecs::World<MyEntity> world;
+
+    auto& reg = world.registry();
+    std::vector<MyEntity> entities;
+    for (std::uint32_t i = 0; i < 100; ++i) {
+        const auto entity = reg.CreateEntity();
+        reg.AttachComponent<MyComponent>(entity, {i});
+        reg.AttachSharedComponent(entity, MyMaterial{{1, 1, 1, 1}, i % 3});
+        entities.push_back(entity);
+    }
+    reg.DetachComponent<ecs::Shared<MyMaterial>>(entities[0]);
+    reg.DestroyEntity(entities[1]);
+
+    // 相同的值只存一份
+    auto& storage = reg.GetOrCreateSharedStorage<MyMaterial>();
+    ASSERT_EQ(storage.ValueCount(), 3);
+    ASSERT_EQ(storage.Size(), 98);
+
+    const MyMaterial& material = reg.GetComponentReference<ecs::Shared<MyMaterial>>(entities[5]);
+    ASSERT_EQ(material.texture, 2);
+    ASSERT_EQ(reg.GetComponentPointer<ecs::Shared<MyMaterial>>(entities[0]), nullptr);
+
+    auto& viewer = world.viewer();
+    std::size_t count = 0;
+    auto view = viewer.View<std::tuple<MyComponent, ecs::Shared<MyMaterial>>>();
+    for (auto [required, optional] : view) {
+        const auto& [component, shared] = required;
+        static_assert(std::is_same_v<decltype(shared), const MyMaterial&>);
+        ASSERT_EQ(shared.texture, component.value % 3);
+        ++count;
+    }
+    ASSERT_EQ(count, 98);
+
+    // 按值分组，每组的实体是连续的，不会重新排列 Storage
+    const auto packed = storage.PackedEntities();
+    std::size_t groups = 0;
+    count = 0;
+    viewer.EachSharedGroup<MyMaterial>([&](const MyMaterial& value, std::span<const MyEntity> group) {
+        for (const auto entity : group) {
+            ASSERT_EQ(reg.GetComponentReference<MyComponent>(entity).value % 3, value.texture);
+        }
+        count += group.size();
+        ++groups;
+    });
+    ASSERT_EQ(groups, 3);
+    ASSERT_EQ(count, 98);
+    ASSERT_EQ(storage.PackedEntities(), packed);
+
+    // 排好序之后直接使用 Storage 中的实体
+    storage.SortByValue();
+    const auto& sorted = storage.PackedEntities();
+    groups = 0;
+    viewer.EachSharedGroup<MyMaterial>([&](const MyMaterial&, std::span<const MyEntity> group) {
+        ASSERT_GE(group.data(), sorted.data());
+        ASSERT_LE(group.data() + group.size(), sorted.data() + sorted.size());
+        ++groups;
+    });
+    ASSERT_EQ(groups, 3);
+    ASSERT_EQ(reg.GetComponentReference<ecs::Shared<MyMaterial>>(entities[7]).texture, 1);
+}
@@ -0,0 +1,88 @@
+#include "ecs/ecs.hpp"
+
+#include <gtest/gtest.h>
+
+struct WorkerLocalStats {
+    std::uint64_t spawned;
+    std::uint64_t damage;
+};
+
+TEST(WorkerLocalTest, WorkerLocalTest1) {
+    constexpr std::size_t threads = 4;
+    constexpr std::size_t systems = 16;
+    constexpr std::uint64_t count = 1000;
+
+    ecs::WorkerLocal<WorkerLocalStats> stats(
+        [](WorkerLocalStats& total, WorkerLocalStats& local) {
+            total.spawned += local.spawned;
+            total.damage += local.damage;
+        },
+        WorkerLocalStats{0, 0}, threads);
+    ASSERT_EQ(stats.SlotCount(), threads + 1);
+
+    ecs::Scheduler<> scheduler(threads);
+    scheduler.AddStageToBack();
+    scheduler.SetStageExecutionPolicy(0, ecs::ExecutionPolicy::Parallel);
+    for (std::size_t i = 0; i < systems; ++i) {
+        scheduler.AddSystemToFirstStage([&stats] {
+            for (std::uint64_t j = 0; j < count; ++j) {
+                auto& local = stats.Local();
+                ++local.spawned;
+                local.damage += 2;
+            }
+        });
+    }
+
+    // 合并在 Stage 完成时执行，之后的 Stage 可以看到合并结果
+    std::uint64_t observed = 0;
+    scheduler.AddStageCompletionHook(0, [&stats] { stats.Merge(); });
+    scheduler.AddStageToBack();
+    scheduler.AddSystemToStage(1, [&stats, &observed] { observed = stats.Total().spawned; });
+
+    scheduler.Execute();
+    ASSERT_EQ(stats.Total().spawned, systems * count);
+    ASSERT_EQ(stats.Total().damage, 2 * systems * count);
+    ASSERT_EQ(observed, systems * count);
+
+    // 槽位已经重置，再次执行只会累加这一次的结果
+    scheduler.Execute();
+    ASSERT_EQ(stats.Total().spawned, 2 * systems * count);
+
+    stats.Reset();
+    ASSERT_EQ(stats.Total().spawned, 0);
+}
+
+TEST(WorkerLocalTest, WorkerLocalTestInline) {
+    // 调用线程使用第 0 个槽位
+    ecs::WorkerLocal<std::vector<int>> events(
+        [](std::vector<int>& total, std::vector<int>& local) {
+            total.insert(total.end(), local.begin(), local.end());
+        },
+        {}, 2);
+
+    ecs::Scheduler<> scheduler(2);
+    scheduler.AddStageToBack();
+    scheduler.SetStageExecutionPolicy(0, ecs::ExecutionPolicy::Inline);
+    scheduler.AddSystemToFirstStage([&events] { events.Local().push_back(1); });
+    scheduler.AddStageCompletionHook(0, [&events] { events.Merge(); });
+
+    scheduler.Execute();
+    scheduler.Execute();
+    ASSERT_EQ(events.Total(), (std::vector<int>{1, 1}));
+}
+
+TEST(WorkerLocalTest, WorkerLocalTestTooFewSlots) {
+    ecs::WorkerLocal<int> counter([](int& total, int& local) { total += local; }, 0, 1);
+    ASSERT_EQ(counter.SlotCount(), 2);
+
+    // 模拟一个超出槽位数量的工作线程
+    std::thread worker([&counter] {
+        ecs::internal::current_worker_slot = counter.SlotCount();
+        ASSERT_THROW((void)counter.Local(), std::runtime_error);
+    });
+    worker.join();
+
+    ++counter.Local();
+    counter.Merge();
+    ASSERT_EQ(counter.Total(), 1);
+}